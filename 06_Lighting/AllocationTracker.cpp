@@ -0,0 +1,46 @@
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <new>
+
+thread_local AllocationCount AllocationTracker::s_threadCount;
+
+#ifdef TRACK_ALLOCATIONS
+
+/// Global operator new/delete
+
+void* operator new(std::size_t size)
+{
+    AllocationTracker::count(size);
+
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (!pointer)
+        throw std::bad_alloc();
+
+    return pointer;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    AllocationTracker::count(size);
+
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& nothrow) noexcept { return operator new(size, nothrow); }
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+
+void operator delete[](void* pointer) noexcept { free(pointer); }
+
+void operator delete(void* pointer, std::size_t) noexcept { free(pointer); }
+
+void operator delete[](void* pointer, std::size_t) noexcept { free(pointer); }
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { free(pointer); }
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { free(pointer); }
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+/*! \file
+ *  This header declares AllocationCount struct and AllocationTracker class
+ */
+
+#include <cstddef>
+
+/*! \brief
+ *  What a thread has allocated with operator new since it started
+ */
+struct AllocationCount
+{
+    unsigned long long allocations = 0;
+    unsigned long long bytes       = 0;
+};
+
+/*! \class
+ *  Counts the heap allocations of every thread, so the render loop can be checked
+ *  for allocating once it is warm (--alloc-check) and the CPU profiler scopes can
+ *  carry the allocations made inside them.
+ *  \note Counting needs the global operator new/delete of AllocationTracker.cpp,
+ *  which are only there in builds with TRACK_ALLOCATIONS (the CMake option of the
+ *  same name). The counts stay at zero otherwise.
+ */
+class AllocationTracker
+{
+public:
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether this build counts allocations
+     */
+    [[nodiscard]] static constexpr bool isAvailable()
+    {
+#ifdef TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*! \brief
+     *  Getter for the calling thread's count, two of them taken around some work give what the work allocated
+     *  \return Allocations of the thread so far
+     */
+    [[nodiscard]] static AllocationCount getThreadCount() { return s_threadCount; }
+
+    /*! \brief
+     *  Counts an allocation of the calling thread, called by operator new so it must not allocate
+     *  \param bytes Size of the allocation
+     */
+    static void count(std::size_t bytes)
+    {
+        ++s_threadCount.allocations;
+        s_threadCount.bytes += bytes;
+    }
+
+    /*! \brief
+     *  What was allocated between two counts of the same thread
+     *  \param before The earlier count
+     *  \param after The later count
+     *  \return The difference
+     */
+    [[nodiscard]] static AllocationCount difference(const AllocationCount& before, const AllocationCount& after)
+    {
+        return { after.allocations - before.allocations, after.bytes - before.bytes };
+    }
+
+private:
+    /*! \brief
+     *  Constant initialized, so there is nothing to construct on a thread's first allocation
+     */
+    static thread_local AllocationCount s_threadCount;
+};
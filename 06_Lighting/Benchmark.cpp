@@ -0,0 +1,272 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    /// Nearest rank percentile of sorted values
+    double percentile(const std::vector<double>& sorted, double percent)
+    {
+        if ( sorted.empty() )
+            return 0.0;
+
+        auto rank = (size_t)std::ceil(percent / 100.0 * (double)sorted.size());
+
+        return sorted[std::max<size_t>(rank, 1) - 1];
+    }
+
+    /// Bytes a frame sent to the GPU, uniforms as well as buffers and textures
+    unsigned long long uploadBytes(const GLFrameStats& stats)
+    {
+        return stats.uniformBytes + stats.bufferUploadBytes + stats.textureUploadBytes;
+    }
+}
+
+/// Public methods
+
+Benchmark::Benchmark() = default;
+
+void Benchmark::start(GLuint warmupFrames, GLuint measuredFrames)
+{
+    m_enabled        = true;
+    m_warmupFrames   = warmupFrames;
+    m_measuredFrames = measuredFrames;
+    m_frame          = 0;
+
+    // No allocations while measuring
+    m_cpuTimes.reserve(measuredFrames);
+    m_gpuTimes.reserve(measuredFrames);
+    m_frameStats.reserve(measuredFrames);
+
+    glGenQueries(QUERY_COUNT, m_queries);
+}
+
+bool Benchmark::isEnabled() const { return m_enabled; }
+
+void Benchmark::beginFrame()
+{
+    if (!m_enabled)
+        return;
+
+    // The query about to be reused is the oldest, usually done for a while
+    collectQueries(false);
+
+    if (m_queryFrames[m_nextQuery] != NO_FRAME)
+        readQuery(m_nextQuery);
+
+    m_frameStart = std::chrono::steady_clock::now();
+
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_nextQuery]);
+    m_queryFrames[m_nextQuery] = m_frame;
+}
+
+void Benchmark::endFrame()
+{
+    if (!m_enabled)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_nextQuery = (m_nextQuery + 1) % QUERY_COUNT;
+
+    if (m_frame >= m_warmupFrames)
+    {
+        m_cpuTimes.push_back( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count() );
+        m_frameStats.push_back( GLStats::getFrame() );
+    }
+
+    ++m_frame;
+}
+
+void Benchmark::finish()
+{
+    if (!m_enabled)
+        return;
+
+    collectQueries(true);
+    glDeleteQueries(QUERY_COUNT, m_queries);
+
+    m_metrics.clear();
+    addPercentiles("cpu", m_cpuTimes);
+    addPercentiles("gpu", m_gpuTimes);
+
+    if ( GLStats::isAvailable() )
+        addStats();
+}
+
+void Benchmark::addMetric(const std::string& name, double value, bool compared)
+{
+    m_metrics.push_back( { name, value, compared } );
+}
+
+bool Benchmark::writeJson(const char* path, const char* scene) const
+{
+    FILE* out = path ? fopen(path, "w") : stdout;
+    if (!out)
+        return false;
+
+    fprintf(out, "{\n    \"benchmark\": \"%s\",\n    \"warmup\": %u,\n    \"frames\": %u",
+            scene, m_warmupFrames, (GLuint)m_cpuTimes.size());
+
+    for (const auto& metric : m_metrics)
+        fprintf(out, ",\n    \"%s\": %.4f", metric.name.c_str(), metric.value);
+
+    fprintf(out, "\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+
+    return true;
+}
+
+int Benchmark::compareWithBaseline(const char* path, double tolerance) const
+{
+    FILE* in = fopen(path, "r");
+    if (!in)
+    {
+        std::cerr << "Failed to read the baseline " << path << "!" << std::endl;
+        return -1;
+    }
+
+    char line[256];
+    int  regressions = 0;
+
+    while ( fgets(line, sizeof(line), in) )
+    {
+        char   name[128];
+        double baseline = 0.0;
+
+        // Metrics are "name": number lines, the scene is a string and the frame counts are no metrics
+        if ( sscanf(line, " \"%127[^\"]\": %lf", name, &baseline) != 2 ||
+             strcmp(name, "warmup") == 0 || strcmp(name, "frames") == 0 )
+            continue;
+
+        const Metric* metric = findMetric(name);
+
+        // Not comparing is no pass, e.g. a release build has no GL call counts to hold against a debug baseline
+        if (!metric)
+        {
+            printf("MISSING %s: in the baseline, not measured by this run\n", name);
+            ++regressions;
+            continue;
+        }
+
+        if (!metric->compared)
+            continue;
+
+        // Nothing to take a percentage of, anything over a zero baseline is new work
+        if (baseline <= 0.0)
+        {
+            if (metric->value > baseline)
+            {
+                printf("REGRESSION %s: %.4f vs %.4f baseline\n", name, metric->value, baseline);
+                ++regressions;
+            }
+
+            continue;
+        }
+
+        double change = (metric->value - baseline) / baseline * 100.0;
+
+        if (change > tolerance)
+        {
+            printf("REGRESSION %s: %.4f vs %.4f baseline (%+.1f%%)\n", name, metric->value, baseline, change);
+            ++regressions;
+        }
+    }
+
+    fclose(in);
+
+    printf("Baseline %s: %d regression(s) over %.1f%%\n", path, regressions, tolerance);
+
+    return regressions;
+}
+
+/// Private methods
+
+void Benchmark::collectQueries(bool wait)
+{
+    for (GLuint i = 0; i < QUERY_COUNT; ++i)
+    {
+        if (m_queryFrames[i] == NO_FRAME)
+            continue;
+
+        GLint available = GL_FALSE;
+        if (!wait)
+            glGetQueryObjectiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (wait || available)
+            readQuery(i);
+    }
+}
+
+void Benchmark::readQuery(GLuint index)
+{
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(m_queries[index], GL_QUERY_RESULT, &elapsed);
+
+    if (m_queryFrames[index] >= m_warmupFrames)
+        m_gpuTimes.push_back( (double)elapsed / 1000000.0 );
+
+    m_queryFrames[index] = NO_FRAME;
+}
+
+void Benchmark::addPercentiles(const std::string& prefix, std::vector<double> times)
+{
+    // Only p50 and p95 are steady enough to compare against a baseline
+    std::sort( times.begin(), times.end() );
+
+    m_metrics.push_back( { prefix + "_p50_ms", percentile(times, 50.0), true } );
+    m_metrics.push_back( { prefix + "_p95_ms", percentile(times, 95.0), true } );
+    m_metrics.push_back( { prefix + "_p99_ms", percentile(times, 99.0), false } );
+    m_metrics.push_back( { prefix + "_max_ms", times.empty() ? 0.0 : times.back(), false } );
+}
+
+void Benchmark::addStats()
+{
+    unsigned long long totalUploadBytes = 0;
+    unsigned long long maxUploadBytes   = 0;
+
+    for (const auto& stats : m_frameStats)
+    {
+        totalUploadBytes += uploadBytes(stats);
+        maxUploadBytes    = std::max( maxUploadBytes, uploadBytes(stats) );
+    }
+
+    m_metrics.push_back( { "draw_calls_per_frame", meanStat(&GLFrameStats::drawCalls), true } );
+    m_metrics.push_back( { "triangles_per_frame", meanStat(&GLFrameStats::triangles), true } );
+    m_metrics.push_back( { "program_binds_per_frame", meanStat(&GLFrameStats::programBinds), true } );
+    m_metrics.push_back( { "vertex_array_binds_per_frame", meanStat(&GLFrameStats::vertexArrayBinds), true } );
+    m_metrics.push_back( { "texture_binds_per_frame", meanStat(&GLFrameStats::textureBinds), true } );
+    m_metrics.push_back( { "uniform_uploads_per_frame", meanStat(&GLFrameStats::uniformUploads), true } );
+    m_metrics.push_back( { "buffer_upload_bytes_per_frame", meanStat(&GLFrameStats::bufferUploadBytes), true } );
+    m_metrics.push_back( { "texture_upload_bytes_per_frame", meanStat(&GLFrameStats::textureUploadBytes), true } );
+    m_metrics.push_back( { "upload_bytes_per_frame",
+                           m_frameStats.empty() ? 0.0 : (double)totalUploadBytes / (double)m_frameStats.size(), true } );
+    m_metrics.push_back( { "upload_bytes_max", (double)maxUploadBytes, false } );
+}
+
+double Benchmark::meanStat(unsigned long long GLFrameStats::* stat) const
+{
+    if ( m_frameStats.empty() )
+        return 0.0;
+
+    unsigned long long total = 0;
+    for (const auto& stats : m_frameStats)
+        total += stats.*stat;
+
+    return (double)total / (double)m_frameStats.size();
+}
+
+const Benchmark::Metric* Benchmark::findMetric(const char* name) const
+{
+    for (const auto& metric : m_metrics)
+        if (metric.name == name)
+            return &metric;
+
+    return nullptr;
+}
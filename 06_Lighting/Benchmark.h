@@ -0,0 +1,167 @@
+#pragma once
+
+/*! \file
+ *  This header declares Benchmark class
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+/*! \class
+ *  Measures the frames of a run with --benchmark: some warmup frames which are
+ *  not counted, then the measured ones. The CPU time of a frame goes from
+ *  beginFrame to endFrame, so waiting on the swap is not part of it, and the
+ *  GPU time comes from a GL_TIME_ELAPSED query around the same commands.
+ *  Builds with GL_STATS also average the GL calls of a frame: draws, triangles,
+ *  binds and uploads.
+ *  \note The queries go round a ring and are read a few frames later, once
+ *  their result is there, so measuring does not stall the pipeline. The results
+ *  are written as JSON, one metric per line, and the same file is read back as
+ *  the baseline of a later run, which fails when it lacks a metric of the
+ *  baseline: a release build has no GL call counts to hold against a debug
+ *  baseline. The format is the one of the 07_Skybox lesson.
+ */
+class Benchmark
+{
+public:
+    Benchmark();
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    /*! \brief
+     *  Starts measuring, the GL context has to be current
+     *  \param warmupFrames Frames run before measuring
+     *  \param measuredFrames Frames measured
+     */
+    void start(GLuint warmupFrames, GLuint measuredFrames);
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether start was called
+     */
+    [[nodiscard]] bool isEnabled() const;
+
+    /*! \brief
+     *  Marks the start of the frame's work
+     */
+    void beginFrame();
+
+    /*! \brief
+     *  Marks the end of the frame's work, before the buffers are swapped
+     */
+    void endFrame();
+
+    /*! \brief
+     *  Reads the queries still in flight and sums up the run, to call once the last frame is done
+     */
+    void finish();
+
+    /*! \brief
+     *  Adds the result of some other measurement to the JSON, to call after finish
+     *  \param name Name of the metric
+     *  \param value Value of the metric
+     *  \param compared Whether compareWithBaseline looks at it
+     */
+    void addMetric(const std::string& name, double value, bool compared);
+
+    /*! \brief
+     *  Writes the results of finish as JSON
+     *  \param path Path to the file, nullptr for the standard output
+     *  \param scene Name of the scene in the results
+     *  \return Whether the file could be written
+     */
+    bool writeJson(const char* path, const char* scene) const;
+
+    /*! \brief
+     *  Compares with the JSON of an earlier run, a metric regresses when it is
+     *  over the baseline by more than the tolerance, or over a baseline of zero at all
+     *  \param path Path to the baseline
+     *  \param tolerance Tolerance in percent
+     *  \return Number of regressions and of metrics this run lacks, -1 when the baseline can't be read
+     */
+    int compareWithBaseline(const char* path, double tolerance) const;
+
+private:
+    /*! \brief
+     *  Frames a GPU time is read behind, the driver rarely queues more
+     */
+    static constexpr GLuint QUERY_COUNT = 4;
+    static constexpr GLuint NO_FRAME    = 0xFFFFFFFF;
+
+    struct Metric
+    {
+        std::string name;
+        double      value;
+        bool        compared;	// Whether a baseline comparison looks at it, the maxima are too noisy to
+    };
+
+    bool   m_enabled        = false;
+    GLuint m_warmupFrames   = 0;
+    GLuint m_measuredFrames = 0;
+    GLuint m_frame          = 0;
+
+    /*! \brief
+     *  Current frame
+     */
+    std::chrono::steady_clock::time_point m_frameStart;
+
+    /*! \brief
+     *  GPU time queries, and the frame each one was issued in
+     */
+    GLuint m_queries[QUERY_COUNT]     = {};
+    GLuint m_queryFrames[QUERY_COUNT] = { NO_FRAME, NO_FRAME, NO_FRAME, NO_FRAME };
+    GLuint m_nextQuery                = 0;
+
+    /*! \brief
+     *  One sample per measured frame, times in milliseconds
+     */
+    std::vector<double>       m_cpuTimes;
+    std::vector<double>       m_gpuTimes;
+    std::vector<GLFrameStats> m_frameStats;
+
+    std::vector<Metric> m_metrics;
+
+    /*! \brief
+     *  Method to read the queries whose results are there
+     *  \param wait Whether to wait for the ones still running
+     */
+    void collectQueries(bool wait);
+
+    /*! \brief
+     *  Method to read a query result, waiting for it if needed
+     *  \param index Index of the query in the ring
+     */
+    void readQuery(GLuint index);
+
+    /*! \brief
+     *  Method to add p50, p95, p99 and max of the times to the metrics
+     *  \param prefix Prefix of the metric names
+     *  \param times Times in milliseconds
+     */
+    void addPercentiles(const std::string& prefix, std::vector<double> times);
+
+    /*! \brief
+     *  Method to add the means of the GL call counts to the metrics
+     */
+    void addStats();
+
+    /*! \brief
+     *  Method to average a GL call count over the measured frames
+     *  \param stat The count
+     *  \return The mean
+     */
+    [[nodiscard]] double meanStat(unsigned long long GLFrameStats::* stat) const;
+
+    /*! \brief
+     *  Method to look a metric up by its name
+     *  \param name Name in the JSON
+     *  \return The metric, nullptr when this run has none of that name
+     */
+    [[nodiscard]] const Metric* findMetric(const char* name) const;
+};
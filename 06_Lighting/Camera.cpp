@@ -107,6 +107,19 @@ glm::vec3 Camera::getPosition() const { return m_position; }
 
 glm::vec3 Camera::getFront() const { return m_front; }
 
+GLfloat Camera::getYaw() const { return m_yaw; }
+
+GLfloat Camera::getPitch() const { return m_pitch; }
+
+void Camera::setPose(const glm::vec3& position, GLfloat yaw, GLfloat pitch)
+{
+    m_position = position;
+    m_yaw      = yaw;
+    m_pitch    = pitch;
+
+    updateCameraVectors();
+}
+
 /// Private methods
 
 void Camera::updateCameraVectors()
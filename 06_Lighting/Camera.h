@@ -121,6 +121,26 @@ public:
      */
     [[nodiscard]] glm::vec3 getFront() const;
 
+    /*! \brief
+     *  Getter for the yaw
+     *  \see m_yaw
+     */
+    [[nodiscard]] GLfloat getYaw() const;
+
+    /*! \brief
+     *  Getter for the pitch
+     *  \see m_pitch
+     */
+    [[nodiscard]] GLfloat getPitch() const;
+
+    /*! \brief
+     *  Places the camera directly, as when it is played back along a recorded path
+     *  \param position New position
+     *  \param yaw New yaw
+     *  \param pitch New pitch
+     */
+    void setPose(const glm::vec3& position, GLfloat yaw, GLfloat pitch);
+
 private:
     /*! \brief
      *  Camera Attributes
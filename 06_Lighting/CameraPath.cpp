@@ -0,0 +1,117 @@
+#include "CameraPath.h"
+
+#include <cstring>
+
+/// Public methods
+
+CameraPath::~CameraPath() { endRecording(); }
+
+bool CameraPath::beginRecording(const char* path)
+{
+    endRecording();
+
+    m_file = fopen(path, "wb");
+    if (!m_file)
+        return false;
+
+    m_count = 0;
+    writeHeader();
+
+    return true;
+}
+
+void CameraPath::record(GLfloat time, const Camera& camera)
+{
+    if (!m_file)
+        return;
+
+    if (m_count == 0)
+        m_startTime = time;
+
+    glm::vec3 position = camera.getPosition();
+    GLfloat sample[SAMPLE_FLOATS] = { time - m_startTime,
+                                      position.x, position.y, position.z,
+                                      camera.getYaw(), camera.getPitch() };
+
+    fwrite(sample, sizeof(sample), 1, m_file);
+    ++m_count;
+}
+
+void CameraPath::endRecording()
+{
+    if (!m_file)
+        return;
+
+    fseek(m_file, 0, SEEK_SET);
+    writeHeader();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+bool CameraPath::load(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in)
+        return false;
+
+    char         magic[4];
+    unsigned int header[2];
+    bool         loaded = false;
+
+    if ( fread(magic, sizeof(magic), 1, in) == 1 && memcmp(magic, MAGIC, sizeof(magic)) == 0 &&
+         fread(header, sizeof(header), 1, in) == 1 && header[0] == VERSION && header[1] != 0 )
+    {
+        m_samples.resize(header[1] * SAMPLE_FLOATS);
+        loaded = fread(m_samples.data(), SAMPLE_FLOATS * sizeof(GLfloat), header[1], in) == header[1];
+    }
+
+    fclose(in);
+
+    if (!loaded)
+        m_samples.clear();
+
+    m_cursor = 0;
+
+    return loaded;
+}
+
+bool CameraPath::apply(GLfloat time, Camera& camera)
+{
+    size_t sampleCount = m_samples.size() / SAMPLE_FLOATS;
+
+    if (sampleCount == 0 || time > getDuration())
+        return false;
+
+    // Playback only goes forward, so the segment is searched from where the last one was
+    if (time < m_samples[m_cursor * SAMPLE_FLOATS])
+        m_cursor = 0;
+
+    while (m_cursor + 1 < sampleCount && m_samples[(m_cursor + 1) * SAMPLE_FLOATS] <= time)
+        ++m_cursor;
+
+    const GLfloat* a = &m_samples[m_cursor * SAMPLE_FLOATS];
+    const GLfloat* b = m_cursor + 1 < sampleCount ? a + SAMPLE_FLOATS : a;
+    GLfloat        t = b[0] > a[0] ? (time - a[0]) / (b[0] - a[0]) : 0.0f;
+
+    glm::vec3 from(a[1], a[2], a[3]);
+    glm::vec3 to(b[1], b[2], b[3]);
+
+    camera.setPose( from + (to - from) * t, a[4] + (b[4] - a[4]) * t, a[5] + (b[5] - a[5]) * t );
+
+    return true;
+}
+
+GLfloat CameraPath::getDuration() const
+{
+    return m_samples.empty() ? 0.0f : m_samples[m_samples.size() - SAMPLE_FLOATS];
+}
+
+/// Private methods
+
+void CameraPath::writeHeader()
+{
+    unsigned int header[2] = { VERSION, m_count };
+
+    fwrite(MAGIC, 4, 1, m_file);
+    fwrite(header, sizeof(header), 1, m_file);
+}
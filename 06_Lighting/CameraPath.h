@@ -0,0 +1,97 @@
+#pragma once
+
+/*! \file
+ *  This header declares CameraPath class
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Camera.h"
+
+/*! \class
+ *  Records where the camera is every frame and plays it back at a fixed timestep,
+ *  so every run can be benchmarked along the same flythrough.
+ *  \note The file format is the one of the 07_Skybox lesson, a path recorded in
+ *  one scene plays back in the other. A 12 byte header ("CPTH", the format version
+ *  and the number of samples as 32 bit integers) is followed by the samples, six
+ *  floats each: time since the recording started, position, yaw and pitch.
+ */
+class CameraPath
+{
+public:
+    CameraPath() = default;
+
+    CameraPath(const CameraPath&) = delete;
+    CameraPath& operator=(const CameraPath&) = delete;
+
+    /*! \brief
+     *  Destructor, finishes the recording if there is one
+     */
+    ~CameraPath();
+
+    /*! \brief
+     *  Starts writing a new path, samples go straight to the file as they are recorded
+     *  \param path Path to the file
+     *  \return Whether the file could be created
+     */
+    bool beginRecording(const char* path);
+
+    /*! \brief
+     *  Appends the camera state, the first sample recorded is time zero
+     *  \param time Current time in seconds
+     *  \param camera The camera to record
+     */
+    void record(GLfloat time, const Camera& camera);
+
+    /*! \brief
+     *  Finishes the file, the sample count in the header is only known now
+     */
+    void endRecording();
+
+    /*! \brief
+     *  Reads a recorded path to play it back
+     *  \param path Path to the file
+     *  \return Whether a valid path was read
+     */
+    bool load(const char* path);
+
+    /*! \brief
+     *  Puts the camera where the path is at the given time, interpolating between samples
+     *  \param time Playback time in seconds
+     *  \param camera The camera to move
+     *  \return False once the time is past the end of the path
+     */
+    bool apply(GLfloat time, Camera& camera);
+
+    /*! \brief
+     *  Getter for the duration
+     *  \return The time of the last sample
+     */
+    [[nodiscard]] GLfloat getDuration() const;
+
+private:
+    static constexpr char         MAGIC[5]      = "CPTH";
+    static constexpr unsigned int VERSION       = 1;
+    static constexpr size_t       SAMPLE_FLOATS = 6;
+
+    /*! \brief
+     *  Recording
+     */
+    FILE*        m_file      = nullptr;
+    unsigned int m_count     = 0;
+    GLfloat      m_startTime = 0.0f;
+
+    /*! \brief
+     *  Playback
+     */
+    std::vector<GLfloat> m_samples;
+    size_t               m_cursor = 0;
+
+    /*! \brief
+     *  Method to write the header at the current file position
+     */
+    void writeHeader();
+};
@@ -0,0 +1,122 @@
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+
+std::atomic<bool>               CpuProfiler::s_enabled { false };
+std::atomic<CpuProfiler::Ring*> CpuProfiler::s_rings { nullptr };
+
+namespace
+{
+    std::atomic<unsigned int> threadCount { 0 };
+
+    /// The start of the trace, set by the first call
+    std::chrono::steady_clock::time_point epoch()
+    {
+        static const auto start = std::chrono::steady_clock::now();
+
+        return start;
+    }
+}
+
+/// Public methods
+
+void CpuProfiler::enable()
+{
+    epoch();
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::disable() { s_enabled.store(false, std::memory_order_relaxed); }
+
+void CpuProfiler::setThreadName(const char* name) { threadRing()->name = name; }
+
+long long CpuProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch()).count();
+}
+
+void CpuProfiler::record(const char* name, long long begin, long long end, const AllocationCount& allocated)
+{
+    Ring*              ring  = threadRing();
+    unsigned long long next  = ring->written.load(std::memory_order_relaxed);
+    Event&             event = ring->events[next % RING_SIZE];
+
+    event.name      = name;
+    event.begin     = begin;
+    event.end       = end;
+    event.allocated = allocated;
+
+    // Publishes the event to writeTrace
+    ring->written.store(next + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::writeTrace(const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (!out)
+        return false;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+
+    for (Ring* ring = s_rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        if (ring->name)
+        {
+            fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", ring->id, ring->name);
+            first = false;
+        }
+
+        unsigned long long written = ring->written.load(std::memory_order_acquire);
+        unsigned long long start   = written > RING_SIZE ? written - RING_SIZE : 0;
+
+        for (unsigned long long i = start; i < written; ++i)
+        {
+            Event event = ring->events[i % RING_SIZE];
+
+            // The thread has gone round the ring onto this event while it was read
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (ring->written.load(std::memory_order_relaxed) - i >= RING_SIZE)
+                continue;
+
+            // Microseconds, with the nanoseconds kept as decimals
+            long long duration = event.end - event.begin;
+            fprintf(out, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld",
+                    first ? "" : ",\n", event.name, ring->id,
+                    event.begin / 1000, event.begin % 1000, duration / 1000, duration % 1000);
+
+            if ( AllocationTracker::isAvailable() )
+                fprintf(out, ",\"args\":{\"allocations\":%llu,\"allocated_bytes\":%llu}",
+                        event.allocated.allocations, event.allocated.bytes);
+
+            fprintf(out, "}");
+            first = false;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0;
+}
+
+/// Private methods
+
+CpuProfiler::Ring* CpuProfiler::threadRing()
+{
+    thread_local Ring* ring = nullptr;
+
+    if (!ring)
+    {
+        ring       = new Ring();
+        ring->id   = ++threadCount;
+        ring->next = s_rings.load(std::memory_order_relaxed);
+
+        while ( !s_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed) )
+            ;
+    }
+
+    return ring;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+/*! \file
+ *  This header declares CpuProfiler class, CpuProfileScope class and CPU_PROFILE_SCOPE macro
+ */
+
+#include <atomic>
+
+#include "AllocationTracker.h"
+
+/*! \brief
+ *  Marks the rest of the enclosing block as a scope of CPU work, named with a string literal.
+ *  While the profiler is disabled it costs a relaxed load and a branch
+ */
+#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_JOIN(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_JOIN(a, b) CPU_PROFILE_JOIN_EXPANDED(a, b)
+#define CPU_PROFILE_JOIN_EXPANDED(a, b) a##b
+
+/*! \class
+ *  Records scopes of CPU work on every thread and writes them as a Chrome trace,
+ *  which chrome://tracing and ui.perfetto.dev open.
+ *  \note Each thread writes to its own ring of events, so recording takes no lock
+ *  and threads never wait on each other; the rings are only read by writeTrace.
+ *  A ring keeps the last RING_SIZE scopes of its thread. In builds with
+ *  TRACK_ALLOCATIONS every scope also has the heap allocations made in it, as
+ *  arguments of its event. The format is the one of the 07_Skybox lesson.
+ */
+class CpuProfiler
+{
+public:
+    static constexpr unsigned long long RING_SIZE = 1 << 16;
+
+    /*! \brief
+     *  Starts recording, the first scopes are usually the ones of loading so this goes early
+     */
+    static void enable();
+
+    /*! \brief
+     *  Stops recording
+     */
+    static void disable();
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether scopes are recorded
+     */
+    [[nodiscard]] static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /*! \brief
+     *  Names the calling thread in the trace
+     *  \param name Name of the thread, has to stay valid (a string literal)
+     */
+    static void setThreadName(const char* name);
+
+    /*! \brief
+     *  Time function
+     *  \return Nanoseconds since enable
+     */
+    [[nodiscard]] static long long now();
+
+    /*! \brief
+     *  Adds a finished scope to the calling thread's ring
+     *  \param name Name of the scope, has to stay valid (a string literal)
+     *  \param begin Start, from now
+     *  \param end End, from now
+     *  \param allocated What the scope allocated
+     */
+    static void record(const char* name, long long begin, long long end, const AllocationCount& allocated);
+
+    /*! \brief
+     *  Writes the scopes recorded so far as Chrome trace JSON. Threads can go on
+     *  recording meanwhile, events they overwrite during the copy are left out
+     *  \param path Path to the file
+     *  \return Whether the file could be written
+     */
+    static bool writeTrace(const char* path);
+
+private:
+    struct Event
+    {
+        const char* name  = nullptr;
+        long long   begin = 0;
+        long long   end   = 0;
+
+        AllocationCount allocated;
+    };
+
+    /*! \brief
+     *  A thread's events, only ever written by that thread. Rings stay until the
+     *  program ends, so the events of a thread that is gone are still written out
+     */
+    struct Ring
+    {
+        Event                           events[RING_SIZE];
+        std::atomic<unsigned long long> written { 0 };
+        unsigned int                    id   = 0;
+        const char*                     name = nullptr;
+        Ring*                           next = nullptr;
+    };
+
+    static std::atomic<bool> s_enabled;
+
+    /*! \brief
+     *  Every thread's ring, the newest first
+     */
+    static std::atomic<Ring*> s_rings;
+
+    /*! \brief
+     *  Method to get the ring of the calling thread, made on its first scope and pushed onto the list without a lock
+     *  \return The ring
+     */
+    static Ring* threadRing();
+};
+
+/*! \class
+ *  Times from its construction to the end of the enclosing block
+ *  \see CPU_PROFILE_SCOPE
+ */
+class CpuProfileScope
+{
+public:
+    /*! \brief
+     *  Parameterized constructor, starts the scope
+     *  \param name Name of the scope, has to stay valid (a string literal)
+     */
+    explicit CpuProfileScope(const char* name)
+    {
+        if ( CpuProfiler::isEnabled() )
+        {
+            m_name  = name;
+            m_begin = CpuProfiler::now();
+            m_allocationsBefore = AllocationTracker::getThreadCount();
+        }
+    }
+
+    ~CpuProfileScope() { end(); }
+
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+    /*! \brief
+     *  Ends the scope before the end of the block
+     */
+    void end()
+    {
+        if (m_name)
+        {
+            CpuProfiler::record( m_name, m_begin, CpuProfiler::now(),
+                                 AllocationTracker::difference( m_allocationsBefore, AllocationTracker::getThreadCount() ) );
+            m_name = nullptr;
+        }
+    }
+
+private:
+    const char* m_name  = nullptr;
+    long long   m_begin = 0;
+
+    AllocationCount m_allocationsBefore;
+};
@@ -0,0 +1,549 @@
+#define GL_CAPTURE_IMPLEMENTATION
+#include "GLCapture.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+const char*      GLCapture::s_path         = nullptr;
+GLuint           GLCapture::s_frame        = 0;
+GLuint           GLCapture::s_captureFrame = 0;
+bool             GLCapture::s_pending      = false;
+bool             GLCapture::s_failed       = false;
+FILE*            GLCapture::s_file         = nullptr;
+std::set<GLuint> GLCapture::s_buffers;
+std::set<GLuint> GLCapture::s_textures;
+std::set<GLuint> GLCapture::s_programs;
+std::set<GLuint> GLCapture::s_vertexArrays;
+
+/// Public methods
+
+void GLCapture::captureFrame(const char* path, GLuint frame)
+{
+    s_path         = path;
+    s_captureFrame = frame;
+    s_pending      = true;
+}
+
+void GLCapture::beginFrame()
+{
+    if (!s_pending || s_frame++ != s_captureFrame)
+        return;
+
+    s_pending = false;
+    s_file    = fopen(s_path, "wb");
+
+    if (!s_file)
+    {
+        s_failed = true;
+        return;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    write(MAGIC);
+    write(VERSION);
+    write(viewport[2]);
+    write(viewport[3]);
+
+    recordState(viewport);
+}
+
+void GLCapture::endFrame()
+{
+    if (!s_file)
+        return;
+
+    writeRecord(END);
+
+    // A texture it couldn't read back has already failed the capture
+    s_failed = ferror(s_file) != 0 || s_failed;
+    s_failed = fclose(s_file) != 0 || s_failed;
+    s_file   = nullptr;
+
+    s_buffers.clear();
+    s_textures.clear();
+    s_programs.clear();
+    s_vertexArrays.clear();
+}
+
+void GLCapture::writeData(const void* data, GLuint size)
+{
+    write(size);
+
+    if (size != 0)
+        fwrite(data, 1, size, s_file);
+}
+
+void GLCapture::useBuffer(GLuint buffer)
+{
+    if ( buffer != 0 && s_buffers.insert(buffer).second )
+        recordBuffer(buffer);
+}
+
+void GLCapture::useTexture(GLenum target, GLuint texture)
+{
+    if ( texture != 0 && s_textures.insert(texture).second )
+        recordTexture(target, texture);
+}
+
+void GLCapture::useProgram(GLuint program)
+{
+    if ( program != 0 && s_programs.insert(program).second )
+        recordProgram(program);
+}
+
+void GLCapture::useVertexArray(GLuint vertexArray)
+{
+    if ( vertexArray != 0 && s_vertexArrays.insert(vertexArray).second )
+        recordVertexArray(vertexArray);
+}
+
+void GLCapture::writePixels(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels)
+{
+    GLint alignment = 4, unpackBuffer = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+
+    GLuint rowSize = width * pixelSize(format, type);
+    GLuint size    = height * ( (rowSize + alignment - 1) / alignment * alignment );
+
+    write(alignment);
+
+    if (unpackBuffer != 0)
+    {
+        std::vector<GLubyte> data(size);
+        glGetBufferSubData( GL_PIXEL_UNPACK_BUFFER, (GLintptr)pixels, size, data.data() );
+        writeData( data.data(), size );
+    }
+    else
+        writeData( pixels, pixels ? size : 0 );
+}
+
+GLuint GLCapture::uniformComponents(GLenum type)
+{
+    switch (type)
+    {
+        case GL_FLOAT_VEC2:
+        case GL_INT_VEC2:
+        case GL_BOOL_VEC2:
+            return 2;
+        case GL_FLOAT_VEC3:
+        case GL_INT_VEC3:
+        case GL_BOOL_VEC3:
+            return 3;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_BOOL_VEC4:
+        case GL_FLOAT_MAT2:
+            return 4;
+        case GL_FLOAT_MAT3:
+            return 9;
+        case GL_FLOAT_MAT4:
+            return 16;
+        default:
+            return 1;
+    }
+}
+
+bool GLCapture::uniformIsInteger(GLenum type)
+{
+    switch (type)
+    {
+        case GL_FLOAT:
+        case GL_FLOAT_VEC2:
+        case GL_FLOAT_VEC3:
+        case GL_FLOAT_VEC4:
+        case GL_FLOAT_MAT2:
+        case GL_FLOAT_MAT3:
+        case GL_FLOAT_MAT4:
+            return false;
+        default:
+            return true;
+    }
+}
+
+GLuint GLCapture::pixelSize(GLenum format, GLenum type)
+{
+    GLuint channels = 4;
+
+    switch (format)
+    {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT:
+            channels = 1;
+            break;
+        case GL_RG:
+            channels = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+            channels = 3;
+            break;
+        default:
+            break;
+    }
+
+    switch (type)
+    {
+        case GL_FLOAT:
+        case GL_UNSIGNED_INT:
+        case GL_INT:
+            return channels * 4;
+        case GL_HALF_FLOAT:
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+            return channels * 2;
+        case GL_UNSIGNED_INT_5_9_9_9_REV:
+        case GL_UNSIGNED_INT_10F_11F_11F_REV:
+            return 4;
+        default:
+            return channels;
+    }
+}
+
+/// Private methods
+
+void GLCapture::recordState(const GLint viewport[4])
+{
+    GLfloat clearColor[4];
+    GLint   depthFunc, depthMask, blendSource, blendDestination, program, vertexArray, arrayBuffer, activeTexture;
+
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetIntegerv(GL_DEPTH_WRITEMASK, &depthMask);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+
+    writeRecord(VIEWPORT, viewport[0], viewport[1], viewport[2], viewport[3]);
+    writeRecord(CLEAR_COLOR, clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+    for (GLenum capability : { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE })
+        writeRecord(glIsEnabled(capability) ? ENABLE : DISABLE, capability);
+
+    writeRecord(DEPTH_FUNC, depthFunc);
+    writeRecord(DEPTH_MASK, depthMask);
+    writeRecord(BLEND_FUNC, blendSource, blendDestination);
+
+    useProgram(program);
+    writeRecord(USE_PROGRAM, program);
+    useVertexArray(vertexArray);
+    writeRecord(BIND_VERTEX_ARRAY, vertexArray);
+    useBuffer(arrayBuffer);
+    writeRecord(BIND_BUFFER, (GLuint)GL_ARRAY_BUFFER, arrayBuffer);
+
+    const GLenum targets[]  = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP };
+    const GLenum bindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP };
+
+    for (GLuint unit = 0; unit < TEXTURE_UNITS; ++unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+
+        for (GLuint i = 0; i < 2; ++i)
+        {
+            GLint texture = 0;
+            glGetIntegerv(bindings[i], &texture);
+
+            if (texture == 0)
+                continue;
+
+            useTexture(targets[i], texture);
+            writeRecord(ACTIVE_TEXTURE, GL_TEXTURE0 + unit);
+            writeRecord(BIND_TEXTURE, targets[i], texture);
+        }
+    }
+
+    glActiveTexture(activeTexture);
+    writeRecord(ACTIVE_TEXTURE, activeTexture);
+}
+
+void GLCapture::recordBuffer(GLuint buffer)
+{
+    GLint previous = 0, size = 0, usage = 0;
+    glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previous);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage);
+
+    std::vector<GLubyte> contents(size);
+    if (size != 0)
+        glGetBufferSubData( GL_COPY_READ_BUFFER, 0, size, contents.data() );
+
+    glBindBuffer(GL_COPY_READ_BUFFER, previous);
+
+    writeRecord(BUFFER, buffer, usage);
+    writeData( contents.data(), size );
+}
+
+void GLCapture::recordTexture(GLenum target, GLuint texture)
+{
+    bool   cubeMap     = target == GL_TEXTURE_CUBE_MAP;
+    GLenum levelTarget = cubeMap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    GLuint faces       = cubeMap ? 6 : 1;
+
+    GLint previous = 0, packAlignment = 4, packBuffer = 0;
+    glGetIntegerv(cubeMap ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D, &previous);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+    glBindTexture(target, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    GLint internalFormat = GL_RGBA8, compressed = GL_FALSE, levels = 0, width = 0;
+    glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+    // The levels there are, up to the first without storage
+    while (levels < 16)
+    {
+        glGetTexLevelParameteriv(levelTarget, levels, GL_TEXTURE_WIDTH, &width);
+        if (width == 0)
+            break;
+
+        ++levels;
+    }
+
+    // Read back in the layout of the internal format, so nothing is lost and nothing is made up
+    GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+
+    switch (internalFormat)
+    {
+        case GL_RGBA:
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:
+            break;
+        case GL_RED:
+        case GL_R8:
+            format = GL_RED;
+            break;
+        case GL_RG:
+        case GL_RG8:
+            format = GL_RG;
+            break;
+        case GL_RGB:
+        case GL_RGB8:
+        case GL_SRGB8:
+            format = GL_RGB;
+            break;
+        case GL_R16F:
+        case GL_R32F:
+            format = GL_RED;
+            type   = GL_FLOAT;
+            break;
+        case GL_RG16F:
+        case GL_RG32F:
+            format = GL_RG;
+            type   = GL_FLOAT;
+            break;
+        case GL_RGB16F:
+        case GL_RGB32F:
+            format = GL_RGB;
+            type   = GL_FLOAT;
+            break;
+        case GL_RGBA16F:
+        case GL_RGBA32F:
+            type = GL_FLOAT;
+            break;
+        case GL_RGB9_E5:
+            format = GL_RGB;
+            type   = GL_UNSIGNED_INT_5_9_9_9_REV;
+            break;
+        case GL_R11F_G11F_B10F:
+            format = GL_RGB;
+            type   = GL_UNSIGNED_INT_10F_11F_11F_REV;
+            break;
+        default:
+            // Compressed, or a format with no exact readback
+            format = 0;
+            type   = 0;
+            break;
+    }
+
+    if (format == 0 && compressed != GL_TRUE)
+    {
+        std::cerr << "Can't capture texture " << texture << ", internal format 0x" << std::hex << internalFormat
+                  << std::dec << " has no readback!" << std::endl;
+        s_failed = true;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+        glBindTexture(target, previous);
+        return;
+    }
+
+    writeRecord(TEXTURE, texture, target, internalFormat, format, type, levels);
+
+    for (GLenum parameter : { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R })
+    {
+        GLint value = 0;
+        glGetTexParameteriv(target, parameter, &value);
+        write(value);
+    }
+
+    std::vector<GLubyte> pixels;
+
+    for (GLint level = 0; level < levels; ++level)
+    {
+        for (GLuint face = 0; face < faces; ++face)
+        {
+            GLint faceWidth = 0, faceHeight = 0;
+            glGetTexLevelParameteriv(levelTarget + face, level, GL_TEXTURE_WIDTH, &faceWidth);
+            glGetTexLevelParameteriv(levelTarget + face, level, GL_TEXTURE_HEIGHT, &faceHeight);
+
+            if (format == 0)
+            {
+                // The blocks as they are, glCompressedTexImage2D takes them back
+                GLint size = 0;
+                glGetTexLevelParameteriv(levelTarget + face, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                pixels.resize(size);
+                glGetCompressedTexImage( levelTarget + face, level, pixels.data() );
+            }
+            else
+            {
+                pixels.resize( faceWidth * faceHeight * pixelSize(format, type) );
+                glGetTexImage( levelTarget + face, level, format, type, pixels.data() );
+            }
+
+            write(faceWidth);
+            write(faceHeight);
+            writeData( pixels.data(), (GLuint)pixels.size() );
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+    glBindTexture(target, previous);
+}
+
+void GLCapture::recordProgram(GLuint program)
+{
+    GLuint  shaders[8];
+    GLsizei shaderCount = 0;
+    glGetAttachedShaders(program, 8, &shaderCount, shaders);
+
+    writeRecord(PROGRAM, program, shaderCount);
+
+    std::vector<GLchar> source;
+
+    for (GLsizei i = 0; i < shaderCount; ++i)
+    {
+        GLint type = 0, length = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length);
+
+        source.resize(length + 1);
+        glGetShaderSource( shaders[i], length + 1, &length, source.data() );
+
+        write(type);
+        writeData( source.data(), length + 1 );
+    }
+
+    GLint uniformCount = 0, elementCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        GLchar name[256];
+        GLint  size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, sizeof(name), nullptr, &size, &type, name);
+        elementCount += size;
+    }
+
+    write(elementCount);
+
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        GLchar name[256];
+        GLint  size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, sizeof(name) - 8, nullptr, &size, &type, name);
+
+        // Arrays are named after their first element, the others are found by their index; a member of a
+        // struct array is a uniform of its own, with its whole name
+        GLchar* bracket = size > 1 ? strrchr(name, '[') : nullptr;
+
+        for (GLint element = 0; element < size; ++element)
+        {
+            if (bracket)
+                sprintf(bracket, "[%d]", element);
+
+            GLint location = glGetUniformLocation(program, name);
+            GLint values[16];
+
+            if ( uniformIsInteger(type) )
+                glGetUniformiv(program, location, values);
+            else
+                glGetUniformfv( program, location, (GLfloat*)values );
+
+            writeData( name, (GLuint)strlen(name) + 1 );
+            write(location);
+            write(type);
+            writeData( values, uniformComponents(type) * sizeof(GLint) );
+        }
+    }
+}
+
+void GLCapture::recordVertexArray(GLuint vertexArray)
+{
+    struct Attribute
+    {
+        GLint   index, size, type, normalized, integer, stride, buffer, divisor;
+        GLvoid* offset;
+    };
+
+    GLint previous = 0, elementBuffer = 0, attributeCount = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attributeCount);
+    glBindVertexArray(vertexArray);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+
+    std::vector<Attribute> attributes;
+
+    for (GLint index = 0; index < std::min(attributeCount, 16); ++index)
+    {
+        GLint enabled = 0;
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+        if (!enabled)
+            continue;
+
+        Attribute attribute {};
+        attribute.index = index;
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute.size);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_TYPE, &attribute.type);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute.normalized);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attribute.integer);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute.stride);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &attribute.buffer);
+        glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &attribute.divisor);
+        glGetVertexAttribPointerv(index, GL_VERTEX_ATTRIB_ARRAY_POINTER, &attribute.offset);
+        attributes.push_back(attribute);
+    }
+
+    glBindVertexArray(previous);
+
+    // The buffers go first, so GLReplay has them when it makes the vertex array
+    useBuffer(elementBuffer);
+    for (const auto& attribute : attributes)
+        useBuffer(attribute.buffer);
+
+    writeRecord( VERTEX_ARRAY, vertexArray, elementBuffer, (GLuint)attributes.size() );
+
+    for (const auto& attribute : attributes)
+    {
+        write(attribute.index);
+        write(attribute.size);
+        write(attribute.type);
+        write(attribute.normalized);
+        write(attribute.integer);
+        write(attribute.stride);
+        write( (GLuint)(size_t)attribute.offset );
+        write(attribute.buffer);
+        write(attribute.divisor);
+    }
+}
@@ -0,0 +1,592 @@
+#pragma once
+
+/*! \file
+ *  This header declares GLCapture class, and in builds without NDEBUG routes
+ *  the GL calls a frame makes through capturing wrappers
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#include <GL/glew.h>
+
+#ifndef NDEBUG
+#define GL_CAPTURE
+#endif
+
+/*! \class
+ *  Captures the GL calls of one frame into a trace, which GLReplay runs again
+ *  without the lesson, its assets or a window.
+ *  \note The calls recorded are the ones the lessons make in a frame (the
+ *  wrappers below); the objects they use (buffers, textures, programs with
+ *  their uniform values, vertex arrays) are read back from GL the first time the
+ *  frame uses them and written right before that use. The state a frame relies
+ *  on without setting it (viewport, clear color, depth, blending, bindings) is
+ *  written first. GLStats wraps these wrappers in turn, and release builds
+ *  can't capture. The format is the one of the 07_Skybox lesson:
+ *
+ *  A trace starts with MAGIC, VERSION and the width and height of the viewport,
+ *  as 32 bit words. Records follow, each a byte for its Record and its arguments
+ *  as 32 bit words (floats as their bits), data as a word for the size and then
+ *  the bytes; END closes the trace.
+ */
+class GLCapture
+{
+public:
+    static constexpr GLuint MAGIC   = 0x52544C47;	// "GLTR"
+    static constexpr GLuint VERSION = 1;
+
+    /*! \brief
+     *  Texture units whose bindings a trace starts with
+     */
+    static constexpr GLuint TEXTURE_UNITS = 16;
+
+    enum Record : GLubyte
+    {
+        END,
+
+        // Objects: the captured name, then the contents
+        BUFFER,
+        TEXTURE,
+        PROGRAM,
+        VERTEX_ARRAY,
+
+        // Calls, with the arguments they were made with
+        VIEWPORT,
+        CLEAR_COLOR,
+        CLEAR,
+        ENABLE,
+        DISABLE,
+        DEPTH_FUNC,
+        DEPTH_MASK,
+        BLEND_FUNC,
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        BIND_BUFFER,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        GET_UNIFORM_LOCATION,
+        UNIFORM_1I,
+        UNIFORM_1F,
+        UNIFORM_2F,
+        UNIFORM_3F,
+        UNIFORM_MATRIX_4FV,
+        BUFFER_DATA,
+        BUFFER_SUB_DATA,
+        TEX_IMAGE_2D,
+        TEX_PARAMETER_I,
+        GENERATE_MIPMAP,
+        DRAW_ARRAYS,
+        DRAW_ELEMENTS,
+
+        RECORD_COUNT
+    };
+
+    /*! \brief
+     *  What follows the byte of a call record: its argument words and whether
+     *  data comes after them. The objects (and END) have layouts of their own
+     */
+    struct RecordLayout
+    {
+        Record record;
+        GLuint arguments;
+        bool   data;
+    };
+
+    static constexpr RecordLayout RECORD_LAYOUTS[] = {
+        { END, 0, false },
+        { BUFFER, 0, false },
+        { TEXTURE, 0, false },
+        { PROGRAM, 0, false },
+        { VERTEX_ARRAY, 0, false },
+        { VIEWPORT, 4, false },
+        { CLEAR_COLOR, 4, false },
+        { CLEAR, 1, false },
+        { ENABLE, 1, false },
+        { DISABLE, 1, false },
+        { DEPTH_FUNC, 1, false },
+        { DEPTH_MASK, 1, false },
+        { BLEND_FUNC, 2, false },
+        { USE_PROGRAM, 1, false },
+        { BIND_VERTEX_ARRAY, 1, false },
+        { BIND_BUFFER, 2, false },
+        { ACTIVE_TEXTURE, 1, false },
+        { BIND_TEXTURE, 2, false },
+        { GET_UNIFORM_LOCATION, 1, true },
+        { UNIFORM_1I, 2, false },
+        { UNIFORM_1F, 2, false },
+        { UNIFORM_2F, 3, false },
+        { UNIFORM_3F, 4, false },
+        { UNIFORM_MATRIX_4FV, 3, true },
+        { BUFFER_DATA, 3, true },
+        { BUFFER_SUB_DATA, 2, true },
+        { TEX_IMAGE_2D, 8, true },
+        { TEX_PARAMETER_I, 3, false },
+        { GENERATE_MIPMAP, 1, false },
+        { DRAW_ARRAYS, 3, false },
+        { DRAW_ELEMENTS, 4, false }
+    };
+
+    /*! \brief
+     *  Check of RECORD_LAYOUTS, static_asserted below
+     *  \return Whether every Record has its layout at its own index
+     */
+    [[nodiscard]] static constexpr bool recordLayoutsMatch()
+    {
+        for (GLuint record = 0; record < RECORD_COUNT; ++record)
+            if (RECORD_LAYOUTS[record].record != record)
+                return false;
+
+        return true;
+    }
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether this build can capture
+     */
+    [[nodiscard]] static constexpr bool isAvailable()
+    {
+#ifdef GL_CAPTURE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*! \brief
+     *  Sets the frame to capture
+     *  \param path Path to the trace, has to stay valid until the frame is captured
+     *  \param frame Frame to capture, counted from 0
+     */
+    static void captureFrame(const char* path, GLuint frame);
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether the frame to capture is still to come
+     */
+    [[nodiscard]] static bool isPending() { return s_pending; }
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether the trace could not be written
+     */
+    [[nodiscard]] static bool hasFailed() { return s_failed; }
+
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether the current frame is being captured
+     */
+    [[nodiscard]] static bool isCapturing() { return s_file != nullptr; }
+
+    /*! \brief
+     *  Starts a frame, recording it if it is the one to capture
+     */
+    static void beginFrame();
+
+    /*! \brief
+     *  Ends a frame, the captured one is written out
+     */
+    static void endFrame();
+
+    /*! \brief
+     *  Writes the record of a call
+     *  \param record The call
+     *  \param arguments Its arguments, 32 bit words
+     */
+    template<typename... Arguments>
+    static void writeRecord(Record record, Arguments... arguments)
+    {
+        fwrite(&record, 1, 1, s_file);
+        ( write(arguments), ... );
+    }
+
+    static void write(GLuint word) { fwrite(&word, sizeof(word), 1, s_file); }
+    static void write(GLint word) { fwrite(&word, sizeof(word), 1, s_file); }
+    static void write(GLfloat word) { fwrite(&word, sizeof(word), 1, s_file); }
+
+    /*! \brief
+     *  Writes data, its size first
+     *  \param data The data
+     *  \param size Its size
+     */
+    static void writeData(const void* data, GLuint size);
+
+    /*! \brief
+     *  Methods to write an object a call uses before the call, once
+     */
+    static void useBuffer(GLuint buffer);
+    static void useTexture(GLenum target, GLuint texture);
+    static void useProgram(GLuint program);
+    static void useVertexArray(GLuint vertexArray);
+
+    /*! \brief
+     *  Writes the alignment and the pixels of a texture upload, from client memory or from the bound pixel unpack buffer
+     *  \param width Width of the image
+     *  \param height Height of the image
+     *  \param format Format of the pixels
+     *  \param type Type of the pixel components
+     *  \param pixels The pixels, or their offset in the unpack buffer
+     */
+    static void writePixels(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels);
+
+    /*! \brief
+     *  Values of a uniform type, GLReplay sets them back with the same sizes
+     *  \param type Type of the uniform
+     *  \return Number of values
+     */
+    [[nodiscard]] static GLuint uniformComponents(GLenum type);
+
+    /*! \brief
+     *  Tells how the values of a uniform type are read and set
+     *  \param type Type of the uniform
+     *  \return Whether the values are integers
+     */
+    [[nodiscard]] static bool uniformIsInteger(GLenum type);
+
+    /*! \brief
+     *  Bytes of a pixel in client memory
+     *  \param format Format of the pixels
+     *  \param type Type of the pixel components
+     *  \return The size
+     */
+    [[nodiscard]] static GLuint pixelSize(GLenum format, GLenum type);
+
+private:
+    static const char* s_path;
+    static GLuint      s_frame;
+    static GLuint      s_captureFrame;
+    static bool        s_pending;
+    static bool        s_failed;
+    static FILE*       s_file;
+
+    /*! \brief
+     *  The objects written so far
+     */
+    static std::set<GLuint> s_buffers;
+    static std::set<GLuint> s_textures;
+    static std::set<GLuint> s_programs;
+    static std::set<GLuint> s_vertexArrays;
+
+    /*! \brief
+     *  Method to write the state the frame starts with, as the calls that set it
+     *  \param viewport The viewport
+     */
+    static void recordState(const GLint viewport[4]);
+
+    /*! \brief
+     *  Methods to write an object as GL has it now, with the layouts of the 07_Skybox lesson.
+     *  A compressed texture is written with format 0 and its compressed levels; a texture
+     *  with no exact readback fails the capture
+     */
+    static void recordBuffer(GLuint buffer);
+    static void recordTexture(GLenum target, GLuint texture);
+    static void recordProgram(GLuint program);
+    static void recordVertexArray(GLuint vertexArray);
+};
+
+static_assert(sizeof(GLCapture::RECORD_LAYOUTS) / sizeof(GLCapture::RECORD_LAYOUTS[0]) == GLCapture::RECORD_COUNT,
+              "Every GLCapture::Record needs a layout");
+static_assert(GLCapture::recordLayoutsMatch(), "GLCapture::RECORD_LAYOUTS is out of the order of GLCapture::Record");
+
+/// GLCapture.cpp reads GL back with the functions themselves, so it leaves the names alone
+#if defined(GL_CAPTURE) && !defined(GL_CAPTURE_IMPLEMENTATION)
+
+/// The wrappers call GL by the names as GLEW defines them, before the macros below take the names over
+namespace GLCaptureWrappers
+{
+    inline void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::VIEWPORT, x, y, width, height);
+
+        glViewport(x, y, width, height);
+    }
+
+    inline void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::CLEAR_COLOR, red, green, blue, alpha);
+
+        glClearColor(red, green, blue, alpha);
+    }
+
+    inline void clear(GLbitfield mask)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::CLEAR, mask);
+
+        glClear(mask);
+    }
+
+    inline void enable(GLenum capability)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::ENABLE, capability);
+
+        glEnable(capability);
+    }
+
+    inline void disable(GLenum capability)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::DISABLE, capability);
+
+        glDisable(capability);
+    }
+
+    inline void depthFunc(GLenum func)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::DEPTH_FUNC, func);
+
+        glDepthFunc(func);
+    }
+
+    inline void depthMask(GLboolean flag)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::DEPTH_MASK, (GLuint)flag);
+
+        glDepthMask(flag);
+    }
+
+    inline void blendFunc(GLenum source, GLenum destination)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::BLEND_FUNC, source, destination);
+
+        glBlendFunc(source, destination);
+    }
+
+    inline void useProgram(GLuint program)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::useProgram(program);
+            GLCapture::writeRecord(GLCapture::USE_PROGRAM, program);
+        }
+
+        glUseProgram(program);
+    }
+
+    inline void bindVertexArray(GLuint array)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::useVertexArray(array);
+            GLCapture::writeRecord(GLCapture::BIND_VERTEX_ARRAY, array);
+        }
+
+        glBindVertexArray(array);
+    }
+
+    /// The trace has the pixels of texture uploads themselves, so pixel unpack buffers are left out
+    inline void bindBuffer(GLenum target, GLuint buffer)
+    {
+        if ( GLCapture::isCapturing() && target != GL_PIXEL_UNPACK_BUFFER )
+        {
+            GLCapture::useBuffer(buffer);
+            GLCapture::writeRecord(GLCapture::BIND_BUFFER, target, buffer);
+        }
+
+        glBindBuffer(target, buffer);
+    }
+
+    inline void activeTexture(GLenum texture)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::ACTIVE_TEXTURE, texture);
+
+        glActiveTexture(texture);
+    }
+
+    inline void bindTexture(GLenum target, GLuint texture)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::useTexture(target, texture);
+            GLCapture::writeRecord(GLCapture::BIND_TEXTURE, target, texture);
+        }
+
+        glBindTexture(target, texture);
+    }
+
+    /// Looking a uniform up is work for the driver too, so it is replayed as well
+    inline GLint getUniformLocation(GLuint program, const GLchar* name)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::useProgram(program);
+            GLCapture::writeRecord(GLCapture::GET_UNIFORM_LOCATION, program);
+            GLCapture::writeData( name, (GLuint)strlen(name) + 1 );
+        }
+
+        return glGetUniformLocation(program, name);
+    }
+
+    inline void uniform1i(GLint location, GLint v0)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::UNIFORM_1I, location, v0);
+
+        glUniform1i(location, v0);
+    }
+
+    inline void uniform1f(GLint location, GLfloat v0)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::UNIFORM_1F, location, v0);
+
+        glUniform1f(location, v0);
+    }
+
+    inline void uniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::UNIFORM_2F, location, v0, v1);
+
+        glUniform2f(location, v0, v1);
+    }
+
+    inline void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::UNIFORM_3F, location, v0, v1, v2);
+
+        glUniform3f(location, v0, v1, v2);
+    }
+
+    inline void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::writeRecord(GLCapture::UNIFORM_MATRIX_4FV, location, count, (GLuint)transpose);
+            GLCapture::writeData( value, count * 16 * sizeof(GLfloat) );
+        }
+
+        glUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    inline void bufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::writeRecord(GLCapture::BUFFER_DATA, target, (GLuint)size, usage);
+            GLCapture::writeData( data, data ? (GLuint)size : 0 );
+        }
+
+        glBufferData(target, size, data, usage);
+    }
+
+    inline void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::writeRecord(GLCapture::BUFFER_SUB_DATA, target, (GLuint)offset);
+            GLCapture::writeData( data, (GLuint)size );
+        }
+
+        glBufferSubData(target, offset, size, data);
+    }
+
+    inline void texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                           GLint border, GLenum format, GLenum type, const GLvoid* pixels)
+    {
+        if ( GLCapture::isCapturing() )
+        {
+            GLCapture::writeRecord(GLCapture::TEX_IMAGE_2D, target, level, internalFormat, width, height, format, type);
+            GLCapture::writePixels(width, height, format, type, pixels);
+        }
+
+        glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+
+    inline void texParameteri(GLenum target, GLenum name, GLint parameter)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::TEX_PARAMETER_I, target, name, parameter);
+
+        glTexParameteri(target, name, parameter);
+    }
+
+    inline void generateMipmap(GLenum target)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::GENERATE_MIPMAP, target);
+
+        glGenerateMipmap(target);
+    }
+
+    inline void drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord(GLCapture::DRAW_ARRAYS, mode, first, count);
+
+        glDrawArrays(mode, first, count);
+    }
+
+    inline void drawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices)
+    {
+        if ( GLCapture::isCapturing() )
+            GLCapture::writeRecord( GLCapture::DRAW_ELEMENTS, mode, count, type, (GLuint)(size_t)indices );
+
+        glDrawElements(mode, count, type, indices);
+    }
+}
+
+#undef glViewport
+#undef glClearColor
+#undef glClear
+#undef glEnable
+#undef glDisable
+#undef glDepthFunc
+#undef glDepthMask
+#undef glBlendFunc
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindBuffer
+#undef glActiveTexture
+#undef glBindTexture
+#undef glGetUniformLocation
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glTexImage2D
+#undef glTexParameteri
+#undef glGenerateMipmap
+#undef glDrawArrays
+#undef glDrawElements
+
+#define glViewport           GLCaptureWrappers::viewport
+#define glClearColor         GLCaptureWrappers::clearColor
+#define glClear              GLCaptureWrappers::clear
+#define glEnable             GLCaptureWrappers::enable
+#define glDisable            GLCaptureWrappers::disable
+#define glDepthFunc          GLCaptureWrappers::depthFunc
+#define glDepthMask          GLCaptureWrappers::depthMask
+#define glBlendFunc          GLCaptureWrappers::blendFunc
+#define glUseProgram         GLCaptureWrappers::useProgram
+#define glBindVertexArray    GLCaptureWrappers::bindVertexArray
+#define glBindBuffer         GLCaptureWrappers::bindBuffer
+#define glActiveTexture      GLCaptureWrappers::activeTexture
+#define glBindTexture        GLCaptureWrappers::bindTexture
+#define glGetUniformLocation GLCaptureWrappers::getUniformLocation
+#define glUniform1i          GLCaptureWrappers::uniform1i
+#define glUniform1f          GLCaptureWrappers::uniform1f
+#define glUniform2f          GLCaptureWrappers::uniform2f
+#define glUniform3f          GLCaptureWrappers::uniform3f
+#define glUniformMatrix4fv   GLCaptureWrappers::uniformMatrix4fv
+#define glBufferData         GLCaptureWrappers::bufferData
+#define glBufferSubData      GLCaptureWrappers::bufferSubData
+#define glTexImage2D         GLCaptureWrappers::texImage2D
+#define glTexParameteri      GLCaptureWrappers::texParameteri
+#define glGenerateMipmap     GLCaptureWrappers::generateMipmap
+#define glDrawArrays         GLCaptureWrappers::drawArrays
+#define glDrawElements       GLCaptureWrappers::drawElements
+
+#endif
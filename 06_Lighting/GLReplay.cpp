@@ -0,0 +1,514 @@
+#include "GLReplay.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "GLCapture.h"
+#include "GLStats.h"
+
+namespace
+{
+    GLfloat asFloat(GLuint word)
+    {
+        GLfloat value;
+        memcpy( &value, &word, sizeof(value) );
+
+        return value;
+    }
+
+    GLuint mapName(const std::map<GLuint, GLuint>& names, GLuint name)
+    {
+        auto found = names.find(name);
+
+        return found == names.end() ? 0 : found->second;
+    }
+
+    /// Sets a uniform of the current program to its captured value
+    void setUniform(GLint location, GLenum type, const GLubyte* values)
+    {
+        if ( GLCapture::uniformIsInteger(type) )
+        {
+            const auto* integers = (const GLint*)values;
+
+            switch ( GLCapture::uniformComponents(type) )
+            {
+                case 1: glUniform1iv(location, 1, integers); break;
+                case 2: glUniform2iv(location, 1, integers); break;
+                case 3: glUniform3iv(location, 1, integers); break;
+                case 4: glUniform4iv(location, 1, integers); break;
+                default: break;
+            }
+
+            return;
+        }
+
+        const auto* floats = (const GLfloat*)values;
+
+        switch (type)
+        {
+            case GL_FLOAT: glUniform1fv(location, 1, floats); break;
+            case GL_FLOAT_VEC2: glUniform2fv(location, 1, floats); break;
+            case GL_FLOAT_VEC3: glUniform3fv(location, 1, floats); break;
+            case GL_FLOAT_VEC4: glUniform4fv(location, 1, floats); break;
+            case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, floats); break;
+            default: break;
+        }
+    }
+}
+
+/// Public methods
+
+GLReplay::~GLReplay() { destroy(); }
+
+bool GLReplay::load(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in)
+    {
+        std::cerr << "Failed to open the trace " << path << "!" << std::endl;
+        return false;
+    }
+
+    fseek(in, 0, SEEK_END);
+    m_trace.resize( ftell(in) );
+    fseek(in, 0, SEEK_SET);
+
+    bool read = fread( m_trace.data(), 1, m_trace.size(), in ) == m_trace.size();
+    fclose(in);
+
+    GLuint magic = 0, version = 0;
+    m_position = 0;
+
+    if ( !read || !readWord(magic) || !readWord(version) || magic != GLCapture::MAGIC || version != GLCapture::VERSION )
+    {
+        std::cerr << "Failed to read the trace " << path << ", it is not a GL trace of this version!" << std::endl;
+        return false;
+    }
+
+    if ( !readWord(m_width) || !readWord(m_height) || !readRecords() )
+    {
+        std::cerr << "Failed to read the trace " << path << "!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void GLReplay::execute() const
+{
+    for (const auto& command : m_commands)
+    {
+        const GLuint* arguments = command.arguments;
+        const GLvoid* data      = command.dataSize == 0 ? nullptr : &m_trace[command.data];
+
+        switch (command.record)
+        {
+            case GLCapture::VIEWPORT:
+                glViewport(arguments[0], arguments[1], arguments[2], arguments[3]);
+                break;
+            case GLCapture::CLEAR_COLOR:
+                glClearColor( asFloat(arguments[0]), asFloat(arguments[1]), asFloat(arguments[2]), asFloat(arguments[3]) );
+                break;
+            case GLCapture::CLEAR:
+                glClear(arguments[0]);
+                break;
+            case GLCapture::ENABLE:
+                glEnable(arguments[0]);
+                break;
+            case GLCapture::DISABLE:
+                glDisable(arguments[0]);
+                break;
+            case GLCapture::DEPTH_FUNC:
+                glDepthFunc(arguments[0]);
+                break;
+            case GLCapture::DEPTH_MASK:
+                glDepthMask( (GLboolean)arguments[0] );
+                break;
+            case GLCapture::BLEND_FUNC:
+                glBlendFunc(arguments[0], arguments[1]);
+                break;
+            case GLCapture::USE_PROGRAM:
+                glUseProgram(arguments[0]);
+                break;
+            case GLCapture::BIND_VERTEX_ARRAY:
+                glBindVertexArray(arguments[0]);
+                break;
+            case GLCapture::BIND_BUFFER:
+                glBindBuffer(arguments[0], arguments[1]);
+                break;
+            case GLCapture::ACTIVE_TEXTURE:
+                glActiveTexture(arguments[0]);
+                break;
+            case GLCapture::BIND_TEXTURE:
+                glBindTexture(arguments[0], arguments[1]);
+                break;
+            case GLCapture::GET_UNIFORM_LOCATION:
+                glGetUniformLocation( arguments[0], (const GLchar*)data );
+                break;
+            case GLCapture::UNIFORM_1I:
+                glUniform1i(arguments[0], arguments[1]);
+                break;
+            case GLCapture::UNIFORM_1F:
+                glUniform1f( arguments[0], asFloat(arguments[1]) );
+                break;
+            case GLCapture::UNIFORM_2F:
+                glUniform2f( arguments[0], asFloat(arguments[1]), asFloat(arguments[2]) );
+                break;
+            case GLCapture::UNIFORM_3F:
+                glUniform3f( arguments[0], asFloat(arguments[1]), asFloat(arguments[2]), asFloat(arguments[3]) );
+                break;
+            case GLCapture::UNIFORM_MATRIX_4FV:
+                glUniformMatrix4fv( arguments[0], arguments[1], (GLboolean)arguments[2], (const GLfloat*)data );
+                break;
+            case GLCapture::BUFFER_DATA:
+                glBufferData(arguments[0], arguments[1], data, arguments[2]);
+                break;
+            case GLCapture::BUFFER_SUB_DATA:
+                glBufferSubData(arguments[0], arguments[1], command.dataSize, data);
+                break;
+            case GLCapture::TEX_IMAGE_2D:
+                glPixelStorei(GL_UNPACK_ALIGNMENT, arguments[7]);
+                glTexImage2D(arguments[0], arguments[1], arguments[2], arguments[3], arguments[4], 0,
+                             arguments[5], arguments[6], data);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                break;
+            case GLCapture::TEX_PARAMETER_I:
+                glTexParameteri(arguments[0], arguments[1], arguments[2]);
+                break;
+            case GLCapture::GENERATE_MIPMAP:
+                glGenerateMipmap(arguments[0]);
+                break;
+            case GLCapture::DRAW_ARRAYS:
+                glDrawArrays(arguments[0], arguments[1], arguments[2]);
+                break;
+            case GLCapture::DRAW_ELEMENTS:
+                glDrawElements( arguments[0], arguments[1], arguments[2], (const GLvoid*)(size_t)arguments[3] );
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void GLReplay::destroy()
+{
+    for (const auto& buffer : m_buffers)
+        glDeleteBuffers(1, &buffer.second);
+
+    for (const auto& texture : m_textures)
+        glDeleteTextures(1, &texture.second);
+
+    for (const auto& program : m_programs)
+        glDeleteProgram(program.second);
+
+    for (const auto& vertexArray : m_vertexArrays)
+        glDeleteVertexArrays(1, &vertexArray.second);
+
+    m_buffers.clear();
+    m_textures.clear();
+    m_programs.clear();
+    m_vertexArrays.clear();
+    m_uniformLocations.clear();
+    m_commands.clear();
+    m_objectCount = 0;
+}
+
+/// Private methods
+
+bool GLReplay::readWord(GLuint& word)
+{
+    if ( m_position + sizeof(word) > m_trace.size() )
+        return false;
+
+    memcpy( &word, &m_trace[m_position], sizeof(word) );
+    m_position += sizeof(word);
+
+    return true;
+}
+
+bool GLReplay::readWord(GLint& word) { return readWord( (GLuint&)word ); }
+
+bool GLReplay::readData(size_t& data, GLuint& size)
+{
+    if ( !readWord(size) || m_position + size > m_trace.size() )
+        return false;
+
+    data        = m_position;
+    m_position += size;
+
+    return true;
+}
+
+bool GLReplay::readRecords()
+{
+    // The program uniforms are set for, as the captured frame went
+    GLuint currentProgram = 0;
+
+    while ( m_position < m_trace.size() )
+    {
+        GLubyte record = m_trace[m_position++];
+        if (record >= GLCapture::RECORD_COUNT)
+            return false;
+
+        bool objectRead = true;
+
+        switch (record)
+        {
+            case GLCapture::END:
+                return true;
+            case GLCapture::BUFFER:
+                objectRead = readBuffer();
+                break;
+            case GLCapture::TEXTURE:
+                objectRead = readTexture();
+                break;
+            case GLCapture::PROGRAM:
+                objectRead = readProgram();
+                break;
+            case GLCapture::VERTEX_ARRAY:
+                objectRead = readVertexArray();
+                break;
+            default:
+            {
+                Command command;
+                command.record = record;
+
+                for (GLuint i = 0; i < GLCapture::RECORD_LAYOUTS[record].arguments; ++i)
+                    if ( !readWord(command.arguments[i]) )
+                        return false;
+
+                if ( GLCapture::RECORD_LAYOUTS[record].data && !readData(command.data, command.dataSize) )
+                    return false;
+
+                // The names and uniform locations of this run in place of the captured ones
+                GLuint* arguments = command.arguments;
+
+                switch (record)
+                {
+                    case GLCapture::USE_PROGRAM:
+                        currentProgram = arguments[0];
+                        arguments[0]   = mapName(m_programs, arguments[0]);
+                        break;
+                    case GLCapture::GET_UNIFORM_LOCATION:
+                        arguments[0] = mapName(m_programs, arguments[0]);
+                        break;
+                    case GLCapture::BIND_VERTEX_ARRAY:
+                        arguments[0] = mapName(m_vertexArrays, arguments[0]);
+                        break;
+                    case GLCapture::BIND_BUFFER:
+                        arguments[1] = mapName(m_buffers, arguments[1]);
+                        break;
+                    case GLCapture::BIND_TEXTURE:
+                        arguments[1] = mapName(m_textures, arguments[1]);
+                        break;
+                    case GLCapture::UNIFORM_1I:
+                    case GLCapture::UNIFORM_1F:
+                    case GLCapture::UNIFORM_2F:
+                    case GLCapture::UNIFORM_3F:
+                    case GLCapture::UNIFORM_MATRIX_4FV:
+                    {
+                        const auto& locations = m_uniformLocations[currentProgram];
+                        auto        found     = locations.find( (GLint)arguments[0] );
+                        arguments[0] = (GLuint)( found == locations.end() ? -1 : found->second );
+                        break;
+                    }
+                    default:
+                        break;
+                }
+
+                m_commands.push_back(command);
+                break;
+            }
+        }
+
+        if (!objectRead)
+            return false;
+    }
+
+    // The trace ended without END
+    return false;
+}
+
+bool GLReplay::readBuffer()
+{
+    GLuint name, usage, size;
+    size_t data;
+
+    if ( !readWord(name) || !readWord(usage) || !readData(data, size) )
+        return false;
+
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, size == 0 ? nullptr : &m_trace[data], usage);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_buffers[name] = buffer;
+    ++m_objectCount;
+
+    return true;
+}
+
+bool GLReplay::readTexture()
+{
+    GLuint name, target, internalFormat, format, type, levels;
+    GLint  parameters[5];
+
+    if ( !readWord(name) || !readWord(target) || !readWord(internalFormat) || !readWord(format) || !readWord(type) || !readWord(levels) )
+        return false;
+
+    for (GLint& parameter : parameters)
+        if ( !readWord(parameter) )
+            return false;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    m_textures[name] = texture;
+    ++m_objectCount;
+
+    bool   cubeMap     = target == GL_TEXTURE_CUBE_MAP;
+    GLenum levelTarget = cubeMap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    GLuint faces       = cubeMap ? 6 : 1;
+    bool   read        = true;
+
+    for (GLuint level = 0; level < levels && read; ++level)
+    {
+        for (GLuint face = 0; face < faces && read; ++face)
+        {
+            GLuint width, height, size;
+            size_t data;
+            read = readWord(width) && readWord(height) && readData(data, size);
+
+            // Format 0 is a compressed texture, its levels are the blocks
+            if (read && format == 0)
+                glCompressedTexImage2D(levelTarget + face, level, internalFormat, width, height, 0, size, &m_trace[data]);
+            else if (read)
+                glTexImage2D(levelTarget + face, level, internalFormat, width, height, 0, format, type,
+                             size == 0 ? nullptr : &m_trace[data]);
+        }
+    }
+
+    const GLenum parameterNames[] = { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R };
+
+    for (GLuint i = 0; i < 5; ++i)
+        glTexParameteri(target, parameterNames[i], parameters[i]);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(target, 0);
+
+    return read;
+}
+
+bool GLReplay::readProgram()
+{
+    GLuint name, shaderCount;
+
+    if ( !readWord(name) || !readWord(shaderCount) )
+        return false;
+
+    GLuint program   = glCreateProgram();
+    m_programs[name] = program;
+    ++m_objectCount;
+
+    for (GLuint i = 0; i < shaderCount; ++i)
+    {
+        GLuint type, size;
+        size_t data;
+
+        if ( !readWord(type) || !readData(data, size) || size == 0 )
+            return false;
+
+        const auto* source = (const GLchar*)&m_trace[data];
+        GLuint      shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+
+    GLint success;
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if (!success)
+    {
+        GLchar infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Failed to link program " << name << " of the trace!\n" << infoLog << std::endl;
+        return false;
+    }
+
+    GLuint uniformCount;
+    if ( !readWord(uniformCount) )
+        return false;
+
+    glUseProgram(program);
+
+    for (GLuint i = 0; i < uniformCount; ++i)
+    {
+        GLint  capturedLocation;
+        GLuint type, nameSize, valuesSize;
+        size_t uniformName, values;
+
+        if ( !readData(uniformName, nameSize) || nameSize == 0 || !readWord(capturedLocation) || !readWord(type) ||
+             !readData(values, valuesSize) )
+            return false;
+
+        GLint location = glGetUniformLocation( program, (const GLchar*)&m_trace[uniformName] );
+        m_uniformLocations[name][capturedLocation] = location;
+
+        if ( valuesSize == GLCapture::uniformComponents(type) * sizeof(GLint) )
+            setUniform(location, type, &m_trace[values]);
+    }
+
+    glUseProgram(0);
+
+    return true;
+}
+
+bool GLReplay::readVertexArray()
+{
+    GLuint name, elementBuffer, attributeCount;
+
+    if ( !readWord(name) || !readWord(elementBuffer) || !readWord(attributeCount) )
+        return false;
+
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mapName(m_buffers, elementBuffer) );
+
+    m_vertexArrays[name] = vertexArray;
+    ++m_objectCount;
+
+    for (GLuint i = 0; i < attributeCount; ++i)
+    {
+        GLuint attribute[9];	// index, size, type, normalized, integer, stride, offset, buffer, divisor
+
+        for (GLuint& word : attribute)
+            if ( !readWord(word) )
+                return false;
+
+        glBindBuffer( GL_ARRAY_BUFFER, mapName(m_buffers, attribute[7]) );
+
+        if (attribute[4])
+            glVertexAttribIPointer( attribute[0], attribute[1], attribute[2], attribute[5], (const GLvoid*)(size_t)attribute[6] );
+        else
+            glVertexAttribPointer( attribute[0], attribute[1], attribute[2], (GLboolean)attribute[3], attribute[5],
+                                   (const GLvoid*)(size_t)attribute[6] );
+
+        glVertexAttribDivisor(attribute[0], attribute[8]);
+        glEnableVertexAttribArray(attribute[0]);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
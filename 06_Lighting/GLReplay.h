@@ -0,0 +1,122 @@
+#pragma once
+
+/*! \file
+ *  This header declares GLReplay class
+ */
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+/*! \class
+ *  Runs a frame captured by GLCapture again.
+ *  \note load makes the objects of the trace and turns its calls into commands
+ *  with the names of the new objects, so execute only makes the GL calls and
+ *  can be timed on its own; the data the calls upload stays in the trace read
+ *  into memory.
+ */
+class GLReplay
+{
+public:
+    GLReplay() = default;
+
+    GLReplay(const GLReplay&) = delete;
+    GLReplay& operator=(const GLReplay&) = delete;
+
+    /*! \brief
+     *  Destructor, deletes the objects of the trace
+     */
+    ~GLReplay();
+
+    /*! \brief
+     *  Reads the trace and makes its objects, the GL context has to be current
+     *  \param path Path to the trace
+     *  \return Whether the trace could be read
+     */
+    bool load(const char* path);
+
+    /*! \brief
+     *  Makes the calls of the frame
+     */
+    void execute() const;
+
+    /*! \brief
+     *  Deletes the objects of the trace
+     */
+    void destroy();
+
+    /*! \brief
+     *  Getters for the size of the viewport the frame was captured with
+     */
+    [[nodiscard]] GLuint getWidth() const { return m_width; }
+    [[nodiscard]] GLuint getHeight() const { return m_height; }
+
+    [[nodiscard]] GLuint getCallCount() const { return (GLuint)m_commands.size(); }
+    [[nodiscard]] GLuint getObjectCount() const { return m_objectCount; }
+    [[nodiscard]] size_t getTraceSize() const { return m_trace.size(); }
+
+private:
+    /*! \brief
+     *  A call with its arguments, its data is in the trace
+     */
+    struct Command
+    {
+        GLubyte record        = 0;
+        GLuint  arguments[8]  = {};
+        size_t  data          = 0;
+        GLuint  dataSize      = 0;
+    };
+
+    std::vector<GLubyte> m_trace;
+    size_t               m_position = 0;
+
+    GLuint               m_width       = 0;
+    GLuint               m_height      = 0;
+    GLuint               m_objectCount = 0;
+    std::vector<Command> m_commands;
+
+    /*! \brief
+     *  The objects made for the captured names
+     */
+    std::map<GLuint, GLuint> m_buffers;
+    std::map<GLuint, GLuint> m_textures;
+    std::map<GLuint, GLuint> m_programs;
+    std::map<GLuint, GLuint> m_vertexArrays;
+
+    /*! \brief
+     *  For each captured program, the locations of its uniforms in the program made for it
+     */
+    std::map<GLuint, std::map<GLint, GLint>> m_uniformLocations;
+
+    /*! \brief
+     *  Methods to read from the trace
+     *  \return Whether there was enough left
+     */
+    bool readWord(GLuint& word);
+    bool readWord(GLint& word);
+
+    /*! \brief
+     *  Method to read data, which is left in the trace
+     *  \param data Where the data is
+     *  \param size Its size
+     *  \return Whether there was enough left
+     */
+    bool readData(size_t& data, GLuint& size);
+
+    /*! \brief
+     *  Method to read the records up to END
+     *  \return Whether they could be read
+     */
+    bool readRecords();
+
+    /*! \brief
+     *  Methods to make an object of the trace
+     *  \return Whether it could be read and made
+     */
+    bool readBuffer();
+    bool readTexture();
+    bool readProgram();
+    bool readVertexArray();
+};
@@ -0,0 +1,69 @@
+#include "GLStats.h"
+
+GLFrameStats GLStats::s_current;
+GLFrameStats GLStats::s_last;
+bool         GLStats::s_unpackBufferBound = false;
+
+namespace
+{
+    /// Bytes of a pixel, rows are taken as tightly packed
+    unsigned long long pixelSize(GLenum format, GLenum type)
+    {
+        unsigned long long channels = 4;
+
+        switch (format)
+        {
+            case GL_RED:
+            case GL_DEPTH_COMPONENT:
+                channels = 1;
+                break;
+            case GL_RG:
+                channels = 2;
+                break;
+            case GL_RGB:
+            case GL_BGR:
+                channels = 3;
+                break;
+            default:
+                break;
+        }
+
+        switch (type)
+        {
+            case GL_FLOAT:
+            case GL_UNSIGNED_INT:
+            case GL_INT:
+                return channels * 4;
+            case GL_HALF_FLOAT:
+            case GL_UNSIGNED_SHORT:
+            case GL_SHORT:
+                return channels * 2;
+            default:
+                return channels;
+        }
+    }
+}
+
+/// Public methods
+
+void GLStats::beginFrame()
+{
+    s_last    = s_current;
+    s_current = GLFrameStats();
+}
+
+void GLStats::countDraw(GLenum mode, GLsizei count)
+{
+    ++s_current.drawCalls;
+
+    if (mode == GL_TRIANGLES)
+        s_current.triangles += count / 3;
+    else if ( (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2 )
+        s_current.triangles += count - 2;
+}
+
+void GLStats::countTextureUpload(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels)
+{
+    if (pixels || s_unpackBufferBound)
+        s_current.textureUploadBytes += (unsigned long long)width * (unsigned long long)height * pixelSize(format, type);
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+/*! \file
+ *  This header declares GLFrameStats struct and GLStats class, and in builds
+ *  without NDEBUG routes the GL calls that draw, bind or upload through counting wrappers
+ */
+
+#include <GL/glew.h>
+
+/// Captured calls go through GLCapture's wrappers, which the ones below call
+#include "GLCapture.h"
+
+/*! \brief
+ *  What the GL calls of a frame did, counted by the wrappers of this file
+ */
+struct GLFrameStats
+{
+    unsigned long long drawCalls          = 0;
+    unsigned long long triangles          = 0;
+    unsigned long long programBinds       = 0;
+    unsigned long long vertexArrayBinds   = 0;
+    unsigned long long textureBinds       = 0;
+    unsigned long long uniformUploads     = 0;
+    unsigned long long uniformBytes       = 0;
+    unsigned long long bufferUploadBytes  = 0;
+    unsigned long long textureUploadBytes = 0;
+};
+
+#ifndef NDEBUG
+#define GL_STATS
+#endif
+
+/*! \class
+ *  Counts the GL calls of the current frame.
+ *  \note Builds without NDEBUG define macros over the names of the GL functions
+ *  below, so files including this header call them through wrappers that count;
+ *  release builds (CMake's Release and RelWithDebInfo) call GL directly and every
+ *  count stays at zero. GL calls made inside SOIL2 are not counted. The counters
+ *  are the ones of the 07_Skybox lesson.
+ */
+class GLStats
+{
+public:
+    /*! \brief
+     *  Getter for the state
+     *  \return Whether this build counts GL calls
+     */
+    [[nodiscard]] static constexpr bool isAvailable()
+    {
+#ifdef GL_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*! \brief
+     *  Starts counting a new frame, the one before stays readable with getLastFrame
+     */
+    static void beginFrame();
+
+    /*! \brief
+     *  Getter for the current frame
+     *  \return The counts of the current frame so far
+     */
+    [[nodiscard]] static const GLFrameStats& getFrame() { return s_current; }
+
+    /*! \brief
+     *  Getter for the last frame
+     *  \return The counts of the frame before, complete unlike the current one
+     */
+    [[nodiscard]] static const GLFrameStats& getLastFrame() { return s_last; }
+
+    /*! \brief
+     *  Counts a draw call and its triangles
+     *  \param mode Primitive type
+     *  \param count Vertices drawn
+     */
+    static void countDraw(GLenum mode, GLsizei count);
+
+    static void countProgramBind() { ++s_current.programBinds; }
+
+    static void countVertexArrayBind() { ++s_current.vertexArrayBinds; }
+
+    static void countTextureBind() { ++s_current.textureBinds; }
+
+    /*! \brief
+     *  Counts a uniform upload
+     *  \param bytes Size of the values
+     */
+    static void countUniform(GLsizeiptr bytes)
+    {
+        ++s_current.uniformUploads;
+        s_current.uniformBytes += bytes;
+    }
+
+    static void countBufferUpload(GLsizeiptr bytes) { s_current.bufferUploadBytes += bytes; }
+
+    /*! \brief
+     *  Counts a texture upload. Pixels come from client memory, or from a pixel unpack
+     *  buffer when one is bound; null pixels and no buffer only allocate the storage
+     *  \param width Width of the image
+     *  \param height Height of the image
+     *  \param format Format of the pixels
+     *  \param type Type of the pixel components
+     *  \param pixels The pixels, or their offset in the unpack buffer
+     */
+    static void countTextureUpload(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels);
+
+    static void setUnpackBufferBound(bool bound) { s_unpackBufferBound = bound; }
+
+private:
+    static GLFrameStats s_current;
+    static GLFrameStats s_last;
+    static bool         s_unpackBufferBound;
+};
+
+#ifdef GL_STATS
+
+/// The wrappers call GL by the names as GLEW (or GLCapture) defines them, before the macros below take the names over
+namespace GLStatsWrappers
+{
+    inline void drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        GLStats::countDraw(mode, count);
+        glDrawArrays(mode, first, count);
+    }
+
+    inline void drawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices)
+    {
+        GLStats::countDraw(mode, count);
+        glDrawElements(mode, count, type, indices);
+    }
+
+    inline void useProgram(GLuint program)
+    {
+        GLStats::countProgramBind();
+        glUseProgram(program);
+    }
+
+    inline void bindVertexArray(GLuint array)
+    {
+        GLStats::countVertexArrayBind();
+        glBindVertexArray(array);
+    }
+
+    inline void bindTexture(GLenum target, GLuint texture)
+    {
+        GLStats::countTextureBind();
+        glBindTexture(target, texture);
+    }
+
+    inline void bindBuffer(GLenum target, GLuint buffer)
+    {
+        if (target == GL_PIXEL_UNPACK_BUFFER)
+            GLStats::setUnpackBufferBound(buffer != 0);
+
+        glBindBuffer(target, buffer);
+    }
+
+    inline void uniform1i(GLint location, GLint v0)
+    {
+        GLStats::countUniform( sizeof(GLint) );
+        glUniform1i(location, v0);
+    }
+
+    inline void uniform1f(GLint location, GLfloat v0)
+    {
+        GLStats::countUniform( sizeof(GLfloat) );
+        glUniform1f(location, v0);
+    }
+
+    inline void uniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        GLStats::countUniform( 2 * sizeof(GLfloat) );
+        glUniform2f(location, v0, v1);
+    }
+
+    inline void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        GLStats::countUniform( 3 * sizeof(GLfloat) );
+        glUniform3f(location, v0, v1, v2);
+    }
+
+    inline void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        GLStats::countUniform( count * 16 * sizeof(GLfloat) );
+        glUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    inline void bufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage)
+    {
+        if (data)
+            GLStats::countBufferUpload(size);
+
+        glBufferData(target, size, data, usage);
+    }
+
+    inline void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+    {
+        GLStats::countBufferUpload(size);
+        glBufferSubData(target, offset, size, data);
+    }
+
+    inline void texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                           GLint border, GLenum format, GLenum type, const GLvoid* pixels)
+    {
+        GLStats::countTextureUpload(width, height, format, type, pixels);
+        glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+}
+
+#undef glDrawArrays
+#undef glDrawElements
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindTexture
+#undef glBindBuffer
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glTexImage2D
+
+#define glDrawArrays       GLStatsWrappers::drawArrays
+#define glDrawElements     GLStatsWrappers::drawElements
+#define glUseProgram       GLStatsWrappers::useProgram
+#define glBindVertexArray  GLStatsWrappers::bindVertexArray
+#define glBindTexture      GLStatsWrappers::bindTexture
+#define glBindBuffer       GLStatsWrappers::bindBuffer
+#define glUniform1i        GLStatsWrappers::uniform1i
+#define glUniform1f        GLStatsWrappers::uniform1f
+#define glUniform2f        GLStatsWrappers::uniform2f
+#define glUniform3f        GLStatsWrappers::uniform3f
+#define glUniformMatrix4fv GLStatsWrappers::uniformMatrix4fv
+#define glBufferData       GLStatsWrappers::bufferData
+#define glBufferSubData    GLStatsWrappers::bufferSubData
+#define glTexImage2D       GLStatsWrappers::texImage2D
+
+#endif
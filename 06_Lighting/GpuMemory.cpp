@@ -0,0 +1,256 @@
+#include "GpuMemory.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "GLStats.h"
+
+std::vector<GpuMemory::Allocation> GpuMemory::s_allocations;
+
+namespace
+{
+    const double MB = 1024.0 * 1024.0;
+
+    /// Compressed levels as the driver stores them, the others from the bits of their components (RGB9_E5's shared exponent too)
+    unsigned long long levelBytes(GLenum target, GLint level)
+    {
+        GLint compressed = GL_FALSE, width = 0, height = 0;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+
+        if (compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+
+            return size;
+        }
+
+        GLint bits = 0;
+
+        for (GLenum component : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                  GL_TEXTURE_SHARED_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE })
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, component, &size);
+            bits += size;
+        }
+
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+
+        return (unsigned long long)width * height * bits / 8;
+    }
+
+    /// The formats and usages the lessons make, the others are printed as numbers
+    const char* formatName(GLenum format)
+    {
+        switch (format)
+        {
+            case GL_RED: return "RED";
+            case GL_R8: return "R8";
+            case GL_RGB: return "RGB";
+            case GL_RGB8: return "RGB8";
+            case GL_RGBA: return "RGBA";
+            case GL_RGBA8: return "RGBA8";
+            case GL_RGB16F: return "RGB16F";
+            case GL_RGBA16F: return "RGBA16F";
+            case GL_RGB9_E5: return "RGB9_E5";
+            case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+            case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: return "BC6H";
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "DXT1";
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return "DXT1A";
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: return "DXT3";
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "DXT5";
+            case GL_COMPRESSED_RED_RGTC1: return "BC4";
+            case GL_COMPRESSED_RG_RGTC2: return "BC5";
+            case GL_STATIC_DRAW: return "STATIC_DRAW";
+            case GL_DYNAMIC_DRAW: return "DYNAMIC_DRAW";
+            case GL_STREAM_DRAW: return "STREAM_DRAW";
+            default: return nullptr;
+        }
+    }
+}
+
+/// Public methods
+
+void GpuMemory::registerTexture(GLenum target, GLuint texture, const std::string& owner)
+{
+    bool   cubeMap     = target == GL_TEXTURE_CUBE_MAP;
+    GLenum levelTarget = cubeMap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    GLuint faces       = cubeMap ? 6 : 1;
+
+    GLint previous = 0;
+    glGetIntegerv(cubeMap ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D, &previous);
+    glBindTexture(target, texture);
+
+    Allocation allocation;
+    allocation.category = cubeMap ? CUBEMAPS : TEXTURES;
+    allocation.name     = texture;
+    allocation.owner    = owner;
+
+    GLint format = GL_NONE;
+    glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_WIDTH, &allocation.width);
+    glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_HEIGHT, &allocation.height);
+    allocation.format = format;
+
+    // The levels there are, up to the first without storage
+    for (GLint width = allocation.width; width != 0 && allocation.levels < 32; ++allocation.levels)
+    {
+        for (GLuint face = 0; face < faces; ++face)
+            allocation.bytes += levelBytes(levelTarget + face, allocation.levels);
+
+        glGetTexLevelParameteriv(levelTarget, allocation.levels + 1, GL_TEXTURE_WIDTH, &width);
+    }
+
+    glBindTexture(target, previous);
+    add(allocation);
+}
+
+void GpuMemory::registerBuffer(GLenum target, GLuint buffer, const std::string& owner)
+{
+    // Queried through the copy target, so no vertex array's element buffer changes on the way
+    GLint previous = 0, size = 0, usage = GL_NONE;
+    glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previous);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage);
+    glBindBuffer(GL_COPY_READ_BUFFER, previous);
+
+    Allocation allocation;
+    allocation.category = OTHER_BUFFERS;
+    allocation.name     = buffer;
+    allocation.bytes    = size;
+    allocation.format   = usage;
+    allocation.width    = size;
+    allocation.owner    = owner;
+
+    if (target == GL_ARRAY_BUFFER)
+        allocation.category = VERTEX_BUFFERS;
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+        allocation.category = INDEX_BUFFERS;
+
+    add(allocation);
+}
+
+void GpuMemory::registerRenderbuffer(GLuint renderbuffer, const std::string& owner)
+{
+    GLint previous = 0, format = GL_NONE, bits = 0;
+    glGetIntegerv(GL_RENDERBUFFER_BINDING, &previous);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+
+    Allocation allocation;
+    allocation.category = RENDER_TARGETS;
+    allocation.name     = renderbuffer;
+    allocation.levels   = 1;
+    allocation.owner    = owner;
+
+    glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &format);
+    glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &allocation.width);
+    glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &allocation.height);
+
+    for (GLenum component : { GL_RENDERBUFFER_RED_SIZE, GL_RENDERBUFFER_GREEN_SIZE, GL_RENDERBUFFER_BLUE_SIZE,
+                              GL_RENDERBUFFER_ALPHA_SIZE, GL_RENDERBUFFER_DEPTH_SIZE, GL_RENDERBUFFER_STENCIL_SIZE })
+    {
+        GLint size = 0;
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, component, &size);
+        bits += size;
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, previous);
+
+    allocation.format = format;
+    allocation.bytes  = (unsigned long long)allocation.width * allocation.height * bits / 8;
+    add(allocation);
+}
+
+unsigned long long GpuMemory::getTotal(Category category)
+{
+    unsigned long long total = 0;
+
+    for (const auto& allocation : s_allocations)
+        if (allocation.category == category)
+            total += allocation.bytes;
+
+    return total;
+}
+
+unsigned long long GpuMemory::getTotal()
+{
+    unsigned long long total = 0;
+
+    for (const auto& allocation : s_allocations)
+        total += allocation.bytes;
+
+    return total;
+}
+
+const char* GpuMemory::getCategoryName(Category category)
+{
+    static const char* names[CATEGORY_COUNT] =
+        { "textures", "cubemaps", "vertex_buffers", "index_buffers", "other_buffers", "render_targets" };
+
+    return names[category];
+}
+
+void GpuMemory::printReport(GLuint count)
+{
+    printf("GPU memory: %.3f MB in %u allocations\n", getTotal() / MB, getCount());
+
+    for (GLuint i = 0; i < CATEGORY_COUNT; ++i)
+        printf( "  %-16s%10.3f MB\n", getCategoryName( (Category)i ), getTotal( (Category)i ) / MB );
+
+    std::vector<Allocation> largest = s_allocations;
+    count = std::min( count, (GLuint)largest.size() );
+    std::partial_sort(largest.begin(), largest.begin() + count, largest.end(),
+                      [](const Allocation& a, const Allocation& b) { return a.bytes > b.bytes; });
+
+    if (count != 0)
+        printf("Largest %u:\n", count);
+
+    for (GLuint i = 0; i < count; ++i)
+    {
+        const Allocation& allocation = largest[i];
+        char              format[24], size[32];
+
+        if ( formatName(allocation.format) )
+            snprintf( format, sizeof(format), "%s", formatName(allocation.format) );
+        else
+            snprintf(format, sizeof(format), "0x%04X", allocation.format);
+
+        // Buffers have no dimensions or levels, their width is their size
+        if (allocation.category >= VERTEX_BUFFERS && allocation.category <= OTHER_BUFFERS)
+            snprintf(size, sizeof(size), "%d bytes", allocation.width);
+        else
+            snprintf(size, sizeof(size), "%dx%d, %d level%s",
+                     allocation.width, allocation.height, allocation.levels, allocation.levels == 1 ? "" : "s");
+
+        printf("  %10.3f MB  %-16s%-18s%-20s%s\n", allocation.bytes / MB, getCategoryName(allocation.category), format, size,
+               allocation.owner.c_str());
+    }
+}
+
+/// Private methods
+
+void GpuMemory::add(const Allocation& allocation)
+{
+    if (allocation.category <= CUBEMAPS)
+        releaseTexture(allocation.name);
+    else if (allocation.category == RENDER_TARGETS)
+        releaseRenderbuffer(allocation.name);
+    else
+        releaseBuffer(allocation.name);
+
+    s_allocations.push_back(allocation);
+}
+
+void GpuMemory::release(GLuint name, Category first, Category last)
+{
+    auto found = std::find_if(s_allocations.begin(), s_allocations.end(), [&](const Allocation& allocation)
+    {
+        return allocation.name == name && allocation.category >= first && allocation.category <= last;
+    });
+
+    if ( found != s_allocations.end() )
+        s_allocations.erase(found);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+/*! \file
+ *  This header declares GpuMemory class
+ */
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+/*! \class
+ *  What the textures, buffers and render targets hold in GPU memory, each with who made it.
+ *  \note The sizes are read back from GL when an object is registered, so they are what
+ *  the driver reports for the storage, not what the caller meant to upload. Drivers may
+ *  still pad, RGB8 is often stored as RGBA8 and GL has no way of telling. Registering is
+ *  for load time, it queries GL and allocates. The registry is the one of the 07_Skybox lesson.
+ */
+class GpuMemory
+{
+public:
+    /// Textures before buffers before render targets, the release methods go by these ranges
+    enum Category
+    {
+        TEXTURES,
+        CUBEMAPS,
+        VERTEX_BUFFERS,
+        INDEX_BUFFERS,
+        OTHER_BUFFERS,
+        RENDER_TARGETS,
+        CATEGORY_COUNT
+    };
+
+    /*! \brief
+     *  One object and its storage
+     */
+    struct Allocation
+    {
+        Category           category = TEXTURES;
+        GLuint             name     = 0;
+        unsigned long long bytes    = 0;
+        GLenum             format   = GL_NONE;	// Internal format, or the usage of a buffer
+        GLint              width    = 0;
+        GLint              height   = 0;
+        GLint              levels   = 0;
+        std::string        owner;
+    };
+
+    /*! \brief
+     *  Registers a 2D texture or a cubemap, once all its levels are there
+     *  \param target GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+     *  \param texture Name of the texture
+     *  \param owner Who made it, e.g. the image it was loaded from
+     */
+    static void registerTexture(GLenum target, GLuint texture, const std::string& owner);
+
+    /*! \brief
+     *  Registers a buffer after its glBufferData
+     *  \param target Target the buffer was made for, it gives the category
+     *  \param buffer Name of the buffer
+     *  \param owner Who made it
+     */
+    static void registerBuffer(GLenum target, GLuint buffer, const std::string& owner);
+
+    /*! \brief
+     *  Registers a renderbuffer after its glRenderbufferStorage
+     *  \param renderbuffer Name of the renderbuffer
+     *  \param owner Who made it
+     */
+    static void registerRenderbuffer(GLuint renderbuffer, const std::string& owner);
+
+    /*! \brief
+     *  Methods to forget an object, before or after its glDelete*
+     */
+    static void releaseTexture(GLuint texture) { release(texture, TEXTURES, CUBEMAPS); }
+    static void releaseBuffer(GLuint buffer) { release(buffer, VERTEX_BUFFERS, OTHER_BUFFERS); }
+    static void releaseRenderbuffer(GLuint renderbuffer) { release(renderbuffer, RENDER_TARGETS, RENDER_TARGETS); }
+
+    /*! \brief
+     *  Getter for the bytes of a category
+     *  \param category Category to sum
+     *  \return Bytes of its objects
+     */
+    [[nodiscard]] static unsigned long long getTotal(Category category);
+
+    /*! \brief
+     *  Getter for the bytes of every object
+     *  \return Bytes of all the categories
+     */
+    [[nodiscard]] static unsigned long long getTotal();
+
+    [[nodiscard]] static GLuint getCount() { return (GLuint)s_allocations.size(); }
+
+    /*! \brief
+     *  Getter for the name of a category
+     *  \param category Category to name
+     *  \return The name the benchmark JSON uses, e.g. "vertex_buffers"
+     */
+    [[nodiscard]] static const char* getCategoryName(Category category);
+
+    /*! \brief
+     *  Prints the totals by category and the largest objects to the standard output
+     *  \param count How many of the largest objects to list
+     */
+    static void printReport(GLuint count);
+
+private:
+    static std::vector<Allocation> s_allocations;
+
+    /*! \brief
+     *  Adds an object, a name made again replaces what was there
+     *  \param allocation Object to add
+     */
+    static void add(const Allocation& allocation);
+
+    /*! \brief
+     *  Removes an object, textures, buffers and renderbuffers each have their own names
+     *  \param name Name of the object
+     *  \param first First category of its kind
+     *  \param last Last category of its kind
+     */
+    static void release(GLuint name, Category first, Category last);
+};
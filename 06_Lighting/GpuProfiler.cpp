@@ -0,0 +1,180 @@
+#include "GpuProfiler.h"
+
+#include <cstring>
+
+/// Public methods
+
+void GpuProfiler::init()
+{
+    for (auto& slot : m_slots)
+        glGenQueries(MAX_SCOPES * 2, slot.queries);
+
+    m_enabled = true;
+}
+
+void GpuProfiler::destroy()
+{
+    if (!m_enabled)
+        return;
+
+    for (auto& slot : m_slots)
+        glDeleteQueries(MAX_SCOPES * 2, slot.queries);
+
+    m_enabled = false;
+}
+
+void GpuProfiler::setFirstMeasuredFrame(GLuint frame) { m_firstMeasuredFrame = frame; }
+
+void GpuProfiler::beginFrame()
+{
+    if (!m_enabled)
+        return;
+
+    // Whatever finished since the last frame
+    for (auto& slot : m_slots)
+        collect(slot, false);
+
+    FrameSlot& slot = m_slots[m_frame % FRAME_LATENCY];
+
+    // Still not done, dropped
+    slot.pending    = false;
+    slot.frame      = m_frame;
+    slot.entryCount = 0;
+    m_openCount     = 0;
+
+    beginScope("Frame");
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!m_enabled)
+        return;
+
+    endScope();
+
+    FrameSlot& slot = m_slots[m_frame % FRAME_LATENCY];
+    slot.pending = slot.entryCount > 0;
+
+    ++m_frame;
+}
+
+void GpuProfiler::beginScope(const char* name)
+{
+    if (!m_enabled || m_openCount == MAX_SCOPES)
+        return;
+
+    FrameSlot& slot  = m_slots[m_frame % FRAME_LATENCY];
+    GLuint     scope = findScope(name, m_openCount);
+    GLuint     entry = NO_ENTRY;
+
+    // Past MAX_SCOPES names, or entries in a frame, the scope is not timed
+    if (scope != NO_ENTRY && slot.entryCount < MAX_SCOPES)
+    {
+        entry = slot.entryCount++;
+        slot.scopes[entry] = scope;
+        glQueryCounter(slot.queries[entry * 2], GL_TIMESTAMP);
+    }
+
+    m_open[m_openCount++] = entry;
+}
+
+void GpuProfiler::endScope()
+{
+    if (!m_enabled || m_openCount == 0)
+        return;
+
+    FrameSlot& slot  = m_slots[m_frame % FRAME_LATENCY];
+    GLuint     entry = m_open[--m_openCount];
+
+    if (entry != NO_ENTRY)
+        glQueryCounter(slot.queries[entry * 2 + 1], GL_TIMESTAMP);
+}
+
+void GpuProfiler::flush()
+{
+    if (!m_enabled)
+        return;
+
+    for (auto& slot : m_slots)
+        collect(slot, true);
+}
+
+GLuint GpuProfiler::getScopeCount() const { return m_scopeCount; }
+
+const char* GpuProfiler::getScopeName(GLuint scope) const { return m_scopes[scope].name; }
+
+GLuint GpuProfiler::getScopeDepth(GLuint scope) const { return m_scopes[scope].depth; }
+
+double GpuProfiler::getRollingAverage(GLuint scope) const
+{
+    const Scope& s = m_scopes[scope];
+
+    return s.sampleCount == 0 ? 0.0 : s.windowSum / s.sampleCount;
+}
+
+double GpuProfiler::getMeasuredAverage(GLuint scope) const
+{
+    const Scope& s = m_scopes[scope];
+
+    return s.measuredCount == 0 ? 0.0 : s.measuredSum / s.measuredCount;
+}
+
+/// Private methods
+
+GLuint GpuProfiler::findScope(const char* name, GLuint depth)
+{
+    for (GLuint i = 0; i < m_scopeCount; ++i)
+        if (strcmp(m_scopes[i].name, name) == 0)
+            return i;
+
+    if (m_scopeCount == MAX_SCOPES)
+        return NO_ENTRY;
+
+    m_scopes[m_scopeCount].name  = name;
+    m_scopes[m_scopeCount].depth = depth;
+
+    return m_scopeCount++;
+}
+
+void GpuProfiler::collect(FrameSlot& slot, bool wait)
+{
+    if (!slot.pending)
+        return;
+
+    // The end of the frame scope was the last query issued
+    GLint available = GL_FALSE;
+    if (!wait)
+        glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!wait && !available)
+        return;
+
+    for (GLuint i = 0; i < slot.entryCount; ++i)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(slot.queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(slot.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        addSample( m_scopes[slot.scopes[i]], (double)(end - begin) / 1000000.0, slot.frame >= m_firstMeasuredFrame );
+    }
+
+    slot.pending = false;
+}
+
+void GpuProfiler::addSample(Scope& scope, double milliseconds, bool measured)
+{
+    if (scope.sampleCount == AVERAGE_FRAMES)
+        scope.windowSum -= scope.window[scope.nextSample];
+    else
+        ++scope.sampleCount;
+
+    scope.window[scope.nextSample] = milliseconds;
+    scope.windowSum  += milliseconds;
+    scope.nextSample  = (scope.nextSample + 1) % AVERAGE_FRAMES;
+
+    if (measured)
+    {
+        scope.measuredSum += milliseconds;
+        ++scope.measuredCount;
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+/*! \file
+ *  This header declares GpuProfiler class
+ */
+
+#include <GL/glew.h>
+
+/*! \class
+ *  Times named passes of the frame on the GPU. Every scope is a pair of
+ *  GL_TIMESTAMP queries: unlike GL_TIME_ELAPSED they nest, and they don't get
+ *  in the way of the benchmark's own GL_TIME_ELAPSED query around the frame.
+ *  \note The queries of a frame are read FRAME_LATENCY frames later, once the
+ *  GPU is done with them. A frame whose results are still not there when its
+ *  queries come round again is dropped rather than waited for, so the profiler
+ *  never stalls the pipeline.
+ */
+class GpuProfiler
+{
+public:
+    static constexpr GLuint MAX_SCOPES     = 16;
+    static constexpr GLuint AVERAGE_FRAMES = 60;	// Frames of the rolling average
+
+    /*! \brief
+     *  Creates the queries, the GL context has to be current
+     */
+    void init();
+
+    /*! \brief
+     *  Deletes the queries
+     */
+    void destroy();
+
+    /*! \brief
+     *  Setter for the first measured frame
+     *  \param frame Frames from this one on count towards getMeasuredAverage,
+     *  as the ones after the warmup of a benchmark
+     */
+    void setFirstMeasuredFrame(GLuint frame);
+
+    /*! \brief
+     *  Reads the results that are there and opens the frame scope
+     */
+    void beginFrame();
+
+    /*! \brief
+     *  Closes the frame scope
+     */
+    void endFrame();
+
+    /*! \brief
+     *  Starts timing a pass, scopes nest and each endScope closes the last one opened
+     *  \param name Name of the pass, has to stay valid (a string literal)
+     */
+    void beginScope(const char* name);
+
+    /*! \brief
+     *  Stops timing the last pass started
+     */
+    void endScope();
+
+    /*! \brief
+     *  Waits for the frames still in flight, so the measured averages take in the last frames too
+     */
+    void flush();
+
+    /*! \brief
+     *  Getter for the scope count
+     *  \return Scopes seen so far, in the order they were first opened, the first one is the frame
+     */
+    [[nodiscard]] GLuint getScopeCount() const;
+
+    /*! \brief
+     *  Getter for a scope name
+     *  \param scope Index of the scope
+     *  \return The name given to beginScope
+     */
+    [[nodiscard]] const char* getScopeName(GLuint scope) const;
+
+    /*! \brief
+     *  Getter for a scope depth
+     *  \param scope Index of the scope
+     *  \return How deep the scope is nested, 0 for the frame
+     */
+    [[nodiscard]] GLuint getScopeDepth(GLuint scope) const;
+
+    /*! \brief
+     *  Getter for the rolling average
+     *  \param scope Index of the scope
+     *  \return Milliseconds, over the last AVERAGE_FRAMES frames
+     */
+    [[nodiscard]] double getRollingAverage(GLuint scope) const;
+
+    /*! \brief
+     *  Getter for the measured average
+     *  \param scope Index of the scope
+     *  \return Milliseconds, over the frames from setFirstMeasuredFrame on
+     */
+    [[nodiscard]] double getMeasuredAverage(GLuint scope) const;
+
+private:
+    static constexpr GLuint FRAME_LATENCY = 4;
+    static constexpr GLuint NO_ENTRY      = 0xFFFFFFFF;
+
+    struct Scope
+    {
+        const char* name  = nullptr;
+        GLuint      depth = 0;
+
+        double window[AVERAGE_FRAMES] = {};	// Rolling average, the last samples and their sum
+        double windowSum              = 0.0;
+        GLuint sampleCount            = 0;
+        GLuint nextSample             = 0;
+
+        double measuredSum   = 0.0;
+        GLuint measuredCount = 0;
+    };
+
+    /*! \brief
+     *  The queries of one frame in flight, a begin and an end timestamp for each scope entered
+     */
+    struct FrameSlot
+    {
+        GLuint queries[MAX_SCOPES * 2] = {};
+        GLuint scopes[MAX_SCOPES]      = {};
+        GLuint entryCount              = 0;
+        GLuint frame                   = 0;
+        bool   pending                 = false;
+    };
+
+    bool   m_enabled            = false;
+    GLuint m_frame              = 0;
+    GLuint m_firstMeasuredFrame = 0;
+
+    Scope  m_scopes[MAX_SCOPES];
+    GLuint m_scopeCount = 0;
+
+    FrameSlot m_slots[FRAME_LATENCY];
+
+    /*! \brief
+     *  Entries of the current frame still open
+     */
+    GLuint m_open[MAX_SCOPES] = {};
+    GLuint m_openCount        = 0;
+
+    /*! \brief
+     *  Method to find a scope by name, or add it
+     *  \param name Name of the scope
+     *  \param depth Depth of the scope, when it is added
+     *  \return Index of the scope, NO_ENTRY when there is no room
+     */
+    GLuint findScope(const char* name, GLuint depth);
+
+    /*! \brief
+     *  Method to read the results of a frame
+     *  \param slot The frame
+     *  \param wait Whether to wait for results that are not there yet
+     */
+    void collect(FrameSlot& slot, bool wait);
+
+    /*! \brief
+     *  Method to add a time to a scope
+     *  \param scope The scope
+     *  \param milliseconds The time
+     *  \param measured Whether it counts towards the measured average
+     */
+    static void addSample(Scope& scope, double milliseconds, bool measured);
+};
@@ -0,0 +1,143 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#include <SOIL2/SOIL2.h>
+
+#include "GpuMemory.h"
+
+/// Public methods
+
+Headless::Headless() : m_startTime( std::chrono::steady_clock::now() ) {}
+
+Headless::~Headless() { destroy(); }
+
+bool Headless::createContext()
+{
+#ifdef HEADLESS_EGL
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay)
+        m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+    // Without the Mesa platform the default display may still do, e.g. with EGL_PLATFORM=surfaceless
+    if (m_display == EGL_NO_DISPLAY)
+        m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if ( m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr) )
+    {
+        std::cerr << "Failed to initialize EGL!" << std::endl;
+        return false;
+    }
+
+    EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3,
+                                   EGL_CONTEXT_MINOR_VERSION, 3,
+                                   EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                   EGL_NONE };
+    EGLConfig config;
+    EGLint    configCount = 0;
+
+    if ( !eglBindAPI(EGL_OPENGL_API) ||
+         !eglChooseConfig(m_display, configAttributes, &config, 1, &configCount) || configCount == 0 )
+    {
+        std::cerr << "Failed to find an EGL config for OpenGL!" << std::endl;
+        return false;
+    }
+
+    m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+
+    // Without a surface, this needs EGL_KHR_surfaceless_context
+    if ( m_context == EGL_NO_CONTEXT || !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context) )
+    {
+        std::cerr << "Failed to create an OpenGL 3.3 context with EGL!" << std::endl;
+        return false;
+    }
+
+    return true;
+#else
+    std::cerr << "Headless rendering needs EGL, which this build was made without!" << std::endl;
+    return false;
+#endif
+}
+
+bool Headless::createFramebuffer(GLuint width, GLuint height)
+{
+    m_width  = width;
+    m_height = height;
+
+    // Color and depth-stencil, like the window framebuffer GLFW gives by default
+    glGenRenderbuffers(1, &m_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &m_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    GpuMemory::registerRenderbuffer(m_colorBuffer, "headless framebuffer");
+    GpuMemory::registerRenderbuffer(m_depthBuffer, "headless framebuffer");
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Failed to create the headless framebuffer!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Headless::destroy()
+{
+#ifdef HEADLESS_EGL
+    if (m_context != EGL_NO_CONTEXT)
+    {
+        if (m_framebuffer)
+        {
+            glDeleteFramebuffers(1, &m_framebuffer);
+            glDeleteRenderbuffers(1, &m_colorBuffer);
+            glDeleteRenderbuffers(1, &m_depthBuffer);
+            GpuMemory::releaseRenderbuffer(m_colorBuffer);
+            GpuMemory::releaseRenderbuffer(m_depthBuffer);
+            m_framebuffer = 0;
+        }
+
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(m_display, m_context);
+        m_context = EGL_NO_CONTEXT;
+    }
+
+    if (m_display != EGL_NO_DISPLAY)
+    {
+        eglTerminate(m_display);
+        m_display = EGL_NO_DISPLAY;
+    }
+#endif
+}
+
+void Headless::dumpFrame(GLuint frame) { m_dumpFrames.push_back(frame); }
+
+void Headless::endFrame()
+{
+    if ( std::find(m_dumpFrames.begin(), m_dumpFrames.end(), m_frame) != m_dumpFrames.end() )
+    {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "headless_%05u.png", m_frame);
+
+        if ( !SOIL_save_screenshot(filename, SOIL_SAVE_TYPE_PNG, 0, 0, (int)m_width, (int)m_height) )
+            std::cerr << "Failed to save " << filename << "!" << std::endl;
+    }
+
+    ++m_frame;
+}
+
+double Headless::getTime() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
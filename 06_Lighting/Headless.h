@@ -0,0 +1,90 @@
+#pragma once
+
+/*! \file
+ *  This header declares Headless class
+ */
+
+#include <chrono>
+#include <vector>
+
+#include <GL/glew.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/*! \class
+ *  Renders without a window, for benchmarks and for machines without a display.
+ *  The context comes from EGL without any surface (Mesa gives one with llvmpipe
+ *  when there is no GPU) and the scene draws into a framebuffer object, which
+ *  stays bound so the rendering code does not change.
+ *  \note Only available where the build found EGL (HEADLESS_EGL)
+ */
+class Headless
+{
+public:
+    Headless();
+
+    Headless(const Headless&) = delete;
+    Headless& operator=(const Headless&) = delete;
+
+    /*! \brief
+     *  Destructor, releases the framebuffer and the context
+     */
+    ~Headless();
+
+    /*! \brief
+     *  Creates an OpenGL 3.3 core context and makes it current
+     *  \return Whether there is a context, GLEW has to be initialized after it
+     */
+    bool createContext();
+
+    /*! \brief
+     *  Creates the framebuffer to render into and leaves it bound
+     *  \param width Width in pixels
+     *  \param height Height in pixels
+     *  \return Whether the framebuffer is complete
+     */
+    bool createFramebuffer(GLuint width, GLuint height);
+
+    /*! \brief
+     *  Releases the framebuffer and the context
+     */
+    void destroy();
+
+    /*! \brief
+     *  Selects a frame to save as headless_<frame>.png once it is rendered,
+     *  the frame padded to 5 digits (headless_00042.png)
+     *  \param frame Frame number, counted from 0
+     */
+    void dumpFrame(GLuint frame);
+
+    /*! \brief
+     *  Takes the place of swapping the buffers of a window
+     */
+    void endFrame();
+
+    /*! \brief
+     *  Getter for the time, in place of glfwGetTime which needs a display
+     *  \return Seconds since the object was created
+     */
+    [[nodiscard]] double getTime() const;
+
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLContext m_context = EGL_NO_CONTEXT;
+#endif
+
+    GLuint m_width       = 0;
+    GLuint m_height      = 0;
+    GLuint m_frame       = 0;
+    GLuint m_framebuffer = 0;
+    GLuint m_colorBuffer = 0;
+    GLuint m_depthBuffer = 0;
+
+    std::vector<GLuint> m_dumpFrames;
+
+    std::chrono::steady_clock::time_point m_startTime;
+};
@@ -0,0 +1,175 @@
+#include "Overlay.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "GLStats.h"
+#include "GpuMemory.h"
+
+namespace
+{
+    /// Five rows of three bits, one octal digit a row, the top one first
+    constexpr unsigned short FONT[] =
+    {
+        000000, 022202, 055000, 057575, 036236, 051245, 025253, 022000,   //   ! " # $ % & '
+        012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244,   // ( ) * + , - . /
+        075557, 026227, 071747, 071317, 055711, 074717, 074757, 071111,   // 0 1 2 3 4 5 6 7
+        075757, 075717, 002020, 002024, 012421, 007070, 042124, 071302,   // 8 9 : ; < = > ?
+        075747, 025755, 065656, 034443, 065556, 074647, 074644, 034553,   // @ A B C D E F G
+        055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552,   // H I J K L M N O
+        065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775,   // P Q R S T U V W
+        055255, 055222, 071247, 064446, 044211, 031113, 025000, 000007,   // X Y Z [ \ ] ^ _
+        077777
+    };
+
+    /// Lower case prints as upper case, anything the font doesn't have as a space
+    GLuint glyphIndex(char c)
+    {
+        if (c >= 'a' && c <= 'z')
+            c = (char)(c - 'a' + 'A');
+
+        return c > ' ' && c <= '_' ? (GLuint)(c - ' ') : 0;
+    }
+}
+
+/// Public methods
+
+void Overlay::init(GLuint program)
+{
+    m_program       = program;
+    m_screenSizeLoc = glGetUniformLocation(program, "screenSize");
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "font"), 0);
+    glUseProgram(0);
+
+    // Every glyph is a 4x6 cell of the texture, the glyph in its top left and a pixel of spacing around
+    GLubyte pixels[CELL_HEIGHT][GLYPH_COUNT * CELL_WIDTH] = {};
+
+    for (GLuint glyph = 0; glyph < GLYPH_COUNT; ++glyph)
+        for (GLuint y = 0; y < 5; ++y)
+            for (GLuint x = 0; x < 3; ++x)
+                if ( FONT[glyph] & (1 << ((4 - y) * 3 + (2 - x))) )
+                    pixels[y][glyph * CELL_WIDTH + x] = 255;
+
+    glGenTextures(1, &m_fontTexture);
+    glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, GLYPH_COUNT * CELL_WIDTH, CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GpuMemory::registerTexture(GL_TEXTURE_2D, m_fontTexture, "overlay font");
+
+    // Position in pixels from the top left, texture coords and color
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (GLvoid*)nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)) );
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer( 2, 4, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (GLvoid*)(4 * sizeof(GLfloat)) );
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+    GpuMemory::registerBuffer(GL_ARRAY_BUFFER, m_vbo, "overlay");
+}
+
+void Overlay::destroy()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteTextures(1, &m_fontTexture);
+    GpuMemory::releaseBuffer(m_vbo);
+    GpuMemory::releaseTexture(m_fontTexture);
+    m_vao = m_vbo = m_fontTexture = 0;
+}
+
+void Overlay::clear() { m_lineCount = 0; }
+
+void Overlay::print(const char* format, ...)
+{
+    if (m_lineCount == MAX_LINES)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(m_lines[m_lineCount++], MAX_LINE_LENGTH + 1, format, args);
+    va_end(args);
+}
+
+void Overlay::draw(GLuint screenWidth, GLuint screenHeight)
+{
+    if (m_lineCount == 0 || m_vao == 0)
+        return;
+
+    size_t longest = 0;
+    for (GLuint i = 0; i < m_lineCount; ++i)
+        longest = std::max( longest, strlen(m_lines[i]) );
+
+    const GLfloat background[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+    const GLfloat text[4]       = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const auto    cellWidth     = (GLfloat)(CELL_WIDTH * SCALE);
+    const auto    cellHeight    = (GLfloat)(CELL_HEIGHT * SCALE);
+
+    // Background first, with the solid glyph
+    m_vertexCount = 0;
+    addQuad(0.0f, 0.0f, (GLfloat)(longest + 1) * cellWidth, (GLfloat)(m_lineCount + 1) * cellHeight, SOLID_GLYPH, background);
+
+    for (GLuint i = 0; i < m_lineCount; ++i)
+        for (GLuint j = 0; m_lines[i][j] != '\0'; ++j)
+        {
+            GLuint glyph = glyphIndex(m_lines[i][j]);
+
+            if (glyph != 0)
+                addQuad((GLfloat)j * cellWidth + cellWidth / 2, (GLfloat)i * cellHeight + cellHeight / 2,
+                        3 * SCALE, 5 * SCALE, glyph, text);
+        }
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(m_program);
+    glUniform2f(m_screenSizeLoc, (GLfloat)screenWidth, (GLfloat)screenHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertexCount * VERTEX_FLOATS * sizeof(GLfloat), m_vertices);
+    glBindVertexArray(m_vao);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)m_vertexCount);
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+/// Private methods
+
+void Overlay::addQuad(GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLuint glyph, const GLfloat color[4])
+{
+    const GLfloat textureWidth = GLYPH_COUNT * CELL_WIDTH;
+    const GLfloat u0 = (GLfloat)(glyph * CELL_WIDTH) / textureWidth;
+    const GLfloat u1 = (GLfloat)(glyph * CELL_WIDTH + 3) / textureWidth;
+    const GLfloat v1 = 5.0f / CELL_HEIGHT;
+    const GLfloat corners[6][4] = { { x, y, u0, 0.0f }, { x, y + height, u0, v1 }, { x + width, y + height, u1, v1 },
+                                    { x, y, u0, 0.0f }, { x + width, y + height, u1, v1 }, { x + width, y, u1, 0.0f } };
+
+    for (const auto& corner : corners)
+    {
+        GLfloat* vertex = &m_vertices[(m_vertexCount++) * VERTEX_FLOATS];
+
+        memcpy( vertex, corner, 4 * sizeof(GLfloat) );
+        memcpy( vertex + 4, color, 4 * sizeof(GLfloat) );
+    }
+}
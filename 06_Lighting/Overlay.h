@@ -0,0 +1,81 @@
+#pragma once
+
+/*! \file
+ *  This header declares Overlay class
+ */
+
+#include <GL/glew.h>
+
+/*! \class
+ *  Lines of text drawn over the top left of the frame, for the profiler numbers.
+ *  \note The font is a built-in 3x5 pixel one, upper case only, so there are no
+ *  font files to load. Lines are printed anew every frame between clear and
+ *  draw, into fixed size arrays, so the overlay does not allocate while it runs.
+ */
+class Overlay
+{
+public:
+    static constexpr GLuint MAX_LINES       = 24;
+    static constexpr GLuint MAX_LINE_LENGTH = 48;
+    static constexpr GLuint SCALE           = 2;	// Screen pixels per font pixel
+
+    /*! \brief
+     *  Creates the font texture and the vertex buffer, the GL context has to be current
+     *  \param program The program built from Shaders/overlay.vert and Shaders/overlay.frag
+     */
+    void init(GLuint program);
+
+    /*! \brief
+     *  Deletes the font texture and the vertex buffer
+     */
+    void destroy();
+
+    /*! \brief
+     *  Starts the lines of a new frame
+     */
+    void clear();
+
+    /*! \brief
+     *  Adds a line, longer lines are cut
+     *  \param format printf format
+     */
+    void print(const char* format, ...);
+
+    /*! \brief
+     *  Draws the lines on a dark background, over whatever is in the framebuffer
+     *  \param screenWidth Width of the framebuffer
+     *  \param screenHeight Height of the framebuffer
+     */
+    void draw(GLuint screenWidth, GLuint screenHeight);
+
+private:
+    static constexpr GLuint CELL_WIDTH    = 4;
+    static constexpr GLuint CELL_HEIGHT   = 6;
+    static constexpr GLuint GLYPH_COUNT   = 65;	// ' ' to '_', and a solid block for the background
+    static constexpr GLuint SOLID_GLYPH   = 64;
+    static constexpr GLuint VERTEX_FLOATS = 8;
+    static constexpr GLuint MAX_QUADS     = MAX_LINES * MAX_LINE_LENGTH + 1;
+
+    GLuint m_program       = 0;
+    GLuint m_vao           = 0;
+    GLuint m_vbo           = 0;
+    GLuint m_fontTexture   = 0;
+    GLint  m_screenSizeLoc = -1;
+
+    char   m_lines[MAX_LINES][MAX_LINE_LENGTH + 1] = {};
+    GLuint m_lineCount                             = 0;
+
+    GLfloat m_vertices[MAX_QUADS * 6 * VERTEX_FLOATS] = {};
+    GLuint  m_vertexCount                             = 0;
+
+    /*! \brief
+     *  Method to add the two triangles of a glyph
+     *  \param x Left, in pixels
+     *  \param y Top, in pixels
+     *  \param width Width, in pixels
+     *  \param height Height, in pixels
+     *  \param glyph Index of the glyph in the font
+     *  \param color RGBA color
+     */
+    void addQuad(GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLuint glyph, const GLfloat color[4]);
+};
@@ -4,8 +4,13 @@
 
 #include "Shader.h"
 
+#include "CpuProfiler.h"
+#include "GLStats.h"
+
 Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
 {
+    CPU_PROFILE_SCOPE("Shader compile");
+
     std::string vertexCode;
     std::string fragmentCode;
     std::ifstream vShaderFile;
@@ -2,8 +2,13 @@
 // Created by Nikolay Fedotenko on 18.12.2021.
 //
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include <SOIL2/SOIL2.h>
 
@@ -13,6 +18,16 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "AllocationTracker.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "CpuProfiler.h"
+#include "GLCapture.h"
+#include "GLStats.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "Headless.h"
+#include "Overlay.h"
 
 /// Window dimensions
 const GLuint WIDTH = 800, HEIGHT = 600;
@@ -32,6 +47,25 @@ glm::vec3 lightPos( 1.2f, 1.0f, 2.0f );
 GLfloat deltaTime = 0.0f;	// Time between current frame and last frame
 GLfloat lastFrame = 0.0f;  	// Time of last frame
 
+/// Camera path, recorded with --record <file> and played back with --replay <file>
+CameraPath cameraPath;
+bool       replaying    = false;
+GLfloat    replayStep   = 1.0f / 60.0f;	// Fixed timestep of the playback
+GLuint     replayFrames = 0;
+
+/// Rendering without a window, with --headless
+bool     headless   = false;
+Headless headlessContext;
+GLuint   frameLimit = 0;
+
+/// Frame time measurements, with --benchmark
+Benchmark benchmark;
+
+/// GPU time of the passes, shown with --overlay or toggled with O
+GpuProfiler gpuProfiler;
+Overlay     overlay;
+bool        showOverlay = false;
+
 /// Function declarations
 
 /*! \brief
@@ -58,49 +92,203 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
  */
 void mouseCallback(GLFWwindow* window, double xPos, double yPos);
 
+/*! \brief
+ *  Time function, GLFW's timer is only there with a window
+ *  \return Seconds since the start
+ */
+double getTime();
+
 
 /*! \brief
  *  Main function, inits and runs everything
+ *  \param argc Number of arguments
+ *  \param argv [--record <path>] [--replay <path>] [--replay-step <seconds>]
+ *              [--headless] [--frames <count>] [--dump-frame <frame>]... [--overlay] [--trace <path>] [--alloc-check]
+ *              [--benchmark] [--warmup <frames>] [--measure <frames>]
+ *              [--json <path>] [--baseline <path>] [--tolerance <percent>]
+ *              [--capture <path>] [--capture-frame <frame>] [--gpu-memory <count>]
  */
-int main( )
+int main(int argc, char* argv[])
 {
-    glfwInit();
+    const char* recordPath   = nullptr;
+    const char* replayPath   = nullptr;
+    const char* jsonPath     = nullptr;
+    const char* baselinePath = nullptr;
+    const char* tracePath    = nullptr;
+    const char* capturePath  = nullptr;
+    bool        benchmarking    = false;
+    bool        allocationCheck = false;
+    bool        gpuMemoryReport = false;
+    GLuint      warmupFrames = 60, measuredFrames = 600;
+    GLuint      captureFrame = 0;
+    GLuint      gpuMemoryTop = 0;	// With --gpu-memory, how many of the largest allocations the report at the end lists
+    double      tolerance    = 10.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--replay-step") == 0 && i + 1 < argc)
+            replayStep = (GLfloat)atof(argv[++i]);
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameLimit = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc)
+            headlessContext.dumpFrame( (GLuint)atoi(argv[++i]) );
+        else if (strcmp(argv[i], "--overlay") == 0)
+            showOverlay = true;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (strcmp(argv[i], "--alloc-check") == 0)
+            allocationCheck = true;
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            benchmarking = true;
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            warmupFrames = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--measure") == 0 && i + 1 < argc)
+            measuredFrames = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (strcmp(argv[i], "--capture-frame") == 0 && i + 1 < argc)
+            captureFrame = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--gpu-memory") == 0 && i + 1 < argc)
+        {
+            gpuMemoryReport = true;
+            gpuMemoryTop    = (GLuint)atoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--record <path>] [--replay <path>] [--replay-step <seconds>]"
+                      << " [--headless] [--frames <count>] [--dump-frame <frame>]... [--overlay] [--trace <path>] [--alloc-check]"
+                      << " [--benchmark] [--warmup <frames>] [--measure <frames>]"
+                      << " [--json <path>] [--baseline <path>] [--tolerance <percent>]"
+                      << " [--capture <path>] [--capture-frame <frame>] [--gpu-memory <count>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    if ( allocationCheck && !AllocationTracker::isAvailable() )
+    {
+        std::cerr << "--alloc-check needs a build with TRACK_ALLOCATIONS!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The capture goes through the wrappers of GLCapture, which only a build without NDEBUG has
+    if (capturePath)
+    {
+        if ( !GLCapture::isAvailable() )
+        {
+            std::cerr << "--capture needs a build without NDEBUG!" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT,
-                                          "C++ sect: OpenGL (lecture 6)", nullptr, nullptr);
+        GLCapture::captureFrame(capturePath, captureFrame);
+    }
 
-    if (!window)
+    // CPU scopes from the start, so loading is in the trace too
+    if (tracePath)
     {
-        std::cerr << "Failed to create window!" << std::endl;
-        glfwTerminate();
+        CpuProfiler::enable();
+        CpuProfiler::setThreadName("Main");
+    }
+
+    // The benchmark decides how long the run is
+    if (benchmarking)
+        frameLimit = warmupFrames + measuredFrames;
+
+    // Nothing would end a headless run otherwise
+    if (headless && !replayPath && frameLimit == 0)
+        frameLimit = 100;
+
+    if (replayPath)
+    {
+        if ( !cameraPath.load(replayPath) || replayStep <= 0.0f )
+        {
+            std::cerr << "Failed to load camera path " << replayPath << "!" << std::endl;
+            return EXIT_FAILURE;
+        }
 
+        replaying = true;
+    }
+    else if ( recordPath && !cameraPath.beginRecording(recordPath) )
+    {
+        std::cerr << "Failed to create camera path " << recordPath << "!" << std::endl;
         return EXIT_FAILURE;
     }
 
-    // Use callbacks
-    glfwSetKeyCallback(window, keyCallback);
-    glfwSetCursorPosCallback(window, mouseCallback);
+    GLFWwindow* window = nullptr;
+
+    if (headless)
+    {
+        if ( !headlessContext.createContext() )
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        glfwInit();
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+        window = glfwCreateWindow(WIDTH, HEIGHT, "C++ sect: OpenGL (lecture 6)", nullptr, nullptr);
+
+        if (!window)
+        {
+            std::cerr << "Failed to create window!" << std::endl;
+            glfwTerminate();
+
+            return EXIT_FAILURE;
+        }
+
+        // Use callbacks
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetCursorPosCallback(window, mouseCallback);
 
-    glfwMakeContextCurrent(window);
-    glfwGetFramebufferSize(window, &SCREEN_WIDTH, &SCREEN_HEIGHT);
+        glfwMakeContextCurrent(window);
+        glfwGetFramebufferSize(window, &SCREEN_WIDTH, &SCREEN_HEIGHT);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK)
+    GLenum glewStatus = glewInit();
+
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // A GLEW built for GLX has loaded the functions by the time it finds there is no GLX display
+    if (headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewStatus = GLEW_OK;
+#endif
+
+    if (glewStatus != GLEW_OK)
     {
         std::cerr << "Failed to initialize GLEW!" << std::endl;
         return EXIT_FAILURE;
     }
 
+    if (headless)
+    {
+        if ( !headlessContext.createFramebuffer(WIDTH, HEIGHT) )
+            return EXIT_FAILURE;
+
+        SCREEN_WIDTH  = WIDTH;
+        SCREEN_HEIGHT = HEIGHT;
+    }
+
     glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
     // Use Z-buffer
@@ -110,6 +298,7 @@ int main( )
     // Build and compile our shader programs
     Shader lightingShader("Shaders/lighting.vert", "Shaders/lighting.frag");
     Shader lampShader("Shaders/lamp.vert", "Shaders/lamp.frag");
+    Shader overlayShader("Shaders/overlay.vert", "Shaders/overlay.frag");
 
     // Set up vertex data (with buffers) and attribute pointers
     GLfloat vertices[] =
@@ -187,6 +376,7 @@ int main( )
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    GpuMemory::registerBuffer(GL_ARRAY_BUFFER, VBO, "container");
 
     glBindVertexArray(boxVAO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)nullptr);
@@ -216,8 +406,10 @@ int main( )
     unsigned char* image;
 
     // Diffuse map
+    CpuProfileScope diffuseDecodeScope("Decode");
     image = SOIL_load_image("Images/container2.png",
                             &imageWidth, &imageHeight, nullptr, SOIL_LOAD_RGB);
+    diffuseDecodeScope.end();
     glBindTexture(GL_TEXTURE_2D, diffuseMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -226,10 +418,13 @@ int main( )
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    GpuMemory::registerTexture(GL_TEXTURE_2D, diffuseMap, "Images/container2.png");
 
     // Specular map
+    CpuProfileScope specularDecodeScope("Decode");
     image = SOIL_load_image("Images/container2_specular.png",
                             &imageWidth, &imageHeight, nullptr, SOIL_LOAD_RGB);
+    specularDecodeScope.end();
     glBindTexture(GL_TEXTURE_2D, specularMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -239,6 +434,7 @@ int main( )
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST);
     glBindTexture(GL_TEXTURE_2D, 0);
+    GpuMemory::registerTexture(GL_TEXTURE_2D, specularMap, "Images/container2_specular.png");
 
     // Set texture units
     lightingShader.use();
@@ -249,21 +445,74 @@ int main( )
                                             (GLfloat)SCREEN_WIDTH / (GLfloat)SCREEN_HEIGHT,
                                             0.1f, 100.0f);
 
+    if (benchmarking)
+    {
+        benchmark.start(warmupFrames, measuredFrames);
+        gpuProfiler.setFirstMeasuredFrame(warmupFrames);
+    }
+
+    gpuProfiler.init();
+    overlay.init( overlayShader.getProgram() );
+
+    auto   replayStart = (GLfloat)getTime();
+    GLuint frames      = 0;
+
+    // With --alloc-check, the frames after the warmup that allocated and the first of them
+    GLuint          allocatingFrames = 0, firstAllocatingFrame = 0;
+    AllocationCount allocatedAfterWarmup, firstFrameAllocated;
+
     // Game (main) loop
-    while ( !glfwWindowShouldClose(window) )
+    while ( headless || !glfwWindowShouldClose(window) )
     {
+        if (frameLimit != 0 && frames == frameLimit)
+            break;
+
+        ++frames;
+
+        AllocationCount frameStartAllocations = AllocationTracker::getThreadCount();
+        CPU_PROFILE_SCOPE("Frame");
+        GLStats::beginFrame();
+        GLCapture::beginFrame();
+        benchmark.beginFrame();
+        gpuProfiler.beginFrame();
+
         // Set frame time
-        auto currentFrame = (GLfloat)glfwGetTime();
+        auto currentFrame = (GLfloat)getTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        glfwPollEvents();
-        doMovement();
+        if (!headless)
+            glfwPollEvents();
+
+        if (replaying)
+        {
+            // Fixed timestep, so every run renders the same frames whatever the machine
+            deltaTime = replayStep;
+
+            GLuint replayFrame = replayFrames;
+
+            // A benchmark runs its number of frames, going round the path as often as that takes
+            if ( benchmark.isEnabled() )
+                replayFrame %= (GLuint)(cameraPath.getDuration() / replayStep) + 1;
+
+            if ( !cameraPath.apply((GLfloat)replayFrame * replayStep, camera) )
+                break;
+
+            ++replayFrames;
+        }
+        else
+        {
+            doMovement();
+            cameraPath.record(currentFrame, camera);
+        }
+
+        CpuProfileScope submitScope("Submit");
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Use corresponding shader when setting uniforms/drawing objects
+        gpuProfiler.beginScope("Containers");
         lightingShader.use();
         GLint viewPosLoc = glGetUniformLocation(lightingShader.getProgram(), "viewPos");
         glUniform3f(viewPosLoc, camera.getPosition().x, camera.getPosition().y, camera.getPosition().z);
@@ -374,8 +623,10 @@ int main( )
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
         glBindVertexArray(0);
+        gpuProfiler.endScope();
 
         // Draw the lamp object also binding the appropriate shader
+        gpuProfiler.beginScope("Lamps");
         lampShader.use();
 
         // Get location objects for the matrices on the lamp shader (these could be different on a different shader)
@@ -407,21 +658,189 @@ int main( )
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
         glBindVertexArray(0);
+        gpuProfiler.endScope();
+
+        // The averages lag a few frames behind, the queries are read once the GPU is done with them
+        if (showOverlay)
+        {
+            gpuProfiler.beginScope("Overlay");
+            overlay.clear();
+            overlay.print("GPU MS, %u FRAME AVERAGE", GpuProfiler::AVERAGE_FRAMES);
+
+            for (GLuint i = 0; i < gpuProfiler.getScopeCount(); ++i)
+            {
+                auto indent = (int)(2 * gpuProfiler.getScopeDepth(i));
+                overlay.print("%*s%-*s%8.3f", indent, "", 14 - indent, gpuProfiler.getScopeName(i),
+                              gpuProfiler.getRollingAverage(i));
+            }
+
+            if ( GLStats::isAvailable() )
+            {
+                const GLFrameStats& stats = GLStats::getLastFrame();
+
+                overlay.print("GL CALLS, LAST FRAME");
+                overlay.print("  DRAWS %llu, TRIANGLES %llu", stats.drawCalls, stats.triangles);
+                overlay.print("  BINDS PROGRAM %llu VAO %llu TEXTURE %llu",
+                              stats.programBinds, stats.vertexArrayBinds, stats.textureBinds);
+                overlay.print("  UNIFORMS %llu, %llu BYTES", stats.uniformUploads, stats.uniformBytes);
+                overlay.print("  UPLOADS BUFFER %llu TEXTURE %llu BYTES",
+                              stats.bufferUploadBytes, stats.textureUploadBytes);
+            }
+
+            const double MB = 1024.0 * 1024.0;
+            overlay.print("GPU MEMORY %.2f MB", GpuMemory::getTotal() / MB);
+            overlay.print("  TEXTURES %.2f CUBEMAPS %.2f",
+                          GpuMemory::getTotal(GpuMemory::TEXTURES) / MB, GpuMemory::getTotal(GpuMemory::CUBEMAPS) / MB);
+            overlay.print("  BUFFERS %.2f TARGETS %.2f",
+                          ( GpuMemory::getTotal(GpuMemory::VERTEX_BUFFERS) + GpuMemory::getTotal(GpuMemory::INDEX_BUFFERS) +
+                            GpuMemory::getTotal(GpuMemory::OTHER_BUFFERS) ) / MB,
+                          GpuMemory::getTotal(GpuMemory::RENDER_TARGETS) / MB);
+
+            overlay.draw(SCREEN_WIDTH, SCREEN_HEIGHT);
+            gpuProfiler.endScope();
+        }
 
-        glfwSwapBuffers(window);
+        submitScope.end();
+        GLCapture::endFrame();
+
+        gpuProfiler.endFrame();
+        benchmark.endFrame();
+
+        if (headless)
+            headlessContext.endFrame();
+        else
+            glfwSwapBuffers(window);
+
+        // Once warm, a frame has everything it needs and should not touch the heap
+        if (allocationCheck && frames > warmupFrames)
+        {
+            AllocationCount allocated = AllocationTracker::difference( frameStartAllocations,
+                                                                       AllocationTracker::getThreadCount() );
+
+            if (allocated.allocations != 0)
+            {
+                if (allocatingFrames == 0)
+                {
+                    firstAllocatingFrame = frames - 1;
+                    firstFrameAllocated  = allocated;
+                }
+
+                ++allocatingFrames;
+                allocatedAfterWarmup.allocations += allocated.allocations;
+                allocatedAfterWarmup.bytes       += allocated.bytes;
+            }
+        }
     }
 
+    // Before anything is deleted, so the report has all the lesson made
+    if (gpuMemoryReport)
+        GpuMemory::printReport(gpuMemoryTop);
+
+    cameraPath.endRecording();
+
+    int exitCode = EXIT_SUCCESS;
+
+    if ( benchmark.isEnabled() )
+    {
+        benchmark.finish();
+        gpuProfiler.flush();
+
+        // The passes are only there to explain a change of the frame time, they are not compared with the baseline
+        for (GLuint i = 1; i < gpuProfiler.getScopeCount(); ++i)
+        {
+            std::string name = gpuProfiler.getScopeName(i);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            benchmark.addMetric("gpu_pass_" + name + "_ms", gpuProfiler.getMeasuredAverage(i), false);
+        }
+
+        // Only the total is compared, growing past the tolerance is a regression like a slower frame
+        for (GLuint i = 0; i < GpuMemory::CATEGORY_COUNT; ++i)
+        {
+            auto category = (GpuMemory::Category)i;
+            benchmark.addMetric(std::string("gpu_memory_") + GpuMemory::getCategoryName(category) + "_bytes",
+                                (double)GpuMemory::getTotal(category), false);
+        }
+
+        benchmark.addMetric("gpu_memory_bytes", (double)GpuMemory::getTotal(), true);
+
+        if ( !benchmark.writeJson(jsonPath, "06_Lighting") )
+        {
+            std::cerr << "Failed to write " << jsonPath << "!" << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+
+        // A regression, or a baseline that can't be read, fails the run
+        if ( baselinePath && benchmark.compareWithBaseline(baselinePath, tolerance) != 0 )
+            exitCode = EXIT_FAILURE;
+    }
+
+    // After the benchmark, which counts their memory too
     glDeleteVertexArrays(1, &boxVAO);
     glDeleteVertexArrays(1, &lightVAO);
     glDeleteBuffers(1, &VBO);
+    GpuMemory::releaseBuffer(VBO);
+    overlay.destroy();
+    gpuProfiler.destroy();
 
-    glfwTerminate();
+    if (allocationCheck)
+    {
+        GLuint checkedFrames = frames > warmupFrames ? frames - warmupFrames : 0;
+
+        // Nothing checked is no pass, --frames has to go past --warmup
+        if (checkedFrames == 0)
+        {
+            std::cerr << "No frames checked for allocations, the run ended within the " << warmupFrames << " warmup frames!"
+                      << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+        // --trace gives the allocations of every scope
+        else if (allocatingFrames != 0)
+        {
+            printf("ALLOCATIONS in %u of %u frames after the warmup: %llu, %llu bytes; the first in frame %u: %llu, %llu bytes\n",
+                   allocatingFrames, checkedFrames, allocatedAfterWarmup.allocations, allocatedAfterWarmup.bytes,
+                   firstAllocatingFrame, firstFrameAllocated.allocations, firstFrameAllocated.bytes);
+            exitCode = EXIT_FAILURE;
+        }
+        else
+            printf("No allocations in the %u frames after the warmup\n", checkedFrames);
+    }
 
-    return 0;
+    if ( GLCapture::isPending() )
+    {
+        std::cerr << "Nothing captured, the run ended before frame " << captureFrame << "!" << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    else if ( GLCapture::hasFailed() )
+    {
+        std::cerr << "Failed to write " << capturePath << "!" << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+
+    if ( tracePath && !CpuProfiler::writeTrace(tracePath) )
+    {
+        std::cerr << "Failed to write " << tracePath << "!" << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+
+    if (replaying)
+    {
+        auto replayTime = (GLfloat)getTime() - replayStart;
+        printf("Replayed %u frames in %.3f s, %.3f ms per frame\n",
+               replayFrames, replayTime, replayFrames ? 1000.0f * replayTime / (GLfloat)replayFrames : 0.0f);
+    }
+
+    if (headless)
+        headlessContext.destroy();
+    else
+        glfwTerminate();
+
+    return exitCode;
 }
 
 /// Function definitions
 
+double getTime() { return headless ? headlessContext.getTime() : glfwGetTime(); }
+
 void doMovement()
 {
     // Camera controls
@@ -439,12 +858,19 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
-    else if (key >= 0 && key < 1024)
+    else if (key == GLFW_KEY_O && action == GLFW_PRESS)
+        showOverlay = !showOverlay;
+
+    if (key >= 0 && key < 1024)
         keys[key] = action == GLFW_PRESS;
 }
 
 void mouseCallback(GLFWwindow* window, double xPos, double yPos)
 {
+    // The recorded path drives the camera
+    if (replaying)
+        return;
+
     if (firstMouse)
     {
         lastX = (GLfloat)xPos;
@@ -0,0 +1,126 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Benchmark.h"
+#include "GLReplay.h"
+#include "GLStats.h"
+#include "Headless.h"
+
+/*! \brief
+ *  Runs a frame captured with --capture again and again, headless, and times it like --benchmark times the
+ *  lesson: the same JSON and the same baseline comparison, without the lesson, its assets or a window.
+ *  GALLIUM_DRIVER picks the software driver to compare, e.g. llvmpipe and softpipe, or two builds of Mesa.
+ *  \param argc Number of arguments
+ *  \param argv <trace> [--warmup <frames>] [--measure <frames>] [--json <path>] [--baseline <path>]
+ *              [--tolerance <percent>] [--dump-frame <frame>]...
+ */
+int main(int argc, char* argv[])
+{
+    const char* tracePath    = nullptr;
+    const char* jsonPath     = nullptr;
+    const char* baselinePath = nullptr;
+    GLuint      warmupFrames = 10, measuredFrames = 100;
+    double      tolerance    = 10.0;
+    Headless    headless;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            warmupFrames = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--measure") == 0 && i + 1 < argc)
+            measuredFrames = (GLuint)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc)
+            headless.dumpFrame( (GLuint)atoi(argv[++i]) );
+        else if (!tracePath && argv[i][0] != '-')
+            tracePath = argv[i];
+        else
+        {
+            tracePath = nullptr;
+            break;
+        }
+    }
+
+    if (!tracePath)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <trace> [--warmup <frames>] [--measure <frames>] [--json <path>] [--baseline <path>] [--tolerance <percent>]"
+                  << " [--dump-frame <frame>]..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if ( !headless.createContext() )
+        return EXIT_FAILURE;
+
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // A GLEW built for GLX has loaded the functions by the time it finds there is no GLX display, which is fine without a window
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewStatus = GLEW_OK;
+#endif
+
+    if (glewStatus != GLEW_OK)
+    {
+        std::cerr << "Failed to initialize GLEW!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int exitCode = EXIT_SUCCESS;
+
+    // Scoped, so the objects of the trace go before the context
+    {
+        GLReplay replay;
+        auto     loadStart = std::chrono::steady_clock::now();
+
+        if ( !replay.load(tracePath) || !headless.createFramebuffer( replay.getWidth(), replay.getHeight() ) )
+            return EXIT_FAILURE;
+
+        glFinish();
+        printf("Loaded %s: %u calls, %u objects, %zu bytes in %.3f ms\n",
+               tracePath, replay.getCallCount(), replay.getObjectCount(), replay.getTraceSize(),
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count());
+
+        Benchmark benchmark;
+        benchmark.start(warmupFrames, measuredFrames);
+
+        for (GLuint frame = 0; frame < warmupFrames + measuredFrames; ++frame)
+        {
+            GLStats::beginFrame();
+            benchmark.beginFrame();
+            replay.execute();
+            benchmark.endFrame();
+            headless.endFrame();
+        }
+
+        benchmark.finish();
+
+        if ( !benchmark.writeJson(jsonPath, tracePath) )
+        {
+            std::cerr << "Failed to write " << jsonPath << "!" << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+
+        // A regression, or a baseline that can't be read, fails the run
+        if ( baselinePath && benchmark.compareWithBaseline(baselinePath, tolerance) != 0 )
+            exitCode = EXIT_FAILURE;
+
+        replay.destroy();
+    }
+
+    headless.destroy();
+
+    return exitCode;
+}
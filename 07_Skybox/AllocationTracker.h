@@ -0,0 +1,127 @@
+#pragma once
+
+// Std. Includes
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// What a thread has allocated with operator new since it started
+struct AllocationCount
+{
+    unsigned long long allocations;
+    unsigned long long bytes;
+};
+
+// Counts the heap allocations of every thread, so the render loop can be checked for allocating once it is warm
+// (--alloc-check) and the CPU profiler scopes can carry the allocations made inside them. Counting needs the global
+// operator new/delete of this file, which are only there in builds with TRACK_ALLOCATIONS (the CMake option of the
+// same name); exactly one file defines ALLOCATION_TRACKER_IMPLEMENTATION before including this one to compile them.
+class AllocationTracker
+{
+public:
+    static bool IsAvailable( )
+    {
+#ifdef TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // The calling thread's count, two of them taken around some work give what the work allocated
+    static AllocationCount GetThreadCount( )
+    {
+        return threadCount( );
+    }
+
+    // Called by operator new, must not allocate
+    static void Count( std::size_t bytes )
+    {
+        AllocationCount &count = threadCount( );
+
+        count.allocations++;
+        count.bytes += bytes;
+    }
+
+    // What was allocated between two counts of the same thread
+    static AllocationCount Difference( const AllocationCount &before, const AllocationCount &after )
+    {
+        AllocationCount difference = { after.allocations - before.allocations, after.bytes - before.bytes };
+
+        return difference;
+    }
+
+private:
+    static AllocationCount &threadCount( )
+    {
+        // Constant initialized, so there is nothing to construct on a thread's first allocation
+        thread_local AllocationCount count = { 0, 0 };
+
+        return count;
+    }
+};
+
+#if defined( TRACK_ALLOCATIONS ) && defined( ALLOCATION_TRACKER_IMPLEMENTATION )
+
+void *operator new( std::size_t size )
+{
+    AllocationTracker::Count( size );
+
+    void *pointer = malloc( 0 == size ? 1 : size );
+
+    if ( NULL == pointer )
+    {
+        throw std::bad_alloc( );
+    }
+
+    return pointer;
+}
+
+void *operator new[]( std::size_t size )
+{
+    return operator new( size );
+}
+
+void *operator new( std::size_t size, const std::nothrow_t & ) noexcept
+{
+    AllocationTracker::Count( size );
+
+    return malloc( 0 == size ? 1 : size );
+}
+
+void *operator new[]( std::size_t size, const std::nothrow_t &nothrow ) noexcept
+{
+    return operator new( size, nothrow );
+}
+
+void operator delete( void *pointer ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete[]( void *pointer ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete( void *pointer, std::size_t ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete[]( void *pointer, std::size_t ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete( void *pointer, const std::nothrow_t & ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete[]( void *pointer, const std::nothrow_t & ) noexcept
+{
+    free( pointer );
+}
+
+#endif
@@ -0,0 +1,389 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+#include "GLStats.h"
+
+// Measures the frames of a run with --benchmark: some warmup frames which are not counted, then the measured ones.
+// The CPU time of a frame goes from BeginFrame to EndFrame, so waiting on the swap is not part of it, and the GPU
+// time comes from a GL_TIME_ELAPSED query around the same commands. The queries go round a ring and are read a few
+// frames later, once their result is there, so measuring does not stall the pipeline.
+//
+// The results are written as JSON, one metric per line, and the same file read back as a baseline tells whether a
+// later run got slower than the tolerance allows. Builds with GL_STATS add the GLStats counts of the frames, so a
+// baseline also catches a change that draws, binds or uploads more. A release build has no such counts, so it fails
+// against the baseline of a debug build rather than passing without them; compare builds of the same kind.
+class Benchmark
+{
+public:
+    Benchmark( ) : enabled( false ), warmupFrames( 0 ), measuredFrames( 0 ), frame( 0 ), nextQuery( 0 )
+    {
+        std::fill( this->queries, this->queries + QUERY_COUNT, 0 );
+        std::fill( this->queryFrames, this->queryFrames + QUERY_COUNT, NO_FRAME );
+    }
+
+    // Starts measuring, the GL context has to be current
+    void Start( GLuint warmupFrames, GLuint measuredFrames )
+    {
+        this->enabled = true;
+        this->warmupFrames = warmupFrames;
+        this->measuredFrames = measuredFrames;
+        this->frame = 0;
+
+        // No allocations while measuring
+        this->cpuTimes.reserve( measuredFrames );
+        this->gpuTimes.reserve( measuredFrames );
+        this->frameStats.reserve( measuredFrames );
+
+        glGenQueries( QUERY_COUNT, this->queries );
+    }
+
+    bool IsEnabled( ) const
+    {
+        return this->enabled;
+    }
+
+    // Warmup and measured frames together
+    GLuint GetTotalFrames( ) const
+    {
+        return this->warmupFrames + this->measuredFrames;
+    }
+
+    void BeginFrame( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        // The query about to be reused is the oldest, usually done for a while
+        this->collectQueries( false );
+
+        if ( NO_FRAME != this->queryFrames[this->nextQuery] )
+        {
+            this->readQuery( this->nextQuery );
+        }
+
+        this->frameStart = std::chrono::steady_clock::now( );
+
+        glBeginQuery( GL_TIME_ELAPSED, this->queries[this->nextQuery] );
+        this->queryFrames[this->nextQuery] = this->frame;
+    }
+
+    void EndFrame( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        glEndQuery( GL_TIME_ELAPSED );
+        this->nextQuery = ( this->nextQuery + 1 ) % QUERY_COUNT;
+
+        if ( this->isMeasured( this->frame ) )
+        {
+            this->cpuTimes.push_back( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - this->frameStart ).count( ) );
+            this->frameStats.push_back( GLStats::GetFrame( ) );
+        }
+
+        this->frame++;
+    }
+
+    // Reads the queries still in flight and sums up the run, call it once the last frame is done
+    void Finish( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        this->collectQueries( true );
+        glDeleteQueries( QUERY_COUNT, this->queries );
+
+        this->metrics.clear( );
+        this->addPercentiles( "cpu", this->cpuTimes );
+        this->addPercentiles( "gpu", this->gpuTimes );
+
+        if ( GLStats::IsAvailable( ) )
+        {
+            this->addStats( );
+        }
+    }
+
+    // Adds a result of some other measurement to the JSON, after Finish
+    void AddMetric( const std::string &name, double value, bool compared )
+    {
+        Metric metric = { name, value, compared };
+        this->metrics.push_back( metric );
+    }
+
+    // Writes the results of Finish to the file, or to the standard output without one
+    bool WriteJson( const char *path, const char *scene ) const
+    {
+        FILE *out = ( NULL != path ) ? fopen( path, "w" ) : stdout;
+
+        if ( NULL == out )
+        {
+            return false;
+        }
+
+        fprintf( out, "{\n    \"benchmark\": \"%s\",\n    \"warmup\": %u,\n    \"frames\": %u", scene, this->warmupFrames, ( GLuint )this->cpuTimes.size( ) );
+
+        for ( size_t i = 0; i < this->metrics.size( ); i++ )
+        {
+            fprintf( out, ",\n    \"%s\": %.4f", this->metrics[i].name.c_str( ), this->metrics[i].value );
+        }
+
+        fprintf( out, "\n}\n" );
+
+        if ( stdout != out )
+        {
+            fclose( out );
+        }
+
+        return true;
+    }
+
+    // Compares with the JSON of an earlier run, a metric regresses when it is over the baseline by more than
+    // the tolerance (in percent), or over a baseline of zero at all, and fails when this run lacks it. Returns
+    // the number of regressions and missing metrics, or -1 when the baseline can't be read
+    int CompareWithBaseline( const char *path, double tolerance ) const
+    {
+        FILE *in = fopen( path, "r" );
+
+        if ( NULL == in )
+        {
+            std::cout << "Failed to read the baseline " << path << std::endl;
+            return -1;
+        }
+
+        char line[256];
+        int regressions = 0;
+
+        while ( NULL != fgets( line, sizeof( line ), in ) )
+        {
+            char name[128];
+            double baseline = 0.0;
+
+            // Metrics are "name": number lines, the scene is a string and the frame counts are no metrics
+            if ( 2 != sscanf( line, " \"%127[^\"]\": %lf", name, &baseline ) || 0 == strcmp( name, "warmup" ) || 0 == strcmp( name, "frames" ) )
+            {
+                continue;
+            }
+
+            const Metric *metric = this->findMetric( name );
+
+            // Not comparing is no pass, e.g. a release build has no GL call counts to hold against a debug baseline
+            if ( NULL == metric )
+            {
+                printf( "MISSING %s: in the baseline, not measured by this run\n", name );
+                regressions++;
+                continue;
+            }
+
+            if ( !metric->compared )
+            {
+                continue;
+            }
+
+            // Nothing to take a percentage of, anything over a zero baseline is new work
+            if ( baseline <= 0.0 )
+            {
+                if ( metric->value > baseline )
+                {
+                    printf( "REGRESSION %s: %.4f vs %.4f baseline\n", name, metric->value, baseline );
+                    regressions++;
+                }
+
+                continue;
+            }
+
+            double change = ( metric->value - baseline ) / baseline * 100.0;
+
+            if ( change > tolerance )
+            {
+                printf( "REGRESSION %s: %.4f vs %.4f baseline (%+.1f%%)\n", name, metric->value, baseline, change );
+                regressions++;
+            }
+        }
+
+        fclose( in );
+
+        printf( "Baseline %s: %d regression(s) over %.1f%%\n", path, regressions, tolerance );
+
+        return regressions;
+    }
+
+private:
+    enum
+    {
+        // Frames a GPU time is read behind, the driver rarely queues more
+        QUERY_COUNT = 4,
+        NO_FRAME = 0xFFFFFFFF
+    };
+
+    struct Metric
+    {
+        std::string name;
+        double value;
+        // Whether a baseline comparison looks at it, the maxima are too noisy to
+        bool compared;
+    };
+
+    bool enabled;
+    GLuint warmupFrames, measuredFrames;
+    GLuint frame;
+
+    // Current frame
+    std::chrono::steady_clock::time_point frameStart;
+
+    // GPU time queries, and the frame each one was issued in
+    GLuint queries[QUERY_COUNT];
+    GLuint queryFrames[QUERY_COUNT];
+    GLuint nextQuery;
+
+    // One sample per measured frame, times in milliseconds
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<GLFrameStats> frameStats;
+
+    std::vector<Metric> metrics;
+
+    const Metric *findMetric( const char *name ) const
+    {
+        for ( size_t i = 0; i < this->metrics.size( ); i++ )
+        {
+            if ( this->metrics[i].name == name )
+            {
+                return &this->metrics[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    bool isMeasured( GLuint frame ) const
+    {
+        return frame >= this->warmupFrames;
+    }
+
+    // Reads the queries whose results are there, or all of them when waiting is fine
+    void collectQueries( bool wait )
+    {
+        for ( GLuint i = 0; i < QUERY_COUNT; i++ )
+        {
+            if ( NO_FRAME == this->queryFrames[i] )
+            {
+                continue;
+            }
+
+            GLint available = GL_FALSE;
+
+            if ( !wait )
+            {
+                glGetQueryObjectiv( this->queries[i], GL_QUERY_RESULT_AVAILABLE, &available );
+            }
+
+            if ( wait || available )
+            {
+                this->readQuery( i );
+            }
+        }
+    }
+
+    void readQuery( GLuint index )
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v( this->queries[index], GL_QUERY_RESULT, &elapsed );
+
+        if ( this->isMeasured( this->queryFrames[index] ) )
+        {
+            this->gpuTimes.push_back( elapsed / 1000000.0 );
+        }
+
+        this->queryFrames[index] = NO_FRAME;
+    }
+
+    // Nearest rank percentiles, only p50 and p95 are steady enough to compare against a baseline
+    void addPercentiles( const std::string &prefix, std::vector<double> times )
+    {
+        std::sort( times.begin( ), times.end( ) );
+
+        this->AddMetric( prefix + "_p50_ms", percentile( times, 50.0 ), true );
+        this->AddMetric( prefix + "_p95_ms", percentile( times, 95.0 ), true );
+        this->AddMetric( prefix + "_p99_ms", percentile( times, 99.0 ), false );
+        this->AddMetric( prefix + "_max_ms", times.empty( ) ? 0.0 : times.back( ), false );
+    }
+
+    // Means of the GL counts, uploads are uniforms, buffers and textures together
+    void addStats( )
+    {
+        std::vector<double> uploadBytes;
+
+        for ( size_t i = 0; i < this->frameStats.size( ); i++ )
+        {
+            const GLFrameStats &stats = this->frameStats[i];
+            uploadBytes.push_back( stats.uniformBytes + stats.bufferUploadBytes + stats.textureUploadBytes );
+        }
+
+        this->AddMetric( "draw_calls_per_frame", this->meanStat( &GLFrameStats::drawCalls ), true );
+        this->AddMetric( "triangles_per_frame", this->meanStat( &GLFrameStats::triangles ), true );
+        this->AddMetric( "program_binds_per_frame", this->meanStat( &GLFrameStats::programBinds ), true );
+        this->AddMetric( "vertex_array_binds_per_frame", this->meanStat( &GLFrameStats::vertexArrayBinds ), true );
+        this->AddMetric( "texture_binds_per_frame", this->meanStat( &GLFrameStats::textureBinds ), true );
+        this->AddMetric( "uniform_uploads_per_frame", this->meanStat( &GLFrameStats::uniformUploads ), true );
+        this->AddMetric( "buffer_upload_bytes_per_frame", this->meanStat( &GLFrameStats::bufferUploadBytes ), true );
+        this->AddMetric( "texture_upload_bytes_per_frame", this->meanStat( &GLFrameStats::textureUploadBytes ), true );
+        this->AddMetric( "upload_bytes_per_frame", mean( uploadBytes ), true );
+        this->AddMetric( "upload_bytes_max", uploadBytes.empty( ) ? 0.0 : *std::max_element( uploadBytes.begin( ), uploadBytes.end( ) ), false );
+    }
+
+    double meanStat( unsigned long long GLFrameStats::*stat ) const
+    {
+        double sum = 0.0;
+
+        for ( size_t i = 0; i < this->frameStats.size( ); i++ )
+        {
+            sum += this->frameStats[i].*stat;
+        }
+
+        return this->frameStats.empty( ) ? 0.0 : sum / this->frameStats.size( );
+    }
+
+    static double percentile( const std::vector<double> &sorted, double percent )
+    {
+        if ( sorted.empty( ) )
+        {
+            return 0.0;
+        }
+
+        size_t rank = ( size_t )ceil( percent / 100.0 * sorted.size( ) );
+
+        return sorted[std::max<size_t>( rank, 1 ) - 1];
+    }
+
+    template<typename T>
+    static double mean( const std::vector<T> &values )
+    {
+        double sum = 0.0;
+
+        for ( size_t i = 0; i < values.size( ); i++ )
+        {
+            sum += values[i];
+        }
+
+        return values.empty( ) ? 0.0 : sum / values.size( );
+    }
+};
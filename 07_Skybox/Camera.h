@@ -26,7 +26,21 @@ const GLfloat SPEED      =  6.0f;
 const GLfloat SENSITIVTY =  0.25f;
 const GLfloat ZOOM       =  45.0f;
 
+// Frustum planes, as returned by Camera::GetFrustumPlanes
+enum Frustum_Plane
+{
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
 // An abstract camera class that processes input and calculates the corresponding Eular Angles, Vectors and Matrices for use in OpenGL
+// Input only updates the angles and the position and marks what depends on them as dirty. The vectors, the matrices and the
+// frustum are rebuilt at most once, when something asks for them, so any number of cursor events in a frame cost one update.
 class Camera
 {
 public:
@@ -37,7 +51,7 @@ public:
         this->worldUp = up;
         this->yaw = yaw;
         this->pitch = pitch;
-        this->updateCameraVectors( );
+        this->init( );
     }
     
     // Constructor with scalar values
@@ -47,13 +61,74 @@ public:
         this->worldUp = glm::vec3( upX, upY, upZ );
         this->yaw = yaw;
         this->pitch = pitch;
-        this->updateCameraVectors( );
+        this->init( );
     }
     
     // Returns the view matrix calculated using Eular Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix( )
+    const glm::mat4 &GetViewMatrix( )
+    {
+        this->update( );
+        
+        return this->view;
+    }
+    
+    // Sets what the projection matrix is built from, the field of view is the zoom
+    void SetProjection( GLfloat aspect, GLfloat nearPlane, GLfloat farPlane )
+    {
+        if ( aspect != this->aspect || nearPlane != this->nearPlane || farPlane != this->farPlane )
+        {
+            this->aspect = aspect;
+            this->nearPlane = nearPlane;
+            this->farPlane = farPlane;
+            this->markDirty( PROJECTION_DIRTY );
+        }
+    }
+    
+    const glm::mat4 &GetProjectionMatrix( )
+    {
+        this->update( );
+        
+        return this->projection;
+    }
+    
+    // Projection * view
+    const glm::mat4 &GetViewProjectionMatrix( )
+    {
+        this->update( );
+        
+        return this->viewProjection;
+    }
+    
+    // The planes of the view frustum in world space, indexed by Frustum_Plane. Each one is (normal, distance),
+    // with the normal pointing inside and of unit length, so dot( normal, p ) + distance is the signed distance to it
+    const glm::vec4 *GetFrustumPlanes( )
+    {
+        this->update( );
+        
+        return this->frustumPlanes;
+    }
+    
+    // Whether a bounding sphere is at least partly inside the view frustum
+    bool IsSphereVisible( const glm::vec3 &center, GLfloat radius )
+    {
+        const glm::vec4 *planes = this->GetFrustumPlanes( );
+        
+        for ( int i = 0; i < FRUSTUM_PLANE_COUNT; i++ )
+        {
+            if ( glm::dot( glm::vec3( planes[i] ), center ) + planes[i].w < -radius )
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    // Changes whenever any of the matrices change, so a consumer can keep the one it last used and skip its own
+    // work (uniform uploads, culling) while the camera stands still
+    unsigned long GetVersion( ) const
     {
-        return glm::lookAt( this->position, this->position + this->front, this->up );
+        return this->version;
     }
     
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -61,6 +136,9 @@ public:
     {
         GLfloat velocity = this->movementSpeed * deltaTime;
         
+        // Moves along the vectors of the latest angles
+        this->updateCameraVectors( );
+        
         if ( direction == FORWARD )
         {
             this->position += this->front * velocity;
@@ -80,6 +158,8 @@ public:
         {
             this->position += this->right * velocity;
         }
+        
+        this->markDirty( VIEW_DIRTY );
     }
     
     // Processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -105,8 +185,8 @@ public:
             }
         }
         
-        // Update Front, Right and Up Vectors using the updated Eular angles
-        this->updateCameraVectors( );
+        // Front, Right and Up Vectors are updated from the Eular angles when they are next needed
+        this->markDirty( VECTORS_DIRTY | VIEW_DIRTY );
     }
     
     // Processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
@@ -127,9 +207,30 @@ public:
     
     glm::vec3 GetFront( )
     {
+        this->updateCameraVectors( );
+        
         return this->front;
     }
     
+    GLfloat GetYaw( )
+    {
+        return this->yaw;
+    }
+    
+    GLfloat GetPitch( )
+    {
+        return this->pitch;
+    }
+    
+    // Places the camera directly, as when it is played back along a recorded path
+    void SetPose( glm::vec3 position, GLfloat yaw, GLfloat pitch )
+    {
+        this->position = position;
+        this->yaw = yaw;
+        this->pitch = pitch;
+        this->markDirty( VECTORS_DIRTY | VIEW_DIRTY );
+    }
+    
 private:
     // Camera Attributes
     glm::vec3 position;
@@ -147,9 +248,101 @@ private:
     GLfloat mouseSensitivity;
     GLfloat zoom;
     
-    // Calculates the front vector from the Camera's (updated) Eular Angles
+    // Projection
+    GLfloat aspect;
+    GLfloat nearPlane;
+    GLfloat farPlane;
+    
+    // Cached results, valid unless their dirty bit is set
+    enum
+    {
+        VECTORS_DIRTY    = 1 << 0,
+        VIEW_DIRTY       = 1 << 1,
+        PROJECTION_DIRTY = 1 << 2
+    };
+    
+    unsigned int dirty;
+    unsigned long version;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 frustumPlanes[FRUSTUM_PLANE_COUNT];
+    
+    void init( )
+    {
+        this->aspect = 4.0f / 3.0f;
+        this->nearPlane = 0.1f;
+        this->farPlane = 100.0f;
+        this->dirty = 0;
+        this->version = 0;
+        this->markDirty( VECTORS_DIRTY | VIEW_DIRTY | PROJECTION_DIRTY );
+    }
+    
+    void markDirty( unsigned int flags )
+    {
+        this->dirty |= flags;
+        this->version++;
+    }
+    
+    // Brings whatever is dirty up to date
+    void update( )
+    {
+        if ( !this->dirty )
+        {
+            return;
+        }
+        
+        this->updateCameraVectors( );
+        
+        if ( this->dirty & VIEW_DIRTY )
+        {
+            this->view = glm::lookAt( this->position, this->position + this->front, this->up );
+        }
+        
+        if ( this->dirty & PROJECTION_DIRTY )
+        {
+            this->projection = glm::perspective( this->zoom, this->aspect, this->nearPlane, this->farPlane );
+        }
+        
+        this->viewProjection = this->projection * this->view;
+        this->updateFrustumPlanes( );
+        this->dirty = 0;
+    }
+    
+    // Gribb & Hartmann: the planes are sums and differences of the rows of the view-projection matrix
+    void updateFrustumPlanes( )
+    {
+        const glm::mat4 &m = this->viewProjection;
+        glm::vec4 rows[4];
+        
+        for ( int i = 0; i < 4; i++ )
+        {
+            rows[i] = glm::vec4( m[0][i], m[1][i], m[2][i], m[3][i] );
+        }
+        
+        this->frustumPlanes[FRUSTUM_LEFT]   = rows[3] + rows[0];
+        this->frustumPlanes[FRUSTUM_RIGHT]  = rows[3] - rows[0];
+        this->frustumPlanes[FRUSTUM_BOTTOM] = rows[3] + rows[1];
+        this->frustumPlanes[FRUSTUM_TOP]    = rows[3] - rows[1];
+        this->frustumPlanes[FRUSTUM_NEAR]   = rows[3] + rows[2];
+        this->frustumPlanes[FRUSTUM_FAR]    = rows[3] - rows[2];
+        
+        for ( int i = 0; i < FRUSTUM_PLANE_COUNT; i++ )
+        {
+            this->frustumPlanes[i] /= glm::length( glm::vec3( this->frustumPlanes[i] ) );
+        }
+    }
+    
+    // Calculates the front vector from the Camera's (updated) Eular Angles, if they changed since the last time
     void updateCameraVectors( )
     {
+        if ( !( this->dirty & VECTORS_DIRTY ) )
+        {
+            return;
+        }
+        
+        this->dirty &= ~VECTORS_DIRTY;
+        
         // Calculate the new Front vector
         glm::vec3 front;
         front.x = cos( glm::radians( this->yaw ) ) * cos( glm::radians( this->pitch ) );
@@ -0,0 +1,194 @@
+#pragma once
+
+// Std. Includes
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+// Records where the camera is every frame and plays it back, so every run (and every scene, the 06_Lighting
+// lesson reads the same files) can be benchmarked along the same flythrough.
+//
+// The file is a 12 byte header, "CPTH", the format version and the number of samples as 32 bit integers,
+// followed by the samples, six floats each: the time in seconds since the recording started, the position,
+// the yaw and the pitch. It is the camera state that gets recorded and not the input, so playing it back
+// does not depend on the frame rate of the machine it was recorded on.
+class CameraPath
+{
+public:
+    CameraPath( ) : file( NULL ), count( 0 ), startTime( 0.0f ), cursor( 0 )
+    {
+
+    }
+
+    ~CameraPath( )
+    {
+        this->EndRecording( );
+    }
+
+    // Starts writing a new path to the file, samples go straight to it as they are recorded
+    bool BeginRecording( const char *path )
+    {
+        this->EndRecording( );
+
+        this->file = fopen( path, "wb" );
+
+        if ( NULL == this->file )
+        {
+            return false;
+        }
+
+        this->count = 0;
+        this->writeHeader( );
+
+        return true;
+    }
+
+    // Appends the camera state at the given time, the first sample recorded is time zero
+    void Record( GLfloat time, Camera &camera )
+    {
+        if ( NULL == this->file )
+        {
+            return;
+        }
+
+        if ( 0 == this->count )
+        {
+            this->startTime = time;
+        }
+
+        glm::vec3 position = camera.GetPosition( );
+        GLfloat sample[SAMPLE_FLOATS] = { time - this->startTime, position.x, position.y, position.z, camera.GetYaw( ), camera.GetPitch( ) };
+
+        fwrite( sample, sizeof( sample ), 1, this->file );
+        this->count++;
+    }
+
+    // Finishes the file, the sample count in the header is only known now
+    void EndRecording( )
+    {
+        if ( NULL == this->file )
+        {
+            return;
+        }
+
+        fseek( this->file, 0, SEEK_SET );
+        this->writeHeader( );
+        fclose( this->file );
+        this->file = NULL;
+    }
+
+    bool IsRecording( ) const
+    {
+        return NULL != this->file;
+    }
+
+    // Reads a recorded path to play it back
+    bool Load( const char *path )
+    {
+        FILE *in = fopen( path, "rb" );
+
+        if ( NULL == in )
+        {
+            return false;
+        }
+
+        char magic[4];
+        unsigned int header[2];
+        bool loaded = false;
+
+        if ( 1 == fread( magic, sizeof( magic ), 1, in ) && 0 == memcmp( magic, MAGIC, sizeof( magic ) ) &&
+             1 == fread( header, sizeof( header ), 1, in ) && VERSION == header[0] && 0 != header[1] )
+        {
+            this->samples.resize( header[1] * SAMPLE_FLOATS );
+            loaded = ( header[1] == fread( &this->samples[0], SAMPLE_FLOATS * sizeof( GLfloat ), header[1], in ) );
+        }
+
+        fclose( in );
+
+        if ( !loaded )
+        {
+            this->samples.clear( );
+        }
+
+        this->cursor = 0;
+
+        return loaded;
+    }
+
+    // Puts the camera where the path is at the given time, interpolating between the recorded samples.
+    // Returns false once the time is past the end of the path
+    bool Apply( GLfloat time, Camera &camera )
+    {
+        size_t sampleCount = this->samples.size( ) / SAMPLE_FLOATS;
+
+        if ( 0 == sampleCount || time > this->GetDuration( ) )
+        {
+            return false;
+        }
+
+        // Playback only goes forward, so the segment is found from where the last one was
+        if ( time < this->sampleTime( this->cursor ) )
+        {
+            this->cursor = 0;
+        }
+
+        while ( this->cursor + 1 < sampleCount && this->sampleTime( this->cursor + 1 ) <= time )
+        {
+            this->cursor++;
+        }
+
+        const GLfloat *a = &this->samples[this->cursor * SAMPLE_FLOATS];
+        const GLfloat *b = ( this->cursor + 1 < sampleCount ) ? a + SAMPLE_FLOATS : a;
+        GLfloat t = ( b[0] > a[0] ) ? ( time - a[0] ) / ( b[0] - a[0] ) : 0.0f;
+
+        glm::vec3 position = glm::vec3( a[1], a[2], a[3] ) + ( glm::vec3( b[1], b[2], b[3] ) - glm::vec3( a[1], a[2], a[3] ) ) * t;
+
+        camera.SetPose( position, a[4] + ( b[4] - a[4] ) * t, a[5] + ( b[5] - a[5] ) * t );
+
+        return true;
+    }
+
+    // The time of the last sample
+    GLfloat GetDuration( ) const
+    {
+        return this->samples.empty( ) ? 0.0f : this->samples[this->samples.size( ) - SAMPLE_FLOATS];
+    }
+
+private:
+    static constexpr char MAGIC[5] = "CPTH";
+
+    enum
+    {
+        VERSION = 1,
+        SAMPLE_FLOATS = 6
+    };
+
+    // Recording
+    FILE *file;
+    unsigned int count;
+    GLfloat startTime;
+
+    // Playback
+    std::vector<GLfloat> samples;
+    size_t cursor;
+
+    GLfloat sampleTime( size_t index ) const
+    {
+        return this->samples[index * SAMPLE_FLOATS];
+    }
+
+    void writeHeader( )
+    {
+        unsigned int header[2] = { VERSION, this->count };
+
+        fwrite( MAGIC, 4, 1, this->file );
+        fwrite( header, sizeof( header ), 1, this->file );
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+// Std. Includes
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#include "AllocationTracker.h"
+
+// Marks the rest of the enclosing block as a scope of CPU work, named with a string literal. While the profiler is
+// disabled it costs a relaxed load and a branch.
+#define CPU_PROFILE_SCOPE( name ) CpuProfileScope CPU_PROFILE_JOIN( cpuProfileScope, __LINE__ )( name )
+#define CPU_PROFILE_JOIN( a, b ) CPU_PROFILE_JOIN_EXPANDED( a, b )
+#define CPU_PROFILE_JOIN_EXPANDED( a, b ) a##b
+
+// Records scopes of CPU work on every thread and writes them as a Chrome trace, which chrome://tracing and
+// ui.perfetto.dev open. Each thread writes to its own ring of events, so recording takes no lock and threads never
+// wait on each other; the rings are only read by WriteTrace. A ring keeps the last RING_SIZE scopes of its thread.
+// In builds with TRACK_ALLOCATIONS every scope also has the heap allocations made in it, as arguments of its event.
+class CpuProfiler
+{
+public:
+    enum
+    {
+        RING_SIZE = 1 << 16
+    };
+
+    // Starts recording, from any thread, the first scopes are usually the ones of loading so this goes early
+    static void Enable( )
+    {
+        epoch( );
+        enabled( ).store( true, std::memory_order_relaxed );
+    }
+
+    static void Disable( )
+    {
+        enabled( ).store( false, std::memory_order_relaxed );
+    }
+
+    static bool IsEnabled( )
+    {
+        return enabled( ).load( std::memory_order_relaxed );
+    }
+
+    // Names the calling thread in the trace, the name has to stay valid (a string literal)
+    static void SetThreadName( const char *name )
+    {
+        threadRing( )->name = name;
+    }
+
+    // Nanoseconds since Enable
+    static long long Now( )
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now( ) - epoch( ) ).count( );
+    }
+
+    // Adds a finished scope to the calling thread's ring, with what it allocated
+    static void Record( const char *name, long long begin, long long end, const AllocationCount &allocated )
+    {
+        Ring *ring = threadRing( );
+        unsigned long long next = ring->written.load( std::memory_order_relaxed );
+        Event &event = ring->events[next % RING_SIZE];
+
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        event.allocated = allocated;
+
+        // Publishes the event to WriteTrace
+        ring->written.store( next + 1, std::memory_order_release );
+    }
+
+    // Writes the scopes recorded so far as Chrome trace JSON, returns false if the file can't be written. Threads can
+    // go on recording meanwhile, events they overwrite during the copy are left out.
+    static bool WriteTrace( const char *path )
+    {
+        FILE *out = fopen( path, "w" );
+
+        if ( NULL == out )
+        {
+            return false;
+        }
+
+        fprintf( out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+
+        bool first = true;
+
+        for ( Ring *ring = rings( ).load( std::memory_order_acquire ); NULL != ring; ring = ring->next )
+        {
+            if ( NULL != ring->name )
+            {
+                fprintf( out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", ring->id, ring->name );
+                first = false;
+            }
+
+            unsigned long long written = ring->written.load( std::memory_order_acquire );
+            unsigned long long start = written > RING_SIZE ? written - RING_SIZE : 0;
+
+            for ( unsigned long long i = start; i < written; i++ )
+            {
+                Event event = ring->events[i % RING_SIZE];
+
+                // The thread has gone round the ring onto this event while it was read
+                std::atomic_thread_fence( std::memory_order_acquire );
+                if ( ring->written.load( std::memory_order_relaxed ) - i >= RING_SIZE )
+                {
+                    continue;
+                }
+
+                // Microseconds, with the nanoseconds kept as decimals
+                fprintf( out, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld", first ? "" : ",\n", event.name, ring->id,
+                         event.begin / 1000, event.begin % 1000, ( event.end - event.begin ) / 1000, ( event.end - event.begin ) % 1000 );
+
+                if ( AllocationTracker::IsAvailable( ) )
+                {
+                    fprintf( out, ",\"args\":{\"allocations\":%llu,\"allocated_bytes\":%llu}", event.allocated.allocations, event.allocated.bytes );
+                }
+
+                fprintf( out, "}" );
+                first = false;
+            }
+        }
+
+        fprintf( out, "\n]}\n" );
+
+        return 0 == fclose( out );
+    }
+
+private:
+    struct Event
+    {
+        const char *name;
+        long long begin, end;
+        AllocationCount allocated;
+    };
+
+    // A thread's events, only ever written by that thread. Rings stay until the program ends, so the events of a
+    // thread that is gone are still written out.
+    struct Ring
+    {
+        Event events[RING_SIZE];
+        std::atomic<unsigned long long> written;
+        unsigned int id;
+        const char *name;
+        Ring *next;
+    };
+
+    static std::atomic<bool> &enabled( )
+    {
+        static std::atomic<bool> enabled( false );
+
+        return enabled;
+    }
+
+    static std::chrono::steady_clock::time_point epoch( )
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now( );
+
+        return epoch;
+    }
+
+    // Every thread's ring, the newest first
+    static std::atomic<Ring *> &rings( )
+    {
+        static std::atomic<Ring *> rings( NULL );
+
+        return rings;
+    }
+
+    // The ring of the calling thread, made on its first scope and pushed onto the list without a lock
+    static Ring *threadRing( )
+    {
+        static std::atomic<unsigned int> threadCount( 0 );
+        thread_local Ring *ring = NULL;
+
+        if ( NULL == ring )
+        {
+            ring = new Ring( );
+            ring->written.store( 0, std::memory_order_relaxed );
+            ring->id = ++threadCount;
+            ring->name = NULL;
+            ring->next = rings( ).load( std::memory_order_relaxed );
+
+            while ( !rings( ).compare_exchange_weak( ring->next, ring, std::memory_order_release, std::memory_order_relaxed ) )
+            {
+            }
+        }
+
+        return ring;
+    }
+};
+
+// Times from its construction to the end of the enclosing block, see CPU_PROFILE_SCOPE
+class CpuProfileScope
+{
+public:
+    explicit CpuProfileScope( const char *name ) : name( NULL ), begin( 0 ), allocationsBefore( )
+    {
+        if ( CpuProfiler::IsEnabled( ) )
+        {
+            this->name = name;
+            this->begin = CpuProfiler::Now( );
+            this->allocationsBefore = AllocationTracker::GetThreadCount( );
+        }
+    }
+
+    ~CpuProfileScope( )
+    {
+        this->End( );
+    }
+
+    // Ends the scope before the end of the block
+    void End( )
+    {
+        if ( NULL != this->name )
+        {
+            CpuProfiler::Record( this->name, this->begin, CpuProfiler::Now( ), AllocationTracker::Difference( this->allocationsBefore, AllocationTracker::GetThreadCount( ) ) );
+            this->name = NULL;
+        }
+    }
+
+    CpuProfileScope( const CpuProfileScope & ) = delete;
+    CpuProfileScope &operator=( const CpuProfileScope & ) = delete;
+
+private:
+    const char *name;
+    long long begin;
+    AllocationCount allocationsBefore;
+};
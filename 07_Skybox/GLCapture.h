@@ -0,0 +1,1063 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+// Captures the GL calls of one frame into a trace, which GLReplay runs again without the lesson, its assets or a
+// window. The calls recorded are the ones the lessons make in a frame (below, with the wrappers); the objects they
+// use (buffers, textures, programs with their uniform values, vertex arrays) are read back from GL the first time
+// the frame uses them and written right before that use, as they are then. The state a frame relies on without
+// setting it (viewport, clear color, depth, blending and the bindings) is written first, the same way.
+//
+// A trace starts with MAGIC, VERSION and the width and height of the viewport, as 32 bit words. Records follow,
+// each a byte for its Record and its arguments as 32 bit words (floats as their bits), data as a word for the size
+// and then the bytes; END closes the trace.
+//
+// Builds without NDEBUG route the calls through the wrappers below, like GLStats which wraps these ones in turn;
+// release builds can't capture.
+#ifndef NDEBUG
+#define GL_CAPTURE
+#endif
+
+class GLCapture
+{
+public:
+    enum
+    {
+        MAGIC = 0x52544C47,	// "GLTR"
+        VERSION = 1
+    };
+
+    enum Record
+    {
+        END,
+
+        // Objects: the captured name, then the contents
+        BUFFER,
+        TEXTURE,
+        PROGRAM,
+        VERTEX_ARRAY,
+
+        // Calls, with the arguments they were made with
+        VIEWPORT,
+        CLEAR_COLOR,
+        CLEAR,
+        ENABLE,
+        DISABLE,
+        DEPTH_FUNC,
+        DEPTH_MASK,
+        BLEND_FUNC,
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        BIND_BUFFER,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        GET_UNIFORM_LOCATION,
+        UNIFORM_1I,
+        UNIFORM_1F,
+        UNIFORM_2F,
+        UNIFORM_3F,
+        UNIFORM_MATRIX_4FV,
+        BUFFER_DATA,
+        BUFFER_SUB_DATA,
+        TEX_IMAGE_2D,
+        TEX_PARAMETER_I,
+        GENERATE_MIPMAP,
+        DRAW_ARRAYS,
+        DRAW_ELEMENTS,
+
+        RECORD_COUNT
+    };
+
+    // What follows the byte of a record: its argument words and whether data comes after them. The objects (and END)
+    // have layouts of their own, GLReplay reads them separately
+    struct RecordLayout
+    {
+        Record record;
+        GLuint arguments;
+        bool data;
+    };
+
+    static constexpr RecordLayout RECORD_LAYOUTS[] =
+    {
+        { END, 0, false },
+        { BUFFER, 0, false },
+        { TEXTURE, 0, false },
+        { PROGRAM, 0, false },
+        { VERTEX_ARRAY, 0, false },
+        { VIEWPORT, 4, false },
+        { CLEAR_COLOR, 4, false },
+        { CLEAR, 1, false },
+        { ENABLE, 1, false },
+        { DISABLE, 1, false },
+        { DEPTH_FUNC, 1, false },
+        { DEPTH_MASK, 1, false },
+        { BLEND_FUNC, 2, false },
+        { USE_PROGRAM, 1, false },
+        { BIND_VERTEX_ARRAY, 1, false },
+        { BIND_BUFFER, 2, false },
+        { ACTIVE_TEXTURE, 1, false },
+        { BIND_TEXTURE, 2, false },
+        { GET_UNIFORM_LOCATION, 1, true },
+        { UNIFORM_1I, 2, false },
+        { UNIFORM_1F, 2, false },
+        { UNIFORM_2F, 3, false },
+        { UNIFORM_3F, 4, false },
+        { UNIFORM_MATRIX_4FV, 3, true },
+        { BUFFER_DATA, 3, true },
+        { BUFFER_SUB_DATA, 2, true },
+        { TEX_IMAGE_2D, 8, true },
+        { TEX_PARAMETER_I, 3, false },
+        { GENERATE_MIPMAP, 1, false },
+        { DRAW_ARRAYS, 3, false },
+        { DRAW_ELEMENTS, 4, false }
+    };
+
+    // Whether every Record has its layout at its own index
+    static constexpr bool RecordLayoutsMatch( )
+    {
+        for ( GLuint record = 0; record < RECORD_COUNT; record++ )
+        {
+            if ( RECORD_LAYOUTS[record].record != record )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Texture units whose bindings a trace starts with
+    enum
+    {
+        TEXTURE_UNITS = 16
+    };
+
+    static bool IsAvailable( )
+    {
+#ifdef GL_CAPTURE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Captures the given frame, counted from 0, into the file at path
+    static void CaptureFrame( const char *path, GLuint frame )
+    {
+        state( ).path = path;
+        state( ).captureFrame = frame;
+        state( ).pending = true;
+    }
+
+    // Whether the frame to capture is still to come
+    static bool IsPending( )
+    {
+        return state( ).pending;
+    }
+
+    // Whether the trace could not be written
+    static bool HasFailed( )
+    {
+        return state( ).failed;
+    }
+
+    // Starts a frame, recording it if it is the one to capture
+    static void BeginFrame( )
+    {
+        State &state = GLCapture::state( );
+
+        if ( !state.pending || state.frame++ != state.captureFrame )
+        {
+            return;
+        }
+
+        state.pending = false;
+        state.file = fopen( state.path, "wb" );
+
+        if ( NULL == state.file )
+        {
+            state.failed = true;
+            return;
+        }
+
+        GLint viewport[4];
+        glGetIntegerv( GL_VIEWPORT, viewport );
+
+        Write( MAGIC );
+        Write( VERSION );
+        Write( viewport[2] );
+        Write( viewport[3] );
+
+        recordState( viewport );
+    }
+
+    // Ends a frame, the captured one is written out
+    static void EndFrame( )
+    {
+        State &state = GLCapture::state( );
+
+        if ( NULL == state.file )
+        {
+            return;
+        }
+
+        WriteRecord( END );
+
+        // A texture it couldn't read back has already failed the capture
+        state.failed = ( 0 != ferror( state.file ) ) || state.failed;
+        state.failed = ( 0 != fclose( state.file ) ) || state.failed;
+        state.file = NULL;
+        state.buffers.clear( );
+        state.textures.clear( );
+        state.programs.clear( );
+        state.vertexArrays.clear( );
+    }
+
+    static bool IsCapturing( )
+    {
+        return NULL != state( ).file;
+    }
+
+    // Writes the record of a call, the arguments are 32 bit words
+    template <typename... Arguments>
+    static void WriteRecord( Record record, Arguments... arguments )
+    {
+        GLubyte byte = ( GLubyte )record;
+        fwrite( &byte, 1, 1, state( ).file );
+
+        ( Write( arguments ), ... );
+    }
+
+    static void Write( GLuint word )
+    {
+        fwrite( &word, sizeof( word ), 1, state( ).file );
+    }
+
+    static void Write( GLint word )
+    {
+        fwrite( &word, sizeof( word ), 1, state( ).file );
+    }
+
+    static void Write( GLfloat word )
+    {
+        fwrite( &word, sizeof( word ), 1, state( ).file );
+    }
+
+    static void WriteData( const void *data, GLuint size )
+    {
+        Write( size );
+
+        if ( 0 != size )
+        {
+            fwrite( data, 1, size, state( ).file );
+        }
+    }
+
+    // The objects a call uses are written before it, once
+    static void UseBuffer( GLuint buffer )
+    {
+        if ( 0 != buffer && state( ).buffers.insert( buffer ).second )
+        {
+            recordBuffer( buffer );
+        }
+    }
+
+    static void UseTexture( GLenum target, GLuint texture )
+    {
+        if ( 0 != texture && state( ).textures.insert( texture ).second )
+        {
+            recordTexture( target, texture );
+        }
+    }
+
+    static void UseProgram( GLuint program )
+    {
+        if ( 0 != program && state( ).programs.insert( program ).second )
+        {
+            recordProgram( program );
+        }
+    }
+
+    static void UseVertexArray( GLuint vertexArray )
+    {
+        if ( 0 != vertexArray && state( ).vertexArrays.insert( vertexArray ).second )
+        {
+            recordVertexArray( vertexArray );
+        }
+    }
+
+    // Writes the pixels of a texture upload, from client memory or from the bound pixel unpack buffer
+    static void WritePixels( GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels )
+    {
+        GLint alignment = 4, unpackBuffer = 0;
+        glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment );
+        glGetIntegerv( GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer );
+
+        GLuint rowSize = width * PixelSize( format, type );
+        GLuint size = height * ( ( rowSize + alignment - 1 ) / alignment * alignment );
+
+        Write( alignment );
+
+        if ( 0 != unpackBuffer )
+        {
+            std::vector<GLubyte> data( size );
+            glGetBufferSubData( GL_PIXEL_UNPACK_BUFFER, ( GLintptr )pixels, size, data.data( ) );
+            WriteData( data.data( ), size );
+        }
+        else
+        {
+            WriteData( pixels, NULL == pixels ? 0 : size );
+        }
+    }
+
+    // The values of a uniform type, GLReplay sets them back with the same sizes
+    static GLuint UniformComponents( GLenum type )
+    {
+        switch ( type )
+        {
+            case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+            case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+            case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 4;
+            case GL_FLOAT_MAT3: return 9;
+            case GL_FLOAT_MAT4: return 16;
+            default: return 1;
+        }
+    }
+
+    static bool UniformIsInteger( GLenum type )
+    {
+        switch ( type )
+        {
+            case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+            case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    // Bytes of a pixel in client memory
+    static GLuint PixelSize( GLenum format, GLenum type )
+    {
+        GLuint channels = 4;
+
+        switch ( format )
+        {
+            case GL_RED: case GL_DEPTH_COMPONENT: channels = 1; break;
+            case GL_RG: channels = 2; break;
+            case GL_RGB: case GL_BGR: channels = 3; break;
+        }
+
+        switch ( type )
+        {
+            case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: return channels * 4;
+            case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: return channels * 2;
+            case GL_UNSIGNED_INT_5_9_9_9_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV: return 4;
+            default: return channels;
+        }
+    }
+
+private:
+    struct State
+    {
+        const char *path;
+        GLuint frame, captureFrame;
+        bool pending, failed;
+        FILE *file;
+
+        // The objects written so far
+        std::set<GLuint> buffers, textures, programs, vertexArrays;
+    };
+
+    static State &state( )
+    {
+        static State state = State( );
+
+        return state;
+    }
+
+    // The state the frame starts with, as the calls that set it
+    static void recordState( const GLint viewport[4] )
+    {
+        GLfloat clearColor[4];
+        GLint depthFunc, depthMask, blendSource, blendDestination, program, vertexArray, arrayBuffer, activeTexture;
+
+        glGetFloatv( GL_COLOR_CLEAR_VALUE, clearColor );
+        glGetIntegerv( GL_DEPTH_FUNC, &depthFunc );
+        glGetIntegerv( GL_DEPTH_WRITEMASK, &depthMask );
+        glGetIntegerv( GL_BLEND_SRC_RGB, &blendSource );
+        glGetIntegerv( GL_BLEND_DST_RGB, &blendDestination );
+        glGetIntegerv( GL_CURRENT_PROGRAM, &program );
+        glGetIntegerv( GL_VERTEX_ARRAY_BINDING, &vertexArray );
+        glGetIntegerv( GL_ARRAY_BUFFER_BINDING, &arrayBuffer );
+        glGetIntegerv( GL_ACTIVE_TEXTURE, &activeTexture );
+
+        WriteRecord( VIEWPORT, viewport[0], viewport[1], viewport[2], viewport[3] );
+        WriteRecord( CLEAR_COLOR, clearColor[0], clearColor[1], clearColor[2], clearColor[3] );
+
+        const GLenum capabilities[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+
+        for ( GLenum capability : capabilities )
+        {
+            WriteRecord( glIsEnabled( capability ) ? ENABLE : DISABLE, capability );
+        }
+
+        WriteRecord( DEPTH_FUNC, depthFunc );
+        WriteRecord( DEPTH_MASK, depthMask );
+        WriteRecord( BLEND_FUNC, blendSource, blendDestination );
+
+        UseProgram( program );
+        WriteRecord( USE_PROGRAM, program );
+        UseVertexArray( vertexArray );
+        WriteRecord( BIND_VERTEX_ARRAY, vertexArray );
+        UseBuffer( arrayBuffer );
+        WriteRecord( BIND_BUFFER, ( GLuint )GL_ARRAY_BUFFER, arrayBuffer );
+
+        for ( GLuint unit = 0; unit < TEXTURE_UNITS; unit++ )
+        {
+            glActiveTexture( GL_TEXTURE0 + unit );
+
+            const GLenum targets[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP };
+            const GLenum bindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP };
+
+            for ( GLuint i = 0; i < 2; i++ )
+            {
+                GLint texture = 0;
+                glGetIntegerv( bindings[i], &texture );
+
+                if ( 0 != texture )
+                {
+                    UseTexture( targets[i], texture );
+                    WriteRecord( ACTIVE_TEXTURE, GL_TEXTURE0 + unit );
+                    WriteRecord( BIND_TEXTURE, targets[i], texture );
+                }
+            }
+        }
+
+        glActiveTexture( activeTexture );
+        WriteRecord( ACTIVE_TEXTURE, activeTexture );
+    }
+
+    // BUFFER: name, usage, contents
+    static void recordBuffer( GLuint buffer )
+    {
+        GLint previous = 0, size = 0, usage = 0;
+        glGetIntegerv( GL_COPY_READ_BUFFER_BINDING, &previous );
+        glBindBuffer( GL_COPY_READ_BUFFER, buffer );
+        glGetBufferParameteriv( GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size );
+        glGetBufferParameteriv( GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage );
+
+        std::vector<GLubyte> contents( size );
+
+        if ( 0 != size )
+        {
+            glGetBufferSubData( GL_COPY_READ_BUFFER, 0, size, contents.data( ) );
+        }
+
+        glBindBuffer( GL_COPY_READ_BUFFER, previous );
+
+        WriteRecord( BUFFER, buffer, usage );
+        WriteData( contents.data( ), size );
+    }
+
+    // TEXTURE: name, target, internal format, format and type of the pixels, level count, filters and wraps, then
+    // every level (every face of it for a cube map) as width, height and the pixels, rows tightly packed. A compressed
+    // texture has format 0 and its levels hold the compressed image; a format with no exact readback fails the capture
+    static void recordTexture( GLenum target, GLuint texture )
+    {
+        GLenum bindingName = ( GL_TEXTURE_CUBE_MAP == target ) ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D;
+        GLenum levelTarget = ( GL_TEXTURE_CUBE_MAP == target ) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        GLuint faces = ( GL_TEXTURE_CUBE_MAP == target ) ? 6 : 1;
+
+        GLint previous = 0, packAlignment = 4, packBuffer = 0;
+        glGetIntegerv( bindingName, &previous );
+        glGetIntegerv( GL_PACK_ALIGNMENT, &packAlignment );
+        glGetIntegerv( GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer );
+        glBindTexture( target, texture );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+        GLint internalFormat = GL_RGBA8, compressed = GL_FALSE, levels = 0, width = 0;
+        glGetTexLevelParameteriv( levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat );
+        glGetTexLevelParameteriv( levelTarget, 0, GL_TEXTURE_COMPRESSED, &compressed );
+
+        // The levels there are, up to the first without storage
+        while ( levels < 16 )
+        {
+            glGetTexLevelParameteriv( levelTarget, levels, GL_TEXTURE_WIDTH, &width );
+
+            if ( 0 == width )
+            {
+                break;
+            }
+
+            levels++;
+        }
+
+        // Read back in the layout of the internal format, so nothing is lost and nothing is made up
+        GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+
+        switch ( internalFormat )
+        {
+            case GL_RGBA: case GL_RGBA8: case GL_SRGB8_ALPHA8: break;
+            case GL_RED: case GL_R8: format = GL_RED; break;
+            case GL_RG: case GL_RG8: format = GL_RG; break;
+            case GL_RGB: case GL_RGB8: case GL_SRGB8: format = GL_RGB; break;
+            case GL_R16F: case GL_R32F: format = GL_RED; type = GL_FLOAT; break;
+            case GL_RG16F: case GL_RG32F: format = GL_RG; type = GL_FLOAT; break;
+            case GL_RGB16F: case GL_RGB32F: format = GL_RGB; type = GL_FLOAT; break;
+            case GL_RGBA16F: case GL_RGBA32F: type = GL_FLOAT; break;
+            case GL_RGB9_E5: format = GL_RGB; type = GL_UNSIGNED_INT_5_9_9_9_REV; break;
+            case GL_R11F_G11F_B10F: format = GL_RGB; type = GL_UNSIGNED_INT_10F_11F_11F_REV; break;
+            default: format = 0; type = 0; break;
+        }
+
+        if ( 0 == format && GL_TRUE != compressed )
+        {
+            std::cout << "Can't capture texture " << texture << ", internal format 0x" << std::hex << internalFormat << std::dec << " has no readback" << std::endl;
+            state( ).failed = true;
+
+            glBindBuffer( GL_PIXEL_PACK_BUFFER, packBuffer );
+            glPixelStorei( GL_PACK_ALIGNMENT, packAlignment );
+            glBindTexture( target, previous );
+            return;
+        }
+
+        const GLenum parameters[] = { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R };
+
+        WriteRecord( TEXTURE, texture, target, internalFormat, format, type, levels );
+
+        for ( GLenum parameter : parameters )
+        {
+            GLint value = 0;
+            glGetTexParameteriv( target, parameter, &value );
+            Write( value );
+        }
+
+        std::vector<GLubyte> pixels;
+
+        for ( GLint level = 0; level < levels; level++ )
+        {
+            for ( GLuint face = 0; face < faces; face++ )
+            {
+                GLint width = 0, height = 0;
+                glGetTexLevelParameteriv( levelTarget + face, level, GL_TEXTURE_WIDTH, &width );
+                glGetTexLevelParameteriv( levelTarget + face, level, GL_TEXTURE_HEIGHT, &height );
+
+                if ( 0 == format )
+                {
+                    // The blocks as they are, glCompressedTexImage2D takes them back
+                    GLint size = 0;
+                    glGetTexLevelParameteriv( levelTarget + face, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size );
+                    pixels.resize( size );
+                    glGetCompressedTexImage( levelTarget + face, level, pixels.data( ) );
+                }
+                else
+                {
+                    pixels.resize( width * height * PixelSize( format, type ) );
+                    glGetTexImage( levelTarget + face, level, format, type, pixels.data( ) );
+                }
+
+                Write( width );
+                Write( height );
+                WriteData( pixels.data( ), ( GLuint )pixels.size( ) );
+            }
+        }
+
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, packBuffer );
+        glPixelStorei( GL_PACK_ALIGNMENT, packAlignment );
+        glBindTexture( target, previous );
+    }
+
+    // PROGRAM: name, shader count, every shader as type and source, uniform count, every uniform (every element of
+    // an array) as name, location, type and value
+    static void recordProgram( GLuint program )
+    {
+        GLuint shaders[8];
+        GLsizei shaderCount = 0;
+        glGetAttachedShaders( program, 8, &shaderCount, shaders );
+
+        WriteRecord( PROGRAM, program, shaderCount );
+
+        std::vector<GLchar> source;
+
+        for ( GLsizei i = 0; i < shaderCount; i++ )
+        {
+            GLint type = 0, length = 0;
+            glGetShaderiv( shaders[i], GL_SHADER_TYPE, &type );
+            glGetShaderiv( shaders[i], GL_SHADER_SOURCE_LENGTH, &length );
+
+            source.resize( length + 1 );
+            glGetShaderSource( shaders[i], length + 1, &length, source.data( ) );
+
+            Write( type );
+            WriteData( source.data( ), length + 1 );
+        }
+
+        GLint uniformCount = 0, elementCount = 0;
+        glGetProgramiv( program, GL_ACTIVE_UNIFORMS, &uniformCount );
+
+        for ( GLint i = 0; i < uniformCount; i++ )
+        {
+            GLchar name[256];
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform( program, i, sizeof( name ), NULL, &size, &type, name );
+            elementCount += size;
+        }
+
+        Write( elementCount );
+
+        for ( GLint i = 0; i < uniformCount; i++ )
+        {
+            GLchar name[256];
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform( program, i, sizeof( name ) - 8, NULL, &size, &type, name );
+
+            // Arrays are named after their first element, the others are found by their index; a member of a
+            // struct array is a uniform of its own, with its whole name
+            GLchar *bracket = 1 < size ? strrchr( name, '[' ) : NULL;
+
+            for ( GLint element = 0; element < size; element++ )
+            {
+                if ( NULL != bracket )
+                {
+                    sprintf( bracket, "[%d]", element );
+                }
+
+                GLint location = glGetUniformLocation( program, name );
+                GLint values[16];
+                GLuint components = UniformComponents( type );
+
+                if ( UniformIsInteger( type ) )
+                {
+                    glGetUniformiv( program, location, values );
+                }
+                else
+                {
+                    glGetUniformfv( program, location, ( GLfloat * )values );
+                }
+
+                WriteData( name, ( GLuint )strlen( name ) + 1 );
+                Write( location );
+                Write( type );
+                WriteData( values, components * sizeof( GLint ) );
+            }
+        }
+    }
+
+    // VERTEX_ARRAY: name, element buffer, enabled attribute count, every one of them as index, size, type,
+    // normalized, integer, stride, offset, buffer and divisor
+    static void recordVertexArray( GLuint vertexArray )
+    {
+        struct Attribute
+        {
+            GLint index, size, type, normalized, integer, stride, buffer, divisor;
+            GLvoid *offset;
+        };
+
+        GLint previous = 0, elementBuffer = 0, attributeCount = 0;
+        glGetIntegerv( GL_VERTEX_ARRAY_BINDING, &previous );
+        glGetIntegerv( GL_MAX_VERTEX_ATTRIBS, &attributeCount );
+        glBindVertexArray( vertexArray );
+        glGetIntegerv( GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer );
+
+        std::vector<Attribute> attributes;
+
+        for ( GLint index = 0; index < std::min( attributeCount, 16 ); index++ )
+        {
+            GLint enabled = 0;
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled );
+
+            if ( !enabled )
+            {
+                continue;
+            }
+
+            Attribute attribute;
+            attribute.index = index;
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute.size );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_TYPE, &attribute.type );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute.normalized );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attribute.integer );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute.stride );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &attribute.buffer );
+            glGetVertexAttribiv( index, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &attribute.divisor );
+            glGetVertexAttribPointerv( index, GL_VERTEX_ATTRIB_ARRAY_POINTER, &attribute.offset );
+            attributes.push_back( attribute );
+        }
+
+        glBindVertexArray( previous );
+
+        // The buffers go first, so GLReplay has them when it makes the vertex array
+        UseBuffer( elementBuffer );
+
+        for ( const Attribute &attribute : attributes )
+        {
+            UseBuffer( attribute.buffer );
+        }
+
+        WriteRecord( VERTEX_ARRAY, vertexArray, elementBuffer, ( GLuint )attributes.size( ) );
+
+        for ( const Attribute &attribute : attributes )
+        {
+            Write( attribute.index );
+            Write( attribute.size );
+            Write( attribute.type );
+            Write( attribute.normalized );
+            Write( attribute.integer );
+            Write( attribute.stride );
+            Write( ( GLuint )( size_t )attribute.offset );
+            Write( attribute.buffer );
+            Write( attribute.divisor );
+        }
+    }
+
+};
+
+static_assert( sizeof( GLCapture::RECORD_LAYOUTS ) / sizeof( GLCapture::RECORD_LAYOUTS[0] ) == GLCapture::RECORD_COUNT, "Every GLCapture::Record needs a layout" );
+static_assert( GLCapture::RecordLayoutsMatch( ), "GLCapture::RECORD_LAYOUTS is out of the order of GLCapture::Record" );
+
+#ifdef GL_CAPTURE
+
+// The wrappers call GL by the names as GLEW defines them, before the macros below take the names over
+namespace GLCaptureWrappers
+{
+    inline void Viewport( GLint x, GLint y, GLsizei width, GLsizei height )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::VIEWPORT, x, y, width, height );
+        }
+
+        glViewport( x, y, width, height );
+    }
+
+    inline void ClearColor( GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::CLEAR_COLOR, red, green, blue, alpha );
+        }
+
+        glClearColor( red, green, blue, alpha );
+    }
+
+    inline void Clear( GLbitfield mask )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::CLEAR, mask );
+        }
+
+        glClear( mask );
+    }
+
+    inline void Enable( GLenum capability )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::ENABLE, capability );
+        }
+
+        glEnable( capability );
+    }
+
+    inline void Disable( GLenum capability )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::DISABLE, capability );
+        }
+
+        glDisable( capability );
+    }
+
+    inline void DepthFunc( GLenum func )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::DEPTH_FUNC, func );
+        }
+
+        glDepthFunc( func );
+    }
+
+    inline void DepthMask( GLboolean flag )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::DEPTH_MASK, ( GLuint )flag );
+        }
+
+        glDepthMask( flag );
+    }
+
+    inline void BlendFunc( GLenum source, GLenum destination )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::BLEND_FUNC, source, destination );
+        }
+
+        glBlendFunc( source, destination );
+    }
+
+    inline void UseProgram( GLuint program )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::UseProgram( program );
+            GLCapture::WriteRecord( GLCapture::USE_PROGRAM, program );
+        }
+
+        glUseProgram( program );
+    }
+
+    inline void BindVertexArray( GLuint array )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::UseVertexArray( array );
+            GLCapture::WriteRecord( GLCapture::BIND_VERTEX_ARRAY, array );
+        }
+
+        glBindVertexArray( array );
+    }
+
+    // The trace has the pixels of texture uploads themselves, so pixel unpack buffers are left out
+    inline void BindBuffer( GLenum target, GLuint buffer )
+    {
+        if ( GLCapture::IsCapturing( ) && GL_PIXEL_UNPACK_BUFFER != target )
+        {
+            GLCapture::UseBuffer( buffer );
+            GLCapture::WriteRecord( GLCapture::BIND_BUFFER, target, buffer );
+        }
+
+        glBindBuffer( target, buffer );
+    }
+
+    inline void ActiveTexture( GLenum texture )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::ACTIVE_TEXTURE, texture );
+        }
+
+        glActiveTexture( texture );
+    }
+
+    inline void BindTexture( GLenum target, GLuint texture )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::UseTexture( target, texture );
+            GLCapture::WriteRecord( GLCapture::BIND_TEXTURE, target, texture );
+        }
+
+        glBindTexture( target, texture );
+    }
+
+    // Looking a uniform up is work for the driver too, so it is replayed as well
+    inline GLint GetUniformLocation( GLuint program, const GLchar *name )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::UseProgram( program );
+            GLCapture::WriteRecord( GLCapture::GET_UNIFORM_LOCATION, program );
+            GLCapture::WriteData( name, ( GLuint )strlen( name ) + 1 );
+        }
+
+        return glGetUniformLocation( program, name );
+    }
+
+    inline void Uniform1i( GLint location, GLint v0 )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::UNIFORM_1I, location, v0 );
+        }
+
+        glUniform1i( location, v0 );
+    }
+
+    inline void Uniform1f( GLint location, GLfloat v0 )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::UNIFORM_1F, location, v0 );
+        }
+
+        glUniform1f( location, v0 );
+    }
+
+    inline void Uniform2f( GLint location, GLfloat v0, GLfloat v1 )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::UNIFORM_2F, location, v0, v1 );
+        }
+
+        glUniform2f( location, v0, v1 );
+    }
+
+    inline void Uniform3f( GLint location, GLfloat v0, GLfloat v1, GLfloat v2 )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::UNIFORM_3F, location, v0, v1, v2 );
+        }
+
+        glUniform3f( location, v0, v1, v2 );
+    }
+
+    inline void UniformMatrix4fv( GLint location, GLsizei count, GLboolean transpose, const GLfloat *value )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::UNIFORM_MATRIX_4FV, location, count, ( GLuint )transpose );
+            GLCapture::WriteData( value, count * 16 * sizeof( GLfloat ) );
+        }
+
+        glUniformMatrix4fv( location, count, transpose, value );
+    }
+
+    inline void BufferData( GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::BUFFER_DATA, target, ( GLuint )size, usage );
+            GLCapture::WriteData( data, NULL == data ? 0 : ( GLuint )size );
+        }
+
+        glBufferData( target, size, data, usage );
+    }
+
+    inline void BufferSubData( GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::BUFFER_SUB_DATA, target, ( GLuint )offset );
+            GLCapture::WriteData( data, ( GLuint )size );
+        }
+
+        glBufferSubData( target, offset, size, data );
+    }
+
+    inline void TexImage2D( GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::TEX_IMAGE_2D, target, level, internalFormat, width, height, format, type );
+            GLCapture::WritePixels( width, height, format, type, pixels );
+        }
+
+        glTexImage2D( target, level, internalFormat, width, height, border, format, type, pixels );
+    }
+
+    inline void TexParameteri( GLenum target, GLenum name, GLint parameter )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::TEX_PARAMETER_I, target, name, parameter );
+        }
+
+        glTexParameteri( target, name, parameter );
+    }
+
+    inline void GenerateMipmap( GLenum target )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::GENERATE_MIPMAP, target );
+        }
+
+        glGenerateMipmap( target );
+    }
+
+    inline void DrawArrays( GLenum mode, GLint first, GLsizei count )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::DRAW_ARRAYS, mode, first, count );
+        }
+
+        glDrawArrays( mode, first, count );
+    }
+
+    inline void DrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid *indices )
+    {
+        if ( GLCapture::IsCapturing( ) )
+        {
+            GLCapture::WriteRecord( GLCapture::DRAW_ELEMENTS, mode, count, type, ( GLuint )( size_t )indices );
+        }
+
+        glDrawElements( mode, count, type, indices );
+    }
+}
+
+#undef glViewport
+#undef glClearColor
+#undef glClear
+#undef glEnable
+#undef glDisable
+#undef glDepthFunc
+#undef glDepthMask
+#undef glBlendFunc
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindBuffer
+#undef glActiveTexture
+#undef glBindTexture
+#undef glGetUniformLocation
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glTexImage2D
+#undef glTexParameteri
+#undef glGenerateMipmap
+#undef glDrawArrays
+#undef glDrawElements
+
+#define glViewport GLCaptureWrappers::Viewport
+#define glClearColor GLCaptureWrappers::ClearColor
+#define glClear GLCaptureWrappers::Clear
+#define glEnable GLCaptureWrappers::Enable
+#define glDisable GLCaptureWrappers::Disable
+#define glDepthFunc GLCaptureWrappers::DepthFunc
+#define glDepthMask GLCaptureWrappers::DepthMask
+#define glBlendFunc GLCaptureWrappers::BlendFunc
+#define glUseProgram GLCaptureWrappers::UseProgram
+#define glBindVertexArray GLCaptureWrappers::BindVertexArray
+#define glBindBuffer GLCaptureWrappers::BindBuffer
+#define glActiveTexture GLCaptureWrappers::ActiveTexture
+#define glBindTexture GLCaptureWrappers::BindTexture
+#define glGetUniformLocation GLCaptureWrappers::GetUniformLocation
+#define glUniform1i GLCaptureWrappers::Uniform1i
+#define glUniform1f GLCaptureWrappers::Uniform1f
+#define glUniform2f GLCaptureWrappers::Uniform2f
+#define glUniform3f GLCaptureWrappers::Uniform3f
+#define glUniformMatrix4fv GLCaptureWrappers::UniformMatrix4fv
+#define glBufferData GLCaptureWrappers::BufferData
+#define glBufferSubData GLCaptureWrappers::BufferSubData
+#define glTexImage2D GLCaptureWrappers::TexImage2D
+#define glTexParameteri GLCaptureWrappers::TexParameteri
+#define glGenerateMipmap GLCaptureWrappers::GenerateMipmap
+#define glDrawArrays GLCaptureWrappers::DrawArrays
+#define glDrawElements GLCaptureWrappers::DrawElements
+
+#endif
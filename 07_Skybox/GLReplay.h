@@ -0,0 +1,554 @@
+#pragma once
+
+// Std. Includes
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+#include "GLCapture.h"
+
+// Runs a frame captured by GLCapture again. Load makes the objects of the trace and turns its calls into commands
+// with the names of the new objects, so Execute only makes the GL calls and can be timed on its own; the data the
+// calls upload stays in the trace read into memory.
+class GLReplay
+{
+public:
+    GLReplay( ) : position( 0 ), width( 0 ), height( 0 ), objectCount( 0 )
+    {
+    }
+
+    ~GLReplay( )
+    {
+        this->Destroy( );
+    }
+
+    GLReplay( const GLReplay & ) = delete;
+    GLReplay &operator=( const GLReplay & ) = delete;
+
+    // Reads the trace and makes its objects, the GL context has to be current; false if the trace can't be read
+    bool Load( const char *path )
+    {
+        FILE *in = fopen( path, "rb" );
+
+        if ( NULL == in )
+        {
+            std::cout << "Failed to open the trace " << path << std::endl;
+            return false;
+        }
+
+        fseek( in, 0, SEEK_END );
+        this->trace.resize( ftell( in ) );
+        fseek( in, 0, SEEK_SET );
+
+        bool read = ( fread( this->trace.data( ), 1, this->trace.size( ), in ) == this->trace.size( ) );
+        fclose( in );
+
+        GLuint magic = 0, version = 0;
+        this->position = 0;
+
+        if ( !read || !this->readWord( magic ) || !this->readWord( version ) || GLCapture::MAGIC != magic || GLCapture::VERSION != version )
+        {
+            std::cout << "Failed to read the trace " << path << ", it is not a GL trace of this version" << std::endl;
+            return false;
+        }
+
+        if ( !this->readWord( this->width ) || !this->readWord( this->height ) || !this->readRecords( ) )
+        {
+            std::cout << "Failed to read the trace " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Makes the calls of the frame
+    void Execute( )
+    {
+        for ( const Command &command : this->commands )
+        {
+            const GLuint *arguments = command.arguments;
+            const GLvoid *data = ( 0 == command.dataSize ) ? NULL : &this->trace[command.data];
+
+            switch ( command.record )
+            {
+                case GLCapture::VIEWPORT: glViewport( arguments[0], arguments[1], arguments[2], arguments[3] ); break;
+                case GLCapture::CLEAR_COLOR: glClearColor( asFloat( arguments[0] ), asFloat( arguments[1] ), asFloat( arguments[2] ), asFloat( arguments[3] ) ); break;
+                case GLCapture::CLEAR: glClear( arguments[0] ); break;
+                case GLCapture::ENABLE: glEnable( arguments[0] ); break;
+                case GLCapture::DISABLE: glDisable( arguments[0] ); break;
+                case GLCapture::DEPTH_FUNC: glDepthFunc( arguments[0] ); break;
+                case GLCapture::DEPTH_MASK: glDepthMask( ( GLboolean )arguments[0] ); break;
+                case GLCapture::BLEND_FUNC: glBlendFunc( arguments[0], arguments[1] ); break;
+                case GLCapture::USE_PROGRAM: glUseProgram( arguments[0] ); break;
+                case GLCapture::BIND_VERTEX_ARRAY: glBindVertexArray( arguments[0] ); break;
+                case GLCapture::BIND_BUFFER: glBindBuffer( arguments[0], arguments[1] ); break;
+                case GLCapture::ACTIVE_TEXTURE: glActiveTexture( arguments[0] ); break;
+                case GLCapture::BIND_TEXTURE: glBindTexture( arguments[0], arguments[1] ); break;
+                case GLCapture::GET_UNIFORM_LOCATION: glGetUniformLocation( arguments[0], ( const GLchar * )data ); break;
+                case GLCapture::UNIFORM_1I: glUniform1i( arguments[0], arguments[1] ); break;
+                case GLCapture::UNIFORM_1F: glUniform1f( arguments[0], asFloat( arguments[1] ) ); break;
+                case GLCapture::UNIFORM_2F: glUniform2f( arguments[0], asFloat( arguments[1] ), asFloat( arguments[2] ) ); break;
+                case GLCapture::UNIFORM_3F: glUniform3f( arguments[0], asFloat( arguments[1] ), asFloat( arguments[2] ), asFloat( arguments[3] ) ); break;
+                case GLCapture::UNIFORM_MATRIX_4FV: glUniformMatrix4fv( arguments[0], arguments[1], ( GLboolean )arguments[2], ( const GLfloat * )data ); break;
+                case GLCapture::BUFFER_DATA: glBufferData( arguments[0], arguments[1], data, arguments[2] ); break;
+                case GLCapture::BUFFER_SUB_DATA: glBufferSubData( arguments[0], arguments[1], command.dataSize, data ); break;
+                case GLCapture::TEX_PARAMETER_I: glTexParameteri( arguments[0], arguments[1], arguments[2] ); break;
+                case GLCapture::GENERATE_MIPMAP: glGenerateMipmap( arguments[0] ); break;
+                case GLCapture::DRAW_ARRAYS: glDrawArrays( arguments[0], arguments[1], arguments[2] ); break;
+                case GLCapture::DRAW_ELEMENTS: glDrawElements( arguments[0], arguments[1], arguments[2], ( const GLvoid * )( size_t )arguments[3] ); break;
+
+                case GLCapture::TEX_IMAGE_2D:
+                    glPixelStorei( GL_UNPACK_ALIGNMENT, arguments[7] );
+                    glTexImage2D( arguments[0], arguments[1], arguments[2], arguments[3], arguments[4], 0, arguments[5], arguments[6], data );
+                    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+                    break;
+            }
+        }
+    }
+
+    // Deletes the objects of the trace
+    void Destroy( )
+    {
+        for ( const auto &buffer : this->buffers )
+        {
+            glDeleteBuffers( 1, &buffer.second );
+        }
+
+        for ( const auto &texture : this->textures )
+        {
+            glDeleteTextures( 1, &texture.second );
+        }
+
+        for ( const auto &program : this->programs )
+        {
+            glDeleteProgram( program.second );
+        }
+
+        for ( const auto &vertexArray : this->vertexArrays )
+        {
+            glDeleteVertexArrays( 1, &vertexArray.second );
+        }
+
+        this->buffers.clear( );
+        this->textures.clear( );
+        this->programs.clear( );
+        this->vertexArrays.clear( );
+        this->uniformLocations.clear( );
+        this->commands.clear( );
+        this->objectCount = 0;
+    }
+
+    // The size of the viewport the frame was captured with
+    GLuint GetWidth( ) const
+    {
+        return this->width;
+    }
+
+    GLuint GetHeight( ) const
+    {
+        return this->height;
+    }
+
+    GLuint GetCallCount( ) const
+    {
+        return ( GLuint )this->commands.size( );
+    }
+
+    GLuint GetObjectCount( ) const
+    {
+        return this->objectCount;
+    }
+
+    size_t GetTraceSize( ) const
+    {
+        return this->trace.size( );
+    }
+
+private:
+    // A call with its arguments, its data is in the trace
+    struct Command
+    {
+        GLubyte record;
+        GLuint arguments[8];
+        size_t data;
+        GLuint dataSize;
+    };
+
+    std::vector<GLubyte> trace;
+    size_t position;
+
+    GLuint width, height;
+    GLuint objectCount;
+    std::vector<Command> commands;
+
+    // The objects made for the captured names
+    std::map<GLuint, GLuint> buffers, textures, programs, vertexArrays;
+
+    // For each captured program, the locations of its uniforms in the program made for it
+    std::map<GLuint, std::map<GLint, GLint>> uniformLocations;
+
+    static GLfloat asFloat( GLuint word )
+    {
+        GLfloat value;
+        memcpy( &value, &word, sizeof( value ) );
+
+        return value;
+    }
+
+    bool readWord( GLuint &word )
+    {
+        if ( this->position + sizeof( word ) > this->trace.size( ) )
+        {
+            return false;
+        }
+
+        memcpy( &word, &this->trace[this->position], sizeof( word ) );
+        this->position += sizeof( word );
+
+        return true;
+    }
+
+    bool readWord( GLint &word )
+    {
+        return this->readWord( ( GLuint & )word );
+    }
+
+    // Data is left in the trace, this gives where it is
+    bool readData( size_t &data, GLuint &size )
+    {
+        if ( !this->readWord( size ) || this->position + size > this->trace.size( ) )
+        {
+            return false;
+        }
+
+        data = this->position;
+        this->position += size;
+
+        return true;
+    }
+
+    static GLuint mapName( const std::map<GLuint, GLuint> &names, GLuint name )
+    {
+        std::map<GLuint, GLuint>::const_iterator found = names.find( name );
+
+        return ( names.end( ) == found ) ? 0 : found->second;
+    }
+
+    bool readRecords( )
+    {
+        // The program uniforms are set for, as the captured frame went
+        GLuint currentProgram = 0;
+
+        while ( this->position < this->trace.size( ) )
+        {
+            GLubyte record = this->trace[this->position++];
+
+            if ( record >= GLCapture::RECORD_COUNT )
+            {
+                return false;
+            }
+
+            switch ( record )
+            {
+                case GLCapture::END: return true;
+                case GLCapture::BUFFER: if ( !this->readBuffer( ) ) return false; continue;
+                case GLCapture::TEXTURE: if ( !this->readTexture( ) ) return false; continue;
+                case GLCapture::PROGRAM: if ( !this->readProgram( ) ) return false; continue;
+                case GLCapture::VERTEX_ARRAY: if ( !this->readVertexArray( ) ) return false; continue;
+            }
+
+            Command command = { record, { 0 }, 0, 0 };
+
+            for ( GLuint i = 0; i < GLCapture::RECORD_LAYOUTS[record].arguments; i++ )
+            {
+                if ( !this->readWord( command.arguments[i] ) )
+                {
+                    return false;
+                }
+            }
+
+            if ( GLCapture::RECORD_LAYOUTS[record].data && !this->readData( command.data, command.dataSize ) )
+            {
+                return false;
+            }
+
+            // The names and uniform locations of this run in place of the captured ones
+            GLuint *arguments = command.arguments;
+
+            switch ( record )
+            {
+                case GLCapture::USE_PROGRAM:
+                    currentProgram = arguments[0];
+                    arguments[0] = mapName( this->programs, arguments[0] );
+                    break;
+                case GLCapture::GET_UNIFORM_LOCATION: arguments[0] = mapName( this->programs, arguments[0] ); break;
+                case GLCapture::BIND_VERTEX_ARRAY: arguments[0] = mapName( this->vertexArrays, arguments[0] ); break;
+                case GLCapture::BIND_BUFFER: arguments[1] = mapName( this->buffers, arguments[1] ); break;
+                case GLCapture::BIND_TEXTURE: arguments[1] = mapName( this->textures, arguments[1] ); break;
+
+                case GLCapture::UNIFORM_1I: case GLCapture::UNIFORM_1F: case GLCapture::UNIFORM_2F:
+                case GLCapture::UNIFORM_3F: case GLCapture::UNIFORM_MATRIX_4FV:
+                {
+                    const std::map<GLint, GLint> &locations = this->uniformLocations[currentProgram];
+                    std::map<GLint, GLint>::const_iterator found = locations.find( ( GLint )arguments[0] );
+                    arguments[0] = ( GLuint )( ( locations.end( ) == found ) ? -1 : found->second );
+                    break;
+                }
+            }
+
+            this->commands.push_back( command );
+        }
+
+        // The trace ended without END
+        return false;
+    }
+
+    bool readBuffer( )
+    {
+        GLuint name, usage, size;
+        size_t data;
+
+        if ( !this->readWord( name ) || !this->readWord( usage ) || !this->readData( data, size ) )
+        {
+            return false;
+        }
+
+        GLuint buffer;
+        glGenBuffers( 1, &buffer );
+        glBindBuffer( GL_ARRAY_BUFFER, buffer );
+        glBufferData( GL_ARRAY_BUFFER, size, ( 0 == size ) ? NULL : &this->trace[data], usage );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+        this->buffers[name] = buffer;
+        this->objectCount++;
+
+        return true;
+    }
+
+    bool readTexture( )
+    {
+        GLuint name, target, internalFormat, format, type, levels;
+        GLint parameters[5];
+
+        if ( !this->readWord( name ) || !this->readWord( target ) || !this->readWord( internalFormat ) || !this->readWord( format ) || !this->readWord( type ) || !this->readWord( levels ) )
+        {
+            return false;
+        }
+
+        for ( GLint &parameter : parameters )
+        {
+            if ( !this->readWord( parameter ) )
+            {
+                return false;
+            }
+        }
+
+        GLuint texture;
+        glGenTextures( 1, &texture );
+        glBindTexture( target, texture );
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+        GLenum levelTarget = ( GL_TEXTURE_CUBE_MAP == target ) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        GLuint faces = ( GL_TEXTURE_CUBE_MAP == target ) ? 6 : 1;
+        bool read = true;
+
+        for ( GLuint level = 0; level < levels && read; level++ )
+        {
+            for ( GLuint face = 0; face < faces && read; face++ )
+            {
+                GLuint width, height, size;
+                size_t data;
+                read = this->readWord( width ) && this->readWord( height ) && this->readData( data, size );
+
+                if ( read && 0 == format )
+                {
+                    // A compressed texture, its levels are the blocks
+                    glCompressedTexImage2D( levelTarget + face, level, internalFormat, width, height, 0, size, &this->trace[data] );
+                }
+                else if ( read )
+                {
+                    glTexImage2D( levelTarget + face, level, internalFormat, width, height, 0, format, type, ( 0 == size ) ? NULL : &this->trace[data] );
+                }
+            }
+        }
+
+        const GLenum parameterNames[] = { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R };
+
+        for ( GLuint i = 0; i < 5; i++ )
+        {
+            glTexParameteri( target, parameterNames[i], parameters[i] );
+        }
+
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+        glBindTexture( target, 0 );
+
+        this->textures[name] = texture;
+        this->objectCount++;
+
+        return read;
+    }
+
+    bool readProgram( )
+    {
+        GLuint name, shaderCount;
+
+        if ( !this->readWord( name ) || !this->readWord( shaderCount ) )
+        {
+            return false;
+        }
+
+        GLuint program = glCreateProgram( );
+        this->programs[name] = program;
+        this->objectCount++;
+
+        for ( GLuint i = 0; i < shaderCount; i++ )
+        {
+            GLuint type, size;
+            size_t data;
+
+            if ( !this->readWord( type ) || !this->readData( data, size ) || 0 == size )
+            {
+                return false;
+            }
+
+            const GLchar *source = ( const GLchar * )&this->trace[data];
+            GLuint shader = glCreateShader( type );
+            glShaderSource( shader, 1, &source, NULL );
+            glCompileShader( shader );
+            glAttachShader( program, shader );
+            glDeleteShader( shader );
+        }
+
+        GLint success;
+        glLinkProgram( program );
+        glGetProgramiv( program, GL_LINK_STATUS, &success );
+
+        if ( !success )
+        {
+            GLchar infoLog[512];
+            glGetProgramInfoLog( program, 512, NULL, infoLog );
+            std::cout << "Failed to link program " << name << " of the trace\n" << infoLog << std::endl;
+            return false;
+        }
+
+        GLuint uniformCount;
+
+        if ( !this->readWord( uniformCount ) )
+        {
+            return false;
+        }
+
+        glUseProgram( program );
+
+        for ( GLuint i = 0; i < uniformCount; i++ )
+        {
+            GLint capturedLocation;
+            GLuint type, nameSize, valuesSize;
+            size_t uniformName, values;
+
+            if ( !this->readData( uniformName, nameSize ) || 0 == nameSize || !this->readWord( capturedLocation ) || !this->readWord( type ) || !this->readData( values, valuesSize ) )
+            {
+                return false;
+            }
+
+            GLint location = glGetUniformLocation( program, ( const GLchar * )&this->trace[uniformName] );
+            this->uniformLocations[name][capturedLocation] = location;
+
+            if ( valuesSize == GLCapture::UniformComponents( type ) * sizeof( GLint ) )
+            {
+                setUniform( location, type, &this->trace[values] );
+            }
+        }
+
+        glUseProgram( 0 );
+
+        return true;
+    }
+
+    // Sets a uniform of the current program to its captured value
+    static void setUniform( GLint location, GLenum type, const GLubyte *values )
+    {
+        if ( GLCapture::UniformIsInteger( type ) )
+        {
+            const GLint *integers = ( const GLint * )values;
+
+            switch ( GLCapture::UniformComponents( type ) )
+            {
+                case 1: glUniform1iv( location, 1, integers ); break;
+                case 2: glUniform2iv( location, 1, integers ); break;
+                case 3: glUniform3iv( location, 1, integers ); break;
+                case 4: glUniform4iv( location, 1, integers ); break;
+            }
+
+            return;
+        }
+
+        const GLfloat *floats = ( const GLfloat * )values;
+
+        switch ( type )
+        {
+            case GL_FLOAT: glUniform1fv( location, 1, floats ); break;
+            case GL_FLOAT_VEC2: glUniform2fv( location, 1, floats ); break;
+            case GL_FLOAT_VEC3: glUniform3fv( location, 1, floats ); break;
+            case GL_FLOAT_VEC4: glUniform4fv( location, 1, floats ); break;
+            case GL_FLOAT_MAT2: glUniformMatrix2fv( location, 1, GL_FALSE, floats ); break;
+            case GL_FLOAT_MAT3: glUniformMatrix3fv( location, 1, GL_FALSE, floats ); break;
+            case GL_FLOAT_MAT4: glUniformMatrix4fv( location, 1, GL_FALSE, floats ); break;
+        }
+    }
+
+    bool readVertexArray( )
+    {
+        GLuint name, elementBuffer, attributeCount;
+
+        if ( !this->readWord( name ) || !this->readWord( elementBuffer ) || !this->readWord( attributeCount ) )
+        {
+            return false;
+        }
+
+        GLuint vertexArray;
+        glGenVertexArrays( 1, &vertexArray );
+        glBindVertexArray( vertexArray );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mapName( this->buffers, elementBuffer ) );
+
+        this->vertexArrays[name] = vertexArray;
+        this->objectCount++;
+
+        for ( GLuint i = 0; i < attributeCount; i++ )
+        {
+            GLuint attribute[9];	// index, size, type, normalized, integer, stride, offset, buffer, divisor
+
+            for ( GLuint &word : attribute )
+            {
+                if ( !this->readWord( word ) )
+                {
+                    return false;
+                }
+            }
+
+            glBindBuffer( GL_ARRAY_BUFFER, mapName( this->buffers, attribute[7] ) );
+
+            if ( attribute[4] )
+            {
+                glVertexAttribIPointer( attribute[0], attribute[1], attribute[2], attribute[5], ( const GLvoid * )( size_t )attribute[6] );
+            }
+            else
+            {
+                glVertexAttribPointer( attribute[0], attribute[1], attribute[2], ( GLboolean )attribute[3], attribute[5], ( const GLvoid * )( size_t )attribute[6] );
+            }
+
+            glVertexAttribDivisor( attribute[0], attribute[8] );
+            glEnableVertexAttribArray( attribute[0] );
+        }
+
+        glBindVertexArray( 0 );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+        return true;
+    }
+};
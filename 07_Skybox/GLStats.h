@@ -0,0 +1,289 @@
+#pragma once
+
+// GL Includes
+#include <GL/glew.h>
+
+// Captured calls go through GLCapture's wrappers, which the ones below call
+#include "GLCapture.h"
+
+// What the GL calls of a frame did, counted by the wrappers of this file
+struct GLFrameStats
+{
+    unsigned long long drawCalls;
+    unsigned long long triangles;
+    unsigned long long programBinds;
+    unsigned long long vertexArrayBinds;
+    unsigned long long textureBinds;
+    unsigned long long uniformUploads;
+    unsigned long long uniformBytes;
+    unsigned long long bufferUploadBytes;
+    unsigned long long textureUploadBytes;
+};
+
+// Builds without NDEBUG route the GL calls that draw, bind or upload through the counting wrappers below, by defining
+// macros over their names; release builds (CMake's Release and RelWithDebInfo) call GL directly and every count stays
+// at zero. The counts only see the calls of files that include this header, GL calls made inside SOIL2 are not counted.
+#ifndef NDEBUG
+#define GL_STATS
+#endif
+
+class GLStats
+{
+public:
+    static bool IsAvailable( )
+    {
+#ifdef GL_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Starts counting a new frame, the one before stays readable with GetLastFrame
+    static void BeginFrame( )
+    {
+        last( ) = current( );
+        current( ) = GLFrameStats( );
+    }
+
+    // The counts of the current frame so far
+    static const GLFrameStats &GetFrame( )
+    {
+        return current( );
+    }
+
+    // The counts of the frame before, complete unlike the current one
+    static const GLFrameStats &GetLastFrame( )
+    {
+        return last( );
+    }
+
+    static void CountDraw( GLenum mode, GLsizei count, GLsizei instances )
+    {
+        GLFrameStats &stats = current( );
+
+        stats.drawCalls++;
+
+        if ( GL_TRIANGLES == mode )
+        {
+            stats.triangles += ( unsigned long long )( count / 3 ) * instances;
+        }
+        else if ( ( GL_TRIANGLE_STRIP == mode || GL_TRIANGLE_FAN == mode ) && count > 2 )
+        {
+            stats.triangles += ( unsigned long long )( count - 2 ) * instances;
+        }
+    }
+
+    static void CountProgramBind( )
+    {
+        current( ).programBinds++;
+    }
+
+    static void CountVertexArrayBind( )
+    {
+        current( ).vertexArrayBinds++;
+    }
+
+    static void CountTextureBind( )
+    {
+        current( ).textureBinds++;
+    }
+
+    static void CountUniform( GLsizeiptr bytes )
+    {
+        current( ).uniformUploads++;
+        current( ).uniformBytes += bytes;
+    }
+
+    static void CountBufferUpload( GLsizeiptr bytes )
+    {
+        current( ).bufferUploadBytes += bytes;
+    }
+
+    // Pixels come from client memory, or from a pixel unpack buffer when one is bound; NULL pixels and no buffer
+    // only allocate the storage
+    static void CountTextureUpload( GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels )
+    {
+        if ( NULL != pixels || unpackBufferBound( ) )
+        {
+            current( ).textureUploadBytes += ( unsigned long long )width * height * pixelSize( format, type );
+        }
+    }
+
+    static void SetUnpackBufferBound( bool bound )
+    {
+        unpackBufferBound( ) = bound;
+    }
+
+private:
+    static GLFrameStats &current( )
+    {
+        static GLFrameStats stats = GLFrameStats( );
+
+        return stats;
+    }
+
+    static GLFrameStats &last( )
+    {
+        static GLFrameStats stats = GLFrameStats( );
+
+        return stats;
+    }
+
+    static bool &unpackBufferBound( )
+    {
+        static bool bound = false;
+
+        return bound;
+    }
+
+    // Bytes of a pixel, rows are taken as tightly packed
+    static GLuint pixelSize( GLenum format, GLenum type )
+    {
+        GLuint channels = 4;
+
+        switch ( format )
+        {
+            case GL_RED: case GL_DEPTH_COMPONENT: channels = 1; break;
+            case GL_RG: channels = 2; break;
+            case GL_RGB: case GL_BGR: channels = 3; break;
+        }
+
+        switch ( type )
+        {
+            case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: return channels * 4;
+            case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: return channels * 2;
+            default: return channels;
+        }
+    }
+};
+
+#ifdef GL_STATS
+
+// The wrappers call GL by the names as GLEW (or GLCapture) defines them, before the macros below take the names over
+namespace GLStatsWrappers
+{
+    inline void DrawArrays( GLenum mode, GLint first, GLsizei count )
+    {
+        GLStats::CountDraw( mode, count, 1 );
+        glDrawArrays( mode, first, count );
+    }
+
+    inline void DrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid *indices )
+    {
+        GLStats::CountDraw( mode, count, 1 );
+        glDrawElements( mode, count, type, indices );
+    }
+
+    inline void UseProgram( GLuint program )
+    {
+        GLStats::CountProgramBind( );
+        glUseProgram( program );
+    }
+
+    inline void BindVertexArray( GLuint array )
+    {
+        GLStats::CountVertexArrayBind( );
+        glBindVertexArray( array );
+    }
+
+    inline void BindTexture( GLenum target, GLuint texture )
+    {
+        GLStats::CountTextureBind( );
+        glBindTexture( target, texture );
+    }
+
+    inline void BindBuffer( GLenum target, GLuint buffer )
+    {
+        if ( GL_PIXEL_UNPACK_BUFFER == target )
+        {
+            GLStats::SetUnpackBufferBound( 0 != buffer );
+        }
+
+        glBindBuffer( target, buffer );
+    }
+
+    inline void Uniform1i( GLint location, GLint v0 )
+    {
+        GLStats::CountUniform( sizeof( GLint ) );
+        glUniform1i( location, v0 );
+    }
+
+    inline void Uniform1f( GLint location, GLfloat v0 )
+    {
+        GLStats::CountUniform( sizeof( GLfloat ) );
+        glUniform1f( location, v0 );
+    }
+
+    inline void Uniform2f( GLint location, GLfloat v0, GLfloat v1 )
+    {
+        GLStats::CountUniform( 2 * sizeof( GLfloat ) );
+        glUniform2f( location, v0, v1 );
+    }
+
+    inline void Uniform3f( GLint location, GLfloat v0, GLfloat v1, GLfloat v2 )
+    {
+        GLStats::CountUniform( 3 * sizeof( GLfloat ) );
+        glUniform3f( location, v0, v1, v2 );
+    }
+
+    inline void UniformMatrix4fv( GLint location, GLsizei count, GLboolean transpose, const GLfloat *value )
+    {
+        GLStats::CountUniform( count * 16 * sizeof( GLfloat ) );
+        glUniformMatrix4fv( location, count, transpose, value );
+    }
+
+    inline void BufferData( GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage )
+    {
+        if ( NULL != data )
+        {
+            GLStats::CountBufferUpload( size );
+        }
+
+        glBufferData( target, size, data, usage );
+    }
+
+    inline void BufferSubData( GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data )
+    {
+        GLStats::CountBufferUpload( size );
+        glBufferSubData( target, offset, size, data );
+    }
+
+    inline void TexImage2D( GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels )
+    {
+        GLStats::CountTextureUpload( width, height, format, type, pixels );
+        glTexImage2D( target, level, internalFormat, width, height, border, format, type, pixels );
+    }
+}
+
+#undef glDrawArrays
+#undef glDrawElements
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBindTexture
+#undef glBindBuffer
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glTexImage2D
+
+#define glDrawArrays GLStatsWrappers::DrawArrays
+#define glDrawElements GLStatsWrappers::DrawElements
+#define glUseProgram GLStatsWrappers::UseProgram
+#define glBindVertexArray GLStatsWrappers::BindVertexArray
+#define glBindTexture GLStatsWrappers::BindTexture
+#define glBindBuffer GLStatsWrappers::BindBuffer
+#define glUniform1i GLStatsWrappers::Uniform1i
+#define glUniform1f GLStatsWrappers::Uniform1f
+#define glUniform2f GLStatsWrappers::Uniform2f
+#define glUniform3f GLStatsWrappers::Uniform3f
+#define glUniformMatrix4fv GLStatsWrappers::UniformMatrix4fv
+#define glBufferData GLStatsWrappers::BufferData
+#define glBufferSubData GLStatsWrappers::BufferSubData
+#define glTexImage2D GLStatsWrappers::TexImage2D
+
+#endif
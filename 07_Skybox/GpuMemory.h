@@ -0,0 +1,338 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+// What the textures, buffers and render targets hold in GPU memory, each with who made it. The sizes are read
+// back from GL when an object is registered, so they are what the driver reports for the storage, not what
+// the caller meant to upload. Drivers may still pad: RGB8 is often stored as RGBA8, and GL has no way of
+// telling. Registering is for load time, it queries GL and allocates
+class GpuMemory
+{
+public:
+    // Textures before buffers before render targets, the Release methods go by these ranges
+    enum Category
+    {
+        TEXTURES,
+        CUBEMAPS,
+        VERTEX_BUFFERS,
+        INDEX_BUFFERS,
+        OTHER_BUFFERS,
+        RENDER_TARGETS,
+        CATEGORY_COUNT
+    };
+
+    struct Allocation
+    {
+        Category category;
+        GLuint name;
+        unsigned long long bytes;
+        GLenum format;	// Internal format, or the usage of a buffer
+        GLint width, height, levels;
+        std::string owner;
+    };
+
+    // A 2D texture or a cubemap, once all its levels are there
+    static void RegisterTexture( GLenum target, GLuint texture, const std::string &owner )
+    {
+        bool cubeMap = GL_TEXTURE_CUBE_MAP == target;
+        GLenum levelTarget = cubeMap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        GLuint faces = cubeMap ? 6 : 1;
+
+        GLint previous = 0;
+        glGetIntegerv( cubeMap ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D, &previous );
+        glBindTexture( target, texture );
+
+        Allocation allocation = { cubeMap ? CUBEMAPS : TEXTURES, texture, 0, GL_NONE, 0, 0, 0, owner };
+        GLint format = GL_NONE;
+        glGetTexLevelParameteriv( levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &format );
+        glGetTexLevelParameteriv( levelTarget, 0, GL_TEXTURE_WIDTH, &allocation.width );
+        glGetTexLevelParameteriv( levelTarget, 0, GL_TEXTURE_HEIGHT, &allocation.height );
+        allocation.format = format;
+
+        // The levels there are, up to the first without storage
+        for ( GLint width = allocation.width; 0 != width && allocation.levels < 32; allocation.levels++ )
+        {
+            for ( GLuint face = 0; face < faces; face++ )
+            {
+                allocation.bytes += levelBytes( levelTarget + face, allocation.levels );
+            }
+
+            glGetTexLevelParameteriv( levelTarget, allocation.levels + 1, GL_TEXTURE_WIDTH, &width );
+        }
+
+        glBindTexture( target, previous );
+        add( allocation );
+    }
+
+    // A buffer after its glBufferData, the target it was made for gives the category
+    static void RegisterBuffer( GLenum target, GLuint buffer, const std::string &owner )
+    {
+        // Queried through the copy target, so no vertex array's element buffer changes on the way
+        GLint previous = 0, size = 0, usage = GL_NONE;
+        glGetIntegerv( GL_COPY_READ_BUFFER_BINDING, &previous );
+        glBindBuffer( GL_COPY_READ_BUFFER, buffer );
+        glGetBufferParameteriv( GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size );
+        glGetBufferParameteriv( GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage );
+        glBindBuffer( GL_COPY_READ_BUFFER, previous );
+
+        Category category = OTHER_BUFFERS;
+
+        if ( GL_ARRAY_BUFFER == target )
+        {
+            category = VERTEX_BUFFERS;
+        }
+        else if ( GL_ELEMENT_ARRAY_BUFFER == target )
+        {
+            category = INDEX_BUFFERS;
+        }
+
+        Allocation allocation = { category, buffer, ( unsigned long long )size, ( GLenum )usage, size, 1, 0, owner };
+        add( allocation );
+    }
+
+    // A renderbuffer after its glRenderbufferStorage
+    static void RegisterRenderbuffer( GLuint renderbuffer, const std::string &owner )
+    {
+        GLint previous = 0, format = GL_NONE, width = 0, height = 0, bits = 0;
+        glGetIntegerv( GL_RENDERBUFFER_BINDING, &previous );
+        glBindRenderbuffer( GL_RENDERBUFFER, renderbuffer );
+        glGetRenderbufferParameteriv( GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &format );
+        glGetRenderbufferParameteriv( GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width );
+        glGetRenderbufferParameteriv( GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height );
+
+        const GLenum sizes[] = { GL_RENDERBUFFER_RED_SIZE, GL_RENDERBUFFER_GREEN_SIZE, GL_RENDERBUFFER_BLUE_SIZE, GL_RENDERBUFFER_ALPHA_SIZE,
+                                 GL_RENDERBUFFER_DEPTH_SIZE, GL_RENDERBUFFER_STENCIL_SIZE };
+
+        for ( GLuint i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ )
+        {
+            GLint size = 0;
+            glGetRenderbufferParameteriv( GL_RENDERBUFFER, sizes[i], &size );
+            bits += size;
+        }
+
+        glBindRenderbuffer( GL_RENDERBUFFER, previous );
+
+        Allocation allocation = { RENDER_TARGETS, renderbuffer, ( unsigned long long )width * height * bits / 8, ( GLenum )format, width, height, 1, owner };
+        add( allocation );
+    }
+
+    // Before or after the glDelete* of the object
+    static void ReleaseTexture( GLuint texture )
+    {
+        release( texture, TEXTURES, CUBEMAPS );
+    }
+
+    static void ReleaseBuffer( GLuint buffer )
+    {
+        release( buffer, VERTEX_BUFFERS, OTHER_BUFFERS );
+    }
+
+    static void ReleaseRenderbuffer( GLuint renderbuffer )
+    {
+        release( renderbuffer, RENDER_TARGETS, RENDER_TARGETS );
+    }
+
+    static unsigned long long GetTotal( Category category )
+    {
+        unsigned long long total = 0;
+        const std::vector<Allocation> &allocations = GpuMemory::allocations( );
+
+        for ( size_t i = 0; i < allocations.size( ); i++ )
+        {
+            if ( category == allocations[i].category )
+            {
+                total += allocations[i].bytes;
+            }
+        }
+
+        return total;
+    }
+
+    static unsigned long long GetTotal( )
+    {
+        unsigned long long total = 0;
+
+        for ( GLuint i = 0; i < CATEGORY_COUNT; i++ )
+        {
+            total += GetTotal( ( Category )i );
+        }
+
+        return total;
+    }
+
+    static GLuint GetCount( )
+    {
+        return ( GLuint )allocations( ).size( );
+    }
+
+    // As the benchmark JSON names it, e.g. "vertex_buffers"
+    static const char *GetCategoryName( Category category )
+    {
+        static const char *names[CATEGORY_COUNT] = { "textures", "cubemaps", "vertex_buffers", "index_buffers", "other_buffers", "render_targets" };
+
+        return names[category];
+    }
+
+    // The totals by category and the largest allocations, count of them, to the standard output
+    static void PrintReport( GLuint count )
+    {
+        const double MB = 1024.0 * 1024.0;
+        std::vector<Allocation> largest = allocations( );
+
+        printf( "GPU memory: %.3f MB in %u allocations\n", GetTotal( ) / MB, GetCount( ) );
+
+        for ( GLuint i = 0; i < CATEGORY_COUNT; i++ )
+        {
+            printf( "  %-16s%10.3f MB\n", GetCategoryName( ( Category )i ), GetTotal( ( Category )i ) / MB );
+        }
+
+        count = std::min( count, ( GLuint )largest.size( ) );
+        std::partial_sort( largest.begin( ), largest.begin( ) + count, largest.end( ), compareBytes );
+
+        if ( 0 != count )
+        {
+            printf( "Largest %u:\n", count );
+        }
+
+        for ( GLuint i = 0; i < count; i++ )
+        {
+            const Allocation &allocation = largest[i];
+            char format[24], size[32];
+
+            if ( NULL != getFormatName( allocation.format ) )
+            {
+                snprintf( format, sizeof( format ), "%s", getFormatName( allocation.format ) );
+            }
+            else
+            {
+                snprintf( format, sizeof( format ), "0x%04X", allocation.format );
+            }
+
+            // Buffers have no dimensions or levels, their width is their size
+            if ( VERTEX_BUFFERS <= allocation.category && OTHER_BUFFERS >= allocation.category )
+            {
+                snprintf( size, sizeof( size ), "%d bytes", allocation.width );
+            }
+            else
+            {
+                snprintf( size, sizeof( size ), "%dx%d, %d level%s", allocation.width, allocation.height, allocation.levels, ( 1 == allocation.levels ) ? "" : "s" );
+            }
+
+            printf( "  %10.3f MB  %-16s%-18s%-20s%s\n", allocation.bytes / MB, GetCategoryName( allocation.category ), format, size, allocation.owner.c_str( ) );
+        }
+    }
+
+private:
+    static std::vector<Allocation> &allocations( )
+    {
+        static std::vector<Allocation> allocations;
+
+        return allocations;
+    }
+
+    // A name made again replaces what was there
+    static void add( const Allocation &allocation )
+    {
+        if ( TEXTURES <= allocation.category && CUBEMAPS >= allocation.category )
+        {
+            ReleaseTexture( allocation.name );
+        }
+        else if ( RENDER_TARGETS == allocation.category )
+        {
+            ReleaseRenderbuffer( allocation.name );
+        }
+        else
+        {
+            ReleaseBuffer( allocation.name );
+        }
+
+        allocations( ).push_back( allocation );
+    }
+
+    // Textures, buffers and renderbuffers each have their own names, first and last give the categories of one of them
+    static void release( GLuint name, Category first, Category last )
+    {
+        std::vector<Allocation> &allocations = GpuMemory::allocations( );
+
+        for ( size_t i = 0; i < allocations.size( ); i++ )
+        {
+            if ( name == allocations[i].name && first <= allocations[i].category && last >= allocations[i].category )
+            {
+                allocations.erase( allocations.begin( ) + i );
+                return;
+            }
+        }
+    }
+
+    // Compressed levels as the driver stores them, the others from the bits of their components (RGB9_E5's shared exponent too)
+    static unsigned long long levelBytes( GLenum target, GLint level )
+    {
+        GLint compressed = GL_FALSE, width = 0, height = 0;
+        glGetTexLevelParameteriv( target, level, GL_TEXTURE_COMPRESSED, &compressed );
+
+        if ( compressed )
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv( target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size );
+
+            return size;
+        }
+
+        const GLenum sizes[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                 GL_TEXTURE_SHARED_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE };
+        GLint bits = 0;
+
+        for ( GLuint i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ )
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv( target, level, sizes[i], &size );
+            bits += size;
+        }
+
+        glGetTexLevelParameteriv( target, level, GL_TEXTURE_WIDTH, &width );
+        glGetTexLevelParameteriv( target, level, GL_TEXTURE_HEIGHT, &height );
+
+        return ( unsigned long long )width * height * bits / 8;
+    }
+
+    static bool compareBytes( const Allocation &a, const Allocation &b )
+    {
+        return a.bytes > b.bytes;
+    }
+
+    // The formats and usages the lessons make, the others are printed as numbers
+    static const char *getFormatName( GLenum format )
+    {
+        switch ( format )
+        {
+            case GL_RED: return "RED";
+            case GL_R8: return "R8";
+            case GL_RGB: return "RGB";
+            case GL_RGB8: return "RGB8";
+            case GL_RGBA: return "RGBA";
+            case GL_RGBA8: return "RGBA8";
+            case GL_RGB16F: return "RGB16F";
+            case GL_RGBA16F: return "RGBA16F";
+            case GL_RGB9_E5: return "RGB9_E5";
+            case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+            case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: return "BC6H";
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "DXT1";
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return "DXT1A";
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: return "DXT3";
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "DXT5";
+            case GL_COMPRESSED_RED_RGTC1: return "BC4";
+            case GL_COMPRESSED_RG_RGTC2: return "BC5";
+            case GL_STATIC_DRAW: return "STATIC_DRAW";
+            case GL_DYNAMIC_DRAW: return "DYNAMIC_DRAW";
+            case GL_STREAM_DRAW: return "STREAM_DRAW";
+            default: return NULL;
+        }
+    }
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+// Std. Includes
+#include <cstring>
+
+// GL Includes
+#include <GL/glew.h>
+
+// Times named passes of the frame on the GPU. Every scope is a pair of GL_TIMESTAMP queries, unlike GL_TIME_ELAPSED
+// they nest, and they don't get in the way of the benchmark's own GL_TIME_ELAPSED query around the whole frame.
+//
+// The queries of a frame are read FRAME_LATENCY frames later, once the GPU is done with them; a frame whose results
+// are still not there by the time its queries come round again is dropped rather than waited for, so the profiler
+// never stalls the pipeline. Each scope keeps a rolling average over the last frames for the overlay, and the
+// average over the frames measured by a benchmark.
+class GpuProfiler
+{
+public:
+    enum
+    {
+        MAX_SCOPES = 16,
+        // Frames of the rolling average
+        AVERAGE_FRAMES = 60
+    };
+
+    GpuProfiler( ) : enabled( false ), frame( 0 ), firstMeasuredFrame( 0 ), scopeCount( 0 ), openCount( 0 )
+    {
+        memset( this->slots, 0, sizeof( this->slots ) );
+        memset( this->scopes, 0, sizeof( this->scopes ) );
+    }
+
+    // Creates the queries, the GL context has to be current
+    void Init( )
+    {
+        for ( GLuint i = 0; i < FRAME_LATENCY; i++ )
+        {
+            glGenQueries( MAX_SCOPES * 2, this->slots[i].queries );
+        }
+
+        this->enabled = true;
+    }
+
+    void Destroy( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        for ( GLuint i = 0; i < FRAME_LATENCY; i++ )
+        {
+            glDeleteQueries( MAX_SCOPES * 2, this->slots[i].queries );
+        }
+
+        this->enabled = false;
+    }
+
+    // Frames from this one on count towards GetMeasuredAverage, as the ones after the warmup of a benchmark
+    void SetFirstMeasuredFrame( GLuint frame )
+    {
+        this->firstMeasuredFrame = frame;
+    }
+
+    void BeginFrame( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        // Whatever finished since the last frame
+        for ( GLuint i = 0; i < FRAME_LATENCY; i++ )
+        {
+            this->collect( this->slots[i], false );
+        }
+
+        FrameSlot &slot = this->slots[this->frame % FRAME_LATENCY];
+
+        // Still not done, dropped
+        slot.pending = false;
+        slot.frame = this->frame;
+        slot.entryCount = 0;
+        this->openCount = 0;
+
+        this->BeginScope( "Frame" );
+    }
+
+    void EndFrame( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        this->EndScope( );
+
+        FrameSlot &slot = this->slots[this->frame % FRAME_LATENCY];
+        slot.pending = ( slot.entryCount > 0 );
+
+        this->frame++;
+    }
+
+    // Starts timing a pass, the name has to stay valid (a string literal). Scopes nest, each EndScope closes
+    // the last one opened. Past MAX_SCOPES names, or entries in a frame, the scope is not timed
+    void BeginScope( const char *name )
+    {
+        if ( !this->enabled || MAX_SCOPES == this->openCount )
+        {
+            return;
+        }
+
+        FrameSlot &slot = this->slots[this->frame % FRAME_LATENCY];
+        GLuint scope = this->findScope( name, this->openCount );
+        GLuint entry = NO_ENTRY;
+
+        if ( NO_ENTRY != scope && slot.entryCount < MAX_SCOPES )
+        {
+            entry = slot.entryCount++;
+            slot.scopes[entry] = scope;
+            glQueryCounter( slot.queries[entry * 2], GL_TIMESTAMP );
+        }
+
+        this->open[this->openCount++] = entry;
+    }
+
+    void EndScope( )
+    {
+        if ( !this->enabled || 0 == this->openCount )
+        {
+            return;
+        }
+
+        FrameSlot &slot = this->slots[this->frame % FRAME_LATENCY];
+        GLuint entry = this->open[--this->openCount];
+
+        if ( NO_ENTRY != entry )
+        {
+            glQueryCounter( slot.queries[entry * 2 + 1], GL_TIMESTAMP );
+        }
+    }
+
+    // Waits for the frames still in flight, so the measured averages take in the last frames too
+    void Flush( )
+    {
+        if ( !this->enabled )
+        {
+            return;
+        }
+
+        for ( GLuint i = 0; i < FRAME_LATENCY; i++ )
+        {
+            this->collect( this->slots[i], true );
+        }
+    }
+
+    bool IsEnabled( ) const
+    {
+        return this->enabled;
+    }
+
+    // Scopes seen so far, in the order they were first opened. The first one is the whole frame
+    GLuint GetScopeCount( ) const
+    {
+        return this->scopeCount;
+    }
+
+    const char *GetScopeName( GLuint scope ) const
+    {
+        return this->scopes[scope].name;
+    }
+
+    // How deep the scope is nested, 0 for the frame
+    GLuint GetScopeDepth( GLuint scope ) const
+    {
+        return this->scopes[scope].depth;
+    }
+
+    // Milliseconds, over the last AVERAGE_FRAMES frames
+    double GetRollingAverage( GLuint scope ) const
+    {
+        const Scope &s = this->scopes[scope];
+
+        return ( 0 == s.sampleCount ) ? 0.0 : s.windowSum / s.sampleCount;
+    }
+
+    // Milliseconds, over the frames from SetFirstMeasuredFrame on
+    double GetMeasuredAverage( GLuint scope ) const
+    {
+        const Scope &s = this->scopes[scope];
+
+        return ( 0 == s.measuredCount ) ? 0.0 : s.measuredSum / s.measuredCount;
+    }
+
+private:
+    enum
+    {
+        FRAME_LATENCY = 4,
+        NO_ENTRY = 0xFFFFFFFF
+    };
+
+    struct Scope
+    {
+        const char *name;
+        GLuint depth;
+
+        // Rolling average, the last samples and their sum
+        double window[AVERAGE_FRAMES];
+        double windowSum;
+        GLuint sampleCount;
+        GLuint nextSample;
+
+        double measuredSum;
+        GLuint measuredCount;
+    };
+
+    // The queries of one frame in flight, a begin and an end timestamp for each scope entered
+    struct FrameSlot
+    {
+        GLuint queries[MAX_SCOPES * 2];
+        GLuint scopes[MAX_SCOPES];
+        GLuint entryCount;
+        GLuint frame;
+        bool pending;
+    };
+
+    bool enabled;
+    GLuint frame;
+    GLuint firstMeasuredFrame;
+
+    Scope scopes[MAX_SCOPES];
+    GLuint scopeCount;
+
+    FrameSlot slots[FRAME_LATENCY];
+
+    // Entries of the current frame still open
+    GLuint open[MAX_SCOPES];
+    GLuint openCount;
+
+    GLuint findScope( const char *name, GLuint depth )
+    {
+        for ( GLuint i = 0; i < this->scopeCount; i++ )
+        {
+            if ( 0 == strcmp( this->scopes[i].name, name ) )
+            {
+                return i;
+            }
+        }
+
+        if ( MAX_SCOPES == this->scopeCount )
+        {
+            return NO_ENTRY;
+        }
+
+        Scope &scope = this->scopes[this->scopeCount];
+        scope.name = name;
+        scope.depth = depth;
+
+        return this->scopeCount++;
+    }
+
+    // Reads the frame's results if the GPU is done with them, the end of the frame scope was the last query issued
+    void collect( FrameSlot &slot, bool wait )
+    {
+        if ( !slot.pending )
+        {
+            return;
+        }
+
+        GLint available = GL_FALSE;
+
+        if ( !wait )
+        {
+            glGetQueryObjectiv( slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available );
+        }
+
+        if ( !wait && !available )
+        {
+            return;
+        }
+
+        for ( GLuint i = 0; i < slot.entryCount; i++ )
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v( slot.queries[i * 2], GL_QUERY_RESULT, &begin );
+            glGetQueryObjectui64v( slot.queries[i * 2 + 1], GL_QUERY_RESULT, &end );
+
+            this->addSample( this->scopes[slot.scopes[i]], ( end - begin ) / 1000000.0, slot.frame >= this->firstMeasuredFrame );
+        }
+
+        slot.pending = false;
+    }
+
+    void addSample( Scope &scope, double milliseconds, bool measured )
+    {
+        if ( AVERAGE_FRAMES == scope.sampleCount )
+        {
+            scope.windowSum -= scope.window[scope.nextSample];
+        }
+        else
+        {
+            scope.sampleCount++;
+        }
+
+        scope.window[scope.nextSample] = milliseconds;
+        scope.windowSum += milliseconds;
+        scope.nextSample = ( scope.nextSample + 1 ) % AVERAGE_FRAMES;
+
+        if ( measured )
+        {
+            scope.measuredSum += milliseconds;
+            scope.measuredCount++;
+        }
+    }
+};
@@ -0,0 +1,219 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <SOIL2/SOIL2.h>
+
+#include "GpuMemory.h"
+
+// Renders without a window, for benchmarks and for machines without a display (CI). The context comes from
+// EGL without any surface (Mesa gives one with llvmpipe when there is no GPU, GALLIUM_DRIVER picks another
+// driver) and the scene draws into a framebuffer object, which stays bound so the lesson code does not change.
+// Only available where the build found EGL (HEADLESS_EGL), CreateContext fails anywhere else.
+class Headless
+{
+public:
+    Headless( ) : width( 0 ), height( 0 ), frame( 0 ), framebuffer( 0 ), colorBuffer( 0 ), depthBuffer( 0 ), capture( NULL )
+    {
+#ifdef HEADLESS_EGL
+        this->display = EGL_NO_DISPLAY;
+        this->context = EGL_NO_CONTEXT;
+#endif
+        this->startTime = std::chrono::steady_clock::now( );
+    }
+
+    ~Headless( )
+    {
+        this->Destroy( );
+    }
+
+    // Creates an OpenGL 3.3 core context and makes it current, GLEW has to be initialized before CreateFramebuffer
+    bool CreateContext( )
+    {
+#ifdef HEADLESS_EGL
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = ( PFNEGLGETPLATFORMDISPLAYEXTPROC )eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+
+        if ( NULL != getPlatformDisplay )
+        {
+            this->display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+        }
+
+        // Without the Mesa platform the default display may still do, e.g. with EGL_PLATFORM=surfaceless
+        if ( EGL_NO_DISPLAY == this->display )
+        {
+            this->display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+        }
+
+        if ( EGL_NO_DISPLAY == this->display || !eglInitialize( this->display, NULL, NULL ) )
+        {
+            std::cout << "Failed to initialize EGL" << std::endl;
+            return false;
+        }
+
+        EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLint contextAttributes[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+
+        if ( !eglBindAPI( EGL_OPENGL_API ) || !eglChooseConfig( this->display, configAttributes, &config, 1, &configCount ) || 0 == configCount )
+        {
+            std::cout << "Failed to find an EGL config for OpenGL" << std::endl;
+            return false;
+        }
+
+        this->context = eglCreateContext( this->display, config, EGL_NO_CONTEXT, contextAttributes );
+
+        // Without a surface, this needs EGL_KHR_surfaceless_context
+        if ( EGL_NO_CONTEXT == this->context || !eglMakeCurrent( this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context ) )
+        {
+            std::cout << "Failed to create an OpenGL 3.3 context with EGL" << std::endl;
+            return false;
+        }
+
+        return true;
+#else
+        std::cout << "Headless rendering needs EGL, which this build was made without" << std::endl;
+        return false;
+#endif
+    }
+
+    // Creates the framebuffer to render into and leaves it bound
+    bool CreateFramebuffer( GLuint width, GLuint height )
+    {
+        this->width = width;
+        this->height = height;
+
+        // The framebuffer stands in for the window's, with color and depth-stencil like GLFW gives by default
+        glGenRenderbuffers( 1, &this->colorBuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, this->colorBuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+        glGenRenderbuffers( 1, &this->depthBuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, this->depthBuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height );
+        glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+        GpuMemory::RegisterRenderbuffer( this->colorBuffer, "headless framebuffer" );
+        GpuMemory::RegisterRenderbuffer( this->depthBuffer, "headless framebuffer" );
+
+        glGenFramebuffers( 1, &this->framebuffer );
+        glBindFramebuffer( GL_FRAMEBUFFER, this->framebuffer );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorBuffer );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->depthBuffer );
+
+        if ( GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus( GL_FRAMEBUFFER ) )
+        {
+            std::cout << "Failed to create the headless framebuffer" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void Destroy( )
+    {
+        // Waits for the frames still being written, they are only known to have failed once they are
+        if ( NULL != this->capture && !SOIL_capture_flush( this->capture ) )
+        {
+            std::cout << "Failed to save a headless frame" << std::endl;
+        }
+        SOIL_capture_destroy( this->capture );
+        this->capture = NULL;
+
+#ifdef HEADLESS_EGL
+        if ( EGL_NO_CONTEXT != this->context )
+        {
+            if ( 0 != this->framebuffer )
+            {
+                glDeleteFramebuffers( 1, &this->framebuffer );
+                glDeleteRenderbuffers( 1, &this->colorBuffer );
+                glDeleteRenderbuffers( 1, &this->depthBuffer );
+                GpuMemory::ReleaseRenderbuffer( this->colorBuffer );
+                GpuMemory::ReleaseRenderbuffer( this->depthBuffer );
+                this->framebuffer = 0;
+            }
+            
+            eglMakeCurrent( this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+            eglDestroyContext( this->display, this->context );
+            this->context = EGL_NO_CONTEXT;
+        }
+
+        if ( EGL_NO_DISPLAY != this->display )
+        {
+            eglTerminate( this->display );
+            this->display = EGL_NO_DISPLAY;
+        }
+#endif
+    }
+
+    // Saves the given frame, counted from 0, as headless_<frame>.png (padded to 5 digits, headless_00042.png) once it is rendered
+    void DumpFrame( GLuint frame )
+    {
+        this->dumpFrames.push_back( frame );
+    }
+
+    // Takes the place of swapping the buffers of a window
+    void EndFrame( )
+    {
+        if ( std::find( this->dumpFrames.begin( ), this->dumpFrames.end( ), this->frame ) != this->dumpFrames.end( ) )
+        {
+            if ( NULL == this->capture )
+            {
+                this->capture = SOIL_capture_create( SOIL_SAVE_TYPE_PNG, 0, 0, 0 );
+            }
+
+            char filename[32];
+            sprintf( filename, "headless_%05u.png", this->frame );
+            if ( NULL == this->capture || !SOIL_capture_frame( this->capture, filename, 0, 0, this->width, this->height ) )
+            {
+                std::cout << "Failed to save " << filename << ": " << SOIL_last_result( ) << std::endl;
+            }
+        }
+
+        this->frame++;
+    }
+
+    // Frames rendered so far
+    GLuint GetFrame( ) const
+    {
+        return this->frame;
+    }
+
+    // Seconds since the start, in place of glfwGetTime which needs GLFW (and a display) initialized
+    double GetTime( ) const
+    {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now( ) - this->startTime ).count( );
+    }
+
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay display;
+    EGLContext context;
+#endif
+
+    GLuint width, height;
+    GLuint frame;
+    GLuint framebuffer, colorBuffer, depthBuffer;
+
+    std::vector<GLuint> dumpFrames;
+    SOIL_capture *capture;
+
+    std::chrono::steady_clock::time_point startTime;
+};
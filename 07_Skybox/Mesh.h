@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdio>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -10,6 +11,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "GLStats.h"
+#include "GpuMemory.h"
+
 using namespace std;
 
 struct Vertex
@@ -38,19 +42,19 @@ public:
     vector<Texture> textures;
     
     /*  Functions  */
-    // Constructor
-    Mesh( vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures )
+    // Constructor, the owner names the mesh in GpuMemory
+    Mesh( vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, const string &owner )
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
         
         // Now that we have all the required data, set the vertex buffers and its attribute pointers.
-        this->setupMesh( );
+        this->setupMesh( owner );
     }
     
     // Render the mesh
-    void Draw( Shader shader )
+    void Draw( Shader &shader )
     {
         // Bind appropriate textures
         GLuint diffuseNr = 1;
@@ -60,22 +64,31 @@ public:
         {
             glActiveTexture( GL_TEXTURE0 + i ); // Active proper texture unit before binding
             // Retrieve texture number (the N in diffuse_textureN)
-            stringstream ss;
-            string number;
-            string name = this->textures[i].type;
+            const string &type = this->textures[i].type;
+            GLuint number = 0;
             
-            if( name == "texture_diffuse" )
+            if( type == "texture_diffuse" )
             {
-                ss << diffuseNr++; // Transfer GLuint to stream
+                number = diffuseNr++;
             }
-            else if( name == "texture_specular" )
+            else if( type == "texture_specular" )
             {
-                ss << specularNr++; // Transfer GLuint to stream
+                number = specularNr++;
+            }
+            
+            // The name goes on the stack, a string or a stream would allocate for every texture of every frame
+            char name[64];
+            if ( 0 != number )
+            {
+                snprintf( name, sizeof( name ), "%s%u", type.c_str( ), number );
+            }
+            else
+            {
+                snprintf( name, sizeof( name ), "%s", type.c_str( ) );
             }
             
-            number = ss.str( );
             // Now set the sampler to the correct texture unit
-            glUniform1i( glGetUniformLocation( shader.Program, ( name + number ).c_str( ) ), i );
+            glUniform1i( glGetUniformLocation( shader.Program, name ), i );
             // And finally bind the texture
             glBindTexture( GL_TEXTURE_2D, this->textures[i].id );
         }
@@ -102,7 +115,7 @@ private:
     
     /*  Functions    */
     // Initializes all the buffer objects/arrays
-    void setupMesh( )
+    void setupMesh( const string &owner )
     {
         // Create buffers/arrays
         glGenVertexArrays( 1, &this->VAO );
@@ -132,6 +145,9 @@ private:
         glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( GLvoid * )offsetof( Vertex, TexCoords ) );
         
         glBindVertexArray( 0 );
+        
+        GpuMemory::RegisterBuffer( GL_ARRAY_BUFFER, this->VBO, owner );
+        GpuMemory::RegisterBuffer( GL_ELEMENT_ARRAY_BUFFER, this->EBO, owner );
     }
 };
 
@@ -15,6 +15,9 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "CpuProfiler.h"
+#include "GLStats.h"
+#include "GpuMemory.h"
 #include "Mesh.h"
 
 using namespace std;
@@ -32,7 +35,7 @@ public:
     }
     
     // Draws the model, and thus all its meshes
-    void Draw( Shader shader )
+    void Draw( Shader &shader )
     {
         for ( GLuint i = 0; i < this->meshes.size( ); i++ )
         {
@@ -50,6 +53,8 @@ private:
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel( string path )
     {
+        CPU_PROFILE_SCOPE( "Model import" );
+        
         // Read file via ASSIMP
         Assimp::Importer importer;
         const aiScene *scene = importer.ReadFile( path, aiProcess_Triangulate | aiProcess_FlipUVs );
@@ -162,7 +167,7 @@ private:
         }
         
         // Return a mesh object created from the extracted mesh data
-        return Mesh( vertices, indices, textures );
+        return Mesh( vertices, indices, textures, this->directory + '/' + mesh->mName.C_Str( ) );
     }
     
     // Checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -216,7 +221,9 @@ GLint TextureFromFile( const char *path, string directory )
     
     int width, height;
     
+    CpuProfileScope decodeScope( "Decode" );
     unsigned char *image = SOIL_load_image( filename.c_str( ), &width, &height, 0, SOIL_LOAD_RGB );
+    decodeScope.End( );
     
     // Assign texture to ID
     glBindTexture( GL_TEXTURE_2D, textureID );
@@ -231,5 +238,7 @@ GLint TextureFromFile( const char *path, string directory )
     glBindTexture( GL_TEXTURE_2D, 0 );
     SOIL_free_image_data( image );
     
+    GpuMemory::RegisterTexture( GL_TEXTURE_2D, textureID, filename );
+    
     return textureID;
 }
@@ -0,0 +1,247 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+// GL Includes
+#include <GL/glew.h>
+
+#include "GLStats.h"
+#include "GpuMemory.h"
+
+// Lines of text drawn over the top left of the frame, for the profiler numbers. The font is a built-in 3x5 pixel one,
+// upper case only, so there are no font files to load. Lines are printed anew every frame between Clear and Draw;
+// they go in fixed size arrays and one buffer, so the overlay does not allocate while it runs.
+class Overlay
+{
+public:
+    enum
+    {
+        MAX_LINES = 24,
+        MAX_LINE_LENGTH = 48,
+        // Screen pixels per font pixel
+        SCALE = 2
+    };
+
+    Overlay( ) : program( 0 ), vao( 0 ), vbo( 0 ), fontTexture( 0 ), screenSizeLoc( -1 ), lineCount( 0 )
+    {
+
+    }
+
+    // Takes the program built from res/shaders/overlay.vs and overlay.frag, the GL context has to be current
+    void Init( GLuint program )
+    {
+        this->program = program;
+        this->screenSizeLoc = glGetUniformLocation( program, "screenSize" );
+
+        glUseProgram( program );
+        glUniform1i( glGetUniformLocation( program, "font" ), 0 );
+        glUseProgram( 0 );
+
+        // Every glyph is a 4x6 cell of the texture, the glyph in its top left and a pixel of spacing around
+        GLubyte pixels[CELL_HEIGHT][GLYPH_COUNT * CELL_WIDTH];
+        memset( pixels, 0, sizeof( pixels ) );
+
+        for ( GLuint glyph = 0; glyph < GLYPH_COUNT; glyph++ )
+        {
+            for ( GLuint y = 0; y < 5; y++ )
+            {
+                for ( GLuint x = 0; x < 3; x++ )
+                {
+                    // A glyph is five rows of three bits, one octal digit a row, the top one first
+                    if ( FONT[glyph] & ( 1 << ( ( 4 - y ) * 3 + ( 2 - x ) ) ) )
+                    {
+                        pixels[y][glyph * CELL_WIDTH + x] = 255;
+                    }
+                }
+            }
+        }
+
+        glGenTextures( 1, &this->fontTexture );
+        glBindTexture( GL_TEXTURE_2D, this->fontTexture );
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, GLYPH_COUNT * CELL_WIDTH, CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels );
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+        GpuMemory::RegisterTexture( GL_TEXTURE_2D, this->fontTexture, "overlay font" );
+
+        // Position in pixels from the top left, texture coords and color
+        glGenVertexArrays( 1, &this->vao );
+        glGenBuffers( 1, &this->vbo );
+        glBindVertexArray( this->vao );
+        glBindBuffer( GL_ARRAY_BUFFER, this->vbo );
+        glBufferData( GL_ARRAY_BUFFER, sizeof( this->vertices ), NULL, GL_DYNAMIC_DRAW );
+        glEnableVertexAttribArray( 0 );
+        glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof( GLfloat ), ( GLvoid * ) 0 );
+        glEnableVertexAttribArray( 1 );
+        glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof( GLfloat ), ( GLvoid * )( 2 * sizeof( GLfloat ) ) );
+        glEnableVertexAttribArray( 2 );
+        glVertexAttribPointer( 2, 4, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof( GLfloat ), ( GLvoid * )( 4 * sizeof( GLfloat ) ) );
+        glBindVertexArray( 0 );
+        GpuMemory::RegisterBuffer( GL_ARRAY_BUFFER, this->vbo, "overlay" );
+    }
+
+    void Destroy( )
+    {
+        glDeleteVertexArrays( 1, &this->vao );
+        glDeleteBuffers( 1, &this->vbo );
+        glDeleteTextures( 1, &this->fontTexture );
+        GpuMemory::ReleaseBuffer( this->vbo );
+        GpuMemory::ReleaseTexture( this->fontTexture );
+        this->vao = this->vbo = this->fontTexture = 0;
+    }
+
+    // Starts the lines of a new frame
+    void Clear( )
+    {
+        this->lineCount = 0;
+    }
+
+    // Adds a line, printf style, longer lines are cut
+    void Print( const char *format, ... )
+    {
+        if ( MAX_LINES == this->lineCount )
+        {
+            return;
+        }
+
+        va_list args;
+        va_start( args, format );
+        vsnprintf( this->lines[this->lineCount++], MAX_LINE_LENGTH + 1, format, args );
+        va_end( args );
+    }
+
+    // Draws the lines on a dark background, over whatever is in the framebuffer
+    void Draw( GLuint screenWidth, GLuint screenHeight )
+    {
+        if ( 0 == this->lineCount || 0 == this->vao )
+        {
+            return;
+        }
+
+        GLuint vertexCount = 0;
+        size_t longest = 0;
+
+        for ( GLuint i = 0; i < this->lineCount; i++ )
+        {
+            longest = std::max( longest, strlen( this->lines[i] ) );
+        }
+
+        // Background first, with the solid glyph
+        const GLfloat background[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+        const GLfloat text[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        GLfloat cellWidth = CELL_WIDTH * SCALE, cellHeight = CELL_HEIGHT * SCALE;
+
+        this->addQuad( vertexCount, 0.0f, 0.0f, ( longest + 1 ) * cellWidth, ( this->lineCount + 1 ) * cellHeight, SOLID_GLYPH, background );
+
+        for ( GLuint i = 0; i < this->lineCount; i++ )
+        {
+            for ( GLuint j = 0; '\0' != this->lines[i][j]; j++ )
+            {
+                GLuint glyph = glyphIndex( this->lines[i][j] );
+
+                if ( 0 != glyph )
+                {
+                    this->addQuad( vertexCount, ( j + 0.5f ) * cellWidth, ( i + 0.5f ) * cellHeight, 3 * SCALE, 5 * SCALE, glyph, text );
+                }
+            }
+        }
+
+        GLboolean depthTest = glIsEnabled( GL_DEPTH_TEST );
+        glDisable( GL_DEPTH_TEST );
+        glEnable( GL_BLEND );
+        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+        glUseProgram( this->program );
+        glUniform2f( this->screenSizeLoc, ( GLfloat )screenWidth, ( GLfloat )screenHeight );
+        glActiveTexture( GL_TEXTURE0 );
+        glBindTexture( GL_TEXTURE_2D, this->fontTexture );
+
+        glBindBuffer( GL_ARRAY_BUFFER, this->vbo );
+        glBufferSubData( GL_ARRAY_BUFFER, 0, vertexCount * VERTEX_FLOATS * sizeof( GLfloat ), this->vertices );
+        glBindVertexArray( this->vao );
+        glDrawArrays( GL_TRIANGLES, 0, vertexCount );
+        glBindVertexArray( 0 );
+
+        glDisable( GL_BLEND );
+
+        if ( depthTest )
+        {
+            glEnable( GL_DEPTH_TEST );
+        }
+    }
+
+private:
+    enum
+    {
+        CELL_WIDTH = 4,
+        CELL_HEIGHT = 6,
+        // ' ' to '_', and a solid block for the background
+        GLYPH_COUNT = 65,
+        SOLID_GLYPH = 64,
+        VERTEX_FLOATS = 8,
+        // Every character, and the background
+        MAX_QUADS = MAX_LINES * MAX_LINE_LENGTH + 1
+    };
+
+    static constexpr unsigned short FONT[GLYPH_COUNT] =
+    {
+        000000, 022202, 055000, 057575, 036236, 051245, 025253, 022000,   //   ! " # $ % & '
+        012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244,   // ( ) * + , - . /
+        075557, 026227, 071747, 071317, 055711, 074717, 074757, 071111,   // 0 1 2 3 4 5 6 7
+        075757, 075717, 002020, 002024, 012421, 007070, 042124, 071302,   // 8 9 : ; < = > ?
+        075747, 025755, 065656, 034443, 065556, 074647, 074644, 034553,   // @ A B C D E F G
+        055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552,   // H I J K L M N O
+        065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775,   // P Q R S T U V W
+        055255, 055222, 071247, 064446, 044211, 031113, 025000, 000007,   // X Y Z [ \ ] ^ _
+        077777
+    };
+
+    GLuint program;
+    GLuint vao, vbo;
+    GLuint fontTexture;
+    GLint screenSizeLoc;
+
+    char lines[MAX_LINES][MAX_LINE_LENGTH + 1];
+    GLuint lineCount;
+
+    GLfloat vertices[MAX_QUADS * 6 * VERTEX_FLOATS];
+
+    // Lower case prints as upper case, anything the font doesn't have as a space
+    static GLuint glyphIndex( char c )
+    {
+        if ( c >= 'a' && c <= 'z' )
+        {
+            c -= 'a' - 'A';
+        }
+
+        return ( c > ' ' && c <= '_' ) ? c - ' ' : 0;
+    }
+
+    void addQuad( GLuint &vertexCount, GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLuint glyph, const GLfloat color[4] )
+    {
+        GLfloat u0 = ( GLfloat )( glyph * CELL_WIDTH ) / ( GLYPH_COUNT * CELL_WIDTH );
+        GLfloat u1 = ( GLfloat )( glyph * CELL_WIDTH + 3 ) / ( GLYPH_COUNT * CELL_WIDTH );
+        GLfloat v1 = 5.0f / CELL_HEIGHT;
+        const GLfloat corners[6][4] =
+        {
+            { x, y, u0, 0.0f }, { x, y + height, u0, v1 }, { x + width, y + height, u1, v1 },
+            { x, y, u0, 0.0f }, { x + width, y + height, u1, v1 }, { x + width, y, u1, 0.0f }
+        };
+
+        for ( GLuint i = 0; i < 6; i++ )
+        {
+            GLfloat *vertex = &this->vertices[( vertexCount++ ) * VERTEX_FLOATS];
+
+            memcpy( vertex, corners[i], 4 * sizeof( GLfloat ) );
+            memcpy( vertex + 4, color, 4 * sizeof( GLfloat ) );
+        }
+    }
+};
@@ -157,7 +157,7 @@ solution "SOIL2"
 			links {"opengl32"}
 
 		configuration "linux"
-			links {"GL"}
+			links {"GL","pthread"}
 
 		configuration "macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework" }
@@ -203,7 +203,7 @@ solution "SOIL2"
 			links {"opengl32","SDL2main","SDL2"}
 
 		configuration "linux"
-			links {"GL","SDL2"}
+			links {"GL","SDL2","pthread"}
 
 		configuration "macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework", get_backend_link_name("SDL2") }
@@ -253,7 +253,7 @@ solution "SOIL2"
 			links {"opengl32","SDL2main","SDL2"}
 
 		configuration "linux"
-			links {"GL","SDL2"}
+			links {"GL","SDL2","pthread"}
 
 		configuration "macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework", get_backend_link_name("SDL2") }
@@ -283,3 +283,47 @@ solution "SOIL2"
 			defines { "NDEBUG" }
 			flags { "Optimize" }
 			targetname "soil2-perf-test-release"
+
+	project "soil2-benchmark"
+		kind "ConsoleApp"
+		language "C++"
+		links { "soil2-static-lib" }
+		files { "src/benchmark/*.cpp", "src/common/*.cpp" }
+
+		if os.is("windows") and not is_vs() then
+			links { "mingw32" }
+		end
+
+		configuration "mingw32"
+			flags { "EnableSSE", "EnableSSE2" }
+			defines { "STBI_MINGW_ENABLE_SSE2" }
+			links { "mingw32" }
+
+		configuration "windows"
+			links {"opengl32"}
+
+		configuration "linux"
+			links {"GL","pthread"}
+
+		configuration "macosx"
+			links { "OpenGL.framework", "CoreFoundation.framework" }
+			defines { "GL_SILENCE_DEPRECATION" }
+
+		configuration "haiku"
+			links {"GL"}
+
+		configuration "freebsd"
+			links {"GL","pthread"}
+
+		configuration "debug"
+			defines { "DEBUG" }
+			flags { "Symbols" }
+			if not is_vs() then
+				buildoptions{ "-Wall" }
+			end
+			targetname "soil2-benchmark-debug"
+
+		configuration "release"
+			defines { "NDEBUG" }
+			flags { "Optimize" }
+			targetname "soil2-benchmark-release"
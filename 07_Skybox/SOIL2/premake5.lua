@@ -127,7 +127,7 @@ workspace "SOIL2"
 			links {"opengl32"}
 
 		filter "system:linux"
-			links {"GL"}
+			links {"GL","pthread"}
 
 		filter "system:macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework" }
@@ -168,7 +168,7 @@ workspace "SOIL2"
 			links {"opengl32","SDL2main","SDL2"}
 
 		filter "system:linux"
-			links {"GL","SDL2"}
+			links {"GL","SDL2","pthread"}
 
 		filter "system:macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework", get_backend_link_name("SDL2") }
@@ -225,7 +225,7 @@ workspace "SOIL2"
 			links {"opengl32","SDL2main","SDL2"}
 
 		filter "system:linux"
-			links {"GL","SDL2"}
+			links {"GL","SDL2","pthread"}
 
 		filter "system:macosx"
 			links { "OpenGL.framework", "CoreFoundation.framework", get_backend_link_name("SDL2") }
@@ -264,3 +264,43 @@ workspace "SOIL2"
 
 		filter { "options:windows-vc-build", "system:windows" }
 			incdirs { "./" .. remote_sdl2_version .. "/include" }
+
+	project "soil2-benchmark"
+		kind "ConsoleApp"
+		language "C++"
+		links { "soil2-static-lib" }
+		files { "src/benchmark/*.cpp", "src/common/*.cpp" }
+
+		filter { "system:windows", "action:not vs*" }
+			links { "mingw32" }
+			vectorextensions "SSE2"
+			defines { "STBI_MINGW_ENABLE_SSE2" }
+
+		filter "system:windows"
+			links {"opengl32"}
+
+		filter "system:linux"
+			links {"GL","pthread"}
+
+		filter "system:macosx"
+			links { "OpenGL.framework", "CoreFoundation.framework" }
+			defines { "GL_SILENCE_DEPRECATION" }
+
+		filter "system:haiku"
+			links {"GL"}
+
+		filter "system:bsd"
+			links {"GL","pthread"}
+
+		filter "action:not vs*"
+			buildoptions { "-Wall" }
+
+		filter "configurations:debug"
+			defines { "DEBUG" }
+			symbols "On"
+			targetname "soil2-benchmark-debug"
+
+		filter "configurations:release"
+			defines { "NDEBUG" }
+			optimize "On"
+			targetname "soil2-benchmark-release"
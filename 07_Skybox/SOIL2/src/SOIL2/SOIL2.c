@@ -109,21 +109,50 @@
 #endif
 
 #include "SOIL2.h"
+#include "allocator_helper.h"
+/*	stb_image allocates through the SOIL allocator too	*/
+#define STBI_MALLOC(sz)			soil_malloc( sz )
+#define STBI_REALLOC(p,newsz)	soil_realloc( p, newsz )
+#define STBI_FREE(p)			soil_free( p )
+#include "thread_helper.h"
+/*	the DDS decoder expands the blocks of big images on several threads	*/
+#define STBI_DDS_PARALLEL_FOR(count,min_items,job,user_data)	soil_parallel_for( count, min_items, job, user_data )
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+/*	the PNG writer filters and deflates big images on several threads	*/
+#define STBIW_PARALLEL_FOR(count,job,user_data)	soil_parallel_for( count, 1, job, user_data )
+#ifdef SOIL_NO_SIMD
+#define STBIW_NO_SIMD
+#endif
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 #include "image_helper.h"
 #include "image_DXT.h"
+#include "image_BC6H.h"
+#include "file_helper.h"
 #include "pvr_helper.h"
 #include "pkm_helper.h"
+/*	jo_jpeg encodes the rows of blocks on several threads too	*/
+#define JO_JPEG_PARALLEL_FOR(count,job,user_data)	soil_parallel_for( count, 1, job, user_data )
+#ifdef SOIL_NO_SIMD
+#define JO_JPEG_NO_SIMD
+#endif
 #include "jo_jpeg.h"
 
 #include <stdlib.h>
 #include <string.h>
 
-/*	error reporting	*/
-const char *result_string_pointer = "SOIL initialized";
+/*	error reporting, per thread so concurrent loads don't clobber each other	*/
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL const char *result_string_pointer = "SOIL initialized";
+#else
+static const char *result_string_pointer = "SOIL initialized";
+#endif
+
+/*	SOIL_load_image and SOIL_load_image_from_memory for the texture loaders,
+	applying the options their flags ask for	*/
+static unsigned char* SOIL_internal_load_image( const char *filename, int *width, int *height, int *channels, int force_channels, unsigned int flags );
+static unsigned char* SOIL_internal_load_image_from_memory( const unsigned char *const buffer, int buffer_length, int *width, int *height, int *channels, int force_channels, unsigned int flags );
 
 /*	for loading cube maps	*/
 enum{
@@ -187,6 +216,20 @@ static int has_BGRA8888_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_BGRA8888_capability( void );
 static int has_ETC1_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_ETC1_capability( void );
+/*	for BC6H (BPTC float) compressed textures	*/
+static int has_BPTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_BPTC_capability( void );
+#define SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT		0x8E8E
+#define SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT		0x8E8F
+/*	for uncompressed real HDR textures	*/
+static int has_RGB9E5_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_RGB9E5_capability( void );
+static int has_half_float_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_half_float_capability( void );
+#define SOIL_RGB9_E5						0x8C3D
+#define SOIL_UNSIGNED_INT_5_9_9_9_REV		0x8C3E
+#define SOIL_RGB16F							0x881B
+#define SOIL_HALF_FLOAT						0x140B
 
 /* GL_IMG_texture_compression_pvrtc */
 #define SOIL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG                      0x8C00
@@ -405,6 +448,7 @@ unsigned int
 		unsigned int opengl_texture_target,
 		unsigned int texture_check_size_enum
 	);
+void check_for_GL_errors( const char *calling_location );
 
 /*	and the code magic begins here [8^)	*/
 unsigned int
@@ -456,7 +500,7 @@ unsigned int
 	}
 
 	/*	try to load the image	*/
-	img = SOIL_load_image( filename, &width, &height, &channels, force_channels );
+	img = SOIL_internal_load_image( filename, &width, &height, &channels, force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -476,10 +520,318 @@ unsigned int
 			GL_MAX_TEXTURE_SIZE );
 	/*	and nuke the image data	*/
 	SOIL_free_image_data( img );
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
 
+/*	halves a float image (box filter), used for the BC6H MIPmaps	*/
+static float*
+	SOIL_internal_downsample_float
+	(
+		const float *img,
+		int width, int height, int channels,
+		int *new_width, int *new_height
+	)
+{
+	int nw = width > 1 ? width / 2 : 1;
+	int nh = height > 1 ? height / 2 : 1;
+	int x, y, c;
+	float *out = (float*)soil_malloc( (size_t)nw * nh * channels * sizeof( float ) );
+	if( NULL == out )
+	{
+		return NULL;
+	}
+	for( y = 0; y < nh; ++y )
+	{
+		int y0 = (y * 2 < height) ? y * 2 : height - 1;
+		int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+		for( x = 0; x < nw; ++x )
+		{
+			int x0 = (x * 2 < width) ? x * 2 : width - 1;
+			int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+			for( c = 0; c < channels; ++c )
+			{
+				out[(y * nw + x) * channels + c] = 0.25f * (
+					img[(y0 * width + x0) * channels + c] +
+					img[(y0 * width + x1) * channels + c] +
+					img[(y1 * width + x0) * channels + c] +
+					img[(y1 * width + x1) * channels + c] );
+			}
+		}
+	}
+	*new_width = nw;
+	*new_height = nh;
+	return out;
+}
+
+/*	flips a float image vertically, in place	*/
+static void
+	SOIL_internal_flip_float
+	(
+		float *img,
+		int width, int height, int channels
+	)
+{
+	int j;
+	size_t row = (size_t)width * channels;
+	for( j = 0; j < height / 2; ++j )
+	{
+		float *a = img + j * row;
+		float *b = img + (height - 1 - j) * row;
+		size_t k;
+		for( k = 0; k < row; ++k )
+		{
+			float t = a[k]; a[k] = b[k]; b[k] = t;
+		}
+	}
+}
+
+static unsigned int
+	SOIL_internal_load_OGL_BC6H_texture
+	(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	)
+{
+	float *img;
+	int width, height, channels;
+	int level = 0;
+	int complete = 0;
+	unsigned int tex_id;
+	GLint unpack_aligment;
+
+	if( query_BPTC_capability() != SOIL_CAPABILITY_PRESENT )
+	{
+		result_string_pointer = "BC6H textures not supported by the OpenGL driver";
+		return 0;
+	}
+	img = stbi_loadf( filename, &width, &height, &channels, 3 );
+	if( NULL == img )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return 0;
+	}
+	channels = 3;
+	if( flags & SOIL_FLAG_INVERT_Y )
+	{
+		SOIL_internal_flip_float( img, width, height, channels );
+	}
+
+	tex_id = reuse_texture_ID;
+	if( tex_id == 0 )
+	{
+		glGenTextures( 1, &tex_id );
+	}
+	check_for_GL_errors( "glGenTextures" );
+	if( tex_id == 0 )
+	{
+		soil_free( img );
+		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
+		return 0;
+	}
+	glBindTexture( GL_TEXTURE_2D, tex_id );
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &unpack_aligment );
+	if( 1 != unpack_aligment )
+	{
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	}
+
+	/*	compress and upload every level (the driver can't build
+		MIPmaps for compressed float textures)	*/
+	while( NULL != img )
+	{
+		int DDS_size;
+		unsigned char *DDS_data = convert_image_to_BC6H( img, width, height, channels, &DDS_size );
+		if( NULL == DDS_data )
+		{
+			break;
+		}
+		soilGlCompressedTexImage2D(
+			GL_TEXTURE_2D, level,
+			SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, width, height, 0,
+			DDS_size, DDS_data );
+		check_for_GL_errors( "glCompressedTexImage2D" );
+		SOIL_free_image_data( DDS_data );
+		if( !(flags & (SOIL_FLAG_MIPMAPS | SOIL_FLAG_GL_MIPMAPS)) ||
+			((width == 1) && (height == 1)) )
+		{
+			complete = 1;
+			break;
+		}
+		{
+			float *next = SOIL_internal_downsample_float( img, width, height, channels, &width, &height );
+			soil_free( img );
+			img = next;
+			++level;
+		}
+	}
+	soil_free( img );
+	if( 1 != unpack_aligment )
+	{
+		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_aligment );
+	}
+	if( !complete )
+	{
+		/*	out of memory: a level is missing, the texture can't be sampled;
+			a reused texture stays the caller's to delete	*/
+		if( tex_id != reuse_texture_ID )
+		{
+			glDeleteTextures( 1, &tex_id );
+		}
+		result_string_pointer = "Failed to compress the image to BC6H";
+		return 0;
+	}
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, level > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	} else
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, SOIL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, SOIL_CLAMP_TO_EDGE );
+	}
+	check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+	result_string_pointer = "Image loaded as a BC6H OpenGL texture";
+	return tex_id;
+}
+
+/*	real HDR, uncompressed: the floats are packed into RGB9_E5 or RGB16F
+	at load time, so the shader samples (and filters) plain RGB	*/
+static unsigned int
+	SOIL_internal_load_OGL_packed_HDR_texture
+	(
+		const char *filename,
+		int HDR_format,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	)
+{
+	float *img;
+	int width, height, channels;
+	int level = 0;
+	int complete = 0;
+	unsigned int tex_id;
+	GLint unpack_aligment;
+	int RGB9E5 = (HDR_format == SOIL_HDR_RGB9_E5);
+
+	if( (RGB9E5 ? query_RGB9E5_capability() : query_half_float_capability()) != SOIL_CAPABILITY_PRESENT )
+	{
+		result_string_pointer = RGB9E5 ?
+			"RGB9_E5 textures not supported by the OpenGL driver" :
+			"Half float textures not supported by the OpenGL driver";
+		return 0;
+	}
+	img = stbi_loadf( filename, &width, &height, &channels, 3 );
+	if( NULL == img )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return 0;
+	}
+	channels = 3;
+	if( flags & SOIL_FLAG_INVERT_Y )
+	{
+		SOIL_internal_flip_float( img, width, height, channels );
+	}
+
+	tex_id = reuse_texture_ID;
+	if( tex_id == 0 )
+	{
+		glGenTextures( 1, &tex_id );
+	}
+	check_for_GL_errors( "glGenTextures" );
+	if( tex_id == 0 )
+	{
+		soil_free( img );
+		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
+		return 0;
+	}
+	glBindTexture( GL_TEXTURE_2D, tex_id );
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &unpack_aligment );
+	if( 1 != unpack_aligment )
+	{
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	}
+
+	/*	pack and upload every level (RGB9_E5 isn't renderable,
+		so the driver can't be trusted to build its MIPmaps)	*/
+	while( NULL != img )
+	{
+		void *packed = soil_malloc( (size_t)width * height * (RGB9E5 ? 4 : 6) );
+		if( NULL == packed )
+		{
+			break;
+		}
+		if( RGB9E5 )
+		{
+			RGBF_to_RGB9E5( img, (unsigned int*)packed, width, height );
+			glTexImage2D(
+				GL_TEXTURE_2D, level,
+				SOIL_RGB9_E5, width, height, 0,
+				GL_RGB, SOIL_UNSIGNED_INT_5_9_9_9_REV, packed );
+		} else
+		{
+			RGBF_to_RGB16F( img, (unsigned short*)packed, width, height );
+			glTexImage2D(
+				GL_TEXTURE_2D, level,
+				SOIL_RGB16F, width, height, 0,
+				GL_RGB, SOIL_HALF_FLOAT, packed );
+		}
+		check_for_GL_errors( "glTexImage2D" );
+		soil_free( packed );
+		if( !(flags & (SOIL_FLAG_MIPMAPS | SOIL_FLAG_GL_MIPMAPS)) ||
+			((width == 1) && (height == 1)) )
+		{
+			complete = 1;
+			break;
+		}
+		{
+			float *next = SOIL_internal_downsample_float( img, width, height, channels, &width, &height );
+			soil_free( img );
+			img = next;
+			++level;
+		}
+	}
+	soil_free( img );
+	if( 1 != unpack_aligment )
+	{
+		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_aligment );
+	}
+	if( !complete )
+	{
+		/*	out of memory: a level is missing, the texture can't be sampled;
+			a reused texture stays the caller's to delete	*/
+		if( tex_id != reuse_texture_ID )
+		{
+			glDeleteTextures( 1, &tex_id );
+		}
+		result_string_pointer = "Failed to pack the HDR image";
+		return 0;
+	}
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, level > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	} else
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, SOIL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, SOIL_CLAMP_TO_EDGE );
+	}
+	check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+	result_string_pointer = RGB9E5 ?
+		"Image loaded as an RGB9_E5 OpenGL texture" :
+		"Image loaded as an RGB16F OpenGL texture";
+	return tex_id;
+}
+
 unsigned int
 	SOIL_load_OGL_HDR_texture
 	(
@@ -498,12 +850,26 @@ unsigned int
 	/* error check */
 	if( (fake_HDR_format != SOIL_HDR_RGBE) &&
 		(fake_HDR_format != SOIL_HDR_RGBdivA) &&
-		(fake_HDR_format != SOIL_HDR_RGBdivA2) )
+		(fake_HDR_format != SOIL_HDR_RGBdivA2) &&
+		(fake_HDR_format != SOIL_HDR_BC6H) &&
+		(fake_HDR_format != SOIL_HDR_RGB9_E5) &&
+		(fake_HDR_format != SOIL_HDR_RGB16F) )
 	{
 		result_string_pointer = "Invalid fake HDR format specified";
 		return 0;
 	}
 
+	if( fake_HDR_format == SOIL_HDR_BC6H )
+	{
+		/*	real HDR: keep the floats and compress them	*/
+		return SOIL_internal_load_OGL_BC6H_texture( filename, reuse_texture_ID, flags );
+	}
+	if( (fake_HDR_format == SOIL_HDR_RGB9_E5) || (fake_HDR_format == SOIL_HDR_RGB16F) )
+	{
+		/*	real HDR: keep the floats and pack them	*/
+		return SOIL_internal_load_OGL_packed_HDR_texture( filename, fake_HDR_format, reuse_texture_ID, flags );
+	}
+
 	/* check if the image is HDR */
 	if ( stbi_is_hdr( filename ) )
 	{
@@ -534,6 +900,8 @@ unsigned int
 			GL_MAX_TEXTURE_SIZE );
 	/*	and nuke the image data	*/
 	SOIL_free_image_data( img );
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -594,10 +962,10 @@ unsigned int
 	}
 
 	/*	try to load the image	*/
-	img = SOIL_load_image_from_memory(
+	img = SOIL_internal_load_image_from_memory(
 					buffer, buffer_length,
 					&width, &height, &channels,
-					force_channels );
+					force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -617,6 +985,8 @@ unsigned int
 			GL_MAX_TEXTURE_SIZE );
 	/*	and nuke the image data	*/
 	SOIL_free_image_data( img );
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -657,7 +1027,7 @@ unsigned int
 		return 0;
 	}
 	/*	1st face: try to load the image	*/
-	img = SOIL_load_image( x_pos_file, &width, &height, &channels, force_channels );
+	img = SOIL_internal_load_image( x_pos_file, &width, &height, &channels, force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -681,7 +1051,7 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image( x_neg_file, &width, &height, &channels, force_channels );
+		img = SOIL_internal_load_image( x_neg_file, &width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -706,7 +1076,7 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image( y_pos_file, &width, &height, &channels, force_channels );
+		img = SOIL_internal_load_image( y_pos_file, &width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -731,7 +1101,7 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image( y_neg_file, &width, &height, &channels, force_channels );
+		img = SOIL_internal_load_image( y_neg_file, &width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -756,7 +1126,7 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image( z_pos_file, &width, &height, &channels, force_channels );
+		img = SOIL_internal_load_image( z_pos_file, &width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -781,7 +1151,7 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image( z_neg_file, &width, &height, &channels, force_channels );
+		img = SOIL_internal_load_image( z_neg_file, &width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -802,6 +1172,8 @@ unsigned int
 		/*	and nuke the image data	*/
 		SOIL_free_image_data( img );
 	}
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -848,9 +1220,9 @@ unsigned int
 		return 0;
 	}
 	/*	1st face: try to load the image	*/
-	img = SOIL_load_image_from_memory(
+	img = SOIL_internal_load_image_from_memory(
 			x_pos_buffer, x_pos_buffer_length,
-			&width, &height, &channels, force_channels );
+			&width, &height, &channels, force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -874,9 +1246,9 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image_from_memory(
+		img = SOIL_internal_load_image_from_memory(
 				x_neg_buffer, x_neg_buffer_length,
-				&width, &height, &channels, force_channels );
+				&width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -901,9 +1273,9 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image_from_memory(
+		img = SOIL_internal_load_image_from_memory(
 				y_pos_buffer, y_pos_buffer_length,
-				&width, &height, &channels, force_channels );
+				&width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -928,9 +1300,9 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image_from_memory(
+		img = SOIL_internal_load_image_from_memory(
 				y_neg_buffer, y_neg_buffer_length,
-				&width, &height, &channels, force_channels );
+				&width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -955,9 +1327,9 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image_from_memory(
+		img = SOIL_internal_load_image_from_memory(
 				z_pos_buffer, z_pos_buffer_length,
-				&width, &height, &channels, force_channels );
+				&width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -982,9 +1354,9 @@ unsigned int
 	if( tex_id != 0 )
 	{
 		/*	1st face: try to load the image	*/
-		img = SOIL_load_image_from_memory(
+		img = SOIL_internal_load_image_from_memory(
 				z_neg_buffer, z_neg_buffer_length,
-				&width, &height, &channels, force_channels );
+				&width, &height, &channels, force_channels, flags );
 		/*	channels holds the original number of channels, which may have been forced	*/
 		if( (force_channels >= 1) && (force_channels <= 4) )
 		{
@@ -1005,6 +1377,8 @@ unsigned int
 		/*	and nuke the image data	*/
 		SOIL_free_image_data( img );
 	}
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -1080,7 +1454,7 @@ unsigned int
 		return 0;
 	}
 	/*	1st off, try to load the full image	*/
-	img = SOIL_load_image( filename, &width, &height, &channels, force_channels );
+	img = SOIL_internal_load_image( filename, &width, &height, &channels, force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -1107,6 +1481,7 @@ unsigned int
 			);
 	/*	nuke the temporary image data and return the texture handle	*/
 	SOIL_free_image_data( img );
+	soil_allocator_upload_done();
 	return tex_id;
 }
 
@@ -1186,10 +1561,10 @@ unsigned int
 		return 0;
 	}
 	/*	1st off, try to load the full image	*/
-	img = SOIL_load_image_from_memory(
+	img = SOIL_internal_load_image_from_memory(
 			buffer, buffer_length,
 			&width, &height, &channels,
-			force_channels );
+			force_channels, flags );
 	/*	channels holds the original number of channels, which may have been forced	*/
 	if( (force_channels >= 1) && (force_channels <= 4) )
 	{
@@ -1216,6 +1591,7 @@ unsigned int
 			);
 	/*	nuke the temporary image data and return the texture handle	*/
 	SOIL_free_image_data( img );
+	soil_allocator_upload_done();
 	return tex_id;
 }
 
@@ -1277,7 +1653,7 @@ unsigned int
 		dh = width;
 	}
 	sz = dw+dh;
-	sub_img = (unsigned char *)malloc( sz*sz*channels );
+	sub_img = (unsigned char *)soil_malloc( sz*sz*channels );
 	/*	do the splitting and uploading	*/
 	tex_id = reuse_texture_ID;
 	for( i = 0; i < 6; ++i )
@@ -1326,6 +1702,8 @@ unsigned int
 	}
 	/*	and nuke the image and sub-image data	*/
 	SOIL_free_image_data( sub_img );
+	/*	the upload is done, the allocator can rewind	*/
+	soil_allocator_upload_done();
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -1382,7 +1760,7 @@ static void createMipmaps(const unsigned char *const img,
 		int MIPlevel = 1;
 		int MIPwidth = (width+1) / 2;
 		int MIPheight = (height+1) / 2;
-		unsigned char *resampled = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+		unsigned char *resampled = (unsigned char*)soil_malloc( channels*MIPwidth*MIPheight );
 
 		while( ((1<<MIPlevel) <= width) || ((1<<MIPlevel) <= height) )
 		{
@@ -1466,7 +1844,8 @@ unsigned int
 	int max_supported_size;
 	int iwidth = *width;
 	int iheight = *height;
-	int needCopy;
+	int needResize;
+	unsigned int postprocess_flags = 0;
 	GLint unpack_aligment;
 
 	/*	how large of a texture can this OpenGL implementation handle?	*/
@@ -1512,77 +1891,46 @@ unsigned int
 		flags |= SOIL_FLAG_POWER_OF_TWO;
 	}
 
-	needCopy = ( ( flags & SOIL_FLAG_INVERT_Y ) ||
-				 ( flags & SOIL_FLAG_NTSC_SAFE_RGB ) ||
-				 ( flags & SOIL_FLAG_MULTIPLY_ALPHA ) ||
-				 ( flags & SOIL_FLAG_CoCg_Y )
-				);
-
-	/*	create a copy the image data only if needed */
-	if ( needCopy ) {
-		img = (unsigned char*)malloc( iwidth*iheight*channels );
-		memcpy( img, data, iwidth*iheight*channels );
-	}
+	/*	do I need to make it a power of 2?	*/
+	needResize = (
+		( ( flags & SOIL_FLAG_POWER_OF_TWO) && ( !SOIL_IS_POW2(iwidth) || !SOIL_IS_POW2(iheight) ) ) ||	/*	user asked for it and the texture is not power of 2	*/
+		( (flags & SOIL_FLAG_MIPMAPS)&& !( ( flags & SOIL_FLAG_GL_MIPMAPS ) &&
+										   query_gen_mipmap_capability() == SOIL_CAPABILITY_PRESENT &&
+										   query_NPOT_capability() == SOIL_CAPABILITY_PRESENT ) ) ||	/*	need it for the MIP-maps when mipmaps required
+																											and not GL mipmaps required and supported	*/
+		(iwidth > max_supported_size) ||		/*	it's too big, (make sure it's	*/
+		(iheight > max_supported_size) );		/*	2^n for later down-sampling)	*/
 
-	/*	does the user want me to invert the image?	*/
+	/*	flip, NTSC safe scale and pre-multiply alpha (and YCoCg, unless
+		the image gets resampled first) all happen in one pass over the copy	*/
 	if( flags & SOIL_FLAG_INVERT_Y )
 	{
-		int i, j;
-		for( j = 0; j*2 < iheight; ++j )
-		{
-			int index1 = j * iwidth * channels;
-			int index2 = (iheight - 1 - j) * iwidth * channels;
-			for( i = iwidth * channels; i > 0; --i )
-			{
-				unsigned char temp = img[index1];
-				img[index1] = img[index2];
-				img[index2] = temp;
-				++index1;
-				++index2;
-			}
-		}
+		postprocess_flags |= IMAGE_POSTPROCESS_INVERT_Y;
 	}
-	/*	does the user want me to scale the colors into the NTSC safe RGB range?	*/
 	if( flags & SOIL_FLAG_NTSC_SAFE_RGB )
 	{
-		scale_image_RGB_to_NTSC_safe( img, iwidth, iheight, channels );
+		postprocess_flags |= IMAGE_POSTPROCESS_NTSC_SAFE_RGB;
 	}
-	/*	does the user want me to convert from straight to pre-multiplied alpha?
-		(and do we even _have_ alpha?)	*/
+	/*	(only the images with alpha are touched)	*/
 	if( flags & SOIL_FLAG_MULTIPLY_ALPHA )
 	{
-		int i;
-		switch( channels )
-		{
-		case 2:
-			for( i = 0; i < 2*iwidth*iheight; i += 2 )
-			{
-				img[i] = (img[i] * img[i+1] + 128) >> 8;
-			}
-			break;
-		case 4:
-			for( i = 0; i < 4*iwidth*iheight; i += 4 )
-			{
-				img[i+0] = (img[i+0] * img[i+3] + 128) >> 8;
-				img[i+1] = (img[i+1] * img[i+3] + 128) >> 8;
-				img[i+2] = (img[i+2] * img[i+3] + 128) >> 8;
-			}
-			break;
-		default:
-			/*	no other number of channels contains alpha data	*/
-			break;
-		}
+		postprocess_flags |= IMAGE_POSTPROCESS_MULTIPLY_ALPHA;
+	}
+	if( (flags & SOIL_FLAG_CoCg_Y) &&
+		!( needResize && ( !SOIL_IS_POW2(iwidth) || !SOIL_IS_POW2(iheight) ) ) &&
+		(iwidth <= max_supported_size) && (iheight <= max_supported_size) )
+	{
+		postprocess_flags |= IMAGE_POSTPROCESS_YCOCG;
 	}
 
-	/*	do I need to make it a power of 2?	*/
-	if(
-		( ( flags & SOIL_FLAG_POWER_OF_TWO) && ( !SOIL_IS_POW2(iwidth) || !SOIL_IS_POW2(iheight) ) ) ||	/*	user asked for it and the texture is not power of 2	*/
-		( (flags & SOIL_FLAG_MIPMAPS)&& !( ( flags & SOIL_FLAG_GL_MIPMAPS ) &&
-										   query_gen_mipmap_capability() == SOIL_CAPABILITY_PRESENT &&
-										   query_NPOT_capability() == SOIL_CAPABILITY_PRESENT ) ) ||	/*	need it for the MIP-maps when mipmaps required
-																											and not GL mipmaps required and supported	*/
-		(iwidth > max_supported_size) ||		/*	it's too big, (make sure it's	*/
-		(iheight > max_supported_size) )		/*	2^n for later down-sampling)	*/
+	/*	create a copy the image data only if needed */
+	if( postprocess_flags )
+	{
+		img = (unsigned char*)soil_malloc( iwidth*iheight*channels );
+		postprocess_image( data, img, iwidth, iheight, channels, postprocess_flags );
+	}
+
+	if( needResize )
 	{
 		int new_width = 1;
 		int new_height = 1;
@@ -1598,7 +1946,7 @@ unsigned int
 		if( (new_width != iwidth) || (new_height != iheight) )
 		{
 			/*	yep, resize	*/
-			unsigned char *resampled = (unsigned char*)malloc( channels*new_width*new_height );
+			unsigned char *resampled = (unsigned char*)soil_malloc( channels*new_width*new_height );
 			up_scale_image(
 					NULL != img ? img : data, iwidth, iheight, channels,
 					resampled, new_width, new_height );
@@ -1630,7 +1978,7 @@ unsigned int
 		}
 		new_width = iwidth / reduce_block_x;
 		new_height = iheight / reduce_block_y;
-		resampled = (unsigned char*)malloc( channels*new_width*new_height );
+		resampled = (unsigned char*)soil_malloc( channels*new_width*new_height );
 		/*	perform the actual reduction	*/
 		mipmap_image( NULL != img ? img : data, iwidth, iheight, channels,
 						resampled, reduce_block_x, reduce_block_y );
@@ -1642,11 +1990,18 @@ unsigned int
 		iwidth = new_width;
 		iheight = new_height;
 	}
-	/*	does the user want us to use YCoCg color space?	*/
-	if( flags & SOIL_FLAG_CoCg_Y )
+	/*	does the user want us to use YCoCg color space? (if it wasn't done above)	*/
+	if( (flags & SOIL_FLAG_CoCg_Y) && !(postprocess_flags & IMAGE_POSTPROCESS_YCOCG) )
 	{
 		/*	this will only work with RGB and RGBA images */
-		convert_RGB_to_YCoCg( img, iwidth, iheight, channels );
+		if( NULL == img )
+		{
+			img = (unsigned char*)soil_malloc( iwidth*iheight*channels );
+			postprocess_image( data, img, iwidth, iheight, channels, IMAGE_POSTPROCESS_YCOCG );
+		} else
+		{
+			postprocess_image( img, img, iwidth, iheight, channels, IMAGE_POSTPROCESS_YCOCG );
+		}
 	}
 	/*	create the OpenGL texture ID handle
 		(note: allowing a forced texture ID lets me reload a texture)	*/
@@ -1862,7 +2217,7 @@ int
 	}
 
 	/*  Get the data from OpenGL	*/
-	pixel_data = (unsigned char*)malloc( 3*width*height );
+	pixel_data = (unsigned char*)soil_malloc( 3*width*height );
 	glReadPixels (x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
 
 	if ( 1 != pack_aligment )
@@ -1893,67 +2248,1059 @@ int
 	return save_result;
 }
 
-unsigned char*
-	SOIL_load_image
-	(
-		const char *filename,
-		int *width, int *height, int *channels,
-		int force_channels
-	)
+/*	asynchronous frame capture	*/
+#define SOIL_PIXEL_PACK_BUFFER				0x88EB
+#define SOIL_PIXEL_PACK_BUFFER_BINDING		0x88ED
+#define SOIL_STREAM_READ					0x88E1
+#define SOIL_READ_ONLY						0x88B8
+#define SOIL_SYNC_GPU_COMMANDS_COMPLETE		0x9117
+#define SOIL_ALREADY_SIGNALED				0x911A
+#define SOIL_CONDITION_SATISFIED			0x911C
+#define SOIL_SYNC_FLUSH_COMMANDS_BIT		0x00000001
+#define SOIL_CAPTURE_DEFAULT_RING			3
+#define SOIL_CAPTURE_MAX_RING				16
+
+typedef void (APIENTRY * P_SOIL_GLGENBUFFERSPROC) (GLsizei n, GLuint *buffers);
+typedef void (APIENTRY * P_SOIL_GLDELETEBUFFERSPROC) (GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY * P_SOIL_GLBINDBUFFERPROC) (GLenum target, GLuint buffer);
+typedef void (APIENTRY * P_SOIL_GLBUFFERDATAPROC) (GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+typedef void *(APIENTRY * P_SOIL_GLMAPBUFFERPROC) (GLenum target, GLenum access);
+typedef GLboolean (APIENTRY * P_SOIL_GLUNMAPBUFFERPROC) (GLenum target);
+typedef void *(APIENTRY * P_SOIL_GLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY * P_SOIL_GLCLIENTWAITSYNCPROC) (void *sync, GLbitfield flags, unsigned long long timeout);
+typedef void (APIENTRY * P_SOIL_GLDELETESYNCPROC) (void *sync);
+
+typedef struct
 {
-	unsigned char *result = stbi_load( filename,
-			width, height, channels, force_channels );
-	if( result == NULL )
-	{
-		result_string_pointer = stbi_failure_reason();
-	} else
-	{
-		result_string_pointer = "Image loaded";
-	}
-	return result;
+	unsigned int pbo;
+	void *fence;
+	int in_use;
+	int width, height;
+	char *filename;
 }
+SOIL_capture_slot;
 
-unsigned char*
-	SOIL_load_image_from_memory
-	(
-		const unsigned char *const buffer,
-		int buffer_length,
-		int *width, int *height, int *channels,
-		int force_channels
-	)
+struct SOIL_capture
 {
-	unsigned char *result = stbi_load_from_memory(
-				buffer, buffer_length,
-				width, height, channels,
-				force_channels );
-	if( result == NULL )
-	{
-		result_string_pointer = stbi_failure_reason();
-	} else
-	{
-		result_string_pointer = "Image loaded from memory";
-	}
-	return result;
-}
+	int image_type;
+	int quality;
+	int ring_size;
+	int next_slot;
+	/*	encodes queued beyond this make SOIL_capture_frame wait	*/
+	int max_queued;
+	soil_thread_pool *encoders;
+	SOIL_capture_slot slots[SOIL_CAPTURE_MAX_RING];
+	/*	NULL if the buffers (or the fences) aren't available	*/
+	P_SOIL_GLGENBUFFERSPROC glGenBuffers;
+	P_SOIL_GLDELETEBUFFERSPROC glDeleteBuffers;
+	P_SOIL_GLBINDBUFFERPROC glBindBuffer;
+	P_SOIL_GLBUFFERDATAPROC glBufferData;
+	P_SOIL_GLMAPBUFFERPROC glMapBuffer;
+	P_SOIL_GLUNMAPBUFFERPROC glUnmapBuffer;
+	P_SOIL_GLFENCESYNCPROC glFenceSync;
+	P_SOIL_GLCLIENTWAITSYNCPROC glClientWaitSync;
+	P_SOIL_GLDELETESYNCPROC glDeleteSync;
+	/*	updated by the encoder threads	*/
+	volatile int frames_saved;
+	volatile int frames_failed;
+	unsigned int frames_captured;
+	unsigned int readback_stalls;
+	unsigned int encoder_stalls;
+};
 
+/*	one frame handed to an encoder: it owns the pixels and the name	*/
+typedef struct
+{
+	SOIL_capture *capture;
+	unsigned char *pixels;
+	int width, height;
+	char *filename;
+}
+SOIL_capture_job;
 
-int
-	SOIL_save_image
-	(
-		const char *filename,
-		int image_type,
-		int width, int height, int channels,
-		const unsigned char *const data
-	)
+/*	runs on an encoder thread: the PNG writer's soil_parallel_for stays
+	on this thread, so the encoders alone decide how many cores saving
+	takes instead of every one of them fanning out to all the cores	*/
+static void SOIL_internal_capture_encode( void *user_data )
 {
-	return SOIL_save_image_quality( filename, image_type, width, height, channels, data, 80 );
+	SOIL_capture_job *job = (SOIL_capture_job*)user_data;
+	int result = SOIL_save_image_quality( job->filename, job->capture->image_type,
+			job->width, job->height, 3, job->pixels, job->capture->quality );
+	soil_atomic_increment( result ? &job->capture->frames_saved : &job->capture->frames_failed );
+	/*	these cross threads, so they never come from the SOIL allocator	*/
+	free( job->pixels );
+	free( job->filename );
+	free( job );
 }
 
-int
-	SOIL_save_image_quality
-	(
-		const char *filename,
-		int image_type,
+/*	copies bottom-up RGBA rows into a top-down RGB image and queues it	*/
+static int SOIL_internal_capture_submit( SOIL_capture *capture, const unsigned char *rgba,
+		int width, int height, char *filename )
+{
+	SOIL_capture_job *job = (SOIL_capture_job*)malloc( sizeof( SOIL_capture_job ) );
+	unsigned char *pixels = (unsigned char*)malloc( (size_t)width * height * 3 );
+	int i, j;
+	if( (NULL == job) || (NULL == pixels) )
+	{
+		free( job );
+		free( pixels );
+		free( filename );
+		soil_atomic_increment( &capture->frames_failed );
+		return 0;
+	}
+	for( j = 0; j < height; ++j )
+	{
+		const unsigned char *src = rgba + (size_t)(height - 1 - j) * width * 4;
+		unsigned char *dst = pixels + (size_t)j * width * 3;
+		for( i = 0; i < width; ++i, src += 4, dst += 3 )
+		{
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+	}
+	job->capture = capture;
+	job->pixels = pixels;
+	job->width = width;
+	job->height = height;
+	job->filename = filename;
+	/*	don't let the queue (and the memory) grow without bounds	*/
+	if( soil_thread_pool_wait( capture->encoders, 0x7FFFFFFF ) >= capture->max_queued )
+	{
+		++capture->encoder_stalls;
+		soil_thread_pool_wait( capture->encoders, capture->max_queued - 1 );
+	}
+	if( !soil_thread_pool_submit( capture->encoders, SOIL_internal_capture_encode, job ) )
+	{
+		free( pixels );
+		free( filename );
+		free( job );
+		soil_atomic_increment( &capture->frames_failed );
+		return 0;
+	}
+	return 1;
+}
+
+/*	maps a finished read back and hands it to the encoders	*/
+static void SOIL_internal_capture_harvest( SOIL_capture *capture, SOIL_capture_slot *slot, int wait )
+{
+	const unsigned char *rgba;
+	if( !slot->in_use )
+	{
+		return;
+	}
+	if( NULL != slot->fence )
+	{
+		GLenum status = capture->glClientWaitSync( slot->fence, 0, 0 );
+		if( (SOIL_ALREADY_SIGNALED != status) && (SOIL_CONDITION_SATISFIED != status) )
+		{
+			if( !wait )
+			{
+				return;
+			}
+			++capture->readback_stalls;
+			capture->glClientWaitSync( slot->fence, SOIL_SYNC_FLUSH_COMMANDS_BIT, (unsigned long long)-1 );
+		}
+		capture->glDeleteSync( slot->fence );
+		slot->fence = NULL;
+	} else
+	if( !wait )
+	{
+		/*	no fences: only pick it up when the ring comes back around	*/
+		return;
+	}
+	capture->glBindBuffer( SOIL_PIXEL_PACK_BUFFER, slot->pbo );
+	rgba = (const unsigned char*)capture->glMapBuffer( SOIL_PIXEL_PACK_BUFFER, SOIL_READ_ONLY );
+	if( NULL != rgba )
+	{
+		SOIL_internal_capture_submit( capture, rgba, slot->width, slot->height, slot->filename );
+		capture->glUnmapBuffer( SOIL_PIXEL_PACK_BUFFER );
+	} else
+	{
+		free( slot->filename );
+		soil_atomic_increment( &capture->frames_failed );
+	}
+	capture->glBindBuffer( SOIL_PIXEL_PACK_BUFFER, 0 );
+	slot->filename = NULL;
+	slot->in_use = 0;
+}
+
+SOIL_capture*
+	SOIL_capture_create
+	(
+		int image_type,
+		int quality,
+		int ring_size,
+		int encoder_threads
+	)
+{
+	SOIL_capture *capture;
+	if( (image_type != SOIL_SAVE_TYPE_TGA) && (image_type != SOIL_SAVE_TYPE_BMP) &&
+		(image_type != SOIL_SAVE_TYPE_PNG) && (image_type != SOIL_SAVE_TYPE_JPG) )
+	{
+		result_string_pointer = "Unsupported capture image type";
+		return NULL;
+	}
+	capture = (SOIL_capture*)calloc( 1, sizeof( SOIL_capture ) );
+	if( NULL == capture )
+	{
+		result_string_pointer = "Out of memory";
+		return NULL;
+	}
+	capture->image_type = image_type;
+	capture->quality = quality;
+	capture->ring_size = ring_size < 1 ? SOIL_CAPTURE_DEFAULT_RING :
+			(ring_size > SOIL_CAPTURE_MAX_RING ? SOIL_CAPTURE_MAX_RING : ring_size);
+	capture->encoders = soil_thread_pool_create( encoder_threads );
+	if( NULL == capture->encoders )
+	{
+		free( capture );
+		result_string_pointer = "Failed to start the capture encoders";
+		return NULL;
+	}
+	capture->max_queued = 2 * (encoder_threads > 0 ? encoder_threads : soil_get_thread_count()) + capture->ring_size;
+#if !defined( SOIL_GLES2 ) && !defined( SOIL_GLES1 )
+	capture->glGenBuffers = (P_SOIL_GLGENBUFFERSPROC)SOIL_GL_GetProcAddress( "glGenBuffers" );
+	capture->glDeleteBuffers = (P_SOIL_GLDELETEBUFFERSPROC)SOIL_GL_GetProcAddress( "glDeleteBuffers" );
+	capture->glBindBuffer = (P_SOIL_GLBINDBUFFERPROC)SOIL_GL_GetProcAddress( "glBindBuffer" );
+	capture->glBufferData = (P_SOIL_GLBUFFERDATAPROC)SOIL_GL_GetProcAddress( "glBufferData" );
+	capture->glMapBuffer = (P_SOIL_GLMAPBUFFERPROC)SOIL_GL_GetProcAddress( "glMapBuffer" );
+	capture->glUnmapBuffer = (P_SOIL_GLUNMAPBUFFERPROC)SOIL_GL_GetProcAddress( "glUnmapBuffer" );
+	if( (NULL == capture->glGenBuffers) || (NULL == capture->glDeleteBuffers) ||
+		(NULL == capture->glBindBuffer) || (NULL == capture->glBufferData) ||
+		(NULL == capture->glMapBuffer) || (NULL == capture->glUnmapBuffer) ||
+		(NULL == SOIL_GL_GetProcAddress( "glGetBufferParameteriv" )) )
+	{
+		capture->glGenBuffers = NULL;
+	} else
+	{
+		int i;
+		unsigned int pbos[SOIL_CAPTURE_MAX_RING];
+		capture->glGenBuffers( capture->ring_size, pbos );
+		for( i = 0; i < capture->ring_size; ++i )
+		{
+			capture->slots[i].pbo = pbos[i];
+		}
+		/*	fences need GL 3.2 or ARB_sync, without them a slot is read one ring later	*/
+		capture->glFenceSync = (P_SOIL_GLFENCESYNCPROC)SOIL_GL_GetProcAddress( "glFenceSync" );
+		capture->glClientWaitSync = (P_SOIL_GLCLIENTWAITSYNCPROC)SOIL_GL_GetProcAddress( "glClientWaitSync" );
+		capture->glDeleteSync = (P_SOIL_GLDELETESYNCPROC)SOIL_GL_GetProcAddress( "glDeleteSync" );
+		if( (NULL == capture->glFenceSync) || (NULL == capture->glClientWaitSync) || (NULL == capture->glDeleteSync) )
+		{
+			capture->glFenceSync = NULL;
+		}
+	}
+#endif
+	result_string_pointer = "Capture started";
+	return capture;
+}
+
+int
+	SOIL_capture_frame
+	(
+		SOIL_capture *capture,
+		const char *filename,
+		int x, int y,
+		int width, int height
+	)
+{
+	SOIL_capture_slot *slot;
+	GLint pack_aligment;
+	char *name;
+	size_t name_length;
+	int i;
+
+	/*	error checks	*/
+	if( (NULL == capture) || (NULL == filename) )
+	{
+		result_string_pointer = "Invalid capture or filename";
+		return 0;
+	}
+	if( (width < 1) || (height < 1) || (x < 0) || (y < 0) )
+	{
+		result_string_pointer = "Invalid capture area";
+		return 0;
+	}
+	name_length = strlen( filename ) + 1;
+	name = (char*)malloc( name_length );
+	if( NULL == name )
+	{
+		result_string_pointer = "Out of memory";
+		return 0;
+	}
+	memcpy( name, filename, name_length );
+	++capture->frames_captured;
+
+	glGetIntegerv( GL_PACK_ALIGNMENT, &pack_aligment );
+	if( 4 != pack_aligment )
+	{
+		glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+	}
+
+	if( NULL == capture->glGenBuffers )
+	{
+		/*	no PBOs, read it now, encode it later	*/
+		unsigned char *rgba = (unsigned char*)malloc( (size_t)width * height * 4 );
+		int result = 0;
+		if( NULL != rgba )
+		{
+			glReadPixels( x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba );
+			result = SOIL_internal_capture_submit( capture, rgba, width, height, name );
+			free( rgba );
+		} else
+		{
+			free( name );
+		}
+		if( 4 != pack_aligment )
+		{
+			glPixelStorei( GL_PACK_ALIGNMENT, pack_aligment );
+		}
+		result_string_pointer = result ? "Frame captured" : "Frame capture failed";
+		return result;
+	}
+
+	/*	the buffer we want may still hold an older frame	*/
+	slot = &capture->slots[capture->next_slot];
+	capture->next_slot = (capture->next_slot + 1) % capture->ring_size;
+	{
+		GLint previous_pack_buffer = 0;
+		glGetIntegerv( SOIL_PIXEL_PACK_BUFFER_BINDING, &previous_pack_buffer );
+		SOIL_internal_capture_harvest( capture, slot, 1 );
+
+		/*	start the read back into the buffer, it returns right away	*/
+		capture->glBindBuffer( SOIL_PIXEL_PACK_BUFFER, slot->pbo );
+		if( (slot->width != width) || (slot->height != height) )
+		{
+			capture->glBufferData( SOIL_PIXEL_PACK_BUFFER, (ptrdiff_t)width * height * 4, NULL, SOIL_STREAM_READ );
+		}
+		glReadPixels( x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)0 );
+		slot->width = width;
+		slot->height = height;
+		slot->filename = name;
+		slot->in_use = 1;
+		if( NULL != capture->glFenceSync )
+		{
+			slot->fence = capture->glFenceSync( SOIL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		}
+		check_for_GL_errors( "glReadPixels" );
+
+		/*	and pick up whatever older frames the GPU is done with	*/
+		if( NULL != capture->glFenceSync )
+		{
+			for( i = 1; i < capture->ring_size; ++i )
+			{
+				SOIL_internal_capture_harvest( capture,
+						&capture->slots[(capture->next_slot + i - 1) % capture->ring_size], 0 );
+			}
+		}
+		capture->glBindBuffer( SOIL_PIXEL_PACK_BUFFER, (GLuint)previous_pack_buffer );
+	}
+
+	if( 4 != pack_aligment )
+	{
+		glPixelStorei( GL_PACK_ALIGNMENT, pack_aligment );
+	}
+	result_string_pointer = "Frame captured";
+	return 1;
+}
+
+int
+	SOIL_capture_flush
+	(
+		SOIL_capture *capture
+	)
+{
+	int i;
+	if( NULL == capture )
+	{
+		return 0;
+	}
+	if( NULL != capture->glGenBuffers )
+	{
+		GLint previous_pack_buffer = 0;
+		glGetIntegerv( SOIL_PIXEL_PACK_BUFFER_BINDING, &previous_pack_buffer );
+		/*	oldest first	*/
+		for( i = 0; i < capture->ring_size; ++i )
+		{
+			SOIL_internal_capture_harvest( capture,
+					&capture->slots[(capture->next_slot + i) % capture->ring_size], 1 );
+		}
+		capture->glBindBuffer( SOIL_PIXEL_PACK_BUFFER, (GLuint)previous_pack_buffer );
+	}
+	soil_thread_pool_wait( capture->encoders, 0 );
+	return 0 == capture->frames_failed;
+}
+
+void
+	SOIL_capture_get_stats
+	(
+		const SOIL_capture *capture,
+		SOIL_capture_stats *stats
+	)
+{
+	if( (NULL == capture) || (NULL == stats) )
+	{
+		return;
+	}
+	stats->frames_captured = capture->frames_captured;
+	stats->frames_saved = (unsigned int)capture->frames_saved;
+	stats->frames_failed = (unsigned int)capture->frames_failed;
+	stats->readback_stalls = capture->readback_stalls;
+	stats->encoder_stalls = capture->encoder_stalls;
+}
+
+void
+	SOIL_capture_destroy
+	(
+		SOIL_capture *capture
+	)
+{
+	if( NULL == capture )
+	{
+		return;
+	}
+	SOIL_capture_flush( capture );
+	soil_thread_pool_destroy( capture->encoders );
+	if( NULL != capture->glGenBuffers )
+	{
+		int i;
+		unsigned int pbos[SOIL_CAPTURE_MAX_RING];
+		for( i = 0; i < capture->ring_size; ++i )
+		{
+			pbos[i] = capture->slots[i].pbo;
+		}
+		capture->glDeleteBuffers( capture->ring_size, pbos );
+	}
+	free( capture );
+}
+
+void
+	SOIL_context_init
+	(
+		SOIL_context *ctx
+	)
+{
+	if( NULL != ctx )
+	{
+		memset( ctx, 0, sizeof( SOIL_context ) );
+		ctx->result = SOIL_RESULT_OK;
+		ctx->result_string = "SOIL context initialized";
+	}
+}
+
+void
+	SOIL_free_image_data_ctx
+	(
+		SOIL_context *ctx,
+		unsigned char *img_data
+	)
+{
+	const SOIL_allocator *previous = soil_push_allocator( NULL != ctx ? ctx->allocator : NULL );
+	soil_free( img_data );
+	soil_pop_allocator( previous );
+}
+
+/*	the context used by the legacy API: stb's process wide options apply	*/
+static void SOIL_internal_legacy_context( SOIL_context *ctx )
+{
+	SOIL_context_init( ctx );
+	ctx->flip_vertically = SOIL_OPTION_DEFAULT;
+	ctx->unpremultiply_alpha = SOIL_OPTION_DEFAULT;
+	ctx->convert_iphone_png = SOIL_OPTION_DEFAULT;
+	ctx->jpeg_scale = SOIL_OPTION_DEFAULT;
+}
+
+static void SOIL_internal_set_result( SOIL_context *ctx, int result, const char *result_string )
+{
+	ctx->result = result;
+	ctx->result_string = result_string;
+}
+
+/*	stb only gives us a string, sort it into a result code	*/
+static void SOIL_internal_set_stbi_failure( SOIL_context *ctx )
+{
+	const char *reason = stbi_failure_reason();
+	int result = SOIL_RESULT_DECODE_FAILED;
+	if( NULL == reason )
+	{
+		reason = "Unknown error";
+	} else
+	if( 0 == strcmp( reason, "can't fopen" ) )
+	{
+		result = SOIL_RESULT_FILE_NOT_FOUND;
+	} else
+	if( 0 == strcmp( reason, "outofmem" ) )
+	{
+		result = SOIL_RESULT_OUT_OF_MEMORY;
+	} else
+	if( 0 == strcmp( reason, "unknown image type" ) )
+	{
+		result = SOIL_RESULT_UNKNOWN_FORMAT;
+	}
+	SOIL_internal_set_result( ctx, result, reason );
+}
+
+/*	stb's per-thread options and the allocator, set for the length of one call	*/
+typedef struct
+{
+	const SOIL_allocator *allocator;
+	int flip_set, flip;
+	int unpremultiply_set, unpremultiply;
+	int iphone_set, iphone;
+	int jpeg_scale_set, jpeg_scale;
+}
+SOIL_internal_stbi_options;
+
+/*	fails (and sets the result) when an option can't be honoured: without
+	thread locals stb only has its process wide options, and changing
+	those would race with other threads	*/
+static int SOIL_internal_push_options( SOIL_context *ctx, SOIL_internal_stbi_options *saved )
+{
+#ifndef STBI_THREAD_LOCAL
+	if( ((ctx->flip_vertically != SOIL_OPTION_DEFAULT) &&
+			(!ctx->flip_vertically != !stbi__vertically_flip_on_load))
+#ifndef STBI_NO_JPEG
+		|| ((ctx->jpeg_scale != SOIL_OPTION_DEFAULT) &&
+			(ctx->jpeg_scale != stbi__jpeg_scale_on_load))
+#endif
+#ifndef STBI_NO_PNG
+		|| ((ctx->unpremultiply_alpha != SOIL_OPTION_DEFAULT) &&
+			(!ctx->unpremultiply_alpha != !stbi__unpremultiply_on_load))
+		|| ((ctx->convert_iphone_png != SOIL_OPTION_DEFAULT) &&
+			(!ctx->convert_iphone_png != !stbi__de_iphone_flag))
+#endif
+		)
+	{
+		SOIL_internal_set_result( ctx, SOIL_RESULT_INVALID_ARGUMENT,
+				"Per call options need thread local storage" );
+		return 0;
+	}
+#endif
+	saved->allocator = soil_push_allocator( ctx->allocator );
+#ifdef STBI_THREAD_LOCAL
+	saved->flip_set = stbi__vertically_flip_on_load_set;
+	saved->flip = stbi__vertically_flip_on_load_local;
+#ifndef STBI_NO_PNG
+	saved->unpremultiply_set = stbi__unpremultiply_on_load_set;
+	saved->unpremultiply = stbi__unpremultiply_on_load_local;
+	saved->iphone_set = stbi__de_iphone_flag_set;
+	saved->iphone = stbi__de_iphone_flag_local;
+#endif
+#ifndef STBI_NO_JPEG
+	saved->jpeg_scale_set = stbi__jpeg_scale_on_load_set;
+	saved->jpeg_scale = stbi__jpeg_scale_on_load_local;
+#endif
+	if( ctx->flip_vertically != SOIL_OPTION_DEFAULT )
+	{
+		stbi_set_flip_vertically_on_load_thread( ctx->flip_vertically );
+	}
+#ifndef STBI_NO_JPEG
+	if( ctx->jpeg_scale != SOIL_OPTION_DEFAULT )
+	{
+		stbi_set_jpeg_scale_on_load_thread( ctx->jpeg_scale );
+	}
+#endif
+#ifndef STBI_NO_PNG
+	if( ctx->unpremultiply_alpha != SOIL_OPTION_DEFAULT )
+	{
+		stbi_set_unpremultiply_on_load_thread( ctx->unpremultiply_alpha );
+	}
+	if( ctx->convert_iphone_png != SOIL_OPTION_DEFAULT )
+	{
+		stbi_convert_iphone_png_to_rgb_thread( ctx->convert_iphone_png );
+	}
+#endif
+#endif
+	return 1;
+}
+
+static void SOIL_internal_pop_options( const SOIL_internal_stbi_options *saved )
+{
+	soil_pop_allocator( saved->allocator );
+#ifdef STBI_THREAD_LOCAL
+	stbi__vertically_flip_on_load_set = saved->flip_set;
+	stbi__vertically_flip_on_load_local = saved->flip;
+#ifndef STBI_NO_JPEG
+	stbi__jpeg_scale_on_load_set = saved->jpeg_scale_set;
+	stbi__jpeg_scale_on_load_local = saved->jpeg_scale;
+#endif
+#ifndef STBI_NO_PNG
+	stbi__unpremultiply_on_load_set = saved->unpremultiply_set;
+	stbi__unpremultiply_on_load_local = saved->unpremultiply;
+	stbi__de_iphone_flag_set = saved->iphone_set;
+	stbi__de_iphone_flag_local = saved->iphone;
+#endif
+#endif
+}
+
+unsigned char*
+	SOIL_load_image_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels
+	)
+{
+	SOIL_internal_stbi_options saved;
+	unsigned char *result;
+	if( NULL == ctx )
+	{
+		return NULL;
+	}
+	/*	channels may be NULL, as with stb	*/
+	if( (NULL == buffer) || (buffer_length <= 0) ||
+		(NULL == width) || (NULL == height) )
+	{
+		SOIL_internal_set_result( ctx, SOIL_RESULT_INVALID_ARGUMENT, "Invalid argument" );
+		return NULL;
+	}
+	if( !SOIL_internal_push_options( ctx, &saved ) )
+	{
+		return NULL;
+	}
+	result = stbi_load_from_memory(
+				buffer, buffer_length,
+				width, height, channels,
+				force_channels );
+	SOIL_internal_pop_options( &saved );
+	if( result == NULL )
+	{
+		SOIL_internal_set_stbi_failure( ctx );
+	} else
+	{
+		SOIL_internal_set_result( ctx, SOIL_RESULT_OK, "Image loaded" );
+	}
+	return result;
+}
+
+unsigned char*
+	SOIL_load_image_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels
+	)
+{
+	SOIL_internal_stbi_options saved;
+	unsigned char *result;
+	soil_mapped_file file;
+	if( NULL == ctx )
+	{
+		return NULL;
+	}
+	if( NULL == filename )
+	{
+		SOIL_internal_set_result( ctx, SOIL_RESULT_INVALID_ARGUMENT, "NULL filename" );
+		return NULL;
+	}
+	/*	the file buffer comes from the context's allocator too	*/
+	if( !SOIL_internal_push_options( ctx, &saved ) )
+	{
+		return NULL;
+	}
+	if( !soil_map_file( filename, &file ) )
+	{
+		SOIL_internal_pop_options( &saved );
+		SOIL_internal_set_result( ctx, SOIL_RESULT_FILE_NOT_FOUND, "can't fopen" );
+		return NULL;
+	}
+	/*	decode straight from the mapped file, stb can only take int sizes	*/
+	if( file.size <= 0x7FFFFFFF )
+	{
+		result = SOIL_load_image_from_memory_ctx( ctx, file.data, (int)file.size,
+				width, height, channels, force_channels );
+		soil_unmap_file( &file );
+	} else
+	{
+		soil_unmap_file( &file );
+		result = stbi_load( filename,
+				width, height, channels, force_channels );
+		if( result == NULL )
+		{
+			SOIL_internal_set_stbi_failure( ctx );
+		} else
+		{
+			SOIL_internal_set_result( ctx, SOIL_RESULT_OK, "Image loaded" );
+		}
+	}
+	SOIL_internal_pop_options( &saved );
+	return result;
+}
+
+unsigned char*
+	SOIL_load_image
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels
+	)
+{
+	SOIL_context ctx;
+	unsigned char *result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_load_image_ctx( &ctx, filename,
+			width, height, channels, force_channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+unsigned char*
+	SOIL_load_image_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels
+	)
+{
+	SOIL_context ctx;
+	unsigned char *result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_load_image_from_memory_ctx( &ctx, buffer, buffer_length,
+			width, height, channels, force_channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+/*	the JPEG scale of the SOIL_FLAG_JPEG_SCALE_* flags	*/
+static int SOIL_internal_jpeg_scale( unsigned int flags )
+{
+	if( flags & SOIL_FLAG_JPEG_SCALE_1_8 )
+	{
+		return 3;
+	}
+	if( flags & SOIL_FLAG_JPEG_SCALE_1_4 )
+	{
+		return 2;
+	}
+	if( flags & SOIL_FLAG_JPEG_SCALE_1_2 )
+	{
+		return 1;
+	}
+	return SOIL_OPTION_DEFAULT;
+}
+
+static unsigned char*
+	SOIL_internal_load_image
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned int flags
+	)
+{
+	SOIL_context ctx;
+	unsigned char *result;
+	SOIL_internal_legacy_context( &ctx );
+	ctx.jpeg_scale = SOIL_internal_jpeg_scale( flags );
+	result = SOIL_load_image_ctx( &ctx, filename,
+			width, height, channels, force_channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+static unsigned char*
+	SOIL_internal_load_image_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned int flags
+	)
+{
+	SOIL_context ctx;
+	unsigned char *result;
+	SOIL_internal_legacy_context( &ctx );
+	ctx.jpeg_scale = SOIL_internal_jpeg_scale( flags );
+	result = SOIL_load_image_from_memory_ctx( &ctx, buffer, buffer_length,
+			width, height, channels, force_channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+int
+	SOIL_image_info_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels
+	)
+{
+	SOIL_internal_stbi_options saved;
+	int ok;
+	if( NULL == ctx )
+	{
+		return 0;
+	}
+	if( NULL == filename )
+	{
+		SOIL_internal_set_result( ctx, SOIL_RESULT_INVALID_ARGUMENT, "NULL filename" );
+		return 0;
+	}
+	/*	stb only reads the header, the options still matter: JPEG scaling changes the size	*/
+	if( !SOIL_internal_push_options( ctx, &saved ) )
+	{
+		return 0;
+	}
+	ok = stbi_info( filename, width, height, channels );
+	SOIL_internal_pop_options( &saved );
+	if( !ok )
+	{
+		SOIL_internal_set_stbi_failure( ctx );
+		return 0;
+	}
+	SOIL_internal_set_result( ctx, SOIL_RESULT_OK, "Image header read" );
+	return 1;
+}
+
+int
+	SOIL_image_info_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	)
+{
+	SOIL_internal_stbi_options saved;
+	int ok;
+	if( NULL == ctx )
+	{
+		return 0;
+	}
+	if( !SOIL_internal_push_options( ctx, &saved ) )
+	{
+		return 0;
+	}
+	ok = stbi_info_from_memory( buffer, buffer_length, width, height, channels );
+	SOIL_internal_pop_options( &saved );
+	if( !ok )
+	{
+		SOIL_internal_set_stbi_failure( ctx );
+		return 0;
+	}
+	SOIL_internal_set_result( ctx, SOIL_RESULT_OK, "Image header read" );
+	return 1;
+}
+
+int
+	SOIL_image_info
+	(
+		const char *filename,
+		int *width, int *height, int *channels
+	)
+{
+	SOIL_context ctx;
+	int result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_image_info_ctx( &ctx, filename, width, height, channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+int
+	SOIL_image_info_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	)
+{
+	SOIL_context ctx;
+	int result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_image_info_from_memory_ctx( &ctx, buffer, buffer_length, width, height, channels );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+/*	copies a decoded image into the caller's buffer, row by row	*/
+static int
+	SOIL_internal_copy_into
+	(
+		SOIL_context *ctx,
+		unsigned char *img,
+		int width, int height, int channels,
+		unsigned char *dest, int dest_stride, int dest_size
+	)
+{
+	const size_t row_size = (size_t)width * channels;
+	int j;
+	if( NULL == img )
+	{
+		return 0;
+	}
+	if( dest_stride <= 0 )
+	{
+		dest_stride = (int)row_size;
+	}
+	if( (NULL == dest) || ((size_t)dest_stride < row_size) ||
+		((size_t)dest_stride * (height - 1) + row_size > (size_t)dest_size) )
+	{
+		SOIL_free_image_data_ctx( ctx, img );
+		SOIL_internal_set_result( ctx, SOIL_RESULT_BUFFER_TOO_SMALL, "Destination buffer is too small for the image" );
+		return 0;
+	}
+	if( (size_t)dest_stride == row_size )
+	{
+		memcpy( dest, img, row_size * height );
+	} else
+	{
+		for( j = 0; j < height; ++j )
+		{
+			memcpy( dest + (size_t)j * dest_stride, img + j * row_size, row_size );
+		}
+	}
+	SOIL_free_image_data_ctx( ctx, img );
+	SOIL_internal_set_result( ctx, SOIL_RESULT_OK, "Image loaded" );
+	return 1;
+}
+
+int
+	SOIL_load_image_into_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	)
+{
+	int img_channels;
+	unsigned char *img;
+	if( NULL == channels )
+	{
+		channels = &img_channels;
+	}
+	img = SOIL_load_image_ctx( ctx, filename, width, height, channels, force_channels );
+	return SOIL_internal_copy_into( ctx, img, *width, *height,
+			(force_channels >= 1) && (force_channels <= 4) ? force_channels : *channels,
+			dest, dest_stride, dest_size );
+}
+
+int
+	SOIL_load_image_into_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	)
+{
+	int img_channels;
+	unsigned char *img;
+	if( NULL == channels )
+	{
+		channels = &img_channels;
+	}
+	img = SOIL_load_image_from_memory_ctx( ctx, buffer, buffer_length,
+			width, height, channels, force_channels );
+	return SOIL_internal_copy_into( ctx, img, *width, *height,
+			(force_channels >= 1) && (force_channels <= 4) ? force_channels : *channels,
+			dest, dest_stride, dest_size );
+}
+
+int
+	SOIL_load_image_into
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	)
+{
+	SOIL_context ctx;
+	int result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_load_image_into_ctx( &ctx, filename, width, height, channels,
+			force_channels, dest, dest_stride, dest_size );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+int
+	SOIL_load_image_into_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	)
+{
+	SOIL_context ctx;
+	int result;
+	SOIL_internal_legacy_context( &ctx );
+	result = SOIL_load_image_into_from_memory_ctx( &ctx, buffer, buffer_length, width, height, channels,
+			force_channels, dest, dest_stride, dest_size );
+	result_string_pointer = ctx.result_string;
+	return result;
+}
+
+
+int
+	SOIL_save_image
+	(
+		const char *filename,
+		int image_type,
+		int width, int height, int channels,
+		const unsigned char *const data
+	)
+{
+	return SOIL_save_image_quality( filename, image_type, width, height, channels, data, 80 );
+}
+
+int
+	SOIL_save_PNG_image
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data,
+		int compression_level
+	)
+{
+	int save_result;
+
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(data == NULL) ||
+		(filename == NULL) )
+	{
+		return 0;
+	}
+	/*	the level goes with the call, stb's global one is never touched	*/
+	save_result = stbi_write_png_level( filename,
+			width, height, channels, (const unsigned char *const)data, 0, compression_level );
+	if( save_result == 0 )
+	{
+		result_string_pointer = "Saving the image failed";
+	} else
+	{
+		result_string_pointer = "Image saved";
+	}
+	return save_result;
+}
+
+int
+	SOIL_save_image_quality
+	(
+		const char *filename,
+		int image_type,
 		int width, int height, int channels,
 		const unsigned char *const data,
 		int quality
@@ -2008,6 +3355,105 @@ int
 	return save_result;
 }
 
+int
+	SOIL_save_HDR_image
+	(
+		const char *filename,
+		int image_type,
+		int width, int height, int channels,
+		const float *const data
+	)
+{
+	int save_result;
+
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(data == NULL) ||
+		(filename == NULL) )
+	{
+		return 0;
+	}
+	if( image_type == SOIL_SAVE_TYPE_HDR )
+	{
+		save_result = stbi_write_hdr( filename,
+				width, height, channels, data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS )
+	{
+		save_result = save_image_as_DDS_BC6H( filename,
+				width, height, channels, &data, 1 );
+	} else
+	{
+		save_result = 0;
+	}
+
+	if( save_result == 0 )
+	{
+		result_string_pointer = "Saving the HDR image failed";
+	} else
+	{
+		result_string_pointer = "HDR image saved";
+	}
+	return save_result;
+}
+
+int
+	SOIL_save_HDR_cubemap_as_DDS
+	(
+		const char *filename,
+		const char *x_pos_file,
+		const char *x_neg_file,
+		const char *y_pos_file,
+		const char *y_neg_file,
+		const char *z_pos_file,
+		const char *z_neg_file
+	)
+{
+	const char *files[6];
+	float *faces[6];
+	int width = 0, height = 0, channels;
+	int i, save_result = 1;
+
+	files[0] = x_pos_file; files[1] = x_neg_file;
+	files[2] = y_pos_file; files[3] = y_neg_file;
+	files[4] = z_pos_file; files[5] = z_neg_file;
+	memset( faces, 0, sizeof( faces ) );
+	for( i = 0; (i < 6) && save_result; ++i )
+	{
+		int w, h;
+		faces[i] = stbi_loadf( files[i], &w, &h, &channels, 3 );
+		if( NULL == faces[i] )
+		{
+			result_string_pointer = stbi_failure_reason();
+			save_result = 0;
+		} else
+		if( w != h )
+		{
+			result_string_pointer = "Cubemap faces must be square";
+			save_result = 0;
+		} else
+		if( (i > 0) && ((w != width) || (h != height)) )
+		{
+			result_string_pointer = "Cubemap faces must all be the same size";
+			save_result = 0;
+		}
+		width = w;
+		height = h;
+	}
+	if( save_result )
+	{
+		save_result = save_image_as_DDS_BC6H( filename, width, height, 3,
+				(const float *const *)faces, 6 );
+		result_string_pointer = save_result ? "HDR cubemap saved" : "Saving the HDR cubemap failed";
+	}
+	for( i = 0; i < 6; ++i )
+	{
+		soil_free( faces[i] );
+	}
+	return save_result;
+}
+
 void
 	SOIL_free_image_data
 	(
@@ -2015,7 +3461,7 @@ void
 	)
 {
 	if ( img_data )
-		free( (void*)img_data );
+		soil_free( (void*)img_data );
 }
 
 const char*
@@ -2036,6 +3482,7 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 {
 
 	DDS_header header;
+	DDS_header_DXT10 header10;
 	unsigned int buffer_index = 0;
 	unsigned int tex_ID = 0;
 
@@ -2091,14 +3538,27 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 		DXT3 = ( 'D' << 0 ) | ( 'X' << 8 ) | ( 'T' << 16 ) | ( '3' << 24 ),
 		DXT5 = ( 'D' << 0 ) | ( 'X' << 8 ) | ( 'T' << 16 ) | ( '5' << 24 ),
 		ATI2 = ( 'A' << 0 ) | ( 'T' << 8 ) | ( 'I' << 16 ) | ( '2' << 24 ),
+		DX10 = ( 'D' << 0 ) | ( 'X' << 8 ) | ( '1' << 16 ) | ( '0' << 24 ),
 	};
 
 	/*	make sure it is a type we can upload	*/
 	if( ( header.sPixelFormat.dwFlags & DDPF_FOURCC ) &&
 	    !( header.sPixelFormat.dwFourCC == DXT1 || header.sPixelFormat.dwFourCC == DXT3 ||
-	       header.sPixelFormat.dwFourCC == DXT5 || header.sPixelFormat.dwFourCC == ATI2 ) )
+	       header.sPixelFormat.dwFourCC == DXT5 || header.sPixelFormat.dwFourCC == ATI2 ||
+	       header.sPixelFormat.dwFourCC == DX10 ) )
 	{ goto quick_exit; }
 
+	/*	the DX10 extended header, only BC6H is supported	*/
+	memset( &header10, 0, sizeof( DDS_header_DXT10 ) );
+	if( ( header.sPixelFormat.dwFlags & DDPF_FOURCC ) && header.sPixelFormat.dwFourCC == DX10 )
+	{
+		if( buffer_length < (int)( sizeof( DDS_header ) + sizeof( DDS_header_DXT10 ) ) ) { goto quick_exit; }
+		memcpy( (void *)( &header10 ), (const void *)( &buffer[buffer_index] ), sizeof( DDS_header_DXT10 ) );
+		buffer_index += sizeof( DDS_header_DXT10 );
+		if( header10.dxgiFormat != DXGI_FORMAT_BC6H_UF16 && header10.dxgiFormat != DXGI_FORMAT_BC6H_SF16 ) { goto quick_exit; }
+		if( header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE ) { header.sCaps.dwCaps2 |= DDSCAPS2_CUBEMAP; }
+	}
+
 	/*	OK, validated the header, let's load the image data	*/
 	result_string_pointer = "DDS header loaded and validated";
 	const int width = header.dwWidth;
@@ -2177,6 +3637,15 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 				return 0;
 			}
 		}
+		else if( header.sPixelFormat.dwFourCC == DX10 )
+		{
+			if( query_BPTC_capability() != SOIL_CAPABILITY_PRESENT )
+			{
+				/*	we can't do it!	*/
+				result_string_pointer = "Direct upload of BC6H images not supported by the OpenGL driver";
+				return 0;
+			}
+		}
 		else
 		{
 			if( query_DXT_capability() != SOIL_CAPABILITY_PRESENT )
@@ -2205,6 +3674,11 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			block_size = 16;
 			internal_format = SOIL_COMPRESSED_RG_RGTC2;
 			break;
+		case DX10:
+			block_size = 16;
+			internal_format = header10.dxgiFormat == DXGI_FORMAT_BC6H_SF16 ?
+				SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT : SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+			break;
 		}
 		DDS_main_size = ( ( width + 3 ) >> 2 ) * ( ( height + 3 ) >> 2 ) * block_size;
 	}
@@ -2270,7 +3744,9 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 		mipmaps = 0;
 		DDS_full_size = DDS_main_size;
 	}
-	DDS_data = (unsigned char *)malloc( DDS_full_size );
+	/*	compressed data is uploaded straight from the buffer, only
+		uncompressed data may need swizzling in a copy	*/
+	DDS_data = uncompressed ? (unsigned char *)soil_malloc( DDS_full_size ) : NULL;
 	/*	got the image data RAM, create or use an existing OpenGL texture handle	*/
 	tex_ID = reuse_texture_ID;
 	if( tex_ID == 0 ) { glGenTextures( 1, &tex_ID ); }
@@ -2282,7 +3758,14 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 		if( buffer_index + DDS_full_size <= (unsigned int)buffer_length )
 		{
 			unsigned int byte_offset = DDS_main_size;
-			memcpy( (void *)DDS_data, (const void *)( &buffer[buffer_index] ), DDS_full_size );
+			if( uncompressed )
+			{
+				memcpy( (void *)DDS_data, (const void *)( &buffer[buffer_index] ), DDS_full_size );
+			}
+			else
+			{
+				DDS_data = (unsigned char *)&buffer[buffer_index];
+			}
 			buffer_index += DDS_full_size;
 			/*	upload the main chunk	*/
 			if( uncompressed )
@@ -2373,7 +3856,10 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			result_string_pointer = "DDS file was too small for expected image data";
 		}
 	} /* end reading each face */
-	SOIL_free_image_data( DDS_data );
+	if( uncompressed )
+	{
+		SOIL_free_image_data( DDS_data );
+	}
 	if( tex_ID )
 	{
 		/*	did I have MIPmaps?	*/
@@ -2407,6 +3893,7 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	}
 
 quick_exit:
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -2416,9 +3903,7 @@ unsigned int SOIL_direct_load_DDS(
 		int flags,
 		int loading_as_cubemap )
 {
-	FILE *f;
-	unsigned char *buffer;
-	size_t buffer_length, bytes_read;
+	soil_mapped_file file;
 	unsigned int tex_ID = 0;
 	/*	error checks	*/
 	if( NULL == filename )
@@ -2426,35 +3911,25 @@ unsigned int SOIL_direct_load_DDS(
 		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	f = fopen( filename, "rb" );
-	if( NULL == f )
+	/*	map the file, the upload reads it in place	*/
+	if( !soil_map_file( filename, &file ) )
 	{
 		/*	the file doesn't seem to exist (or be open-able)	*/
 		result_string_pointer = "Can not find DDS file";
 		return 0;
 	}
-	fseek( f, 0, SEEK_END );
-	buffer_length = ftell( f );
-	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
-	if( NULL == buffer )
+	if( file.size > 0x7FFFFFFF )
 	{
-		result_string_pointer = "malloc failed";
-		fclose( f );
+		soil_unmap_file( &file );
+		result_string_pointer = "DDS file is too large";
 		return 0;
 	}
-	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
-	fclose( f );
-	if( bytes_read < buffer_length )
-	{
-		/*	huh?	*/
-		buffer_length = bytes_read;
-	}
 	/*	now try to do the loading	*/
 	tex_ID = SOIL_direct_load_DDS_from_memory(
-		(const unsigned char *const)buffer, (int)buffer_length,
+		file.data, (int)file.size,
 		reuse_texture_ID, flags, loading_as_cubemap );
-	SOIL_free_image_data( buffer );
+	soil_unmap_file( &file );
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -2724,6 +4199,7 @@ unsigned int SOIL_direct_load_PVR_from_memory(
 		}
 	}
 
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -2733,9 +4209,7 @@ unsigned int SOIL_direct_load_PVR(
 		int flags,
 		int loading_as_cubemap )
 {
-	FILE *f;
-	unsigned char *buffer;
-	size_t buffer_length, bytes_read;
+	soil_mapped_file file;
 	unsigned int tex_ID = 0;
 	/*	error checks	*/
 	if( NULL == filename )
@@ -2743,35 +4217,25 @@ unsigned int SOIL_direct_load_PVR(
 		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	f = fopen( filename, "rb" );
-	if( NULL == f )
+	/*	map the file, the upload reads it in place	*/
+	if( !soil_map_file( filename, &file ) )
 	{
 		/*	the file doesn't seem to exist (or be open-able)	*/
 		result_string_pointer = "Can not find PVR file";
 		return 0;
 	}
-	fseek( f, 0, SEEK_END );
-	buffer_length = ftell( f );
-	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
-	if( NULL == buffer )
+	if( file.size > 0x7FFFFFFF )
 	{
-		result_string_pointer = "malloc failed";
-		fclose( f );
+		soil_unmap_file( &file );
+		result_string_pointer = "PVR file is too large";
 		return 0;
 	}
-	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
-	fclose( f );
-	if( bytes_read < buffer_length )
-	{
-		/*	huh?	*/
-		buffer_length = bytes_read;
-	}
 	/*	now try to do the loading	*/
 	tex_ID = SOIL_direct_load_PVR_from_memory(
-		(const unsigned char *const)buffer, (int)buffer_length,
+		file.data, (int)file.size,
 		reuse_texture_ID, flags, loading_as_cubemap );
-	SOIL_free_image_data( buffer );
+	soil_unmap_file( &file );
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -2795,7 +4259,7 @@ unsigned int SOIL_direct_load_ETC1_from_memory(
 		return 0;
 	}
 
-	if ( 0 != strcmp( header->aName, "PKM 10" ) ) {
+	if ( 0 != memcmp( header->aName, "PKM 10", 6 ) ) {
 		result_string_pointer = "error: PKM 10 header not found.";
 		return 0;
 	}
@@ -2863,6 +4327,7 @@ unsigned int SOIL_direct_load_ETC1_from_memory(
 		}
 	}
 
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -2870,9 +4335,7 @@ unsigned int SOIL_direct_load_ETC1(const char *filename,
 		unsigned int reuse_texture_ID,
 		int flags )
 {
-	FILE *f;
-	unsigned char *buffer;
-	size_t buffer_length, bytes_read;
+	soil_mapped_file file;
 	unsigned int tex_ID = 0;
 	/*	error checks	*/
 	if( NULL == filename )
@@ -2880,35 +4343,25 @@ unsigned int SOIL_direct_load_ETC1(const char *filename,
 		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	f = fopen( filename, "rb" );
-	if( NULL == f )
+	/*	map the file, the upload reads it in place	*/
+	if( !soil_map_file( filename, &file ) )
 	{
 		/*	the file doesn't seem to exist (or be open-able)	*/
-		result_string_pointer = "Can not find PVR file";
+		result_string_pointer = "Can not find PKM file";
 		return 0;
 	}
-	fseek( f, 0, SEEK_END );
-	buffer_length = ftell( f );
-	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
-	if( NULL == buffer )
+	if( file.size > 0x7FFFFFFF )
 	{
-		result_string_pointer = "malloc failed";
-		fclose( f );
+		soil_unmap_file( &file );
+		result_string_pointer = "ETC1 file is too large";
 		return 0;
 	}
-	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
-	fclose( f );
-	if( bytes_read < buffer_length )
-	{
-		/*	huh?	*/
-		buffer_length = bytes_read;
-	}
 	/*	now try to do the loading	*/
 	tex_ID = SOIL_direct_load_ETC1_from_memory(
-		(const unsigned char *const)buffer, (int)buffer_length,
+		file.data, (int)file.size,
 		reuse_texture_ID, flags );
-	SOIL_free_image_data( buffer );
+	soil_unmap_file( &file );
+	soil_allocator_upload_done();
 	return tex_ID;
 }
 
@@ -3177,6 +4630,70 @@ int query_ETC1_capability( void )
 	return has_ETC1_capability;
 }
 
+int query_BPTC_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_BPTC_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	we haven't yet checked for the capability, do so	*/
+		if( 0 == SOIL_GL_ExtensionSupported(
+				"GL_ARB_texture_compression_bptc" ) &&
+			0 == SOIL_GL_ExtensionSupported(
+				"GL_EXT_texture_compression_bptc" ) )
+		{
+			/*	not there, flag the failure	*/
+			has_BPTC_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			if ( NULL == soilGlCompressedTexImage2D ) {
+				soilGlCompressedTexImage2D = get_glCompressedTexImage2D_addr();
+			}
+
+			/*	it's there!	*/
+			has_BPTC_capability = ( NULL == soilGlCompressedTexImage2D ) ?
+				SOIL_CAPABILITY_NONE : SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do BC6H or not	*/
+	return has_BPTC_capability;
+}
+
+int query_RGB9E5_capability( void )
+{
+	if( has_RGB9E5_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		if( 0 == SOIL_GL_ExtensionSupported( "GL_EXT_texture_shared_exponent" ) &&
+			!isAtLeastGL3() )
+		{
+			has_RGB9E5_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			has_RGB9E5_capability = SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do RGB9_E5 or not	*/
+	return has_RGB9E5_capability;
+}
+
+int query_half_float_capability( void )
+{
+	if( has_half_float_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	the RGB16F internal format and the GL_HALF_FLOAT type	*/
+		if( ( ( 0 == SOIL_GL_ExtensionSupported( "GL_ARB_texture_float" ) ) ||
+			  ( 0 == SOIL_GL_ExtensionSupported( "GL_ARB_half_float_pixel" ) ) ) &&
+			!isAtLeastGL3() )
+		{
+			has_half_float_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			has_half_float_capability = SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do RGB16F or not	*/
+	return has_half_float_capability;
+}
+
 int query_gen_mipmap_capability( void )
 {
 	/* check for the capability   */
@@ -45,6 +45,8 @@
 #ifndef HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 #define HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -97,6 +99,9 @@ enum
 	SOIL_FLAG_CoCg_Y: Google YCoCg; RGB=>CoYCg, RGBA=>CoCgAY
 	SOIL_FLAG_TEXTURE_RECTANGE: uses ARB_texture_rectangle ; pixel indexed & no repeat or MIPmaps or cubemaps
 	SOIL_FLAG_PVR_LOAD_DIRECT: will load PVR files directly without _ANY_ additional processing ( if supported )
+	SOIL_FLAG_JPEG_SCALE_1_2, SOIL_FLAG_JPEG_SCALE_1_4, SOIL_FLAG_JPEG_SCALE_1_8: decode JPEG files at a half,
+		a quarter or an eighth of their size ( rounded up ), skipping the DCT work for the detail that is
+		dropped; for low LODs, placeholders and thumbnails. Other formats load at full size
 **/
 enum
 {
@@ -113,7 +118,10 @@ enum
 	SOIL_FLAG_PVR_LOAD_DIRECT = 1024,
 	SOIL_FLAG_ETC1_LOAD_DIRECT = 2048,
 	SOIL_FLAG_GL_MIPMAPS = 4096,
-	SOIL_FLAG_SRGB_COLOR_SPACE = 8192
+	SOIL_FLAG_SRGB_COLOR_SPACE = 8192,
+	SOIL_FLAG_JPEG_SCALE_1_2 = 16384,
+	SOIL_FLAG_JPEG_SCALE_1_4 = 32768,
+	SOIL_FLAG_JPEG_SCALE_1_8 = 65536
 };
 
 /**
@@ -122,6 +130,8 @@ enum
 	(BMP supports uncompressed RGB)
 	(DDS supports DXT1 and DXT5)
 	(PNG supports RGB / RGBA)
+	(HDR is Radiance RGBE, only for SOIL_save_HDR_image)
+	(SOIL_save_HDR_image saves DDS as BC6H)
 **/
 enum
 {
@@ -129,7 +139,8 @@ enum
 	SOIL_SAVE_TYPE_BMP = 1,
 	SOIL_SAVE_TYPE_PNG = 2,
 	SOIL_SAVE_TYPE_DDS = 3,
-	SOIL_SAVE_TYPE_JPG = 4
+	SOIL_SAVE_TYPE_JPG = 4,
+	SOIL_SAVE_TYPE_HDR = 5
 };
 
 /**
@@ -146,12 +157,18 @@ enum
 	SOIL_HDR_RGBE:		RGB * pow( 2.0, A - 128.0 )
 	SOIL_HDR_RGBdivA:	RGB / A
 	SOIL_HDR_RGBdivA2:	RGB / (A*A)
+	SOIL_HDR_BC6H:		real HDR, compressed to BC6H (needs GL_ARB_texture_compression_bptc)
+	SOIL_HDR_RGB9_E5:	real HDR, shared exponent, 4 bytes per pixel (needs GL 3.0 or GL_EXT_texture_shared_exponent)
+	SOIL_HDR_RGB16F:	real HDR, half floats (needs GL 3.0 or GL_ARB_texture_float and GL_ARB_half_float_pixel)
 **/
 enum
 {
 	SOIL_HDR_RGBE = 0,
 	SOIL_HDR_RGBdivA = 1,
-	SOIL_HDR_RGBdivA2 = 2
+	SOIL_HDR_RGBdivA2 = 2,
+	SOIL_HDR_BC6H = 3,
+	SOIL_HDR_RGB9_E5 = 4,
+	SOIL_HDR_RGB16F = 5
 };
 
 /**
@@ -220,7 +237,8 @@ unsigned int
 /**
 	Loads an HDR image from disk into an OpenGL texture.
 	\param filename the name of the file to upload as a texture
-	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2
+	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2, SOIL_HDR_BC6H, SOIL_HDR_RGB9_E5, SOIL_HDR_RGB16F
+	\param rescale_to_max ignored by SOIL_HDR_RGBE, SOIL_HDR_BC6H, SOIL_HDR_RGB9_E5 and SOIL_HDR_RGB16F
 	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
 	\param flags can be any of SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_MULTIPLY_ALPHA | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT
 	\return 0-failed, otherwise returns the OpenGL texture handle
@@ -368,13 +386,95 @@ int
 		int width, int height
 	);
 
+/**
+	An asynchronous frame recorder.  Each captured frame is read back
+	into one of a ring of pixel pack buffers, picked up a few frames
+	later once its fence has signaled (so glReadPixels never waits for
+	the GPU), and encoded by a pool of worker threads.
+	Without PBO support (e.g. OpenGL ES 2) the read back is done
+	right away, the encoding still happens in the background.
+**/
+typedef struct SOIL_capture SOIL_capture;
+
+typedef struct
+{
+	/*	frames given to SOIL_capture_frame	*/
+	unsigned int frames_captured;
+	/*	frames written to disk, and frames that failed to be	*/
+	unsigned int frames_saved;
+	unsigned int frames_failed;
+	/*	times a read back wasn't finished when its buffer was needed again	*/
+	unsigned int readback_stalls;
+	/*	times the encoders were behind and capturing had to wait for them	*/
+	unsigned int encoder_stalls;
+}
+SOIL_capture_stats;
+
+/**
+	Creates a frame recorder, an OpenGL context must be current.
+	\param image_type SOIL_SAVE_TYPE_TGA, SOIL_SAVE_TYPE_BMP, SOIL_SAVE_TYPE_PNG or SOIL_SAVE_TYPE_JPG
+	\param quality only used for SOIL_SAVE_TYPE_JPG (0 to 100)
+	\param ring_size frames in flight between read back and encoding, 0 picks 3
+	\param encoder_threads 0 uses one thread per CPU, each encoder saves its frames on its own thread
+	\return NULL if failed
+**/
+SOIL_capture*
+	SOIL_capture_create
+	(
+		int image_type,
+		int quality,
+		int ring_size,
+		int encoder_threads
+	);
+
+/**
+	Queues a capture of the given area of the current read buffer
+	(RGB, like SOIL_save_screenshot), to be saved as filename.
+	Call it after drawing the frame, before swapping buffers.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_capture_frame
+	(
+		SOIL_capture *capture,
+		const char *filename,
+		int x, int y,
+		int width, int height
+	);
+
+/**
+	Waits for every queued frame to be read back and written to disk.
+	\return 0 if any frame failed to be saved, otherwise returns 1
+**/
+int
+	SOIL_capture_flush
+	(
+		SOIL_capture *capture
+	);
+
+void
+	SOIL_capture_get_stats
+	(
+		const SOIL_capture *capture,
+		SOIL_capture_stats *stats
+	);
+
+/**
+	Flushes and frees the recorder, the OpenGL context must still be current.
+**/
+void
+	SOIL_capture_destroy
+	(
+		SOIL_capture *capture
+	);
+
 /**
 	Loads an image from disk into an array of unsigned chars.
 	Note that *channels return the original channel count of the
 	image.  If force_channels was other than SOIL_LOAD_AUTO,
 	the resulting image has force_channels, but *channels may be
 	different (if the original image had a different channel
-	count).
+	count).  The file is memory mapped where the OS allows it.
 	\return 0 if failed, otherwise returns 1
 **/
 unsigned char*
@@ -403,6 +503,261 @@ unsigned char*
 		int force_channels
 	);
 
+/**
+	Reads only the header of an image file: enough to size
+	a buffer for SOIL_load_image_into without decoding anything.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_image_info
+	(
+		const char *filename,
+		int *width, int *height, int *channels
+	);
+
+int
+	SOIL_image_info_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	);
+
+/**
+	Loads an image from disk straight into a buffer owned by the
+	caller, e.g. a mapped pixel unpack buffer.  The rows are written
+	top to bottom, dest_stride bytes apart.
+	\param dest_stride bytes between rows, 0 means width * channels
+	\param dest_size the size of dest in bytes, nothing is written if the image doesn't fit
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_load_image_into
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	);
+
+int
+	SOIL_load_image_into_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	);
+
+/**
+	The result codes reported through a SOIL_context
+**/
+enum
+{
+	SOIL_RESULT_OK = 0,
+	SOIL_RESULT_INVALID_ARGUMENT = 1,
+	SOIL_RESULT_FILE_NOT_FOUND = 2,
+	SOIL_RESULT_UNKNOWN_FORMAT = 3,
+	SOIL_RESULT_DECODE_FAILED = 4,
+	SOIL_RESULT_OUT_OF_MEMORY = 5,
+	SOIL_RESULT_BUFFER_TOO_SMALL = 6
+};
+
+/**
+	Option value meaning "use stb_image's process wide setting"
+**/
+#define SOIL_OPTION_DEFAULT -1
+
+/**
+	Memory hooks for SOIL and stb_image.  Every buffer SOIL allocates
+	while loading, decoding, converting or uploading an image goes
+	through the allocator current on the calling thread, including
+	the images returned by the SOIL_load_image* functions, so those
+	must be freed (with SOIL_free_image_data) on a thread using the
+	same allocator, unless it's the arena below.
+	malloc_fn, realloc_fn and free_fn follow the C library contract.
+	reset_fn is optional: SOIL calls it after every texture upload,
+	an arena can rewind itself there.
+**/
+typedef struct
+{
+	void *(*malloc_fn)( void *user_data, size_t size );
+	void *(*realloc_fn)( void *user_data, void *ptr, size_t size );
+	void (*free_fn)( void *user_data, void *ptr );
+	void (*reset_fn)( void *user_data );
+	void *user_data;
+}
+SOIL_allocator;
+
+/**
+	Sets the allocator used by every SOIL call made on the calling
+	thread.  NULL goes back to malloc / realloc / free.
+**/
+void
+	SOIL_set_allocator
+	(
+		const SOIL_allocator *allocator
+	);
+
+/**
+	Returns a built in arena allocator.  Each thread gets its own arena:
+	allocations are bumped from large blocks, and once a texture upload
+	has freed everything the arena rewinds and merges its blocks, so
+	loading a batch of textures of similar sizes stops allocating from
+	the heap after the first few.  Memory freed out of order is only
+	reclaimed by the rewind.  Buffers malloc'ed before the arena was
+	set are handed to free / realloc, so they may still be freed or
+	grown through SOIL with the arena current, and arena memory goes
+	back to its arena whatever allocator is current and on whichever
+	thread it's freed (it is reclaimed once its own thread rewinds).
+**/
+const SOIL_allocator*
+	SOIL_get_arena_allocator
+	(
+		void
+	);
+
+/**
+	Gives the calling thread's arena memory back to the heap, unless
+	something allocated from it is still in use (on any thread).
+	\return 0 if it was in use and nothing was released, otherwise returns 1
+**/
+int
+	SOIL_arena_release
+	(
+		void
+	);
+
+/**
+	Reports the calling thread's arena size in bytes, and how many
+	times it had to allocate from the heap (both can be NULL).
+**/
+void
+	SOIL_get_arena_stats
+	(
+		size_t *capacity,
+		unsigned int *heap_allocations
+	);
+
+/**
+	Per call state for the reentrant loading functions (the *_ctx
+	functions).  The options only apply to the call they are passed
+	to, so any number of threads can load images at the same time,
+	each with its own context.  A context must not be shared by two
+	threads at once.  Without thread local storage stb only has process
+	wide options, so a call asking for an option they don't already have
+	fails with SOIL_RESULT_INVALID_ARGUMENT.
+**/
+typedef struct
+{
+	/*	options: 0 or 1, or SOIL_OPTION_DEFAULT	*/
+	int flip_vertically;
+	int unpremultiply_alpha;
+	int convert_iphone_png;
+	/*	JPEG files only: decode at 1/2, 1/4 or 1/8 of the size (1, 2 or 3), 0 for full size,
+		or SOIL_OPTION_DEFAULT. SOIL_image_info_ctx reports the scaled size	*/
+	int jpeg_scale;
+	/*	allocator for this call, NULL uses the thread's (see SOIL_set_allocator)	*/
+	const SOIL_allocator *allocator;
+	/*	set by every call: a SOIL_RESULT_* code, and a description	*/
+	int result;
+	const char *result_string;
+}
+SOIL_context;
+
+/**
+	Sets every option of the context to 0 (off), the allocator to NULL
+	and clears the result.
+**/
+void
+	SOIL_context_init
+	(
+		SOIL_context *ctx
+	);
+
+/**
+	Frees an image returned by one of the *_ctx functions,
+	with the allocator of the context.
+**/
+void
+	SOIL_free_image_data_ctx
+	(
+		SOIL_context *ctx,
+		unsigned char *img_data
+	);
+
+/**
+	Reentrant versions of SOIL_load_image, SOIL_load_image_from_memory,
+	SOIL_image_info and SOIL_load_image_into.  They don't touch
+	SOIL_last_result, the outcome is in ctx->result and ctx->result_string.
+	\return the same as the functions they mirror, NULL/0 if ctx is NULL
+**/
+unsigned char*
+	SOIL_load_image_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels
+	);
+
+unsigned char*
+	SOIL_load_image_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels
+	);
+
+int
+	SOIL_image_info_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels
+	);
+
+int
+	SOIL_image_info_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	);
+
+int
+	SOIL_load_image_into_ctx
+	(
+		SOIL_context *ctx,
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	);
+
+int
+	SOIL_load_image_into_from_memory_ctx
+	(
+		SOIL_context *ctx,
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		unsigned char *dest,
+		int dest_stride,
+		int dest_size
+	);
+
 /**
 	Saves an image from an array of unsigned chars (RGBA) to disk
 	\param quality parameter only used for SOIL_SAVE_TYPE_JPG files, values accepted between 0 and 100.
@@ -427,6 +782,56 @@ int
 		const unsigned char *const data
 	);
 
+/**
+	Saves an image from an array of unsigned chars (RGBA) to disk as a PNG,
+	compressed at the given level (SOIL_save_image uses 8).  0 stores the
+	pixels uncompressed, 1 to 4 favour speed, higher values give smaller
+	files.  Big images are filtered and deflated on several threads
+	whatever the level.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_PNG_image
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data,
+		int compression_level
+	);
+
+/**
+	Saves an HDR image from an array of floats (1 to 4 channels) to disk
+	\param image_type SOIL_SAVE_TYPE_HDR (Radiance RGBE) or SOIL_SAVE_TYPE_DDS (BC6H, alpha is dropped)
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_HDR_image
+	(
+		const char *filename,
+		int image_type,
+		int width, int height, int channels,
+		const float *const data
+	);
+
+/**
+	Loads 6 HDR images from disk, compresses them to BC6H and saves
+	them as a single DDS cubemap, which SOIL_direct_load_DDS can
+	upload without any decoding or compression at load time.
+	All faces must have the same (square) size.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_HDR_cubemap_as_DDS
+	(
+		const char *filename,
+		const char *x_pos_file,
+		const char *x_neg_file,
+		const char *y_pos_file,
+		const char *y_neg_file,
+		const char *z_pos_file,
+		const char *z_neg_file
+	);
+
 /**
 	Frees the image data (note, this is just C's "free()"...this function is
 	present mostly so C++ programmers don't forget to use "free()" and call
@@ -441,7 +846,8 @@ void
 /**
 	This function resturn a pointer to a string describing the last thing
 	that happened inside SOIL.  It can be used to determine why an image
-	failed to load.
+	failed to load.  The string is kept per thread when the compiler
+	supports thread local storage.
 **/
 const char*
 	SOIL_last_result
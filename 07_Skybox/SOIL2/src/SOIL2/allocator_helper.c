@@ -0,0 +1,484 @@
+/*
+	Allocator helper functions
+
+	MIT license
+*/
+
+#include "allocator_helper.h"
+#include "thread_helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef SOIL_THREAD_LOCAL
+	/*	no thread locals: one allocator and one arena for the whole process	*/
+	#define SOIL_THREAD_LOCAL
+#endif
+
+/*	allocations are 16 byte aligned, enough for SSE loads	*/
+#define SOIL_ARENA_ALIGN 16
+#define SOIL_ARENA_ALIGN_UP( x ) (((x) + (SOIL_ARENA_ALIGN - 1)) & ~(size_t)(SOIL_ARENA_ALIGN - 1))
+/*	a 1024x1024 RGBA image plus room to spare	*/
+#define SOIL_ARENA_MIN_BLOCK ((size_t)8 << 20)
+
+typedef struct soil_arena_block
+{
+	struct soil_arena_block *next;
+	/*	the blocks of every thread's arena, see soil_arena_find	*/
+	struct soil_arena_block *next_registered;
+	struct soil_arena *arena;
+	size_t size;
+	size_t used;
+}
+soil_arena_block;
+
+typedef struct soil_arena
+{
+	/*	the newest block first, only that one is allocated from	*/
+	soil_arena_block *blocks;
+	/*	atomic, other threads free into it too	*/
+	volatile int live_allocations;
+	unsigned int heap_allocations;
+}
+soil_arena;
+
+/*	every arena allocation starts with its size	*/
+#define SOIL_ARENA_BLOCK_HEADER SOIL_ARENA_ALIGN_UP( sizeof( soil_arena_block ) )
+#define SOIL_ARENA_HEADER SOIL_ARENA_ALIGN
+#define SOIL_ARENA_DATA( block ) ((unsigned char*)(block) + SOIL_ARENA_BLOCK_HEADER)
+#define SOIL_ARENA_SIZE( ptr ) (*(size_t*)((unsigned char*)(ptr) - SOIL_ARENA_HEADER))
+
+static SOIL_THREAD_LOCAL const SOIL_allocator *soil_thread_allocator = NULL;
+static SOIL_THREAD_LOCAL const SOIL_allocator *soil_current_allocator = NULL;
+/*	on the heap, so it outlives its thread for the images still in it	*/
+static SOIL_THREAD_LOCAL soil_arena *soil_thread_arena = NULL;
+
+static soil_arena_block *soil_arena_find( const void *ptr );
+static int soil_arena_free_owned( void *ptr );
+static void *soil_arena_realloc( void *user_data, void *ptr, size_t size );
+static void soil_arena_free( void *user_data, void *ptr );
+
+static const SOIL_allocator *soil_active_allocator( void )
+{
+	return NULL != soil_current_allocator ? soil_current_allocator : soil_thread_allocator;
+}
+
+void*
+	soil_malloc
+	(
+		size_t size
+	)
+{
+	const SOIL_allocator *allocator = soil_active_allocator();
+	if( NULL != allocator )
+	{
+		return allocator->malloc_fn( allocator->user_data, size );
+	}
+	return malloc( size );
+}
+
+void*
+	soil_realloc
+	(
+		void *ptr,
+		size_t size
+	)
+{
+	const SOIL_allocator *allocator = soil_active_allocator();
+	soil_arena_block *block = NULL != ptr ? soil_arena_find( ptr ) : NULL;
+	if( (NULL != block) &&
+		((NULL == allocator) || (soil_arena_realloc != allocator->realloc_fn) || (block->arena != soil_thread_arena)) )
+	{
+		/*	arena memory, but not of an arena current here: move it to the current allocator	*/
+		size_t old_size = SOIL_ARENA_SIZE( ptr );
+		void *moved = soil_malloc( size );
+		if( NULL != moved )
+		{
+			memcpy( moved, ptr, old_size < size ? old_size : size );
+			soil_arena_free_owned( ptr );
+		}
+		return moved;
+	}
+	if( NULL != allocator )
+	{
+		return allocator->realloc_fn( allocator->user_data, ptr, size );
+	}
+	return realloc( ptr, size );
+}
+
+void
+	soil_free
+	(
+		void *ptr
+	)
+{
+	const SOIL_allocator *allocator = soil_active_allocator();
+	if( NULL == ptr )
+	{
+		return;
+	}
+	if( (NULL != allocator) && (soil_arena_free == allocator->free_fn) )
+	{
+		soil_arena_free( allocator->user_data, ptr );
+		return;
+	}
+	/*	arena memory goes back to its arena whatever allocator is current
+		now, or on whichever thread, the heap must never see it	*/
+	if( soil_arena_free_owned( ptr ) )
+	{
+		return;
+	}
+	if( NULL != allocator )
+	{
+		allocator->free_fn( allocator->user_data, ptr );
+		return;
+	}
+	free( ptr );
+}
+
+const SOIL_allocator*
+	soil_push_allocator
+	(
+		const SOIL_allocator *allocator
+	)
+{
+	const SOIL_allocator *previous = soil_current_allocator;
+	if( NULL != allocator )
+	{
+		soil_current_allocator = allocator;
+	}
+	return previous;
+}
+
+void
+	soil_pop_allocator
+	(
+		const SOIL_allocator *previous
+	)
+{
+	soil_current_allocator = previous;
+}
+
+void
+	soil_allocator_upload_done
+	(
+		void
+	)
+{
+	const SOIL_allocator *allocator = soil_active_allocator();
+	if( (NULL != allocator) && (NULL != allocator->reset_fn) )
+	{
+		allocator->reset_fn( allocator->user_data );
+	}
+}
+
+void
+	SOIL_set_allocator
+	(
+		const SOIL_allocator *allocator
+	)
+{
+	soil_thread_allocator = allocator;
+}
+
+/*	the arena	*/
+
+/*	every block of every arena, so a pointer finds its arena wherever it's freed	*/
+static soil_arena_block *soil_arena_registry = NULL;
+static volatile int soil_arena_registry_size = 0;
+static soil_spin_lock soil_arena_registry_lock = 0;
+
+static soil_arena *soil_get_thread_arena( void )
+{
+	if( NULL == soil_thread_arena )
+	{
+		soil_thread_arena = (soil_arena*)calloc( 1, sizeof( soil_arena ) );
+	}
+	return soil_thread_arena;
+}
+
+static void soil_arena_register( soil_arena_block *block )
+{
+	soil_spin_lock_acquire( &soil_arena_registry_lock );
+	block->next_registered = soil_arena_registry;
+	soil_arena_registry = block;
+	soil_atomic_increment( &soil_arena_registry_size );
+	soil_spin_lock_release( &soil_arena_registry_lock );
+}
+
+static void soil_arena_unregister( soil_arena_block *block )
+{
+	soil_arena_block **link;
+	soil_spin_lock_acquire( &soil_arena_registry_lock );
+	for( link = &soil_arena_registry; NULL != *link; link = &(*link)->next_registered )
+	{
+		if( *link == block )
+		{
+			*link = block->next_registered;
+			soil_atomic_decrement( &soil_arena_registry_size );
+			break;
+		}
+	}
+	soil_spin_lock_release( &soil_arena_registry_lock );
+}
+
+static soil_arena_block *soil_arena_find( const void *ptr )
+{
+	soil_arena_block *block;
+	/*	no arena anywhere, the usual case	*/
+	if( 0 == soil_atomic_load( &soil_arena_registry_size ) )
+	{
+		return NULL;
+	}
+	soil_spin_lock_acquire( &soil_arena_registry_lock );
+	for( block = soil_arena_registry; NULL != block; block = block->next_registered )
+	{
+		/*	the whole block, its used part only changes on the owner's thread	*/
+		const unsigned char *data = SOIL_ARENA_DATA( block );
+		if( ((const unsigned char*)ptr >= data) && ((const unsigned char*)ptr < data + block->size) )
+		{
+			break;
+		}
+	}
+	soil_spin_lock_release( &soil_arena_registry_lock );
+	return block;
+}
+
+static void soil_arena_rewind( soil_arena *arena )
+{
+	soil_arena_block *block;
+	for( block = arena->blocks; NULL != block; block = block->next )
+	{
+		block->used = 0;
+	}
+}
+
+static void *soil_arena_malloc( void *user_data, size_t size )
+{
+	soil_arena *arena = soil_get_thread_arena();
+	soil_arena_block *block;
+	size_t needed = SOIL_ARENA_HEADER + SOIL_ARENA_ALIGN_UP( size );
+	unsigned char *ptr;
+	(void)user_data;
+	if( NULL == arena )
+	{
+		return NULL;
+	}
+	/*	the last allocations may have been freed on other threads	*/
+	if( 0 == soil_atomic_load( &arena->live_allocations ) )
+	{
+		soil_arena_rewind( arena );
+	}
+	block = arena->blocks;
+	if( (NULL == block) || (block->size - block->used < needed) )
+	{
+		/*	grow geometrically, so a batch only ever needs a few blocks	*/
+		size_t block_size = NULL != block ? block->size * 2 : SOIL_ARENA_MIN_BLOCK;
+		if( block_size < needed )
+		{
+			block_size = needed;
+		}
+		block = (soil_arena_block*)malloc( SOIL_ARENA_BLOCK_HEADER + block_size );
+		if( NULL == block )
+		{
+			return NULL;
+		}
+		block->size = block_size;
+		block->used = 0;
+		block->arena = arena;
+		block->next = arena->blocks;
+		arena->blocks = block;
+		++arena->heap_allocations;
+		soil_arena_register( block );
+	}
+	ptr = SOIL_ARENA_DATA( block ) + block->used + SOIL_ARENA_HEADER;
+	SOIL_ARENA_SIZE( ptr ) = size;
+	block->used += needed;
+	soil_atomic_increment( &arena->live_allocations );
+	return ptr;
+}
+
+/*	gives ptr back to the arena that owns it
+	\return 0 if no arena owns it, otherwise returns 1	*/
+static int soil_arena_free_owned( void *ptr )
+{
+	soil_arena_block *block = soil_arena_find( ptr );
+	soil_arena *arena;
+	if( NULL == block )
+	{
+		return 0;
+	}
+	arena = block->arena;
+	if( arena != soil_thread_arena )
+	{
+		/*	another thread's: only the owner moves its blocks, the memory
+			comes back when it next rewinds	*/
+		soil_atomic_decrement( &arena->live_allocations );
+		return 1;
+	}
+	/*	the last allocation of the newest block can be given back right away	*/
+	if( (block == arena->blocks) &&
+		((unsigned char*)ptr + SOIL_ARENA_ALIGN_UP( SOIL_ARENA_SIZE( ptr ) ) == SOIL_ARENA_DATA( block ) + block->used) )
+	{
+		block->used -= SOIL_ARENA_HEADER + SOIL_ARENA_ALIGN_UP( SOIL_ARENA_SIZE( ptr ) );
+	}
+	if( 0 == soil_atomic_decrement( &arena->live_allocations ) )
+	{
+		soil_arena_rewind( arena );
+	}
+	return 1;
+}
+
+static void soil_arena_free( void *user_data, void *ptr )
+{
+	(void)user_data;
+	if( (NULL != ptr) && !soil_arena_free_owned( ptr ) )
+	{
+		/*	not an arena's (allocated by malloc before the arena was made current), give it back to the heap	*/
+		free( ptr );
+	}
+}
+
+static void *soil_arena_realloc( void *user_data, void *ptr, size_t size )
+{
+	soil_arena *arena = soil_thread_arena;
+	soil_arena_block *block;
+	size_t old_size;
+	void *result;
+	if( NULL == ptr )
+	{
+		return soil_arena_malloc( user_data, size );
+	}
+	block = soil_arena_find( ptr );
+	if( NULL == block )
+	{
+		/*	not ours, it stays on the heap	*/
+		return realloc( ptr, size );
+	}
+	old_size = SOIL_ARENA_SIZE( ptr );
+	/*	the last allocation of this thread's arena can grow or shrink in place	*/
+	if( (block->arena == arena) && (block == arena->blocks) &&
+		((unsigned char*)ptr + SOIL_ARENA_ALIGN_UP( old_size ) == SOIL_ARENA_DATA( block ) + block->used) &&
+		(block->size - (block->used - SOIL_ARENA_ALIGN_UP( old_size )) >= SOIL_ARENA_ALIGN_UP( size )) )
+	{
+		block->used = block->used - SOIL_ARENA_ALIGN_UP( old_size ) + SOIL_ARENA_ALIGN_UP( size );
+		SOIL_ARENA_SIZE( ptr ) = size;
+		return ptr;
+	}
+	result = soil_arena_malloc( user_data, size );
+	if( NULL != result )
+	{
+		memcpy( result, ptr, old_size < size ? old_size : size );
+		soil_arena_free_owned( ptr );
+	}
+	return result;
+}
+
+static void soil_arena_reset( void *user_data )
+{
+	soil_arena *arena = soil_thread_arena;
+	soil_arena_block *block, *next;
+	size_t total = 0;
+	(void)user_data;
+	if( (NULL == arena) || (NULL == arena->blocks) || (0 != soil_atomic_load( &arena->live_allocations )) )
+	{
+		/*	something is still in use, it's not safe to rewind	*/
+		return;
+	}
+	if( NULL == arena->blocks->next )
+	{
+		arena->blocks->used = 0;
+		return;
+	}
+	/*	merge the blocks into one, so the next batch of the same size fits in it	*/
+	for( block = arena->blocks; NULL != block; block = next )
+	{
+		next = block->next;
+		total += block->size;
+		soil_arena_unregister( block );
+		free( block );
+	}
+	arena->blocks = (soil_arena_block*)malloc( SOIL_ARENA_BLOCK_HEADER + total );
+	if( NULL != arena->blocks )
+	{
+		arena->blocks->size = total;
+		arena->blocks->used = 0;
+		arena->blocks->arena = arena;
+		arena->blocks->next = NULL;
+		++arena->heap_allocations;
+		soil_arena_register( arena->blocks );
+	}
+}
+
+static const SOIL_allocator soil_arena_allocator =
+{
+	soil_arena_malloc,
+	soil_arena_realloc,
+	soil_arena_free,
+	soil_arena_reset,
+	NULL
+};
+
+const SOIL_allocator*
+	SOIL_get_arena_allocator
+	(
+		void
+	)
+{
+	return &soil_arena_allocator;
+}
+
+int
+	SOIL_arena_release
+	(
+		void
+	)
+{
+	soil_arena *arena = soil_thread_arena;
+	soil_arena_block *block, *next;
+	if( NULL == arena )
+	{
+		return 1;
+	}
+	if( 0 != soil_atomic_load( &arena->live_allocations ) )
+	{
+		/*	an image still points into it, like soil_arena_reset won't rewind	*/
+		return 0;
+	}
+	for( block = arena->blocks; NULL != block; block = next )
+	{
+		next = block->next;
+		soil_arena_unregister( block );
+		free( block );
+	}
+	arena->blocks = NULL;
+	return 1;
+}
+
+void
+	SOIL_get_arena_stats
+	(
+		size_t *capacity,
+		unsigned int *heap_allocations
+	)
+{
+	soil_arena *arena = soil_thread_arena;
+	soil_arena_block *block;
+	size_t total = 0;
+	unsigned int heap = 0;
+	if( NULL != arena )
+	{
+		heap = arena->heap_allocations;
+		for( block = arena->blocks; NULL != block; block = block->next )
+		{
+			total += block->size;
+		}
+	}
+	if( NULL != capacity )
+	{
+		*capacity = total;
+	}
+	if( NULL != heap_allocations )
+	{
+		*heap_allocations = heap;
+	}
+}
@@ -0,0 +1,78 @@
+/*
+	Allocator helper functions
+
+	Every allocation SOIL and stb_image make while decoding
+	or uploading goes through soil_malloc / soil_realloc /
+	soil_free, which forward to the SOIL_allocator that is
+	current on the calling thread (plain malloc if none).
+	Also holds the per-thread arena behind
+	SOIL_get_arena_allocator.
+
+	MIT license
+*/
+
+#ifndef HEADER_ALLOCATOR_HELPER
+#define HEADER_ALLOCATOR_HELPER
+
+#include <stddef.h>
+#include "SOIL2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void*
+	soil_malloc
+	(
+		size_t size
+	);
+
+/**
+	Same contract as realloc: NULL ptr allocates, the
+	contents are kept up to the smaller of the two sizes.
+**/
+void*
+	soil_realloc
+	(
+		void *ptr,
+		size_t size
+	);
+
+void
+	soil_free
+	(
+		void *ptr
+	);
+
+/**
+	This function makes allocator current for the calling thread
+	until soil_pop_allocator.  NULL keeps the current one.
+	\return the allocator to give back to soil_pop_allocator
+**/
+const SOIL_allocator*
+	soil_push_allocator
+	(
+		const SOIL_allocator *allocator
+	);
+
+void
+	soil_pop_allocator
+	(
+		const SOIL_allocator *previous
+	);
+
+/**
+	This function is called once a texture is uploaded, it lets
+	the current allocator reset itself (see SOIL_allocator).
+**/
+void
+	soil_allocator_upload_done
+	(
+		void
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_ALLOCATOR_HELPER	*/
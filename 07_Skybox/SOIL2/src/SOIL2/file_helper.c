@@ -0,0 +1,161 @@
+/*
+	File helper functions
+
+	MIT license
+*/
+
+#include "file_helper.h"
+#include "allocator_helper.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined( SOIL_NO_MMAP )
+	#if defined( __WIN32__ ) || defined( _WIN32 ) || defined( WIN32 )
+		#define SOIL_MMAP_WIN32
+		#define WIN32_LEAN_AND_MEAN
+		#include <windows.h>
+	#elif defined( __EMSCRIPTEN__ )
+		#define SOIL_NO_MMAP
+	#elif defined( __unix__ ) || defined( __unix ) || defined( __APPLE__ ) || defined( __HAIKU__ )
+		#define SOIL_MMAP_POSIX
+		#include <sys/types.h>
+		#include <sys/stat.h>
+		#include <sys/mman.h>
+		#include <fcntl.h>
+		#include <unistd.h>
+	#else
+		#define SOIL_NO_MMAP
+	#endif
+#endif
+
+/*	plain stdio read, used when the file can't be mapped	*/
+static int soil_read_file( const char *filename, soil_mapped_file *file )
+{
+	FILE *f;
+	long length;
+	unsigned char *buffer;
+	size_t bytes_read;
+	f = fopen( filename, "rb" );
+	if( NULL == f )
+	{
+		return 0;
+	}
+	fseek( f, 0, SEEK_END );
+	length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if( length < 0 )
+	{
+		fclose( f );
+		return 0;
+	}
+	/*	malloc( 0 ) may return NULL, keep 1 byte around	*/
+	buffer = (unsigned char*)soil_malloc( length > 0 ? (size_t)length : 1 );
+	if( NULL == buffer )
+	{
+		fclose( f );
+		return 0;
+	}
+	bytes_read = fread( (void*)buffer, 1, (size_t)length, f );
+	fclose( f );
+	file->data = buffer;
+	file->size = bytes_read;
+	file->mapped = 0;
+	return 1;
+}
+
+int
+	soil_map_file
+	(
+		const char *filename,
+		soil_mapped_file *file
+	)
+{
+	if( (NULL == filename) || (NULL == file) )
+	{
+		return 0;
+	}
+	memset( file, 0, sizeof( soil_mapped_file ) );
+#if defined( SOIL_MMAP_WIN32 )
+	{
+		HANDLE fh = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+		if( INVALID_HANDLE_VALUE != fh )
+		{
+			LARGE_INTEGER size;
+			if( GetFileSizeEx( fh, &size ) && (size.QuadPart > 0) &&
+				((unsigned long long)size.QuadPart <= (size_t)-1) )
+			{
+				HANDLE mh = CreateFileMappingA( fh, NULL, PAGE_READONLY, 0, 0, NULL );
+				if( NULL != mh )
+				{
+					const void *view = MapViewOfFile( mh, FILE_MAP_READ, 0, 0, 0 );
+					if( NULL != view )
+					{
+						file->data = (const unsigned char*)view;
+						file->size = (size_t)size.QuadPart;
+						file->mapped = 1;
+						file->file_handle = fh;
+						file->map_handle = mh;
+						return 1;
+					}
+					CloseHandle( mh );
+				}
+			}
+			CloseHandle( fh );
+		}
+	}
+#elif defined( SOIL_MMAP_POSIX )
+	{
+		int fd = open( filename, O_RDONLY );
+		if( fd >= 0 )
+		{
+			struct stat st;
+			if( (0 == fstat( fd, &st )) && S_ISREG( st.st_mode ) && (st.st_size > 0) )
+			{
+				void *view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+				if( MAP_FAILED != view )
+				{
+					/*	decoders read front to back	*/
+					posix_madvise( view, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL );
+					/*	the mapping keeps the file alive	*/
+					close( fd );
+					file->data = (const unsigned char*)view;
+					file->size = (size_t)st.st_size;
+					file->mapped = 1;
+					return 1;
+				}
+			}
+			close( fd );
+		}
+	}
+#endif
+	/*	couldn't map it (empty file, pipe, no mmap...), just read it	*/
+	return soil_read_file( filename, file );
+}
+
+void
+	soil_unmap_file
+	(
+		soil_mapped_file *file
+	)
+{
+	if( (NULL == file) || (NULL == file->data) )
+	{
+		return;
+	}
+	if( file->mapped )
+	{
+#if defined( SOIL_MMAP_WIN32 )
+		UnmapViewOfFile( file->data );
+		CloseHandle( (HANDLE)file->map_handle );
+		CloseHandle( (HANDLE)file->file_handle );
+#elif defined( SOIL_MMAP_POSIX )
+		munmap( (void*)file->data, file->size );
+#endif
+	} else
+	{
+		soil_free( (void*)file->data );
+	}
+	memset( file, 0, sizeof( soil_mapped_file ) );
+}
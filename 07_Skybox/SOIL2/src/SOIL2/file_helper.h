@@ -0,0 +1,59 @@
+/*
+	File helper functions
+
+	Maps a whole file read-only into memory (mmap on POSIX,
+	a file mapping on Windows), so decoders can read it in
+	place instead of going through stdio buffers.
+	Define SOIL_NO_MMAP to always read the file into RAM.
+
+	MIT license
+*/
+
+#ifndef HEADER_FILE_HELPER
+#define HEADER_FILE_HELPER
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+	const unsigned char *data;
+	size_t size;
+	/*	0 if data was read into a malloc'ed buffer	*/
+	int mapped;
+	/*	the Win32 file and mapping handles	*/
+	void *file_handle;
+	void *map_handle;
+}
+soil_mapped_file;
+
+/**
+	This function maps the whole file into memory.
+	If mapping isn't possible the file is read into RAM instead,
+	so the caller never has to care which one happened.
+	\return 0 if the file couldn't be opened or read, otherwise returns 1
+**/
+int
+	soil_map_file
+	(
+		const char *filename,
+		soil_mapped_file *file
+	);
+
+/**
+	This function releases a file from soil_map_file.
+**/
+void
+	soil_unmap_file
+	(
+		soil_mapped_file *file
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_FILE_HELPER	*/
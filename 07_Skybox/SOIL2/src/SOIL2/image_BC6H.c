@@ -0,0 +1,466 @@
+/*
+	BC6H (unsigned half float) compression
+
+	MIT license
+*/
+
+#include "image_BC6H.h"
+#include "image_DXT.h"
+#include "thread_helper.h"
+#include "allocator_helper.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*	the largest finite half float	*/
+#define BC6H_MAX_HALF 0x7BFF
+
+/*	the 4 bit interpolation weights of the BC6H / BC7 spec	*/
+static const int bc6h_weights4[16] =
+{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/*	float -> unsigned half float bits, rounded to nearest	*/
+static unsigned short bc6h_float_to_uhalf( float f )
+{
+	union { float f; unsigned int u; } v;
+	unsigned int e, m;
+	if( !(f > 0.0f) )
+	{
+		/*	negative, zero and NaN	*/
+		return 0;
+	}
+	if( f >= 65504.0f )
+	{
+		return BC6H_MAX_HALF;
+	}
+	v.f = f;
+	e = (v.u >> 23) & 0xFF;
+	m = v.u & 0x7FFFFF;
+	if( e < 113 )
+	{
+		/*	denormal half (or flush to 0)	*/
+		if( e < 102 )
+		{
+			return 0;
+		}
+		m |= 0x800000;
+		return (unsigned short)((m + (1u << (125 - e)) ) >> (126 - e));
+	}
+	/*	rounding can carry into the exponent, which is what we want	*/
+	return (unsigned short)((((e - 112) << 10) | (m >> 13)) + ((m >> 12) & 1));
+}
+
+/*	unquantize a 10 bit unsigned endpoint (as the decoder does)	*/
+static int bc6h_unquantize( int q )
+{
+	if( q == 0 )
+	{
+		return 0;
+	}
+	if( q >= 1023 )
+	{
+		return 0xFFFF;
+	}
+	return (q << 6) + 32;
+}
+
+/*	half value -> 10 bit endpoint, the decoder scales by 31/64 at the end.
+	round_up picks the step above, so the endpoints bracket the colours	*/
+static int bc6h_quantize( float h, int round_up )
+{
+	float x = h * (64.0f / 31.0f);
+	int q;
+	if( x <= 16.0f )
+	{
+		return 0;
+	}
+	q = (int)((x - 32.0f) / 64.0f);
+	if( round_up && ( ((q << 6) + 32) * 31.0f / 64.0f < h ) )
+	{
+		++q;
+	}
+	if( q < 1 )
+	{
+		q = 1;
+	}
+	if( q > 1023 )
+	{
+		q = 1023;
+	}
+	return q;
+}
+
+/*	returns the half value the decoder produces for weight w	*/
+static int bc6h_interpolate( int ua, int ub, int w )
+{
+	return ((((64 - w) * ua + w * ub + 32) >> 6) * 31) >> 6;
+}
+
+/*	picks the best index for every pixel, returns the total error	*/
+static float bc6h_find_indices
+	(
+		const float px[16][3],
+		const int qa[3], const int qb[3],
+		int indices[16]
+	)
+{
+	float palette[16][3];
+	float total = 0.0f;
+	int i, j, c;
+	for( c = 0; c < 3; ++c )
+	{
+		int ua = bc6h_unquantize( qa[c] );
+		int ub = bc6h_unquantize( qb[c] );
+		for( j = 0; j < 16; ++j )
+		{
+			palette[j][c] = (float)bc6h_interpolate( ua, ub, bc6h_weights4[j] );
+		}
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		float best = 1e30f;
+		int best_j = 0;
+		for( j = 0; j < 16; ++j )
+		{
+			float dr = palette[j][0] - px[i][0];
+			float dg = palette[j][1] - px[i][1];
+			float db = palette[j][2] - px[i][2];
+			float d = dr*dr + dg*dg + db*db;
+			if( d < best )
+			{
+				best = d;
+				best_j = j;
+			}
+		}
+		indices[i] = best_j;
+		total += best;
+	}
+	return total;
+}
+
+static void bc6h_quantize_endpoints
+	(
+		const float a[3], const float b[3],
+		int qa[3], int qb[3]
+	)
+{
+	int c;
+	for( c = 0; c < 3; ++c )
+	{
+		float fa = a[c] < 0.0f ? 0.0f : (a[c] > BC6H_MAX_HALF ? BC6H_MAX_HALF : a[c]);
+		float fb = b[c] < 0.0f ? 0.0f : (b[c] > BC6H_MAX_HALF ? BC6H_MAX_HALF : b[c]);
+		qa[c] = bc6h_quantize( fa, fa > fb );
+		qb[c] = bc6h_quantize( fb, fb >= fa );
+	}
+}
+
+/*	writes count bits of value at bit position *pos (LSB first)	*/
+static void bc6h_put_bits( unsigned char *block, int *pos, int count, unsigned int value )
+{
+	int i;
+	for( i = 0; i < count; ++i, ++*pos )
+	{
+		if( (value >> i) & 1 )
+		{
+			block[*pos >> 3] |= (unsigned char)(1 << (*pos & 7));
+		}
+	}
+}
+
+/*	encodes one 4x4 block of half values (stored as floats)	*/
+static void bc6h_compress_block( const float px[16][3], unsigned char block[16] )
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	float a[3], b[3];
+	float tmin = 1e30f, tmax = -1e30f;
+	float err, refined_err;
+	int qa[3], qb[3], rqa[3], rqb[3];
+	int indices[16], rindices[16];
+	int i, c, iter, pos;
+
+	/*	principal axis of the block colours	*/
+	for( i = 0; i < 16; ++i )
+	{
+		for( c = 0; c < 3; ++c )
+		{
+			mean[c] += px[i][c];
+		}
+	}
+	for( c = 0; c < 3; ++c )
+	{
+		mean[c] *= 1.0f / 16.0f;
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		float r = px[i][0] - mean[0];
+		float g = px[i][1] - mean[1];
+		float bl = px[i][2] - mean[2];
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*bl;
+		cov[3] += g*g; cov[4] += g*bl; cov[5] += bl*bl;
+	}
+	for( iter = 0; iter < 8; ++iter )
+	{
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float m = fabsf( x );
+		if( fabsf( y ) > m ) m = fabsf( y );
+		if( fabsf( z ) > m ) m = fabsf( z );
+		if( m <= 0.0f )
+		{
+			break;
+		}
+		axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+	}
+	{
+		float len2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+		for( i = 0; i < 16; ++i )
+		{
+			float t = ( (px[i][0] - mean[0]) * axis[0] +
+						(px[i][1] - mean[1]) * axis[1] +
+						(px[i][2] - mean[2]) * axis[2] ) / len2;
+			if( t < tmin ) tmin = t;
+			if( t > tmax ) tmax = t;
+		}
+	}
+	for( c = 0; c < 3; ++c )
+	{
+		a[c] = mean[c] + tmin * axis[c];
+		b[c] = mean[c] + tmax * axis[c];
+	}
+	bc6h_quantize_endpoints( a, b, qa, qb );
+	err = bc6h_find_indices( px, qa, qb, indices );
+
+	/*	one least squares pass on the endpoints	*/
+	if( err > 0.0f )
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+		float det;
+		for( i = 0; i < 16; ++i )
+		{
+			float t = bc6h_weights4[indices[i]] * (1.0f / 64.0f);
+			float s = 1.0f - t;
+			aa += s*s; ab += s*t; bb += t*t;
+			for( c = 0; c < 3; ++c )
+			{
+				ax[c] += s * px[i][c];
+				bx[c] += t * px[i][c];
+			}
+		}
+		det = aa*bb - ab*ab;
+		if( fabsf( det ) > 1e-6f )
+		{
+			float inv = 1.0f / det;
+			for( c = 0; c < 3; ++c )
+			{
+				a[c] = (ax[c]*bb - bx[c]*ab) * inv;
+				b[c] = (bx[c]*aa - ax[c]*ab) * inv;
+			}
+			bc6h_quantize_endpoints( a, b, rqa, rqb );
+			refined_err = bc6h_find_indices( px, rqa, rqb, rindices );
+			if( refined_err < err )
+			{
+				memcpy( qa, rqa, sizeof( qa ) );
+				memcpy( qb, rqb, sizeof( qb ) );
+				memcpy( indices, rindices, sizeof( indices ) );
+			}
+		}
+	}
+
+	/*	the anchor index has an implicit 0 MSB	*/
+	if( indices[0] & 8 )
+	{
+		for( c = 0; c < 3; ++c )
+		{
+			int t = qa[c]; qa[c] = qb[c]; qb[c] = t;
+		}
+		for( i = 0; i < 16; ++i )
+		{
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	/*	mode 11 : 5 mode bits, 60 endpoint bits, 63 index bits	*/
+	memset( block, 0, 16 );
+	pos = 0;
+	bc6h_put_bits( block, &pos, 5, 0x03 );
+	for( c = 0; c < 3; ++c )
+	{
+		bc6h_put_bits( block, &pos, 10, (unsigned int)qa[c] );
+	}
+	for( c = 0; c < 3; ++c )
+	{
+		bc6h_put_bits( block, &pos, 10, (unsigned int)qb[c] );
+	}
+	bc6h_put_bits( block, &pos, 3, (unsigned int)indices[0] );
+	for( i = 1; i < 16; ++i )
+	{
+		bc6h_put_bits( block, &pos, 4, (unsigned int)indices[i] );
+	}
+}
+
+typedef struct
+{
+	const float *image;
+	int width, height, channels;
+	int blocks_x;
+	unsigned char *compressed;
+}
+bc6h_job_data;
+
+/*	encodes the block rows [first, last)	*/
+static void bc6h_compress_rows( void *user_data, int first, int last )
+{
+	bc6h_job_data *job = (bc6h_job_data*)user_data;
+	float px[16][3];
+	int by, bx, x, y, c;
+	for( by = first; by < last; ++by )
+	{
+		for( bx = 0; bx < job->blocks_x; ++bx )
+		{
+			/*	gather the block, replicating the edges	*/
+			for( y = 0; y < 4; ++y )
+			{
+				int sy = by * 4 + y;
+				if( sy >= job->height ) sy = job->height - 1;
+				for( x = 0; x < 4; ++x )
+				{
+					int sx = bx * 4 + x;
+					const float *src;
+					if( sx >= job->width ) sx = job->width - 1;
+					src = job->image + ((size_t)sy * job->width + sx) * job->channels;
+					for( c = 0; c < 3; ++c )
+					{
+						float v = job->channels < 3 ? src[0] : src[c];
+						px[y*4+x][c] = (float)bc6h_float_to_uhalf( v );
+					}
+				}
+			}
+			bc6h_compress_block( px,
+				job->compressed + ((size_t)by * job->blocks_x + bx) * 16 );
+		}
+	}
+}
+
+unsigned char*
+	convert_image_to_BC6H
+	(
+		const float *const uncompressed,
+		int width, int height, int channels,
+		int *out_size
+	)
+{
+	bc6h_job_data job;
+	int blocks_y;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	job.image = uncompressed;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.blocks_x = (width + 3) / 4;
+	blocks_y = (height + 3) / 4;
+	*out_size = job.blocks_x * blocks_y * 16;
+	job.compressed = (unsigned char*)soil_malloc( *out_size );
+	if( NULL == job.compressed )
+	{
+		*out_size = 0;
+		return NULL;
+	}
+	/*	a block row of a 256 wide image is ~64 blocks, worth a thread at 4 rows	*/
+	soil_parallel_for( blocks_y, 4, bc6h_compress_rows, &job );
+	return job.compressed;
+}
+
+int
+	save_image_as_DDS_BC6H
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const float *const *const faces,
+		int face_count
+	)
+{
+	/*	variables	*/
+	FILE *fout;
+	DDS_header header;
+	DDS_header_DXT10 header10;
+	unsigned char *DDS_data[6];
+	int DDS_size = 0;
+	int i, ok = 1;
+	/*	error check	*/
+	if( (NULL == filename) ||
+		(width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(NULL == faces) ||
+		((face_count != 1) && (face_count != 6)) )
+	{
+		return 0;
+	}
+	/*	Convert the faces	*/
+	memset( DDS_data, 0, sizeof( DDS_data ) );
+	for( i = 0; i < face_count; ++i )
+	{
+		DDS_data[i] = convert_image_to_BC6H( faces[i], width, height, channels, &DDS_size );
+		if( NULL == DDS_data[i] )
+		{
+			ok = 0;
+			break;
+		}
+	}
+	if( ok )
+	{
+		memset( &header, 0, sizeof( DDS_header ) );
+		header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+		header.dwSize = 124;
+		header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+		header.dwWidth = width;
+		header.dwHeight = height;
+		header.dwPitchOrLinearSize = DDS_size;
+		header.sPixelFormat.dwSize = 32;
+		header.sPixelFormat.dwFlags = DDPF_FOURCC;
+		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('1' << 16) | ('0' << 24);
+		header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+		memset( &header10, 0, sizeof( DDS_header_DXT10 ) );
+		header10.dxgiFormat = DXGI_FORMAT_BC6H_UF16;
+		header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		header10.arraySize = 1;
+		if( face_count == 6 )
+		{
+			header.sCaps.dwCaps1 |= DDSCAPS_COMPLEX;
+			header.sCaps.dwCaps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+			header10.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+		}
+		/*	write it out	*/
+		fout = fopen( filename, "wb" );
+		if( NULL == fout )
+		{
+			ok = 0;
+		} else
+		{
+			fwrite( &header, sizeof( DDS_header ), 1, fout );
+			fwrite( &header10, sizeof( DDS_header_DXT10 ), 1, fout );
+			for( i = 0; i < face_count; ++i )
+			{
+				fwrite( DDS_data[i], 1, DDS_size, fout );
+			}
+			fclose( fout );
+		}
+	}
+	/*	done	*/
+	for( i = 0; i < face_count; ++i )
+	{
+		soil_free( DDS_data[i] );
+	}
+	return ok;
+}
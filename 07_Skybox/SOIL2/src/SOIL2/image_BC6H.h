@@ -0,0 +1,53 @@
+/*
+	BC6H (unsigned half float) compression
+
+	A fast single region encoder: every block is stored
+	in mode 11 (two 10 bit endpoints per channel, 4 bit
+	indices), the blocks are encoded in parallel.
+
+	MIT license
+*/
+
+#ifndef HEADER_IMAGE_BC6H
+#define HEADER_IMAGE_BC6H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+	Takes a floating point image (1 to 4 channels, only RGB is
+	kept, luminance is replicated) and converts it to BC6H
+	unsigned (16 bytes per 4x4 pixel block).  Negative values
+	are clamped to 0 and values above 65504 to 65504.
+	\return the compressed data (free with SOIL_free_image_data), NULL if failed
+**/
+unsigned char*
+	convert_image_to_BC6H
+	(
+		const float *const uncompressed,
+		int width, int height, int channels,
+		int *out_size
+	);
+
+/**
+	Converts 1 image or the 6 faces of a cubemap to BC6H and
+	saves them as a DX10 DDS file (DXGI_FORMAT_BC6H_UF16).
+	The faces must be in OpenGL order (+X, -X, +Y, -Y, +Z, -Z).
+	\param face_count 1 for a 2D texture, 6 for a cubemap
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	save_image_as_DDS_BC6H
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const float *const *const faces,
+		int face_count
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_IMAGE_BC6H	*/
@@ -85,6 +85,18 @@ typedef struct
 }
 DDS_header ;
 
+/**	The extended header that follows DDS_header when the
+	pixel format FourCC is "DX10" (needed for BC6H / BC7)	**/
+typedef struct
+{
+    unsigned int    dxgiFormat;
+    unsigned int    resourceDimension;
+    unsigned int    miscFlag;
+    unsigned int    arraySize;
+    unsigned int    miscFlags2;
+}
+DDS_header_DXT10 ;
+
 /*	the following constants were copied directly off the MSDN website	*/
 
 /*	The dwFlags member of the original DDSURFACEDESC2 structure
@@ -120,5 +132,12 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_POSITIVEZ	0x00004000
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
+#define DDSCAPS2_CUBEMAP_ALLFACES	0x0000FC00
+
+/*	DDS_header_DXT10 values	*/
+#define DXGI_FORMAT_BC6H_UF16	95
+#define DXGI_FORMAT_BC6H_SF16	96
+#define DDS_DIMENSION_TEXTURE2D	3
+#define DDS_RESOURCE_MISC_TEXTURECUBE	0x4
 
 #endif /* HEADER_IMAGE_DXT	*/
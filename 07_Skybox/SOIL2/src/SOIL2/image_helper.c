@@ -7,7 +7,9 @@
 */
 
 #include "image_helper.h"
+#include "thread_helper.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 /*	Upscaling the image uses simple bilinear interpolation	*/
@@ -433,3 +435,496 @@ RGBE_to_RGBdivA2
 	}
 	return 1;
 }
+
+/*	the fused post-process pass	*/
+
+#if !defined( SOIL_NO_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+	#define IMAGE_HELPER_SSE2
+	#include <emmintrin.h>
+#endif
+
+#if defined( _MSC_VER )
+	#define IMAGE_HELPER_INLINE __forceinline
+#elif defined( __GNUC__ )
+	#define IMAGE_HELPER_INLINE __inline__ __attribute__((always_inline))
+#else
+	#define IMAGE_HELPER_INLINE
+#endif
+
+/*	the same values as the float LUT in scale_image_RGB_to_NTSC_safe,
+	in fixed point so it can be done 8 lanes at a time	*/
+#define IMAGE_NTSC_SAFE( c ) ((((c) * 56540) + 1015376) >> 16)
+
+#ifdef IMAGE_HELPER_SSE2
+/*	IMAGE_NTSC_SAFE on 8 values: 15 + hi + carry of (lo + 32336)	*/
+static IMAGE_HELPER_INLINE __m128i postprocess_NTSC_SSE2( __m128i x )
+{
+	const __m128i scale = _mm_set1_epi16( (short)56540 );
+	__m128i hi = _mm_mulhi_epu16( x, scale );
+	__m128i lo = _mm_mullo_epi16( x, scale );
+	/*	unsigned lo > 33199, as a signed compare	*/
+	__m128i carry = _mm_cmpgt_epi16( _mm_xor_si128( lo, _mm_set1_epi16( (short)0x8000 ) ), _mm_set1_epi16( 33199 - 32768 ) );
+	return _mm_sub_epi16( _mm_add_epi16( hi, _mm_set1_epi16( 15 ) ), carry );
+}
+
+/*	2 RGBA pixels widened to 16 bits	*/
+static IMAGE_HELPER_INLINE __m128i postprocess_RGBA_SSE2( __m128i x, const int NTSC, const int MULA, const int YCOCG )
+{
+	const __m128i alpha_mask = _mm_set_epi16( -1, 0, 0, 0, -1, 0, 0, 0 );
+	__m128i a = _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	if( NTSC )
+	{
+		x = _mm_or_si128( _mm_andnot_si128( alpha_mask, postprocess_NTSC_SSE2( x ) ), _mm_and_si128( alpha_mask, x ) );
+	}
+	if( MULA )
+	{
+		__m128i m = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( x, a ), _mm_set1_epi16( 128 ) ), 8 );
+		x = _mm_or_si128( _mm_andnot_si128( alpha_mask, m ), _mm_and_si128( alpha_mask, x ) );
+	}
+	if( YCOCG )
+	{
+		/*	CoCgAY, packing clamps like clamp_byte.  The math is done in the
+			R lane of each pixel, G and B are shifted down to it	*/
+		const __m128i low_lane = _mm_set_epi16( 0, 0, 0, -1, 0, 0, 0, -1 );
+		const __m128i half = _mm_set1_epi16( 128 );
+		__m128i g = _mm_srli_epi16( _mm_add_epi16( _mm_srli_epi64( x, 16 ), _mm_set1_epi16( 1 ) ), 1 );
+		__m128i b = _mm_srli_epi64( x, 32 );
+		__m128i tmp = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( x, b ), _mm_set1_epi16( 2 ) ), 2 );
+		__m128i co = _mm_add_epi16( half, _mm_srai_epi16( _mm_add_epi16( _mm_sub_epi16( x, b ), _mm_set1_epi16( 1 ) ), 1 ) );
+		__m128i cg = _mm_sub_epi16( _mm_add_epi16( half, g ), tmp );
+		__m128i y = _mm_add_epi16( g, tmp );
+		x = _mm_or_si128(
+				_mm_or_si128(
+					_mm_and_si128( low_lane, co ),
+					_mm_slli_epi64( _mm_and_si128( low_lane, cg ), 16 ) ),
+				_mm_or_si128(
+					_mm_and_si128( _mm_set_epi16( 0, -1, 0, 0, 0, -1, 0, 0 ), _mm_slli_epi64( a, 32 ) ),
+					_mm_slli_epi64( y, 48 ) ) );
+	}
+	return x;
+}
+#endif
+
+/*	one row, specialized by the constant arguments	*/
+static IMAGE_HELPER_INLINE void
+	postprocess_row
+	(
+		const unsigned char *src, unsigned char *dst, int width,
+		const int CH, const int NTSC, const int MULA, const int YCOCG
+	)
+{
+	int i = 0;
+#ifdef IMAGE_HELPER_SSE2
+	if( CH == 4 )
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for( ; i + 4 <= width; i += 4, src += 16, dst += 16 )
+		{
+			__m128i px = _mm_loadu_si128( (const __m128i*)src );
+			__m128i lo = postprocess_RGBA_SSE2( _mm_unpacklo_epi8( px, zero ), NTSC, MULA, YCOCG );
+			__m128i hi = postprocess_RGBA_SSE2( _mm_unpackhi_epi8( px, zero ), NTSC, MULA, YCOCG );
+			_mm_storeu_si128( (__m128i*)dst, _mm_packus_epi16( lo, hi ) );
+		}
+	} else
+	if( (CH & 1) && NTSC && !(YCOCG && CH == 3) )
+	{
+		/*	no alpha: every byte gets the same scaling, pixel boundaries don't matter	*/
+		const __m128i zero = _mm_setzero_si128();
+		/*	stop on a pixel boundary (16 or 48 bytes), the rest is done
+			per pixel, and nothing may be scaled twice when working in place	*/
+		const int bytes = (width * CH) / (16 * CH) * (16 * CH);
+		int j;
+		for( j = 0; j < bytes; j += 16, src += 16, dst += 16 )
+		{
+			__m128i px = _mm_loadu_si128( (const __m128i*)src );
+			__m128i lo = postprocess_NTSC_SSE2( _mm_unpacklo_epi8( px, zero ) );
+			__m128i hi = postprocess_NTSC_SSE2( _mm_unpackhi_epi8( px, zero ) );
+			_mm_storeu_si128( (__m128i*)dst, _mm_packus_epi16( lo, hi ) );
+		}
+		i = bytes / CH;
+	}
+#endif
+	for( ; i < width; ++i, src += CH, dst += CH )
+	{
+		int c0 = src[0];
+		int c1 = CH > 1 ? src[1] : 0;
+		int c2 = CH > 2 ? src[2] : 0;
+		int c3 = CH > 3 ? src[3] : 0;
+		if( NTSC )
+		{
+			/*	leave the alpha (channel 2 or 4) alone	*/
+			c0 = IMAGE_NTSC_SAFE( c0 );
+			if( CH >= 3 )
+			{
+				c1 = IMAGE_NTSC_SAFE( c1 );
+				c2 = IMAGE_NTSC_SAFE( c2 );
+			}
+		}
+		if( MULA )
+		{
+			if( CH == 2 )
+			{
+				c0 = (c0 * c1 + 128) >> 8;
+			} else
+			if( CH == 4 )
+			{
+				c0 = (c0 * c3 + 128) >> 8;
+				c1 = (c1 * c3 + 128) >> 8;
+				c2 = (c2 * c3 + 128) >> 8;
+			}
+		}
+		if( YCOCG && (CH >= 3) )
+		{
+			int r = c0;
+			int g = (c1 + 1) >> 1;
+			int b = c2;
+			int tmp = (2 + r + b) >> 2;
+			if( CH == 3 )
+			{
+				/*	CoYCg	*/
+				c0 = clamp_byte( 128 + ((r - b + 1) >> 1) );
+				c1 = clamp_byte( g + tmp );
+				c2 = clamp_byte( 128 + g - tmp );
+			} else
+			{
+				/*	CoCgAY	*/
+				c0 = clamp_byte( 128 + ((r - b + 1) >> 1) );
+				c1 = clamp_byte( 128 + g - tmp );
+				c2 = c3;
+				c3 = clamp_byte( g + tmp );
+			}
+		}
+		dst[0] = (unsigned char)c0;
+		if( CH > 1 ) dst[1] = (unsigned char)c1;
+		if( CH > 2 ) dst[2] = (unsigned char)c2;
+		if( CH > 3 ) dst[3] = (unsigned char)c3;
+	}
+}
+
+typedef void (*postprocess_row_func)( const unsigned char *src, unsigned char *dst, int width );
+
+#define POSTPROCESS_ROW_FUNC( CH, NTSC, MULA, YCOCG ) \
+	static void postprocess_row_##CH##_##NTSC##MULA##YCOCG( const unsigned char *src, unsigned char *dst, int width ) \
+	{ postprocess_row( src, dst, width, CH, NTSC, MULA, YCOCG ); }
+
+#define POSTPROCESS_ROW_FUNCS( CH ) \
+	POSTPROCESS_ROW_FUNC( CH, 0, 0, 1 ) \
+	POSTPROCESS_ROW_FUNC( CH, 0, 1, 0 ) \
+	POSTPROCESS_ROW_FUNC( CH, 0, 1, 1 ) \
+	POSTPROCESS_ROW_FUNC( CH, 1, 0, 0 ) \
+	POSTPROCESS_ROW_FUNC( CH, 1, 0, 1 ) \
+	POSTPROCESS_ROW_FUNC( CH, 1, 1, 0 ) \
+	POSTPROCESS_ROW_FUNC( CH, 1, 1, 1 )
+
+POSTPROCESS_ROW_FUNCS( 1 )
+POSTPROCESS_ROW_FUNCS( 2 )
+POSTPROCESS_ROW_FUNCS( 3 )
+POSTPROCESS_ROW_FUNCS( 4 )
+
+#define POSTPROCESS_ROW_TABLE( CH ) \
+	{ NULL, \
+	  postprocess_row_##CH##_001, postprocess_row_##CH##_010, postprocess_row_##CH##_011, \
+	  postprocess_row_##CH##_100, postprocess_row_##CH##_101, postprocess_row_##CH##_110, \
+	  postprocess_row_##CH##_111 }
+
+/*	[channels - 1][NTSC << 2 | MULA << 1 | YCOCG], NULL is a plain copy	*/
+static const postprocess_row_func postprocess_row_funcs[4][8] =
+{
+	POSTPROCESS_ROW_TABLE( 1 ),
+	POSTPROCESS_ROW_TABLE( 2 ),
+	POSTPROCESS_ROW_TABLE( 3 ),
+	POSTPROCESS_ROW_TABLE( 4 )
+};
+
+typedef struct
+{
+	const unsigned char *orig;
+	unsigned char *processed;
+	int width, height, channels;
+	int invert_y;
+	postprocess_row_func row_func;
+}
+postprocess_job;
+
+static void postprocess_rows( void *user_data, int first, int last )
+{
+	const postprocess_job *job = (const postprocess_job*)user_data;
+	const size_t row_size = (size_t)job->width * job->channels;
+	int j;
+	for( j = first; j < last; ++j )
+	{
+		const unsigned char *src = job->orig + row_size * (job->invert_y ? job->height - 1 - j : j);
+		unsigned char *dst = job->processed + row_size * j;
+		if( NULL != job->row_func )
+		{
+			job->row_func( src, dst, job->width );
+		} else
+		if( src != dst )
+		{
+			memcpy( dst, src, row_size );
+		}
+	}
+}
+
+int
+	postprocess_image
+	(
+		const unsigned char* const orig,
+		unsigned char* processed,
+		int width, int height, int channels,
+		unsigned int postprocess_flags
+	)
+{
+	postprocess_job job;
+	int ops;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(orig == NULL) || (processed == NULL) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	if( (orig == processed) && (postprocess_flags & IMAGE_POSTPROCESS_INVERT_Y) )
+	{
+		/*	rows would be read after they were overwritten	*/
+		return 0;
+	}
+	ops = ((postprocess_flags & IMAGE_POSTPROCESS_NTSC_SAFE_RGB) ? 4 : 0) |
+		  (((postprocess_flags & IMAGE_POSTPROCESS_MULTIPLY_ALPHA) && !(channels & 1)) ? 2 : 0) |
+		  (((postprocess_flags & IMAGE_POSTPROCESS_YCOCG) && (channels >= 3)) ? 1 : 0);
+	job.orig = orig;
+	job.processed = processed;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.invert_y = (postprocess_flags & IMAGE_POSTPROCESS_INVERT_Y) ? 1 : 0;
+	job.row_func = postprocess_row_funcs[channels - 1][ops];
+	/*	a row at a time, each one is read and written once while it's in cache	*/
+	soil_parallel_for( height, 64, postprocess_rows, &job );
+	return 1;
+}
+
+/*	real HDR: floats to the packed GL formats	*/
+
+typedef union
+{
+	float f;
+	unsigned int u;
+}
+image_float_bits;
+
+/*	largest value RGB9_E5 holds: (511/512) * 2^16	*/
+#define IMAGE_RGB9E5_MAX 65408.0f
+
+/*	negative and NaN become 0, the max is clamped	*/
+static float clamp_HDR( float x, float max_val )
+{
+	return ( x > 0.0f ) ? ( ( x < max_val ) ? x : max_val ) : 0.0f;
+}
+
+/*	2^(24 - e), the scale from a value to its 9 bit mantissa	*/
+static float RGB9E5_scale( int e )
+{
+	image_float_bits s;
+	s.u = (unsigned int)( 151 - e ) << 23;
+	return s.f;
+}
+
+/*	EXT_texture_shared_exponent, with floor(log2) taken from the float exponent	*/
+static unsigned int pack_RGB9E5( float r, float g, float b )
+{
+	image_float_bits m;
+	int e, m_s;
+	float scale;
+	r = clamp_HDR( r, IMAGE_RGB9E5_MAX );
+	g = clamp_HDR( g, IMAGE_RGB9E5_MAX );
+	b = clamp_HDR( b, IMAGE_RGB9E5_MAX );
+	m.f = ( r > g ) ? r : g;
+	m.f = ( b > m.f ) ? b : m.f;
+	e = (int)( m.u >> 23 ) - 111;
+	e = ( e < 0 ) ? 0 : e;
+	scale = RGB9E5_scale( e );
+	m_s = (int)( m.f * scale + 0.5f );
+	if( m_s == 512 )
+	{
+		/*	rounding carried into the next exponent	*/
+		scale = RGB9E5_scale( ++e );
+	}
+	return (unsigned int)( r * scale + 0.5f ) |
+		( (unsigned int)( g * scale + 0.5f ) << 9 ) |
+		( (unsigned int)( b * scale + 0.5f ) << 18 ) |
+		( (unsigned int)e << 27 );
+}
+
+/*	round to nearest even, values over the half max are clamped to it	*/
+static unsigned short pack_half( float x )
+{
+	image_float_bits f;
+	f.f = clamp_HDR( x, 65504.0f );
+	if( f.u < ( 113u << 23 ) )
+	{
+		/*	denormal half: let the float adder do the rounding	*/
+		image_float_bits magic;
+		magic.u = 126u << 23;
+		f.f += magic.f;
+		return (unsigned short)( f.u - magic.u );
+	}
+	f.u += ( ( 15u - 127u ) << 23 ) + 0xFFF + ( ( f.u >> 13 ) & 1 );
+	return (unsigned short)( f.u >> 13 );
+}
+
+#ifdef IMAGE_HELPER_SSE2
+static IMAGE_HELPER_INLINE __m128 clamp_HDR_SSE2( __m128 x, __m128 max_val )
+{
+	/*	maxps returns the 2nd operand for a NaN	*/
+	return _mm_min_ps( _mm_max_ps( x, _mm_setzero_ps() ), max_val );
+}
+
+static IMAGE_HELPER_INLINE __m128 RGB9E5_scale_SSE2( __m128i e )
+{
+	return _mm_castsi128_ps( _mm_slli_epi32( _mm_sub_epi32( _mm_set1_epi32( 151 ), e ), 23 ) );
+}
+
+/*	4 RGB float pixels to 4 RGB9_E5 texels, the same math as pack_RGB9E5	*/
+static IMAGE_HELPER_INLINE void pack_RGB9E5_SSE2( const float *src, unsigned int *dst )
+{
+	const __m128 max_val = _mm_set1_ps( IMAGE_RGB9E5_MAX );
+	const __m128 half = _mm_set1_ps( 0.5f );
+	__m128 a = _mm_loadu_ps( src );
+	__m128 b = _mm_loadu_ps( src + 4 );
+	__m128 c = _mm_loadu_ps( src + 8 );
+	__m128 r, g, bl, m, scale;
+	__m128i e, m_s, packed;
+	/*	a = r0 g0 b0 r1, b = g1 b1 r2 g2, c = b2 r3 g3 b3	*/
+	r = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 3, 0 ) );
+	g = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ),
+						_mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	bl = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ),
+						 _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	r = clamp_HDR_SSE2( r, max_val );
+	g = clamp_HDR_SSE2( g, max_val );
+	bl = clamp_HDR_SSE2( bl, max_val );
+	m = _mm_max_ps( _mm_max_ps( r, g ), bl );
+	e = _mm_sub_epi32( _mm_srli_epi32( _mm_castps_si128( m ), 23 ), _mm_set1_epi32( 111 ) );
+	e = _mm_andnot_si128( _mm_srai_epi32( e, 31 ), e );
+	m_s = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( m, RGB9E5_scale_SSE2( e ) ), half ) );
+	/*	-1 where the rounding carried into the next exponent	*/
+	e = _mm_sub_epi32( e, _mm_cmpeq_epi32( m_s, _mm_set1_epi32( 512 ) ) );
+	scale = RGB9E5_scale_SSE2( e );
+	packed = _mm_or_si128(
+		_mm_or_si128( _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( r, scale ), half ) ),
+					  _mm_slli_epi32( _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( g, scale ), half ) ), 9 ) ),
+		_mm_or_si128( _mm_slli_epi32( _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( bl, scale ), half ) ), 18 ),
+					  _mm_slli_epi32( e, 27 ) ) );
+	_mm_storeu_si128( (__m128i*)dst, packed );
+}
+
+/*	4 floats to 4 halves (in 32 bit lanes), the same math as pack_half	*/
+static IMAGE_HELPER_INLINE __m128i pack_half_SSE2( __m128 x )
+{
+	const __m128i magic = _mm_set1_epi32( 126 << 23 );
+	__m128i f = _mm_castps_si128( clamp_HDR_SSE2( x, _mm_set1_ps( 65504.0f ) ) );
+	__m128i is_denormal = _mm_cmplt_epi32( f, _mm_set1_epi32( 113 << 23 ) );
+	__m128i denormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( f ), _mm_castsi128_ps( magic ) ) ), magic );
+	__m128i normal = _mm_add_epi32( f, _mm_set1_epi32( (int)( ( 15u - 127u ) << 23 ) + 0xFFF ) );
+	normal = _mm_add_epi32( normal, _mm_and_si128( _mm_srli_epi32( f, 13 ), _mm_set1_epi32( 1 ) ) );
+	normal = _mm_srli_epi32( normal, 13 );
+	return _mm_or_si128( _mm_and_si128( is_denormal, denormal ), _mm_andnot_si128( is_denormal, normal ) );
+}
+#endif
+
+typedef struct
+{
+	const float *rgb;
+	void *packed;
+	int width;
+}
+pack_HDR_job;
+
+static void pack_RGB9E5_rows( void *user_data, int first, int last )
+{
+	const pack_HDR_job *job = (const pack_HDR_job*)user_data;
+	const float *src = job->rgb + (size_t)first * job->width * 3;
+	unsigned int *dst = (unsigned int*)job->packed + (size_t)first * job->width;
+	size_t n = (size_t)( last - first ) * job->width;
+	size_t i = 0;
+	#ifdef IMAGE_HELPER_SSE2
+	for( ; i + 4 <= n; i += 4 )
+	{
+		pack_RGB9E5_SSE2( src + i * 3, dst + i );
+	}
+	#endif
+	for( ; i < n; ++i )
+	{
+		dst[i] = pack_RGB9E5( src[i * 3 + 0], src[i * 3 + 1], src[i * 3 + 2] );
+	}
+}
+
+static void pack_RGB16F_rows( void *user_data, int first, int last )
+{
+	const pack_HDR_job *job = (const pack_HDR_job*)user_data;
+	const float *src = job->rgb + (size_t)first * job->width * 3;
+	unsigned short *dst = (unsigned short*)job->packed + (size_t)first * job->width * 3;
+	size_t n = (size_t)( last - first ) * job->width * 3;
+	size_t i = 0;
+	#ifdef IMAGE_HELPER_SSE2
+	/*	the channels convert alike, no need to de-interleave	*/
+	for( ; i + 8 <= n; i += 8 )
+	{
+		__m128i lo = pack_half_SSE2( _mm_loadu_ps( src + i ) );
+		__m128i hi = pack_half_SSE2( _mm_loadu_ps( src + i + 4 ) );
+		/*	halves are at most 0x7BFF, so the signed pack is fine	*/
+		_mm_storeu_si128( (__m128i*)( dst + i ), _mm_packs_epi32( lo, hi ) );
+	}
+	#endif
+	for( ; i < n; ++i )
+	{
+		dst[i] = pack_half( src[i] );
+	}
+}
+
+static int
+	pack_HDR_image
+	(
+		const float* const rgb,
+		void *packed,
+		int width, int height,
+		soil_parallel_job rows_func
+	)
+{
+	pack_HDR_job job;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(rgb == NULL) || (packed == NULL) )
+	{
+		return 0;
+	}
+	job.rgb = rgb;
+	job.packed = packed;
+	job.width = width;
+	soil_parallel_for( height, 64, rows_func, &job );
+	return 1;
+}
+
+int
+	RGBF_to_RGB9E5
+	(
+		const float* const rgb,
+		unsigned int *packed,
+		int width, int height
+	)
+{
+	return pack_HDR_image( rgb, packed, width, height, pack_RGB9E5_rows );
+}
+
+int
+	RGBF_to_RGB16F
+	(
+		const float* const rgb,
+		unsigned short *packed,
+		int width, int height
+	)
+{
+	return pack_HDR_image( rgb, packed, width, height, pack_RGB16F_rows );
+}
@@ -82,6 +82,34 @@ int
 		int width, int height, int channels
 	);
 
+/**	The steps postprocess_image can do	**/
+enum
+{
+	IMAGE_POSTPROCESS_INVERT_Y = 1,
+	IMAGE_POSTPROCESS_NTSC_SAFE_RGB = 2,
+	IMAGE_POSTPROCESS_MULTIPLY_ALPHA = 4,
+	IMAGE_POSTPROCESS_YCOCG = 8
+};
+
+/**
+	This function copies an image into processed, flipping it
+	and doing what scale_image_RGB_to_NTSC_safe, the alpha
+	pre-multiplication and convert_RGB_to_YCoCg do, in that
+	order, in a single pass.  The result is identical to
+	running the separate steps one after the other.
+	orig and processed may be the same buffer, unless the
+	image is flipped.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	postprocess_image
+	(
+		const unsigned char* const orig,
+		unsigned char* processed,
+		int width, int height, int channels,
+		unsigned int postprocess_flags
+	);
+
 /**
 	Converts an HDR image from an array
 	of unsigned chars (RGBE) to RGBdivA
@@ -108,6 +136,36 @@ int
 		int rescale_to_max
 	);
 
+/**
+	Converts an HDR image from RGB floats to packed
+	GL_RGB9_E5 texels (GL_UNSIGNED_INT_5_9_9_9_REV),
+	4 bytes per pixel.  Negative and NaN values become 0,
+	values over 65408 are clamped.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	RGBF_to_RGB9E5
+	(
+		const float* const rgb,
+		unsigned int *packed,
+		int width, int height
+	);
+
+/**
+	Converts an HDR image from RGB floats to RGB
+	half floats (GL_HALF_FLOAT), 6 bytes per pixel.
+	Negative and NaN values become 0, values over
+	65504 are clamped.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	RGBF_to_RGB16F
+	(
+		const float* const rgb,
+		unsigned short *packed,
+		int width, int height
+	);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,7 @@
  * 	Supports 1, 3 or 4 component input. (luminance, RGB or RGBX)
  *
  * Latest revisions:
+ *	1.54 (SOIL2) Encodes MCU rows in parallel, separated by restart markers. SSE2 DCT, quantization and color conversion.
  *	1.53 (2016-07-08) Added support to compile as plain C code.
  *	1.52 (2012-22-11) Added support for specifying Luminance, RGB, or RGBA via comp(onents) argument (1, 3 and 4 respectively). 
  *	1.51 (2012-19-11) Fixed some warnings
@@ -30,6 +31,11 @@
 // Returns false on failure
 extern int jo_write_jpg(const char *filename, const void *data, int width, int height, int comp, int quality);
 
+// Each row of 8x8 blocks is a restart interval, so the rows can be encoded on
+// several threads: #define JO_JPEG_PARALLEL_FOR(count,job,user_data) to run
+// void job(void *user_data, int first, int last) over [0,count).
+// SSE2 is used when available, #define JO_JPEG_NO_SIMD to disable it.
+
 #endif // JO_INCLUDE_JPEG_H
 
 #ifndef JO_JPEG_HEADER_FILE_ONLY
@@ -40,24 +46,65 @@ extern int jo_write_jpg(const char *filename, const void *data, int width, int h
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#ifndef JO_JPEG_PARALLEL_FOR
+#define JO_JPEG_PARALLEL_FOR(count,job,user_data) job(user_data, 0, count)
+#endif
+
+#if !defined(JO_JPEG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JO_JPEG_SSE2
+#include <emmintrin.h>
+#endif
+
 static const unsigned char s_jo_ZigZag[] = { 0,1,5,6,14,15,27,28,2,4,7,13,16,26,29,42,3,8,12,17,25,30,41,43,9,11,18,24,31,40,44,53,10,19,23,32,39,45,52,54,20,22,33,38,46,51,55,60,21,34,37,47,50,56,59,61,35,36,48,49,57,58,62,63 };
 
-static void jo_writeBits(FILE *fp, int *bitBuf, int *bitCnt, const unsigned short *bs) {
-	*bitCnt += bs[1];
-	*bitBuf |= bs[0] << (24 - *bitCnt);
-	while(*bitCnt >= 8) {
-		unsigned char c = (*bitBuf >> 16) & 255;
-		putc(c, fp);
+// Entropy coded data of a run of block rows, kept in memory until it's written out in order
+typedef struct {
+	unsigned char *data;
+	int size, capacity;
+	int bitBuf, bitCnt;
+	int failed;
+} jo_segment;
+
+static void jo_putc(jo_segment *seg, unsigned char c) {
+	if(seg->size == seg->capacity) {
+		int capacity = seg->capacity ? seg->capacity * 2 : 4096;
+		unsigned char *data = (unsigned char *)realloc(seg->data, capacity);
+		if(!data) {
+			seg->failed = 1;
+			return;
+		}
+		seg->data = data;
+		seg->capacity = capacity;
+	}
+	seg->data[seg->size++] = c;
+}
+
+static void jo_writeBits(jo_segment *seg, const unsigned short *bs) {
+	seg->bitCnt += bs[1];
+	seg->bitBuf |= bs[0] << (24 - seg->bitCnt);
+	while(seg->bitCnt >= 8) {
+		unsigned char c = (seg->bitBuf >> 16) & 255;
+		jo_putc(seg, c);
 		if(c == 255) {
-			putc(0, fp);
+			jo_putc(seg, 0);
 		}
-		*bitBuf <<= 8;
-		*bitCnt -= 8;
+		seg->bitBuf <<= 8;
+		seg->bitCnt -= 8;
 	}
 }
 
+// Pads the last byte with 1s, as needed before a marker
+static void jo_flushBits(jo_segment *seg) {
+	static const unsigned short fillBits[] = {0x7F, 7};
+	jo_writeBits(seg, fillBits);
+	seg->bitBuf = 0;
+	seg->bitCnt = 0;
+}
+
+#ifndef JO_JPEG_SSE2
 static void jo_DCT(float *d0, float *d1, float *d2, float *d3, float *d4, float *d5, float *d6, float *d7) {
 	float tmp0 = *d0 + *d7;
 	float tmp7 = *d0 - *d7;
@@ -100,6 +147,71 @@ static void jo_DCT(float *d0, float *d1, float *d2, float *d3, float *d4, float
 	*d1 = z11 + z4;
 	*d7 = z11 - z4;
 } 
+#endif
+
+#ifdef JO_JPEG_SSE2
+// jo_DCT on four independent lanes, with the same operations in the same order
+static void jo_DCT_SSE2(__m128 *d0, __m128 *d1, __m128 *d2, __m128 *d3, __m128 *d4, __m128 *d5, __m128 *d6, __m128 *d7) {
+	__m128 tmp0 = _mm_add_ps(*d0, *d7);
+	__m128 tmp7 = _mm_sub_ps(*d0, *d7);
+	__m128 tmp1 = _mm_add_ps(*d1, *d6);
+	__m128 tmp6 = _mm_sub_ps(*d1, *d6);
+	__m128 tmp2 = _mm_add_ps(*d2, *d5);
+	__m128 tmp5 = _mm_sub_ps(*d2, *d5);
+	__m128 tmp3 = _mm_add_ps(*d3, *d4);
+	__m128 tmp4 = _mm_sub_ps(*d3, *d4);
+
+	// Even part
+	__m128 tmp10 = _mm_add_ps(tmp0, tmp3);
+	__m128 tmp13 = _mm_sub_ps(tmp0, tmp3);
+	__m128 tmp11 = _mm_add_ps(tmp1, tmp2);
+	__m128 tmp12 = _mm_sub_ps(tmp1, tmp2);
+
+	*d0 = _mm_add_ps(tmp10, tmp11);
+	*d4 = _mm_sub_ps(tmp10, tmp11);
+
+	__m128 z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), _mm_set1_ps(0.707106781f));
+	*d2 = _mm_add_ps(tmp13, z1);
+	*d6 = _mm_sub_ps(tmp13, z1);
+
+	// Odd part
+	tmp10 = _mm_add_ps(tmp4, tmp5);
+	tmp11 = _mm_add_ps(tmp5, tmp6);
+	tmp12 = _mm_add_ps(tmp6, tmp7);
+
+	__m128 z5 = _mm_mul_ps(_mm_sub_ps(tmp10, tmp12), _mm_set1_ps(0.382683433f));
+	__m128 z2 = _mm_add_ps(_mm_mul_ps(tmp10, _mm_set1_ps(0.541196100f)), z5);
+	__m128 z4 = _mm_add_ps(_mm_mul_ps(tmp12, _mm_set1_ps(1.306562965f)), z5);
+	__m128 z3 = _mm_mul_ps(tmp11, _mm_set1_ps(0.707106781f));
+
+	__m128 z11 = _mm_add_ps(tmp7, z3);
+	__m128 z13 = _mm_sub_ps(tmp7, z3);
+
+	*d5 = _mm_add_ps(z13, z2);
+	*d3 = _mm_sub_ps(z13, z2);
+	*d1 = _mm_add_ps(z11, z4);
+	*d7 = _mm_sub_ps(z11, z4);
+}
+
+// 8x8 transpose of the block held as rows r[2*i] (left half) and r[2*i+1] (right half)
+static void jo_transpose8x8(__m128 *r) {
+	__m128 t[16];
+	int i;
+	for(i = 0; i < 16; ++i) {
+		t[i] = r[i];
+	}
+	_MM_TRANSPOSE4_PS(t[0], t[2], t[4], t[6]);
+	_MM_TRANSPOSE4_PS(t[1], t[3], t[5], t[7]);
+	_MM_TRANSPOSE4_PS(t[8], t[10], t[12], t[14]);
+	_MM_TRANSPOSE4_PS(t[9], t[11], t[13], t[15]);
+	for(i = 0; i < 4; ++i) {
+		r[2*i] = t[2*i];		// top left stays
+		r[2*i+1] = t[8+2*i];	// bottom left goes top right
+		r[8+2*i] = t[2*i+1];	// top right goes bottom left
+		r[8+2*i+1] = t[8+2*i+1];
+	}
+}
+#endif
 
 static void jo_calcBits(int val, unsigned short bits[2]) {
 	int tmp1 = val < 0 ? -val : val;
@@ -111,11 +223,42 @@ static void jo_calcBits(int val, unsigned short bits[2]) {
 	bits[0] = val & ((1<<bits[1])-1);
 }
 
-static int jo_processDU(FILE *fp, int *bitBuf, int *bitCnt, float *CDU, float *fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
+static int jo_processDU(jo_segment *seg, float *CDU, const float *fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
 	const unsigned short EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
 	const unsigned short M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
-	int dataOff, i, nrmarker;
-	
+	int i, nrmarker;
+	int DU[64];
+
+#ifdef JO_JPEG_SSE2
+	{
+		__m128 r[16];
+		int q[64];
+		for(i = 0; i < 16; ++i) {
+			r[i] = _mm_loadu_ps(&CDU[i*4]);
+		}
+		// DCT rows: transposed, they are columns of four lanes
+		jo_transpose8x8(r);
+		jo_DCT_SSE2(&r[0], &r[2], &r[4], &r[6], &r[8], &r[10], &r[12], &r[14]);
+		jo_DCT_SSE2(&r[1], &r[3], &r[5], &r[7], &r[9], &r[11], &r[13], &r[15]);
+		jo_transpose8x8(r);
+		// DCT columns
+		jo_DCT_SSE2(&r[0], &r[2], &r[4], &r[6], &r[8], &r[10], &r[12], &r[14]);
+		jo_DCT_SSE2(&r[1], &r[3], &r[5], &r[7], &r[9], &r[11], &r[13], &r[15]);
+		// Quantize/descale, rounding half away from zero
+		for(i = 0; i < 16; ++i) {
+			__m128 v = _mm_mul_ps(r[i], _mm_loadu_ps(&fdtbl[i*4]));
+			__m128 sign = _mm_and_ps(v, _mm_set1_ps(-0.0f));
+			__m128i t = _mm_cvttps_epi32(_mm_add_ps(_mm_xor_ps(v, sign), _mm_set1_ps(0.5f)));
+			__m128i neg = _mm_srai_epi32(_mm_castps_si128(sign), 31);
+			_mm_storeu_si128((__m128i *)&q[i*4], _mm_sub_epi32(_mm_xor_si128(t, neg), neg));
+		}
+		// zigzag
+		for(i = 0; i < 64; ++i) {
+			DU[s_jo_ZigZag[i]] = q[i];
+		}
+	}
+#else
+	int dataOff;
 	// DCT rows
 	for(dataOff=0; dataOff<64; dataOff+=8) {
 		jo_DCT(&CDU[dataOff], &CDU[dataOff+1], &CDU[dataOff+2], &CDU[dataOff+3], &CDU[dataOff+4], &CDU[dataOff+5], &CDU[dataOff+6], &CDU[dataOff+7]);
@@ -125,21 +268,21 @@ static int jo_processDU(FILE *fp, int *bitBuf, int *bitCnt, float *CDU, float *f
 		jo_DCT(&CDU[dataOff], &CDU[dataOff+8], &CDU[dataOff+16], &CDU[dataOff+24], &CDU[dataOff+32], &CDU[dataOff+40], &CDU[dataOff+48], &CDU[dataOff+56]);
 	}
 	// Quantize/descale/zigzag the coefficients
-	int DU[64];
 	for(i=0; i<64; ++i) {
 		float v = CDU[i]*fdtbl[i];
 		DU[s_jo_ZigZag[i]] = (int)(v < 0 ? ceilf(v - 0.5f) : floorf(v + 0.5f));
 	}
+#endif
 
 	// Encode DC
 	int diff = DU[0] - DC; 
 	if (diff == 0) {
-		jo_writeBits(fp, bitBuf, bitCnt, HTDC[0]);
+		jo_writeBits(seg, HTDC[0]);
 	} else {
 		unsigned short bits[2];
 		jo_calcBits(diff, bits);
-		jo_writeBits(fp, bitBuf, bitCnt, HTDC[bits[1]]);
-		jo_writeBits(fp, bitBuf, bitCnt, bits);
+		jo_writeBits(seg, HTDC[bits[1]]);
+		jo_writeBits(seg, bits);
 	}
 	// Encode ACs
 	int end0pos = 63;
@@ -147,7 +290,7 @@ static int jo_processDU(FILE *fp, int *bitBuf, int *bitCnt, float *CDU, float *f
 	}
 	// end0pos = first element in reverse order !=0
 	if(end0pos == 0) {
-		jo_writeBits(fp, bitBuf, bitCnt, EOB);
+		jo_writeBits(seg, EOB);
 		return DU[0];
 	}
 	for(i = 1; i <= end0pos; ++i) {
@@ -158,20 +301,105 @@ static int jo_processDU(FILE *fp, int *bitBuf, int *bitCnt, float *CDU, float *f
 		if ( nrzeroes >= 16 ) {
 			int lng = nrzeroes>>4;
 			for (nrmarker=1; nrmarker <= lng; ++nrmarker)
-				jo_writeBits(fp, bitBuf, bitCnt, M16zeroes);
+				jo_writeBits(seg, M16zeroes);
 			nrzeroes &= 15;
 		}
 		unsigned short bits[2];
 		jo_calcBits(DU[i], bits);
-		jo_writeBits(fp, bitBuf, bitCnt, HTAC[(nrzeroes<<4)+bits[1]]);
-		jo_writeBits(fp, bitBuf, bitCnt, bits);
+		jo_writeBits(seg, HTAC[(nrzeroes<<4)+bits[1]]);
+		jo_writeBits(seg, bits);
 	}
 	if(end0pos != 63) {
-		jo_writeBits(fp, bitBuf, bitCnt, EOB);
+		jo_writeBits(seg, EOB);
 	}
 	return DU[0];
 }
 
+// Shared by the threads encoding block rows
+typedef struct {
+	const unsigned char *imageData;
+	int width, height, comp, rowCount;
+	const float *fdtbl_Y, *fdtbl_UV;
+	const unsigned short (*YDC_HT)[2], (*UVDC_HT)[2], (*YAC_HT)[2], (*UVAC_HT)[2];
+	jo_segment *segments;
+} jo_encoder;
+
+// RGB to YCbCr of the 8x8 block at x, y, repeating the last row and column past the edges
+static void jo_convertBlock(const jo_encoder *enc, int x, int y, float *YDU, float *UDU, float *VDU) {
+	const unsigned char *imageData = enc->imageData;
+	int width = enc->width, height = enc->height, comp = enc->comp;
+	int ofsG = comp > 1 ? 1 : 0, ofsB = comp > 1 ? 2 : 0;
+	int row, col, pos;
+	float R[64], G[64], B[64];
+	for(row = y, pos = 0; row < y+8; ++row) {
+#ifdef JO_JPEG_SSE2
+		if(comp == 4 && row < height && x+8 <= width) {
+			// two RGBX quads, the bytes pulled apart with masks and shifts
+			const unsigned char *p = imageData + (size_t)row*width*4 + x*4;
+			__m128i mask = _mm_set1_epi32(0xFF);
+			int half;
+			for(half = 0; half < 2; ++half, pos += 4) {
+				__m128i px = _mm_loadu_si128((const __m128i *)(p + half*16));
+				_mm_storeu_ps(&R[pos], _mm_cvtepi32_ps(_mm_and_si128(px, mask)));
+				_mm_storeu_ps(&G[pos], _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask)));
+				_mm_storeu_ps(&B[pos], _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask)));
+			}
+			continue;
+		}
+#endif
+		for(col = x; col < x+8; ++col, ++pos) {
+			int p = row*width*comp + col*comp;
+			if(row >= height) {
+				p -= width*comp*(row+1 - height);
+			}
+			if(col >= width) {
+				p -= comp*(col+1 - width);
+			}
+			R[pos] = imageData[p+0];
+			G[pos] = imageData[p+ofsG];
+			B[pos] = imageData[p+ofsB];
+		}
+	}
+#ifdef JO_JPEG_SSE2
+	for(pos = 0; pos < 64; pos += 4) {
+		__m128 r = _mm_loadu_ps(&R[pos]), g = _mm_loadu_ps(&G[pos]), b = _mm_loadu_ps(&B[pos]);
+		_mm_storeu_ps(&YDU[pos], _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(+0.29900f), r), _mm_mul_ps(_mm_set1_ps(0.58700f), g)), _mm_mul_ps(_mm_set1_ps(0.11400f), b)), _mm_set1_ps(128)));
+		_mm_storeu_ps(&UDU[pos], _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(-0.16874f), r), _mm_mul_ps(_mm_set1_ps(0.33126f), g)), _mm_mul_ps(_mm_set1_ps(0.50000f), b)));
+		_mm_storeu_ps(&VDU[pos], _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(+0.50000f), r), _mm_mul_ps(_mm_set1_ps(0.41869f), g)), _mm_mul_ps(_mm_set1_ps(0.08131f), b)));
+	}
+#else
+	for(pos = 0; pos < 64; ++pos) {
+		float r = R[pos], g = G[pos], b = B[pos];
+		YDU[pos]=+0.29900f*r+0.58700f*g+0.11400f*b-128;
+		UDU[pos]=-0.16874f*r-0.33126f*g+0.50000f*b;
+		VDU[pos]=+0.50000f*r-0.41869f*g-0.08131f*b;
+	}
+#endif
+}
+
+// Encodes block rows [first, last) into segments[first], each row ending on a restart marker but the last
+static void jo_encodeRows(void *user_data, int first, int last) {
+	jo_encoder *enc = (jo_encoder *)user_data;
+	jo_segment *seg = &enc->segments[first];
+	int blockRow, x;
+	for(blockRow = first; blockRow < last; ++blockRow) {
+		int DCY=0, DCU=0, DCV=0;
+		for(x = 0; x < enc->width; x += 8) {
+			float YDU[64], UDU[64], VDU[64];
+			jo_convertBlock(enc, x, blockRow*8, YDU, UDU, VDU);
+			DCY = jo_processDU(seg, YDU, enc->fdtbl_Y, DCY, enc->YDC_HT, enc->YAC_HT);
+			DCU = jo_processDU(seg, UDU, enc->fdtbl_UV, DCU, enc->UVDC_HT, enc->UVAC_HT);
+			DCV = jo_processDU(seg, VDU, enc->fdtbl_UV, DCV, enc->UVDC_HT, enc->UVAC_HT);
+		}
+		// Do the bit alignment of the RSTn or EOI marker
+		jo_flushBits(seg);
+		if(blockRow + 1 < enc->rowCount) {
+			jo_putc(seg, 0xFF);
+			jo_putc(seg, (unsigned char)(0xD0 + (blockRow & 7)));
+		}
+	}
+}
+
 int jo_write_jpg(const char *filename, const void *data, int width, int height, int comp, int quality) {
 	// Constants that don't pollute global namespace
 	static const unsigned char std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
@@ -240,7 +468,7 @@ int jo_write_jpg(const char *filename, const void *data, int width, int height,
 	static const int YQT[] = {16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99};
 	static const int UVQT[] = {17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99};
 	static const float aasf[] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f, 1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
-	int i, row, col, x, y, k, pos;
+	int i, row, col, k;
 	
 	if(!data || !filename || !width || !height || comp > 4 || comp < 1 || comp == 2) {
 		return 0;
@@ -290,51 +518,50 @@ int jo_write_jpg(const char *filename, const void *data, int width, int height,
 	putc(0x11, fp); // HTUACinfo
 	fwrite(std_ac_chrominance_nrcodes+1, sizeof(std_ac_chrominance_nrcodes)-1, 1, fp);
 	fwrite(std_ac_chrominance_values, sizeof(std_ac_chrominance_values), 1, fp);
+	// Restart interval: one row of blocks
+	const unsigned char dri[] = { 0xFF,0xDD,0,4,(unsigned char)(((width+7)/8)>>8),(unsigned char)(((width+7)/8)&0xFF) };
+	fwrite(dri, sizeof(dri), 1, fp);
 	static const unsigned char head2[] = { 0xFF,0xDA,0,0xC,3,1,0,2,0x11,3,0x11,0,0x3F,0 };
 	fwrite(head2, sizeof(head2), 1, fp);
 
-	// Encode 8x8 macroblocks
-	const unsigned char *imageData = (const unsigned char *)data;
-	int DCY=0, DCU=0, DCV=0;
-	int bitBuf=0, bitCnt=0;
-	int ofsG = comp > 1 ? 1 : 0, ofsB = comp > 1 ? 2 : 0;
-	for(y = 0; y < height; y += 8) {
-		for(x = 0; x < width; x += 8) {
-			float YDU[64], UDU[64], VDU[64];
-			for(row = y, pos = 0; row < y+8; ++row) {
-				for(col = x; col < x+8; ++col, ++pos) {
-					int p = row*width*comp + col*comp;
-					if(row >= height) {
-						p -= width*comp*(row+1 - height);
-					}
-					if(col >= width) {
-						p -= comp*(col+1 - width);
-					}
-
-					float r = imageData[p+0], g = imageData[p+ofsG], b = imageData[p+ofsB];
-					YDU[pos]=+0.29900f*r+0.58700f*g+0.11400f*b-128;
-					UDU[pos]=-0.16874f*r-0.33126f*g+0.50000f*b;
-					VDU[pos]=+0.50000f*r-0.41869f*g-0.08131f*b;
-				}
-			}
+	// Encode 8x8 macroblocks, a row of them per restart interval
+	jo_encoder enc;
+	enc.imageData = (const unsigned char *)data;
+	enc.width = width;
+	enc.height = height;
+	enc.comp = comp;
+	enc.rowCount = (height + 7) / 8;
+	enc.fdtbl_Y = fdtbl_Y;
+	enc.fdtbl_UV = fdtbl_UV;
+	enc.YDC_HT = YDC_HT;
+	enc.UVDC_HT = UVDC_HT;
+	enc.YAC_HT = YAC_HT;
+	enc.UVAC_HT = UVAC_HT;
+	enc.segments = (jo_segment *)calloc(enc.rowCount, sizeof(jo_segment));
+	if(!enc.segments) {
+		fclose(fp);
+		return 0;
+	}
+	JO_JPEG_PARALLEL_FOR(enc.rowCount, jo_encodeRows, &enc);
 
-			DCY = jo_processDU(fp, &bitBuf, &bitCnt, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-			DCU = jo_processDU(fp, &bitBuf, &bitCnt, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-			DCV = jo_processDU(fp, &bitBuf, &bitCnt, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+	int failed = 0;
+	for(i = 0; i < enc.rowCount; ++i) {
+		failed |= enc.segments[i].failed;
+		if(!failed && enc.segments[i].size) {
+			failed = fwrite(enc.segments[i].data, enc.segments[i].size, 1, fp) != 1;
 		}
+		free(enc.segments[i].data);
 	}
-	
-	// Do the bit alignment of the EOI marker
-	static const unsigned short fillBits[] = {0x7F, 7};
-	jo_writeBits(fp, &bitBuf, &bitCnt, fillBits);
+	free(enc.segments);
 
 	// EOI
 	putc(0xFF, fp);
 	putc(0xD9, fp);
 
-	fclose(fp);
-	return 1;
+	if(fclose(fp) != 0) {
+		failed = 1;
+	}
+	return !failed;
 }
 
 #endif
-
@@ -475,6 +475,17 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 // calling it will fail to link if your compiler doesn't
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// as above, the per-thread versions of the unpremultiply and iphone options
+STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply);
+STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
+
+// decode JPEGs at 1/2, 1/4 or 1/8 of their size (scale_shift 1, 2 or 3; 0 is full
+// size). only the low frequency coefficients are inverse transformed, so this is
+// much cheaper than a full decode followed by a downsample. stbi_info reports the
+// scaled size too; other formats are not affected
+STBIDEF void stbi_set_jpeg_scale_on_load(int scale_shift);
+STBIDEF void stbi_set_jpeg_scale_on_load_thread(int scale_shift);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -699,7 +710,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -710,7 +721,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -723,6 +734,35 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels for the JPEG decoder, compiled for the target regardless of the
+// build flags and only used if the CPU has them. #define STBI_NO_AVX2 to leave them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) && \
+    (defined(__AVX2__) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define STBI__AVX2_TARGET
+#endif
+
+static int stbi__avx2_available(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info,1);
+   // the OS has to save the YMM registers too
+   if (((info[2] >> 27) & 1) == 0 || (_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info,7,0);
+   return ((info[1] >> 5) & 1) != 0;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -755,6 +795,7 @@ typedef struct
    int read_from_callbacks;
    int buflen;
    stbi_uc buffer_start[128];
+   int callback_already_read;
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
@@ -768,6 +809,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
    s->io.read = NULL;
    s->read_from_callbacks = 0;
+   s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
 }
@@ -779,7 +821,8 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
-   s->img_buffer_original = s->buffer_start;
+   s->callback_already_read = 0;
+   s->img_buffer = s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
 }
@@ -1530,6 +1573,7 @@ enum
 static void stbi__refill_buffer(stbi__context *s)
 {
    int n = (s->io.read)(s->io_user_data,(char*)s->buffer_start,s->buflen);
+   s->callback_already_read += (int) (s->img_buffer - s->img_buffer_original);
    if (n == 0) {
       // at end of file, treat same as if from memory, but need to handle case
       // where s->img_buffer isn't pointing to safe memory, e.g. 0-byte file
@@ -1904,6 +1948,10 @@ typedef struct
       stbi_uc *linebuf;
       short   *coeff;   // progressive only
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
+
+      // blocks are transformed to idct_size pixels square, 8 >> scale_shift
+      int      scale_shift, idct_size;
+      void   (*idct_kernel)(stbi_uc *out, int out_stride, short data[64]);
    } img_comp[4];
 
    stbi__uint32   code_buffer; // jpeg entropy-coded buffer
@@ -1924,10 +1972,15 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+// reduced size decoding, see stbi_set_jpeg_scale_on_load
+   int scale_shift;
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_v_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -2620,6 +2673,176 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT, bit-identical to the SSE2 one: each row of 32-bit
+// intermediates fits in one register instead of two. Rows go into the passes
+// "spread" (cols 0-3 in the low lane, cols 4-7 in the high one), so 16-bit
+// pairs interleave without crossing lanes; the transposes stay SSE2.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // 16-bit row to [c0-3 c0-3 | c4-7 c4-7]
+   #define dct_spread(r)  _mm256_permute4x64_epi64(_mm256_castsi128_si256(r), 0x50)
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4)
+
+   // butterfly a/b, add bias, then shift by "s" and pack back to 16-bit rows
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_add_epi32(abiased, b); \
+         __m256i dif = _mm256_sub_epi32(abiased, b); \
+         __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(sum, s), _mm256_srai_epi32(dif, s)); \
+         out0 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08)); \
+         out1 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x0d)); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         __m256i s0 = dct_spread(row0), s1 = dct_spread(row1), s2 = dct_spread(row2), s3 = dct_spread(row3); \
+         __m256i s4 = dct_spread(row4), s5 = dct_spread(row5), s6 = dct_spread(row6), s7 = dct_spread(row7); \
+         /* even part */ \
+         dct_rot(t2e,t3e, s2,s6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(s0, s4); \
+         __m256i dif04 = _mm256_sub_epi16(s0, s4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, s7,s3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, s5,s1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(s1, s7); \
+         __m256i sum35 = _mm256_add_epi16(s3, s5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_spread
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2862,6 +3085,21 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// skips the entropy coded data of a scan, up to the next marker that isn't a restart
+static int stbi__jpeg_skip_scan(stbi__jpeg *z)
+{
+   while (!stbi__at_eof(z->s)) {
+      int x = stbi__get8(z->s);
+      if (x != 0xff) continue;
+      do x = stbi__get8(z->s); while (x == 0xff && !stbi__at_eof(z->s));
+      if (x != 0 && !STBI__RESTART(x)) {
+         z->marker = (unsigned char) x;
+         return 1;
+      }
+   }
+   return 1;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2880,7 +3118,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->img_comp[n].idct_kernel(z->img_comp[n].data+(z->img_comp[n].w2*j+i)*z->img_comp[n].idct_size, z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2904,11 +3142,11 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = (i*z->img_comp[n].h + x)*z->img_comp[n].idct_size;
+                        int y2 = (j*z->img_comp[n].v + y)*z->img_comp[n].idct_size;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        z->img_comp[n].idct_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -2924,6 +3162,10 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          return 1;
       }
    } else {
+      // AC scans are of one component; at 1/8 scale it only needs the DC. a band
+      // can't be skipped at the other scales, later refinement scans may span it
+      if (z->spec_start != 0 && z->img_comp[z->order[0]].scale_shift == 3)
+         return stbi__jpeg_skip_scan(z);
       if (z->scan_n == 1) {
          int i,j;
          int n = z->order[0];
@@ -3005,7 +3247,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->img_comp[n].idct_kernel(z->img_comp[n].data+(z->img_comp[n].w2*j+i)*z->img_comp[n].idct_size, z->img_comp[n].w2, data);
             }
          }
       }
@@ -3176,6 +3418,90 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
    return why;
 }
 
+// reduced size IDCTs: the N-point inverse transform of the lowest N x N
+// coefficients, which samples the 8-point one at the centre of each 8/N x 8/N
+// box. in 12-bit fixed point, 0.5*C(k)*cos((2m+1)k*pi/2N) works out to:
+#define stbi__idct_scaled_c0  1448  // 0.5*cos(pi/4), for N=4 and N=2
+#define stbi__idct_scaled_c1  1892  // 0.5*cos(pi/8), N=4
+#define stbi__idct_scaled_c3   784  // 0.5*cos(3pi/8), N=4
+
+// 4-point butterfly, the even half from f0,f2 and the odd half from f1,f3
+#define STBI__IDCT_4(o0,o1,o2,o3, f0,f1,f2,f3) \
+   { \
+      int e0 = ((f0) + (f2)) * stbi__idct_scaled_c0; \
+      int e1 = ((f0) - (f2)) * stbi__idct_scaled_c0; \
+      int d0 = (f1) * stbi__idct_scaled_c1 + (f3) * stbi__idct_scaled_c3; \
+      int d1 = (f1) * stbi__idct_scaled_c3 - (f3) * stbi__idct_scaled_c1; \
+      o0 = e0 + d0; \
+      o1 = e1 + d1; \
+      o2 = e1 - d1; \
+      o3 = e0 - d0; \
+   }
+
+// the columns keep one fractional bit so the rows can't overflow; the rows
+// fold the +128 level shift into their rounding
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   int i,tmp[16];
+   for (i=0; i < 4; ++i) {
+      int t0,t1,t2,t3;
+      STBI__IDCT_4(t0,t1,t2,t3, data[i], data[8+i], data[16+i], data[24+i]);
+      tmp[   i] = (t0 + 1024) >> 11;
+      tmp[4 +i] = (t1 + 1024) >> 11;
+      tmp[8 +i] = (t2 + 1024) >> 11;
+      tmp[12+i] = (t3 + 1024) >> 11;
+   }
+   for (i=0; i < 4; ++i, out += out_stride) {
+      int t0,t1,t2,t3, *row = tmp + i*4;
+      const int bias = (128<<13) + (1<<12);
+      STBI__IDCT_4(t0,t1,t2,t3, row[0], row[1], row[2], row[3]);
+      out[0] = stbi__clamp((t0 + bias) >> 13);
+      out[1] = stbi__clamp((t1 + bias) >> 13);
+      out[2] = stbi__clamp((t2 + bias) >> 13);
+      out[3] = stbi__clamp((t3 + bias) >> 13);
+   }
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   const int bias = (128<<13) + (1<<12);
+   int t0 = ((data[0] + data[8]) * stbi__idct_scaled_c0 + 1024) >> 11;
+   int t1 = ((data[1] + data[9]) * stbi__idct_scaled_c0 + 1024) >> 11;
+   int t2 = ((data[0] - data[8]) * stbi__idct_scaled_c0 + 1024) >> 11;
+   int t3 = ((data[1] - data[9]) * stbi__idct_scaled_c0 + 1024) >> 11;
+   out[0] = stbi__clamp(((t0 + t1) * stbi__idct_scaled_c0 + bias) >> 13);
+   out[1] = stbi__clamp(((t0 - t1) * stbi__idct_scaled_c0 + bias) >> 13);
+   out += out_stride;
+   out[0] = stbi__clamp(((t2 + t3) * stbi__idct_scaled_c0 + bias) >> 13);
+   out[1] = stbi__clamp(((t2 - t3) * stbi__idct_scaled_c0 + bias) >> 13);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp((data[0] + 4 + (128<<3)) >> 3);
+}
+
+// subsampled components are transformed to a bigger size, by as much as they
+// would be upsampled, so they come out at the scaled size of the image
+static void stbi__jpeg_setup_component_scale(stbi__jpeg *z, int n)
+{
+   static void (* const kernels[4])(stbi_uc *out, int out_stride, short data[64]) = {
+      NULL, stbi__idct_block_4x4, stbi__idct_block_2x2, stbi__idct_block_1x1
+   };
+   int hs = z->img_h_max / z->img_comp[n].h;
+   int vs = z->img_v_max / z->img_comp[n].v;
+   int shift = z->scale_shift;
+   while (shift > 0 && hs % 2 == 0 && vs % 2 == 0) {
+      hs /= 2;
+      vs /= 2;
+      --shift;
+   }
+   z->img_comp[n].scale_shift = shift;
+   z->img_comp[n].idct_size = 8 >> shift;
+   z->img_comp[n].idct_kernel = shift ? kernels[shift] : z->idct_block_kernel;
+}
+
 static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 {
    stbi__context *s = z->s;
@@ -3235,8 +3561,9 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      stbi__jpeg_setup_component_scale(z, i);
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * z->img_comp[i].idct_size;
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * z->img_comp[i].idct_size;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3246,10 +3573,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // coefficients are kept for every 8x8 block, whatever the output scale
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3704,12 +4031,200 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the SSE2 kernels above, 16 or 32 pixels at a time; the results are identical
+
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_v_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i = 0;
+   __m256i zero = _mm256_setzero_si256();
+   __m256i bias = _mm256_set1_epi16(2);
+   for (; i+32 <= w; i += 32) {
+      __m256i nearb = _mm256_loadu_si256((const __m256i *) (in_near + i));
+      __m256i farb  = _mm256_loadu_si256((const __m256i *) (in_far + i));
+      // 3*near + far + 2, in two halves of 16-bit lanes
+      __m256i nl = _mm256_unpacklo_epi8(nearb, zero), nh = _mm256_unpackhi_epi8(nearb, zero);
+      __m256i fl = _mm256_unpacklo_epi8(farb, zero),  fh = _mm256_unpackhi_epi8(farb, zero);
+      __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(nl, _mm256_slli_epi16(nl, 1)), fl), bias);
+      __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(nh, _mm256_slli_epi16(nh, 1)), fh), bias);
+      _mm256_storeu_si256((__m256i *) (out + i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2)));
+   }
+   for (; i < w; ++i)
+      out[i] = stbi__div4(3*in_near[i] + in_far[i] + 2);
+   STBI_NOTUSED(hs);
+   return out;
+}
+
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_h_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i;
+   stbi_uc *input = in_near;
+
+   if (w == 1) {
+      // if only one sample, can't do any interpolation
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+   // the neighbours come straight from memory, so no shuffling across lanes
+   for (i=1; i+16 < w; i += 16) {
+      __m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i)));
+      __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i - 1)));
+      __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i + 1)));
+      __m256i curb = _mm256_add_epi16(_mm256_add_epi16(curr, _mm256_slli_epi16(curr, 1)), _mm256_set1_epi16(2));
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(curb, prev), 2);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(curb, next), 2);
+      // interleaving within lanes leaves 0-7|16-23 and 8-15|24-31, which the pack puts back in order
+      __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+      __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // need to generate 2x2 samples for every one in input
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // "prev" is current row shifted right by 1 pixel with t1 inserted,
+      // "next" shifted left by 1 with the first pixel of the next block added;
+      // the lane swaps feed the pixel that crosses between the two halves.
+      __m256i lo_up = _mm256_permute2x128_si256(curr, curr, 0x08);
+      __m256i hi_dn = _mm256_permute2x128_si256(curr, curr, 0x81);
+      __m256i prev = _mm256_insert_epi16(_mm256_alignr_epi8(curr, lo_up, 14), t1, 0);
+      __m256i next = _mm256_insert_epi16(_mm256_alignr_epi8(hi_dn, curr, 2), 3*in_near[i+16] + in_far[i+16], 15);
+
+      // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+      // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), _mm256_set1_epi16(8));
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // interleave even and odd pixels, then undo scaling.
+      __m256i de0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i de1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 4) {
+      __m256i signflip  = _mm256_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi8((char) (unsigned char) 128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      for (; i+15 < count; i += 16) {
+         // load, pixels 0-7 to the low lane and 8-15 to the high one
+         __m256i y_bytes  = _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (y+i))), 0x50);
+         __m256i cr_bytes = _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (pcr+i))), 0x50);
+         __m256i cb_bytes = _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (pcb+i))), 0x50);
+         __m256i cr_biased = _mm256_xor_si256(cr_bytes, signflip); // -128
+         __m256i cb_biased = _mm256_xor_si256(cb_bytes, signflip); // -128
+
+         // unpack to short (and left-shift cr, cb by 8)
+         __m256i yw  = _mm256_unpacklo_epi8(y_bias, y_bytes);
+         __m256i crw = _mm256_unpacklo_epi8(_mm256_setzero_si256(), cr_biased);
+         __m256i cbw = _mm256_unpacklo_epi8(_mm256_setzero_si256(), cb_biased);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte, set up for transpose
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+         // transpose to interleave channels: o0 = pixels 0-3|8-11, o1 = 4-7|12-15
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+         _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+         out += 64;
+      }
+   }
+
+   // the rest (and step == 3) as before
+   stbi__YCbCr_to_RGB_simd(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif // STBI_AVX2
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->resample_row_v_2_kernel = stbi__resample_row_v_2;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
+   j->scale_shift = 0;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3719,6 +4234,16 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+      j->resample_row_v_2_kernel = stbi__resample_row_v_2_avx2;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3760,6 +4285,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // the blocks were decoded at reduced size, so is everything from here on
+   if (z->scale_shift) {
+      int round = (1 << z->scale_shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale_shift;
+      z->s->img_y = (z->s->img_y + round) >> z->scale_shift;
+      for (n=0; n < z->s->img_n; ++n) {
+         int shift = z->img_comp[n].scale_shift;
+         z->img_comp[n].x = (z->img_comp[n].x + (1 << shift) - 1) >> shift;
+         z->img_comp[n].y = (z->img_comp[n].y + (1 << shift) - 1) >> shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3787,16 +4324,17 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
          if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
+         // a component transformed to a bigger size needs that much less upsampling
+         r->hs      = (z->img_h_max / z->img_comp[k].h) >> (z->scale_shift - z->img_comp[k].scale_shift);
+         r->vs      = (z->img_v_max / z->img_comp[k].v) >> (z->scale_shift - z->img_comp[k].scale_shift);
          r->ystep   = r->vs >> 1;
          r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
          r->ypos    = 0;
          r->line0   = r->line1 = z->img_comp[k].data;
 
          if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+         else if (r->hs == 1 && r->vs == 2) r->resample = z->resample_row_v_2_kernel;
+         else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
          else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
          else                               r->resample = stbi__resample_row_generic;
       }
@@ -3908,6 +4446,29 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    }
 }
 
+static int stbi__jpeg_scale_on_load_global = 0;
+
+STBIDEF void stbi_set_jpeg_scale_on_load(int scale_shift)
+{
+   stbi__jpeg_scale_on_load_global = scale_shift < 0 ? 0 : scale_shift > 3 ? 3 : scale_shift;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_scale_on_load  stbi__jpeg_scale_on_load_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_scale_on_load_local, stbi__jpeg_scale_on_load_set;
+
+STBIDEF void stbi_set_jpeg_scale_on_load_thread(int scale_shift)
+{
+   stbi__jpeg_scale_on_load_local = scale_shift < 0 ? 0 : scale_shift > 3 ? 3 : scale_shift;
+   stbi__jpeg_scale_on_load_set = 1;
+}
+
+#define stbi__jpeg_scale_on_load  (stbi__jpeg_scale_on_load_set                 \
+                                    ? stbi__jpeg_scale_on_load_local            \
+                                    : stbi__jpeg_scale_on_load_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *  stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
    unsigned char* result;
@@ -3915,6 +4476,7 @@ static void *  stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   j->scale_shift = stbi__jpeg_scale_on_load;
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
    return result;
@@ -3938,8 +4500,8 @@ static int stbi__jpeg_info_raw(stbi__jpeg *j, int *x, int *y, int *comp)
       stbi__rewind( j->s );
       return 0;
    }
-   if (x) *x = j->s->img_x;
-   if (y) *y = j->s->img_y;
+   if (x) *x = (j->s->img_x + (1 << j->scale_shift) - 1) >> j->scale_shift;
+   if (y) *y = (j->s->img_y + (1 << j->scale_shift) - 1) >> j->scale_shift;
    if (comp) *comp = j->s->img_n >= 3 ? 3 : 1;
    return 1;
 }
@@ -3949,6 +4511,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
    int result;
    stbi__jpeg* j = (stbi__jpeg*) (stbi__malloc(sizeof(stbi__jpeg)));
    j->s = s;
+   j->scale_shift = stbi__jpeg_scale_on_load;
    result = stbi__jpeg_info_raw(j, x, y, comp);
    STBI_FREE(j);
    return result;
@@ -3968,6 +4531,21 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
+// on 64-bit little-endian targets the bit buffer is refilled with one unaligned
+// 8-byte load, which tops it up to at least 56 bits: enough for a whole
+// length/distance pair with their extra bits. #define STBI_NO_WIDE_REFILL to keep
+// the 32-bit buffer and the byte at a time refill everywhere
+#if !defined(STBI_NO_WIDE_REFILL) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64) || \
+     (defined(__LP64__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define STBI__ZWIDE_REFILL
+typedef unsigned long long stbi__zbits;
+#define STBI__ZREFILL_LIMIT  56
+#else
+typedef stbi__uint32 stbi__zbits;
+#define STBI__ZREFILL_LIMIT  24
+#endif
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4054,7 +4632,8 @@ typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
-   stbi__uint32 code_buffer;
+   int num_pad; // zero bytes fed to the bit buffer past the end of the input
+   stbi__zbits code_buffer;
 
    char *zout;
    char *zout_start;
@@ -4072,29 +4651,42 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+#ifdef STBI__ZWIDE_REFILL
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      // the bytes above num_bits that don't fit are loaded again by the
+      // next refill at the same position, so or-ing them in is harmless
+      stbi__zbits v;
+      memcpy(&v, z->zbuffer, 8);
+      z->code_buffer |= v << z->num_bits;
+      z->zbuffer += (63 - z->num_bits) >> 3;
+      z->num_bits |= 56;
+      return;
+   }
+#endif
    do {
-      STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      if (z->zbuffer >= z->zbuffer_end) ++z->num_pad;
+      z->code_buffer |= (stbi__zbits) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= STBI__ZREFILL_LIMIT);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
 }
 
-static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
+// decodes the code at the bottom of 'bits' (at least 16 valid) and returns its length in *size
+static int stbi__zhuffman_decode_slowpath(stbi__zhuffman *z, stbi__zbits bits, int *size)
 {
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (bits & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -4102,8 +4694,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    // code size is s, so:
    b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
    STBI_ASSERT(z->size[b] == s);
-   a->code_buffer >>= s;
-   a->num_bits -= s;
+   *size = s;
    return z->value[b];
 }
 
@@ -4114,11 +4705,14 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
    b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
    if (b) {
       s = b >> 9;
-      a->code_buffer >>= s;
-      a->num_bits -= s;
-      return b & 511;
+      b &= 511;
+   } else {
+      b = stbi__zhuffman_decode_slowpath(z, a->code_buffer, &s);
+      if (b < 0) return -1;
    }
-   return stbi__zhuffman_decode_slowpath(a, z);
+   a->code_buffer >>= s;
+   a->num_bits -= s;
+   return b;
 }
 
 static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room for n bytes
@@ -4154,11 +4748,112 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+#ifdef STBI__ZWIDE_REFILL
+// the bulk of a huffman block: runs while there are 8 bytes of input for a refill
+// and room in the output for the longest match plus an 8-byte copy overrun, so
+// no symbol needs a bounds check. the bit buffer is kept in locals, since stores
+// through zout could otherwise alias it. returns 2 at the end of the block, 1 when
+// it runs out of slack (stbi__parse_huffman_block carries on), 0 on error
+static int stbi__parse_huffman_fast(stbi__zbuf *a)
+{
+   stbi__zbits bits = a->code_buffer;
+   int nbits = a->num_bits;
+   stbi_uc *in = a->zbuffer;
+   char *zout = a->zout;
+   int r = 1;
+   while (a->zbuffer_end - in >= 8 && a->zout_end - zout >= 258 + 8) {
+      stbi__zbits v;
+      stbi_uc *p;
+      int z,s,len,dist;
+      memcpy(&v, in, 8);
+      bits |= v << nbits;
+      in += (63 - nbits) >> 3;
+      nbits |= 56;
+
+      z = a->z_length.fast[bits & STBI__ZFAST_MASK];
+      if (z) {
+         s = z >> 9;
+         z &= 511;
+      } else {
+         z = stbi__zhuffman_decode_slowpath(&a->z_length, bits, &s);
+         if (z < 0) { r = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      }
+      bits >>= s;
+      nbits -= s;
+      if (z < 256) {
+         *zout++ = (char) z;
+         continue;
+      }
+      if (z == 256) {
+         r = 2;
+         break;
+      }
+      z -= 257;
+      len = stbi__zlength_base[z];
+      s = stbi__zlength_extra[z];
+      if (s) {
+         len += (int) (bits & ((1 << s) - 1));
+         bits >>= s;
+         nbits -= s;
+      }
+      z = a->z_distance.fast[bits & STBI__ZFAST_MASK];
+      if (z) {
+         s = z >> 9;
+         z &= 511;
+      } else {
+         z = stbi__zhuffman_decode_slowpath(&a->z_distance, bits, &s);
+         if (z < 0) { r = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      }
+      bits >>= s;
+      nbits -= s;
+      dist = stbi__zdist_base[z];
+      s = stbi__zdist_extra[z];
+      if (s) {
+         dist += (int) (bits & ((1 << s) - 1));
+         bits >>= s;
+         nbits -= s;
+      }
+      if (zout - a->zout_start < dist) { r = stbi__err("bad dist","Corrupt PNG"); break; }
+      p = (stbi_uc *) (zout - dist);
+      if (dist >= 8) {
+         // 8 bytes at a time never overlap; the last copy may run up to 7 bytes past
+         // the match, which the slack above allows and the next symbols overwrite
+         char *e = zout + len;
+         while (zout < e) {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         }
+         zout = e;
+      } else if (dist == 1) {
+         memset(zout, *p, len);
+         zout += len;
+      } else {
+         while (len--) *zout++ = *p++;
+      }
+   }
+   a->code_buffer = bits;
+   a->num_bits = nbits;
+   a->zbuffer = in;
+   a->zout = zout;
+   return r;
+}
+#endif
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+#ifdef STBI__ZWIDE_REFILL
+      if (a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout >= 258 + 8) {
+         a->zout = zout;
+         z = stbi__parse_huffman_fast(a);
+         if (z != 1) return z == 2;
+         zout = a->zout;
+      }
+#endif
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4251,17 +4946,17 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
    int len,nlen,k;
    if (a->num_bits & 7)
       stbi__zreceive(a, a->num_bits & 7); // discard
-   // drain the bit-packed data into header
-   k = 0;
-   while (a->num_bits > 0) {
-      header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
-      a->code_buffer >>= 8;
-      a->num_bits -= 8;
-   }
-   STBI_ASSERT(a->num_bits == 0);
-   // now fill header the normal way
-   while (k < 4)
-      header[k++] = stbi__zget8(a);
+   // hand the whole bytes still in the bit buffer back to the input (the wide
+   // refill can hold more than the header); padding past the end is not returned
+   k = (a->num_bits >> 3) - a->num_pad;
+   if (k > 0)
+      a->zbuffer -= k;
+   a->num_bits = 0;
+   a->num_pad = 0;
+   a->code_buffer = 0;
+   // now read header the normal way
+   for (k=0; k < 4; ++k)
+      header[k] = stbi__zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
@@ -4322,6 +5017,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    if (parse_header)
       if (!stbi__parse_zlib_header(a)) return 0;
    a->num_bits = 0;
+   a->num_pad = 0;
    a->code_buffer = 0;
    do {
       final = stbi__zreceive(a,1);
@@ -4505,6 +5201,114 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// a whole pixel of 3..8 bytes in the low lanes of a register. these read and write
+// 4 or 8 bytes, so they can spill into the next pixel and must not be used for
+// the last pixel of a row
+stbi_inline static __m128i stbi__png_load_px_sse2(const stbi_uc *p, int n)
+{
+   int v;
+   if (n > 4) return _mm_loadl_epi64((const __m128i *) p);
+   memcpy(&v, p, 4);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_px_sse2(stbi_uc *p, __m128i x, int n)
+{
+   int v;
+   if (n > 4) { _mm_storel_epi64((__m128i *) p, x); return; }
+   v = _mm_cvtsi128_si32(x);
+   memcpy(p, &v, 4);
+}
+
+// floor((a+b)/2) per byte; _mm_avg_epu8 rounds up
+stbi_inline static __m128i stbi__png_avg_sse2(__m128i a, __m128i b)
+{
+   __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+   return _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+}
+
+// stbi__paeth on 8 bytes at once, in 16-bit lanes: pa = |b-c|, pb = |a-c|,
+// pc = |a+b-2c|, with the same tie order (a, then b, then c)
+stbi_inline static __m128i stbi__png_paeth_sse2(__m128i a, __m128i b, __m128i c)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a16 = _mm_unpacklo_epi8(a, zero);
+   __m128i b16 = _mm_unpacklo_epi8(b, zero);
+   __m128i c16 = _mm_unpacklo_epi8(c, zero);
+   __m128i pa = _mm_sub_epi16(b16, c16);
+   __m128i pb = _mm_sub_epi16(a16, c16);
+   __m128i pc = _mm_add_epi16(pa, pb);
+   __m128i smallest, use_a, use_b, pred;
+   pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+   pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+   pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+   use_a = _mm_cmpeq_epi16(pa, smallest);
+   use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(pb, smallest));
+   pred = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(use_a, use_b), c16),
+          _mm_or_si128(_mm_and_si128(use_a, a16), _mm_and_si128(use_b, b16)));
+   return _mm_packus_epi16(pred, pred);
+}
+
+// unfilters the first nk bytes of a row whose first pixel the caller already did,
+// for rows with as many output as input channels. the recurrence runs from pixel
+// to pixel, so sub/avg/paeth keep the previous pixel in a register and do all of
+// its bytes at once (pixels of 3 to 8 bytes); up has no recurrence and goes 16
+// bytes at a time. nk must leave at least one pixel for the byte loop; returns
+// how many bytes were done
+static int stbi__png_unfilter_row_sse2(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int filter, int nk, int n)
+{
+   __m128i a, b, c, x;
+   int k = 0;
+   if (filter == STBI__F_up) {
+      for (; k+16 <= nk; k += 16) {
+         x = _mm_loadu_si128((const __m128i *) (raw + k));
+         b = _mm_loadu_si128((const __m128i *) (prior + k));
+         _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(x, b));
+      }
+      return k;
+   }
+   if (n < 3 || filter == STBI__F_none)
+      return 0;
+
+   a = stbi__png_load_px_sse2(cur - n, n);
+   switch (filter) {
+      case STBI__F_sub:
+      case STBI__F_paeth_first: // paeth(a,0,0) is always a
+         for (; k < nk; k += n) {
+            a = _mm_add_epi8(stbi__png_load_px_sse2(raw + k, n), a);
+            stbi__png_store_px_sse2(cur + k, a, n);
+         }
+         break;
+      case STBI__F_avg:
+         for (; k < nk; k += n) {
+            b = stbi__png_load_px_sse2(prior + k, n);
+            a = _mm_add_epi8(stbi__png_load_px_sse2(raw + k, n), stbi__png_avg_sse2(a, b));
+            stbi__png_store_px_sse2(cur + k, a, n);
+         }
+         break;
+      case STBI__F_avg_first:
+         b = _mm_setzero_si128();
+         for (; k < nk; k += n) {
+            a = _mm_add_epi8(stbi__png_load_px_sse2(raw + k, n), stbi__png_avg_sse2(a, b));
+            stbi__png_store_px_sse2(cur + k, a, n);
+         }
+         break;
+      case STBI__F_paeth:
+         c = stbi__png_load_px_sse2(prior - n, n);
+         for (; k < nk; k += n) {
+            b = stbi__png_load_px_sse2(prior + k, n);
+            a = _mm_add_epi8(stbi__png_load_px_sse2(raw + k, n), stbi__png_paeth_sse2(a, b, c));
+            stbi__png_store_px_sse2(cur + k, a, n);
+            c = b;
+         }
+         break;
+   }
+   return k;
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4518,6 +5322,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   int simd = stbi__sse2_available();
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4587,6 +5394,17 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
+#ifdef STBI_SSE2
+         if (simd && depth >= 8 && nk > filter_bytes) {
+            // the last pixel is left to the byte loop below, so nothing is read or
+            // written past the end of the row
+            int done = stbi__png_unfilter_row_sse2(cur, prior, raw, filter, nk - filter_bytes, filter_bytes);
+            cur += done;
+            prior += done;
+            raw += done;
+            nk -= done;
+         }
+#endif
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
@@ -4849,19 +5667,46 @@ static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int
    return 1;
 }
 
-static int stbi__unpremultiply_on_load = 0;
-static int stbi__de_iphone_flag = 0;
+static int stbi__unpremultiply_on_load_global = 0;
+static int stbi__de_iphone_flag_global = 0;
 
 STBIDEF void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply)
 {
-   stbi__unpremultiply_on_load = flag_true_if_should_unpremultiply;
+   stbi__unpremultiply_on_load_global = flag_true_if_should_unpremultiply;
 }
 
 STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert)
 {
-   stbi__de_iphone_flag = flag_true_if_should_convert;
+   stbi__de_iphone_flag_global = flag_true_if_should_convert;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__unpremultiply_on_load  stbi__unpremultiply_on_load_global
+#define stbi__de_iphone_flag  stbi__de_iphone_flag_global
+#else
+static STBI_THREAD_LOCAL int stbi__unpremultiply_on_load_local, stbi__unpremultiply_on_load_set;
+static STBI_THREAD_LOCAL int stbi__de_iphone_flag_local, stbi__de_iphone_flag_set;
+
+STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply)
+{
+   stbi__unpremultiply_on_load_local = flag_true_if_should_unpremultiply;
+   stbi__unpremultiply_on_load_set = 1;
 }
 
+STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert)
+{
+   stbi__de_iphone_flag_local = flag_true_if_should_convert;
+   stbi__de_iphone_flag_set = 1;
+}
+
+#define stbi__unpremultiply_on_load  (stbi__unpremultiply_on_load_set          \
+                                       ? stbi__unpremultiply_on_load_local      \
+                                       : stbi__unpremultiply_on_load_global)
+#define stbi__de_iphone_flag  (stbi__de_iphone_flag_set                         \
+                                ? stbi__de_iphone_flag_local                    \
+                                : stbi__de_iphone_flag_global)
+#endif // STBI_THREAD_LOCAL
+
 static void stbi__de_iphone(stbi__png *z)
 {
    stbi__context *s = z->s;
@@ -5355,7 +6200,8 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
          psize = (info.offset - info.extra_read - info.hsz) >> 2;
    }
    if (psize == 0) {
-      STBI_ASSERT(info.offset == (s->img_buffer - s->buffer_start));
+      // callback_already_read counts the bytes of the buffers the callbacks have refilled
+      if (info.offset != s->callback_already_read + (s->img_buffer - s->img_buffer_original)) return stbi__errpuc("bad offset", "Corrupt BMP");
    }
 
    if (info.bpp == 24 && ma == 0xff000000)
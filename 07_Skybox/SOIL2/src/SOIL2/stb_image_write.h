@@ -26,6 +26,12 @@ BUILDING:
    You can #define STBIW_MALLOC(), STBIW_REALLOC(), and STBIW_FREE() to replace
    malloc,realloc,free.
    You can define STBIW_MEMMOVE() to replace memmove()
+   You can #define STBIW_PARALLEL_FOR(count,job,user_data) to run the PNG
+   row filters and deflate chunks on several threads. job is
+   void job(void *user_data, int first, int last) and must be run over
+   [0,count); the default runs it once on the calling thread.
+   SSE2 is used for the PNG filters when available, #define STBIW_NO_SIMD
+   to disable it.
 
 USAGE:
 
@@ -80,6 +86,16 @@ USAGE:
    TGA supports RLE or non-RLE compressed data. To use non-RLE-compressed
    data, set the global variable 'stbi_write_tga_with_rle' to 0.
 
+   PNG compression can be tuned with the global variable
+   'stbi_write_png_compression_level' (default 8): 0 stores the data
+   uncompressed, 1-4 trade size for speed (short hash chains, no lazy
+   matching), higher values search longer chains for smaller files.
+   stbi_write_png_level and stbi_write_png_level_to_func take the level
+   as an argument instead, so threads can save at different levels.
+   The image data is deflated in independent chunks of rows (each one
+   primed with the 32K that precede it), so big images compress in
+   parallel and the output doesn't depend on the number of threads.
+
 CREDITS:
 
    PNG/BMP/TGA
@@ -124,10 +140,12 @@ extern "C" {
 #else
 #define STBIWDEF extern
 extern int stbi_write_tga_with_rle;
+extern int stbi_write_png_compression_level;
 #endif
 
 #ifndef STBI_WRITE_NO_STDIO
 STBIWDEF int stbi_write_png(char const *filename, int w, int h, int comp, const void  *data, int stride_in_bytes);
+STBIWDEF int stbi_write_png_level(char const *filename, int w, int h, int comp, const void  *data, int stride_in_bytes, int level);
 STBIWDEF int stbi_write_bmp(char const *filename, int w, int h, int comp, const void  *data);
 STBIWDEF int stbi_write_tga(char const *filename, int w, int h, int comp, const void  *data);
 STBIWDEF int stbi_write_hdr(char const *filename, int w, int h, int comp, const float *data);
@@ -136,6 +154,7 @@ STBIWDEF int stbi_write_hdr(char const *filename, int w, int h, int comp, const
 typedef void stbi_write_func(void *context, void *data, int size);
 
 STBIWDEF int stbi_write_png_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data, int stride_in_bytes);
+STBIWDEF int stbi_write_png_level_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data, int stride_in_bytes, int level);
 STBIWDEF int stbi_write_bmp_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data);
 STBIWDEF int stbi_write_tga_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data);
 STBIWDEF int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const float *data);
@@ -197,6 +216,15 @@ STBIWDEF int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w,
 
 #define STBIW_UCHAR(x) (unsigned char) ((x) & 0xff)
 
+#ifndef STBIW_PARALLEL_FOR
+#define STBIW_PARALLEL_FOR(count,job,user_data) job(user_data, 0, count)
+#endif
+
+#if !defined(STBIW_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STBIW_SSE2
+#include <emmintrin.h>
+#endif
+
 typedef struct
 {
    stbi_write_func *func;
@@ -236,8 +264,10 @@ typedef int stb_image_write_test[sizeof(stbiw_uint32)==4 ? 1 : -1];
 
 #ifdef STB_IMAGE_WRITE_STATIC
 static int stbi_write_tga_with_rle = 1;
+static int stbi_write_png_compression_level = 8;
 #else
 int stbi_write_tga_with_rle = 1;
+int stbi_write_png_compression_level = 8;
 #endif
 
 static void stbiw__writefv(stbi__write_context *s, const char *fmt, va_list v)
@@ -725,8 +755,12 @@ static unsigned int stbiw__zhash(unsigned char *data)
 #define stbiw__zlib_huffb(n) ((n) <= 143 ? stbiw__zlib_huff1(n) : stbiw__zlib_huff2(n))
 
 #define stbiw__ZHASH   16384
+#define stbiw__ZWINDOW 32768
 
-unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality)
+// deflates data[start,end) onto the stretchy buffer out; matches may reach back
+// into the 32K before start, so consecutive ranges form one valid stream. A range
+// that isn't the last ends with an empty stored block to land on a byte boundary.
+static unsigned char *stbiw__zlib_compress_range(unsigned char *out, unsigned char *data, int start, int end, int quality, int last)
 {
    static unsigned short lengthc[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
    static unsigned char  lengtheb[]= { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
@@ -734,20 +768,47 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
    static unsigned char  disteb[]  = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
    unsigned int bitbuf=0;
    int i,j, bitcount=0;
-   unsigned char *out = NULL;
-   unsigned char ***hash_table = (unsigned char***) STBIW_MALLOC(stbiw__ZHASH * sizeof(char**));
-   if (quality < 5) quality = 5;
-
-   stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
-   stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
-   stbiw__zlib_add(1,1);  // BFINAL = 1
-   stbiw__zlib_add(1,2);  // BTYPE = 1 -- fixed huffman
+   unsigned char ***hash_table;
+   int lazy = quality >= 5;
+
+   if (quality <= 0) {
+      // stored blocks, at most 65535 bytes each
+      i = start;
+      do {
+         int len = end - i > 65535 ? 65535 : end - i;
+         stbiw__sbpush(out, STBIW_UCHAR(last && i + len == end));
+         stbiw__sbpush(out, STBIW_UCHAR(len));
+         stbiw__sbpush(out, STBIW_UCHAR(len >> 8));
+         stbiw__sbpush(out, STBIW_UCHAR(~len));
+         stbiw__sbpush(out, STBIW_UCHAR(~len >> 8));
+         stbiw__sbmaybegrow(out, len);
+         STBIW_MEMMOVE(out + stbiw__sbn(out), data + i, len);
+         stbiw__sbn(out) += len;
+         i += len;
+      } while (i < end);
+      return out;
+   }
 
+   hash_table = (unsigned char***) STBIW_MALLOC(stbiw__ZHASH * sizeof(char**));
+   if (hash_table == NULL) { (void) stbiw__sbfree(out); return NULL; }
    for (i=0; i < stbiw__ZHASH; ++i)
       hash_table[i] = NULL;
 
-   i=0;
-   while (i < data_len-3) {
+   // prime the window with what precedes this range
+   for (i = start > stbiw__ZWINDOW ? start - stbiw__ZWINDOW : 0; i < start; ++i) {
+      int h = stbiw__zhash(data+i)&(stbiw__ZHASH-1);
+      if (hash_table[h] && stbiw__sbn(hash_table[h]) == 2*quality) {
+         STBIW_MEMMOVE(hash_table[h], hash_table[h]+quality, sizeof(hash_table[h][0])*quality);
+         stbiw__sbn(hash_table[h]) = quality;
+      }
+      stbiw__sbpush(hash_table[h],data+i);
+   }
+
+   stbiw__zlib_add(last ? 1 : 0,1);  // BFINAL
+   stbiw__zlib_add(1,2);  // BTYPE = 1 -- fixed huffman
+
+   i=start;
+   while (i < end-3) {
       // hash next 3 bytes of data to be compressed
       int h = stbiw__zhash(data+i)&(stbiw__ZHASH-1), best=3;
       unsigned char *bestloc = 0;
@@ -755,7 +816,7 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
       int n = stbiw__sbcount(hlist);
       for (j=0; j < n; ++j) {
          if (hlist[j]-data > i-32768) { // if entry lies within window
-            int d = stbiw__zlib_countm(hlist[j], data+i, data_len-i);
+            int d = stbiw__zlib_countm(hlist[j], data+i, end-i);
             if (d >= best) best=d,bestloc=hlist[j];
          }
       }
@@ -766,14 +827,14 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
       }
       stbiw__sbpush(hash_table[h],data+i);
 
-      if (bestloc) {
+      if (bestloc && lazy) {
          // "lazy matching" - check match at *next* byte, and if it's better, do cur byte as literal
          h = stbiw__zhash(data+i+1)&(stbiw__ZHASH-1);
          hlist = hash_table[h];
          n = stbiw__sbcount(hlist);
          for (j=0; j < n; ++j) {
             if (hlist[j]-data > i-32767) {
-               int e = stbiw__zlib_countm(hlist[j], data+i+1, data_len-i-1);
+               int e = stbiw__zlib_countm(hlist[j], data+i+1, end-i-1);
                if (e > best) { // if next match is better, bail on current match
                   bestloc = NULL;
                   break;
@@ -798,33 +859,73 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
       }
    }
    // write out final bytes
-   for (;i < data_len; ++i)
+   for (;i < end; ++i)
       stbiw__zlib_huffb(data[i]);
    stbiw__zlib_huff(256); // end of block
+   if (!last) {
+      // empty stored block: BFINAL = 0, BTYPE = 0, then LEN = 0, NLEN = ~0 once aligned
+      stbiw__zlib_add(0,3);
+   }
    // pad with 0 bits to byte boundary
    while (bitcount)
       stbiw__zlib_add(0,1);
+   if (!last) {
+      stbiw__sbpush(out, 0x00);
+      stbiw__sbpush(out, 0x00);
+      stbiw__sbpush(out, 0xff);
+      stbiw__sbpush(out, 0xff);
+   }
 
    for (i=0; i < stbiw__ZHASH; ++i)
       (void) stbiw__sbfree(hash_table[i]);
    STBIW_FREE(hash_table);
+   return out;
+}
 
-   {
-      // compute adler32 on input
-      unsigned int s1=1, s2=0;
-      int blocklen = (int) (data_len % 5552);
-      j=0;
-      while (j < data_len) {
-         for (i=0; i < blocklen; ++i) s1 += data[j+i], s2 += s1;
-         s1 %= 65521, s2 %= 65521;
-         j += blocklen;
-         blocklen = 5552;
-      }
-      stbiw__sbpush(out, STBIW_UCHAR(s2 >> 8));
-      stbiw__sbpush(out, STBIW_UCHAR(s2));
-      stbiw__sbpush(out, STBIW_UCHAR(s1 >> 8));
-      stbiw__sbpush(out, STBIW_UCHAR(s1));
+static unsigned int stbiw__adler32(unsigned char *data, int data_len)
+{
+   unsigned int s1=1, s2=0;
+   int i, j=0, blocklen = (int) (data_len % 5552);
+   while (j < data_len) {
+      for (i=0; i < blocklen; ++i) s1 += data[j+i], s2 += s1;
+      s1 %= 65521, s2 %= 65521;
+      j += blocklen;
+      blocklen = 5552;
    }
+   return (s2 << 16) | s1;
+}
+
+// the adler32 of two buffers back to back, from each one's adler32
+static unsigned int stbiw__adler32_combine(unsigned int adler1, unsigned int adler2, int len2)
+{
+   unsigned int base = 65521, rem = (unsigned int) len2 % base;
+   unsigned int sum1 = adler1 & 0xffff;
+   unsigned int sum2 = (rem * sum1) % base;
+   sum1 += (adler2 & 0xffff) + base - 1;
+   sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+   if (sum1 >= base) sum1 -= base;
+   if (sum1 >= base) sum1 -= base;
+   if (sum2 >= 2*base) sum2 -= 2*base;
+   if (sum2 >= base) sum2 -= base;
+   return (sum2 << 16) | sum1;
+}
+
+unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality)
+{
+   unsigned int adler;
+   unsigned char *out = NULL;
+   if (quality < 5) quality = 5;
+
+   stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
+   stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
+   out = stbiw__zlib_compress_range(out, data, 0, data_len, quality, 1);
+   if (!out) return NULL;
+
+   adler = stbiw__adler32(data, data_len);
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 24));
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 16));
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 8));
+   stbiw__sbpush(out, STBIW_UCHAR(adler));
    *out_len = stbiw__sbn(out);
    // make returned pointer freeable
    STBIW_MEMMOVE(stbiw__sbraw(out), out, *out_len);
@@ -894,69 +995,239 @@ static unsigned char stbiw__paeth(int a, int b, int c)
    return STBIW_UCHAR(c);
 }
 
-// @OPTIMIZE: provide an option that always forces left-predict or paeth predict
-unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len)
+#ifdef STBIW_SSE2
+// paeth predictor on 8 pixels widened to 16 bits
+static __m128i stbiw__paeth_sse2(__m128i a, __m128i b, __m128i c)
+{
+   __m128i pa = _mm_sub_epi16(b, c), pb = _mm_sub_epi16(a, c);
+   __m128i pc = _mm_add_epi16(pa, pb);
+   __m128i use_a, use_b;
+   pa = _mm_max_epi16(pa, _mm_sub_epi16(_mm_setzero_si128(), pa));
+   pb = _mm_max_epi16(pb, _mm_sub_epi16(_mm_setzero_si128(), pb));
+   pc = _mm_max_epi16(pc, _mm_sub_epi16(_mm_setzero_si128(), pc));
+   use_a = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+   use_b = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+   b = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+   return _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, b));
+}
+#endif
+
+// filters row y into line_buffer; on the first row, types 3 and 4 become 5 and 6 (no row above)
+static void stbiw__encode_png_line(unsigned char *pixels, int stride_bytes, int width, int y, int n, int filter_type, signed char *line_buffer)
+{
+   static int mapping[] = { 0,1,2,3,4 };
+   static int firstmap[] = { 0,1,0,5,6 };
+   int *mymap = (y != 0) ? mapping : firstmap;
+   int i = n, len = width * n;
+   int type = mymap[filter_type];
+   unsigned char *z = pixels + stride_bytes*y;
+
+   if (type == 0) {
+      STBIW_MEMMOVE(line_buffer, z, len);
+      return;
+   }
+
+   // first pixel has no left neighbour
+   for (i=0; i < n; ++i) {
+      switch (type) {
+         case 1: line_buffer[i] = z[i]; break;
+         case 2: line_buffer[i] = z[i] - z[i-stride_bytes]; break;
+         case 3: line_buffer[i] = z[i] - (z[i-stride_bytes]>>1); break;
+         case 4: line_buffer[i] = (signed char) (z[i] - stbiw__paeth(0,z[i-stride_bytes],0)); break;
+         case 5: line_buffer[i] = z[i]; break;
+         case 6: line_buffer[i] = z[i]; break;
+      }
+   }
+
+#ifdef STBIW_SSE2
+   // the encoder filters the original bytes, so every lane is independent
+   for (; i+16 <= len; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *) (z+i));
+      __m128i a = _mm_loadu_si128((const __m128i *) (z+i-n));
+      __m128i r;
+      if (type == 1) {
+         r = _mm_sub_epi8(x, a);
+      } else if (type == 5) {
+         r = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7f)));
+      } else if (type == 6) {
+         r = _mm_sub_epi8(x, a);
+      } else {
+         __m128i b = _mm_loadu_si128((const __m128i *) (z+i-stride_bytes));
+         if (type == 2) {
+            r = _mm_sub_epi8(x, b);
+         } else if (type == 3) {
+            // floor((a+b)/2): avg rounds up, so take the odd bit back off
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            r = _mm_sub_epi8(x, avg);
+         } else {
+            __m128i c = _mm_loadu_si128((const __m128i *) (z+i-stride_bytes-n));
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo = stbiw__paeth_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+            __m128i hi = stbiw__paeth_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+            r = _mm_sub_epi8(x, _mm_packus_epi16(lo, hi));
+         }
+      }
+      _mm_storeu_si128((__m128i *) (line_buffer+i), r);
+   }
+#endif
+
+   for (; i < len; ++i) {
+      switch (type) {
+         case 1: line_buffer[i] = z[i] - z[i-n]; break;
+         case 2: line_buffer[i] = z[i] - z[i-stride_bytes]; break;
+         case 3: line_buffer[i] = z[i] - ((z[i-n] + z[i-stride_bytes])>>1); break;
+         case 4: line_buffer[i] = z[i] - stbiw__paeth(z[i-n], z[i-stride_bytes], z[i-stride_bytes-n]); break;
+         case 5: line_buffer[i] = z[i] - (z[i-n]>>1); break;
+         case 6: line_buffer[i] = z[i] - stbiw__paeth(z[i-n], 0,0); break;
+      }
+   }
+}
+
+// sum of absolute values, the usual guess at how well a filtered row compresses
+static int stbiw__png_line_cost(signed char *line_buffer, int len)
+{
+   int i = 0, est = 0;
+#ifdef STBIW_SSE2
+   __m128i sum = _mm_setzero_si128();
+   for (; i+16 <= len; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *) (line_buffer+i));
+      // |v| as unsigned is min(v, -v), -128 included
+      v = _mm_min_epu8(v, _mm_sub_epi8(_mm_setzero_si128(), v));
+      sum = _mm_add_epi64(sum, _mm_sad_epu8(v, _mm_setzero_si128()));
+   }
+   est = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#endif
+   for (; i < len; ++i)
+      est += abs((signed char) line_buffer[i]);
+   return est;
+}
+
+typedef struct
+{
+   unsigned char *pixels, *filt;
+   int stride_bytes, x, n;
+   int rows_per_chunk, rows, chunk_count, quality;
+   unsigned char **chunks;
+   unsigned int *adlers;
+} stbiw__png_job;
+
+static void stbiw__png_filter_rows(void *user_data, int first, int last)
+{
+   stbiw__png_job *job = (stbiw__png_job *) user_data;
+   int x = job->x, n = job->n, j;
+   signed char *line_buffer = (signed char *) STBIW_MALLOC(x * n);
+   if (!line_buffer) {
+      // leave these rows to the caller's check
+      for (j=first; j < last; ++j) job->filt[j*(x*n+1)] = 0xff;
+      return;
+   }
+   for (j=first; j < last; ++j) {
+      int filter_type, best = 0, bestval = 0x7fffffff;
+      for (filter_type = 0; filter_type < 5; ++filter_type) {
+         int est;
+         stbiw__encode_png_line(job->pixels, job->stride_bytes, x, j, n, filter_type, line_buffer);
+         est = stbiw__png_line_cost(line_buffer, x*n);
+         if (est < bestval) { bestval = est; best = filter_type; }
+      }
+      if (best != 4)
+         stbiw__encode_png_line(job->pixels, job->stride_bytes, x, j, n, best, line_buffer);
+      // line_buffer now holds the best filter's data
+      job->filt[j*(x*n+1)] = (unsigned char) best;
+      STBIW_MEMMOVE(job->filt+j*(x*n+1)+1, line_buffer, x*n);
+   }
+   STBIW_FREE(line_buffer);
+}
+
+// deflates a run of rows into a complete IDAT chunk (length, tag, data, crc)
+static void stbiw__png_deflate_chunks(void *user_data, int first, int last)
+{
+   stbiw__png_job *job = (stbiw__png_job *) user_data;
+   int row_bytes = job->x*job->n+1, k;
+   for (k=first; k < last; ++k) {
+      int start = k * job->rows_per_chunk * row_bytes;
+      int end = (k+1) * job->rows_per_chunk < job->rows ? (k+1) * job->rows_per_chunk * row_bytes : job->rows * row_bytes;
+      unsigned char *out = NULL, *o;
+      unsigned int crc;
+      int len;
+      stbiw__sbmaybegrow(out, 8);
+      stbiw__sbn(out) = 8;
+      if (k == 0) {
+         stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
+         stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
+      }
+      out = stbiw__zlib_compress_range(out, job->filt, start, end, job->quality, k == job->chunk_count-1);
+      job->chunks[k] = out;
+      if (!out) continue;
+      job->adlers[k] = stbiw__adler32(job->filt + start, end - start);
+      len = stbiw__sbn(out) - 8;
+      o = out;
+      stbiw__wp32(o, len);
+      stbiw__wptag(o, "IDAT");
+      crc = stbiw__crc32(out + 4, len + 4);
+      stbiw__sbmaybegrow(out, 4);
+      o = out + stbiw__sbn(out);
+      stbiw__wp32(o, crc);
+      stbiw__sbn(out) += 4;
+   }
+}
+
+#ifndef STBIW_PNG_CHUNK_SIZE
+// filtered bytes deflated per chunk; also the unit of work handed to the threads
+#define STBIW_PNG_CHUNK_SIZE (256*1024)
+#endif
+
+static unsigned char *stbiw__write_png_to_mem_level(unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len, int level)
 {
    int ctype[5] = { -1, 0, 4, 2, 6 };
    unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
-   unsigned char *out,*o, *filt, *zlib;
-   signed char *line_buffer;
-   int i,j,k,p,zlen;
+   unsigned char *out,*o, *filt;
+   int j,k,zlen,chunk_count,failed = 0;
+   unsigned int adler;
+   stbiw__png_job job;
 
    if (stride_bytes == 0)
       stride_bytes = x * n;
 
    filt = (unsigned char *) STBIW_MALLOC((x*n+1) * y); if (!filt) return 0;
-   line_buffer = (signed char *) STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
-   for (j=0; j < y; ++j) {
-      static int mapping[] = { 0,1,2,3,4 };
-      static int firstmap[] = { 0,1,0,5,6 };
-      int *mymap = (j != 0) ? mapping : firstmap;
-      int best = 0, bestval = 0x7fffffff;
-      for (p=0; p < 2; ++p) {
-         for (k= p?best:0; k < 5; ++k) { // @TODO: clarity: rewrite this to go 0..5, and 'continue' the unwanted ones during 2nd pass
-            int type = mymap[k],est=0;
-            unsigned char *z = pixels + stride_bytes*j;
-            for (i=0; i < n; ++i)
-               switch (type) {
-                  case 0: line_buffer[i] = z[i]; break;
-                  case 1: line_buffer[i] = z[i]; break;
-                  case 2: line_buffer[i] = z[i] - z[i-stride_bytes]; break;
-                  case 3: line_buffer[i] = z[i] - (z[i-stride_bytes]>>1); break;
-                  case 4: line_buffer[i] = (signed char) (z[i] - stbiw__paeth(0,z[i-stride_bytes],0)); break;
-                  case 5: line_buffer[i] = z[i]; break;
-                  case 6: line_buffer[i] = z[i]; break;
-               }
-            for (i=n; i < x*n; ++i) {
-               switch (type) {
-                  case 0: line_buffer[i] = z[i]; break;
-                  case 1: line_buffer[i] = z[i] - z[i-n]; break;
-                  case 2: line_buffer[i] = z[i] - z[i-stride_bytes]; break;
-                  case 3: line_buffer[i] = z[i] - ((z[i-n] + z[i-stride_bytes])>>1); break;
-                  case 4: line_buffer[i] = z[i] - stbiw__paeth(z[i-n], z[i-stride_bytes], z[i-stride_bytes-n]); break;
-                  case 5: line_buffer[i] = z[i] - (z[i-n]>>1); break;
-                  case 6: line_buffer[i] = z[i] - stbiw__paeth(z[i-n], 0,0); break;
-               }
-            }
-            if (p) break;
-            for (i=0; i < x*n; ++i)
-               est += abs((signed char) line_buffer[i]);
-            if (est < bestval) { bestval = est; best = k; }
-         }
-      }
-      // when we get here, best contains the filter type, and line_buffer contains the data
-      filt[j*(x*n+1)] = (unsigned char) best;
-      STBIW_MEMMOVE(filt+j*(x*n+1)+1, line_buffer, x*n);
-   }
-   STBIW_FREE(line_buffer);
-   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, 8); // increase 8 to get smaller but use more memory
+   job.pixels = pixels;
+   job.filt = filt;
+   job.stride_bytes = stride_bytes;
+   job.x = x;
+   job.n = n;
+   job.rows = y;
+   job.quality = level < 0 ? 0 : level;
+   job.rows_per_chunk = STBIW_PNG_CHUNK_SIZE / (x*n+1);
+   if (job.rows_per_chunk < 1) job.rows_per_chunk = 1;
+   chunk_count = job.chunk_count = (y + job.rows_per_chunk - 1) / job.rows_per_chunk;
+
+   STBIW_PARALLEL_FOR(y, stbiw__png_filter_rows, &job);
+   for (j=0; j < y; ++j)
+      if (filt[j*(x*n+1)] > 4) { STBIW_FREE(filt); return 0; }
+
+   job.chunks = (unsigned char **) STBIW_MALLOC(chunk_count * (sizeof(unsigned char *) + sizeof(unsigned int)));
+   if (!job.chunks) { STBIW_FREE(filt); return 0; }
+   job.adlers = (unsigned int *) (job.chunks + chunk_count);
+   STBIW_PARALLEL_FOR(chunk_count, stbiw__png_deflate_chunks, &job);
    STBIW_FREE(filt);
-   if (!zlib) return 0;
+
+   // the adler32 trails the stream in an IDAT of its own
+   zlen = 0;
+   adler = 1;
+   for (k=0; k < chunk_count; ++k) {
+      int rows = (k+1) * job.rows_per_chunk < y ? job.rows_per_chunk : y - k * job.rows_per_chunk;
+      if (!job.chunks[k]) { failed = 1; continue; }
+      zlen += stbiw__sbn(job.chunks[k]);
+      adler = stbiw__adler32_combine(adler, job.adlers[k], rows * (x*n+1));
+   }
 
    // each tag requires 12 bytes of overhead
-   out = (unsigned char *) STBIW_MALLOC(8 + 12+13 + 12+zlen + 12);
-   if (!out) return 0;
-   *out_len = 8 + 12+13 + 12+zlen + 12;
+   out = failed ? NULL : (unsigned char *) STBIW_MALLOC(8 + 12+13 + zlen + 12+4 + 12);
+   if (!out) {
+      for (k=0; k < chunk_count; ++k) (void) stbiw__sbfree(job.chunks[k]);
+      STBIW_FREE(job.chunks);
+      return 0;
+   }
+   *out_len = 8 + 12+13 + zlen + 12+4 + 12;
 
    o=out;
    STBIW_MEMMOVE(o,sig,8); o+= 8;
@@ -971,12 +1242,17 @@ unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, in
    *o++ = 0;
    stbiw__wpcrc(&o,13);
 
-   stbiw__wp32(o, zlen);
+   for (k=0; k < chunk_count; ++k) {
+      STBIW_MEMMOVE(o, job.chunks[k], stbiw__sbn(job.chunks[k]));
+      o += stbiw__sbn(job.chunks[k]);
+      (void) stbiw__sbfree(job.chunks[k]);
+   }
+   STBIW_FREE(job.chunks);
+
+   stbiw__wp32(o, 4);
    stbiw__wptag(o, "IDAT");
-   STBIW_MEMMOVE(o, zlib, zlen);
-   o += zlen;
-   STBIW_FREE(zlib);
-   stbiw__wpcrc(&o, zlen);
+   stbiw__wp32(o, adler);
+   stbiw__wpcrc(&o, 4);
 
    stbiw__wp32(o,0);
    stbiw__wptag(o, "IEND");
@@ -987,12 +1263,17 @@ unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, in
    return out;
 }
 
+unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len)
+{
+   return stbiw__write_png_to_mem_level(pixels, stride_bytes, x, y, n, out_len, stbi_write_png_compression_level);
+}
+
 #ifndef STBI_WRITE_NO_STDIO
-STBIWDEF int stbi_write_png(char const *filename, int x, int y, int comp, const void *data, int stride_bytes)
+STBIWDEF int stbi_write_png_level(char const *filename, int x, int y, int comp, const void *data, int stride_bytes, int level)
 {
    FILE *f;
    int len;
-   unsigned char *png = stbi_write_png_to_mem((unsigned char *) data, stride_bytes, x, y, comp, &len);
+   unsigned char *png = stbiw__write_png_to_mem_level((unsigned char *) data, stride_bytes, x, y, comp, &len, level);
    if (png == NULL) return 0;
    f = fopen(filename, "wb");
    if (!f) { STBIW_FREE(png); return 0; }
@@ -1001,18 +1282,28 @@ STBIWDEF int stbi_write_png(char const *filename, int x, int y, int comp, const
    STBIW_FREE(png);
    return 1;
 }
+
+STBIWDEF int stbi_write_png(char const *filename, int x, int y, int comp, const void *data, int stride_bytes)
+{
+   return stbi_write_png_level(filename, x, y, comp, data, stride_bytes, stbi_write_png_compression_level);
+}
 #endif
 
-STBIWDEF int stbi_write_png_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int stride_bytes)
+STBIWDEF int stbi_write_png_level_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int stride_bytes, int level)
 {
    int len;
-   unsigned char *png = stbi_write_png_to_mem((unsigned char *) data, stride_bytes, x, y, comp, &len);
+   unsigned char *png = stbiw__write_png_to_mem_level((unsigned char *) data, stride_bytes, x, y, comp, &len, level);
    if (png == NULL) return 0;
    func(context, png, len);
    STBIW_FREE(png);
    return 1;
 }
 
+STBIWDEF int stbi_write_png_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int stride_bytes)
+{
+   return stbi_write_png_level_to_func(func, context, x, y, comp, data, stride_bytes, stbi_write_png_compression_level);
+}
+
 #endif // STB_IMAGE_WRITE_IMPLEMENTATION
 
 /* Revision history
@@ -4,6 +4,15 @@
 
 #include "image_DXT.h"
 
+/*	#define STBI_DDS_PARALLEL_FOR(count,min_items,job,user_data) to decode
+	the blocks on several threads.  job is
+	void job(void *user_data, int first, int last) and must be run over
+	[0,count), in ranges of at least min_items; the default runs it once
+	on the calling thread.	*/
+#ifndef STBI_DDS_PARALLEL_FOR
+#define STBI_DDS_PARALLEL_FOR(count,min_items,job,user_data)	job( user_data, 0, count )
+#endif
+
 static int stbi__dds_test(stbi__context *s)
 {
 	//	check the magic number
@@ -240,6 +249,271 @@ void stbi_decode_DXT_color_block(
 	//	done
 }
 
+/*	The loader decodes whole 4x4 blocks straight into the image, the
+	values are the same as the stbi_decode_* functions above give.
+	Palettes are built per block, then every pixel picks its entry:
+	with 32 bit loads here, and 8 pixels at a time with AVX2 permutes
+	when the CPU has them.	*/
+enum
+{
+	STBI__DDS_BC1,		/*	DXT1	*/
+	STBI__DDS_BC2,		/*	DXT2/3, explicit 4 bit alpha	*/
+	STBI__DDS_BC3,		/*	DXT4/5, interpolated alpha	*/
+	STBI__DDS_BC4,		/*	ATI1/BC4U, red only	*/
+	STBI__DDS_BC5		/*	ATI2/BC5U, red and green	*/
+};
+
+#define STBI__DDS_FOURCC(a,b,c,d)	((a) | ((b) << 8) | ((c) << 16) | ((unsigned int)(d) << 24))
+
+static void stbi__dds_color_palette(
+			stbi_uc palette[4*4],
+			const stbi_uc compressed[8],
+			int alpha, int dxt1 )
+{
+	int i, r0, g0, b0, r1, g1, b1;
+	int c0 = compressed[0] + (compressed[1] << 8);
+	int c1 = compressed[2] + (compressed[3] << 8);
+	stbi_rgb_888_from_565( c0, &r0, &g0, &b0 );
+	stbi_rgb_888_from_565( c1, &r1, &g1, &b1 );
+	palette[0] = r0;	palette[1] = g0;	palette[2] = b0;
+	palette[4] = r1;	palette[5] = g1;	palette[6] = b1;
+	if( !dxt1 || (c0 > c1) )
+	{
+		palette[8] = (2*r0 + r1) / 3;
+		palette[9] = (2*g0 + g1) / 3;
+		palette[10] = (2*b0 + b1) / 3;
+		palette[12] = (r0 + 2*r1) / 3;
+		palette[13] = (g0 + 2*g1) / 3;
+		palette[14] = (b0 + 2*b1) / 3;
+	} else
+	{
+		palette[8] = (r0 + r1) / 2;
+		palette[9] = (g0 + g1) / 2;
+		palette[10] = (b0 + b1) / 2;
+		palette[12] = palette[13] = palette[14] = 0;
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		palette[i*4+3] = alpha;
+	}
+	if( dxt1 && (c0 <= c1) )
+	{
+		palette[15] = 0;
+	}
+}
+
+static void stbi__dds_alpha_palette(
+			stbi_uc palette[8],
+			const stbi_uc compressed[8] )
+{
+	int a0 = compressed[0], a1 = compressed[1];
+	palette[0] = a0;
+	palette[1] = a1;
+	if( a0 > a1 )
+	{
+		palette[2] = (6*a0 + 1*a1) / 7;
+		palette[3] = (5*a0 + 2*a1) / 7;
+		palette[4] = (4*a0 + 3*a1) / 7;
+		palette[5] = (3*a0 + 4*a1) / 7;
+		palette[6] = (2*a0 + 5*a1) / 7;
+		palette[7] = (1*a0 + 6*a1) / 7;
+	} else
+	{
+		palette[2] = (4*a0 + 1*a1) / 5;
+		palette[3] = (3*a0 + 2*a1) / 5;
+		palette[4] = (2*a0 + 3*a1) / 5;
+		palette[5] = (1*a0 + 4*a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/*	the 16 3 bit indices of an alpha/BC4 block, pixel i at bit 3*i	*/
+static stbi__uint32 stbi__dds_alpha_bits( const stbi_uc compressed[8], int half )
+{
+	const stbi_uc *p = compressed + 2 + 3*half;
+	return p[0] | (p[1] << 8) | ((stbi__uint32)p[2] << 16);
+}
+
+/*	the explicit alpha of DXT2/3, stbi_convert_bit_range( a, 4, 8 )	*/
+static const stbi_uc stbi__dds_alpha4[16] =
+{
+	0, 17, 34, 51, 68, 85, 102, 119, 136, 152, 169, 186, 203, 220, 237, 254
+};
+
+static void stbi__dds_decode_block(
+			int format,
+			const stbi_uc *compressed,
+			stbi_uc *dst, int stride )
+{
+	stbi_uc palette[4*4], channel[2][8];
+	stbi__uint32 bits, channel_bits[2][2];
+	int i;
+	if( format >= STBI__DDS_BC4 )
+	{
+		//	one or two channels, from the 8 entry palettes
+		stbi__dds_alpha_palette( channel[0], compressed );
+		channel_bits[0][0] = stbi__dds_alpha_bits( compressed, 0 );
+		channel_bits[0][1] = stbi__dds_alpha_bits( compressed, 1 );
+		memset( channel[1], 0, 8 );
+		channel_bits[1][0] = channel_bits[1][1] = 0;
+		if( format == STBI__DDS_BC5 )
+		{
+			stbi__dds_alpha_palette( channel[1], compressed + 8 );
+			channel_bits[1][0] = stbi__dds_alpha_bits( compressed + 8, 0 );
+			channel_bits[1][1] = stbi__dds_alpha_bits( compressed + 8, 1 );
+		}
+		for( i = 0; i < 16; ++i )
+		{
+			stbi_uc *p = dst + (i >> 2)*stride + (i & 3)*4;
+			int sh = 3*(i & 7);
+			p[0] = channel[0][(channel_bits[0][i >> 3] >> sh) & 7];
+			p[1] = channel[1][(channel_bits[1][i >> 3] >> sh) & 7];
+			p[2] = 0;
+			p[3] = 255;
+		}
+		return;
+	}
+	if( format != STBI__DDS_BC1 )
+	{
+		compressed += 8;
+	}
+	stbi__dds_color_palette( palette, compressed, 255, format == STBI__DDS_BC1 );
+	bits = compressed[4] | (compressed[5] << 8) | (compressed[6] << 16) | ((stbi__uint32)compressed[7] << 24);
+	for( i = 0; i < 16; ++i )
+	{
+		memcpy( dst + (i >> 2)*stride + (i & 3)*4, palette + ((bits >> (2*i)) & 3)*4, 4 );
+	}
+	compressed -= 8;
+	if( format == STBI__DDS_BC2 )
+	{
+		for( i = 0; i < 16; ++i )
+		{
+			dst[(i >> 2)*stride + (i & 3)*4 + 3] = stbi__dds_alpha4[(compressed[i >> 1] >> ((i & 1)*4)) & 15];
+		}
+	} else if( format == STBI__DDS_BC3 )
+	{
+		stbi__dds_alpha_palette( channel[0], compressed );
+		channel_bits[0][0] = stbi__dds_alpha_bits( compressed, 0 );
+		channel_bits[0][1] = stbi__dds_alpha_bits( compressed, 1 );
+		for( i = 0; i < 16; ++i )
+		{
+			dst[(i >> 2)*stride + (i & 3)*4 + 3] = channel[0][(channel_bits[0][i >> 3] >> (3*(i & 7))) & 7];
+		}
+	}
+}
+
+#ifdef STBI_AVX2
+/*	8 pixels of a palette lookup: 'bits' holds 8 indices of 'width'
+	bits, the palette entries are 32 bit lanes	*/
+STBI__AVX2_TARGET static __m256i stbi__dds_lookup8_avx2( __m256i palette, stbi__uint32 bits, int width )
+{
+	const __m256i shift2 = _mm256_setr_epi32( 0, 2, 4, 6, 8, 10, 12, 14 );
+	const __m256i shift3 = _mm256_setr_epi32( 0, 3, 6, 9, 12, 15, 18, 21 );
+	__m256i idx = _mm256_srlv_epi32( _mm256_set1_epi32( (int)bits ), width == 2 ? shift2 : shift3 );
+	idx = _mm256_and_si256( idx, _mm256_set1_epi32( (1 << width) - 1 ) );
+	return _mm256_permutevar8x32_epi32( palette, idx );
+}
+
+/*	an 8 entry channel palette as 32 bit lanes, moved to byte 'shift'/8	*/
+STBI__AVX2_TARGET static __m256i stbi__dds_channel_palette_avx2( const stbi_uc compressed[8], int shift )
+{
+	stbi_uc channel[8];
+	stbi__dds_alpha_palette( channel, compressed );
+	return _mm256_slli_epi32( _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i *)channel ) ), shift );
+}
+
+STBI__AVX2_TARGET static void stbi__dds_decode_block_avx2(
+			int format,
+			const stbi_uc *compressed,
+			stbi_uc *dst, int stride )
+{
+	__m256i lo, hi;
+	if( format >= STBI__DDS_BC4 )
+	{
+		__m256i r = stbi__dds_channel_palette_avx2( compressed, 0 );
+		lo = _mm256_or_si256( stbi__dds_lookup8_avx2( r, stbi__dds_alpha_bits( compressed, 0 ), 3 ), _mm256_set1_epi32( (int)0xff000000 ) );
+		hi = _mm256_or_si256( stbi__dds_lookup8_avx2( r, stbi__dds_alpha_bits( compressed, 1 ), 3 ), _mm256_set1_epi32( (int)0xff000000 ) );
+		if( format == STBI__DDS_BC5 )
+		{
+			__m256i g = stbi__dds_channel_palette_avx2( compressed + 8, 8 );
+			lo = _mm256_or_si256( lo, stbi__dds_lookup8_avx2( g, stbi__dds_alpha_bits( compressed + 8, 0 ), 3 ) );
+			hi = _mm256_or_si256( hi, stbi__dds_lookup8_avx2( g, stbi__dds_alpha_bits( compressed + 8, 1 ), 3 ) );
+		}
+	} else
+	{
+		stbi_uc palette[4*4];
+		const stbi_uc *color = format == STBI__DDS_BC1 ? compressed : compressed + 8;
+		stbi__uint32 bits;
+		__m256i p;
+		stbi__dds_color_palette( palette, color, format == STBI__DDS_BC1 ? 255 : 0, format == STBI__DDS_BC1 );
+		memcpy( &bits, color + 4, 4 );
+		p = _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i *)palette ) );
+		lo = stbi__dds_lookup8_avx2( p, bits, 2 );
+		hi = stbi__dds_lookup8_avx2( p, bits >> 16, 2 );
+		if( format == STBI__DDS_BC2 )
+		{
+			//	4 bits per pixel, low nibble first, expanded with a byte shuffle
+			__m128i a = _mm_loadl_epi64( (const __m128i *)compressed );
+			__m128i m = _mm_set1_epi8( 15 );
+			a = _mm_unpacklo_epi8( _mm_and_si128( a, m ), _mm_and_si128( _mm_srli_epi16( a, 4 ), m ) );
+			a = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)stbi__dds_alpha4 ), a );
+			lo = _mm256_or_si256( lo, _mm256_slli_epi32( _mm256_cvtepu8_epi32( a ), 24 ) );
+			hi = _mm256_or_si256( hi, _mm256_slli_epi32( _mm256_cvtepu8_epi32( _mm_srli_si128( a, 8 ) ), 24 ) );
+		} else if( format == STBI__DDS_BC3 )
+		{
+			__m256i a = stbi__dds_channel_palette_avx2( compressed, 24 );
+			lo = _mm256_or_si256( lo, stbi__dds_lookup8_avx2( a, stbi__dds_alpha_bits( compressed, 0 ), 3 ) );
+			hi = _mm256_or_si256( hi, stbi__dds_lookup8_avx2( a, stbi__dds_alpha_bits( compressed, 1 ), 3 ) );
+		}
+	}
+	_mm_storeu_si128( (__m128i *)(dst), _mm256_castsi256_si128( lo ) );
+	_mm_storeu_si128( (__m128i *)(dst + stride), _mm256_extracti128_si256( lo, 1 ) );
+	_mm_storeu_si128( (__m128i *)(dst + 2*stride), _mm256_castsi256_si128( hi ) );
+	_mm_storeu_si128( (__m128i *)(dst + 3*stride), _mm256_extracti128_si256( hi, 1 ) );
+}
+#endif
+
+typedef struct
+{
+	const stbi_uc *blocks;
+	stbi_uc *rgba;
+	int width, height;
+	int format, block_size, block_pitch;
+	void (*decode_block)( int format, const stbi_uc *compressed, stbi_uc *dst, int stride );
+} stbi__dds_decode_job;
+
+/*	STBI_DDS_PARALLEL_FOR job: decodes the block rows [first, last) of a face	*/
+static void stbi__dds_decode_rows( void *user_data, int first, int last )
+{
+	stbi__dds_decode_job *job = (stbi__dds_decode_job *)user_data;
+	int stride = job->width * 4;
+	int bx, by, y;
+	for( by = first; by < last; ++by )
+	{
+		const stbi_uc *compressed = job->blocks + by * job->block_pitch * job->block_size;
+		int bh = job->height - 4*by < 4 ? job->height - 4*by : 4;
+		for( bx = 0; bx < job->block_pitch; ++bx, compressed += job->block_size )
+		{
+			stbi_uc *dst = job->rgba + (4*by)*stride + 4*bx*4;
+			int bw = job->width - 4*bx < 4 ? job->width - 4*bx : 4;
+			if( (bw == 4) && (bh == 4) )
+			{
+				job->decode_block( job->format, compressed, dst, stride );
+			} else
+			{
+				//	partial block, only copy what is inside the image
+				stbi_uc block[16*4];
+				job->decode_block( job->format, compressed, block, 16 );
+				for( y = 0; y < bh; ++y )
+				{
+					memcpy( dst + y*stride, block + y*16, bw*4 );
+				}
+			}
+		}
+	}
+}
+
 static int stbi__dds_info( stbi__context *s, int *x, int *y, int *comp, int *iscompressed ) {
 	int flags,is_compressed,has_alpha;
 	DDS_header header={0};
@@ -340,8 +614,8 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 {
 	//	all variables go up front
 	stbi_uc *dds_data = NULL;
-	stbi_uc block[16*4];
-	stbi_uc compressed[8];
+	stbi_uc *compressed = NULL;
+	stbi__dds_decode_job job;
 	int flags, DXT_family;
 	int has_alpha, has_mipmap;
 	int is_compressed, cubemap_faces;
@@ -389,75 +663,62 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 	if( is_compressed )
 	{
 		/*	compressed	*/
-		//	note: header.sPixelFormat.dwFourCC is something like (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24))
-		DXT_family = 1 + (header.sPixelFormat.dwFourCC >> 24) - '1';
-		if( (DXT_family < 1) || (DXT_family > 5) ) return NULL;
+		switch( header.sPixelFormat.dwFourCC )
+		{
+		case STBI__DDS_FOURCC('D','X','T','1'):	DXT_family = STBI__DDS_BC1;	break;
+		case STBI__DDS_FOURCC('D','X','T','2'):
+		case STBI__DDS_FOURCC('D','X','T','3'):	DXT_family = STBI__DDS_BC2;	break;
+		case STBI__DDS_FOURCC('D','X','T','4'):
+		case STBI__DDS_FOURCC('D','X','T','5'):	DXT_family = STBI__DDS_BC3;	break;
+		case STBI__DDS_FOURCC('A','T','I','1'):
+		case STBI__DDS_FOURCC('B','C','4','U'):	DXT_family = STBI__DDS_BC4;	break;
+		case STBI__DDS_FOURCC('A','T','I','2'):
+		case STBI__DDS_FOURCC('B','C','5','U'):	DXT_family = STBI__DDS_BC5;	break;
+		default: return NULL;
+		}
 		/*	check the expected size...oops, nevermind...
 			those non-compliant writers leave
 			dwPitchOrLinearSize == 0	*/
+		job.format = DXT_family;
+		job.block_size = (DXT_family == STBI__DDS_BC1 || DXT_family == STBI__DDS_BC4) ? 8 : 16;
+		job.block_pitch = block_pitch;
+		job.width = s->img_x;
+		job.height = s->img_y;
+		job.decode_block = stbi__dds_decode_block;
+#ifdef STBI_AVX2
+		if( stbi__avx2_available() )
+		{
+			job.decode_block = stbi__dds_decode_block_avx2;
+		}
+#endif
 		//	passed all the tests, get the RAM for decoding
 		sz = (s->img_x)*(s->img_y)*4*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
+		compressed = (unsigned char*)STBI_MALLOC( num_blocks*job.block_size );
+		if( (NULL == dds_data) || (NULL == compressed) )
+		{
+			STBI_FREE( dds_data );
+			STBI_FREE( compressed );
+			return stbi__errpuc( "outofmem", "Out of memory" );
+		}
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
-			//	now read and decode all the blocks
-			for( i = 0; i < num_blocks; ++i )
+			//	read all the blocks, then decode the block rows on every core
+			if( !stbi__getn( s, compressed, num_blocks*job.block_size ) )
 			{
-				//	where are we?
-				int bx, by, bw=4, bh=4;
-				int ref_x = 4 * (i % block_pitch);
-				int ref_y = 4 * (i / block_pitch);
-				//	get the next block's worth of compressed data, and decompress it
-				if( DXT_family == 1 )
-				{
-					//	DXT1
-					stbi__getn( s, compressed, 8 );
-					stbi_decode_DXT1_block( block, compressed );
-				} else if( DXT_family < 4 )
-				{
-					//	DXT2/3
-					stbi__getn( s, compressed, 8 );
-					stbi_decode_DXT23_alpha_block ( block, compressed );
-					stbi__getn( s, compressed, 8 );
-					stbi_decode_DXT_color_block ( block, compressed );
-				} else
-				{
-					//	DXT4/5
-					stbi__getn( s, compressed, 8 );
-					stbi_decode_DXT45_alpha_block ( block, compressed );
-					stbi__getn( s, compressed, 8 );
-					stbi_decode_DXT_color_block ( block, compressed );
-				}
-				//	is this a partial block?
-				if( ref_x + 4 > (int)s->img_x )
-				{
-					bw = s->img_x - ref_x;
-				}
-				if( ref_y + 4 > (int)s->img_y )
-				{
-					bh = s->img_y - ref_y;
-				}
-				//	now drop our decompressed data into the buffer
-				for( by = 0; by < bh; ++by )
-				{
-					int idx = 4*((ref_y+by+cf*s->img_x)*s->img_x + ref_x);
-					for( bx = 0; bx < bw*4; ++bx )
-					{
-
-						dds_data[idx+bx] = block[by*16+bx];
-					}
-				}
+				STBI_FREE( dds_data );
+				STBI_FREE( compressed );
+				return stbi__errpuc( "truncated", "DDS file is missing image data" );
 			}
+			job.blocks = compressed;
+			job.rgba = dds_data + cf*s->img_x*s->img_y*4;
+			STBI_DDS_PARALLEL_FOR( (s->img_y+3) >> 2, 16, stbi__dds_decode_rows, &job );
 			/*	done reading and decoding the main image...
 				stbi__skip MIPmaps if present	*/
 			if( has_mipmap )
 			{
-				int block_size = 16;
-				if( DXT_family == 1 )
-				{
-					block_size = 8;
-				}
+				int block_size = job.block_size;
 				for( i = 1; i < (int)header.dwMipMapCount; ++i )
 				{
 					int mx = s->img_x >> (i + 2);
@@ -474,6 +735,7 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 				}
 			}
 		}/* per cubemap face */
+		STBI_FREE( compressed );
 	} else
 	{
 		/*	uncompressed	*/
@@ -485,7 +747,7 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 		}
 		*comp = s->img_n;
 		sz = s->img_x*s->img_y*s->img_n*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
@@ -82,7 +82,7 @@ static int stbi__pkm_info(stbi__context *s, int *x, int *y, int *comp )
 
 	stbi__getn( s, (stbi_uc*)(&header), sizeof(PKMHeader) );
 
-	if ( 0 != strcmp( header.aName, "PKM 10" ) ) {
+	if ( 0 != memcmp( header.aName, "PKM 10", 6 ) ) {
 		stbi__rewind(s);
 		return 0;
 	}
@@ -147,7 +147,7 @@ static void * stbi__pkm_load(stbi__context *s, int *x, int *y, int *comp, int re
 
 	stbi__getn( s, (stbi_uc*)(&header), sizeof(PKMHeader) );
 
-	if ( 0 != strcmp( header.aName, "PKM 10" ) ) {
+	if ( 0 != memcmp( header.aName, "PKM 10", 6 ) ) {
 		return NULL;
 	}
 
@@ -160,14 +160,14 @@ static void * stbi__pkm_load(stbi__context *s, int *x, int *y, int *comp, int re
 
 	compressed_size = (((width + 3) & ~3) * ((height + 3) & ~3)) >> 1;
 
-	pkm_data = (stbi_uc *)malloc(compressed_size);
+	pkm_data = (stbi_uc *)STBI_MALLOC(compressed_size);
 	stbi__getn( s, pkm_data, compressed_size );
 
-	pkm_res_data = (stbi_uc *)malloc(width * height * s->img_n);
+	pkm_res_data = (stbi_uc *)STBI_MALLOC(width * height * s->img_n);
 
 	wfETC1_DecodeImage(pkm_data, pkm_res_data, width, height);
 
-	free( pkm_data );
+	STBI_FREE( pkm_data );
 
 	if ( NULL != pkm_res_data ) {
 		if( (req_comp < 4) && (req_comp >= 1) ) {
@@ -180,7 +180,7 @@ static void * stbi__pkm_load(stbi__context *s, int *x, int *y, int *comp, int re
 
 		return (stbi_uc *)pkm_res_data;
 	} else {
-		free( pkm_res_data );
+		STBI_FREE( pkm_res_data );
 	}
 
 	return NULL;
@@ -0,0 +1,649 @@
+/*
+	Thread helper functions
+
+	MIT license
+*/
+
+#include "thread_helper.h"
+#include <stdlib.h>
+
+#if !defined( SOIL_NO_THREADS )
+	#if defined( __WIN32__ ) || defined( _WIN32 ) || defined( WIN32 )
+		#define SOIL_THREADS_WIN32
+		#define WIN32_LEAN_AND_MEAN
+		#include <windows.h>
+	#elif defined( __EMSCRIPTEN__ ) && !defined( __EMSCRIPTEN_PTHREADS__ )
+		#define SOIL_NO_THREADS
+	#else
+		#define SOIL_THREADS_PTHREADS
+		#include <pthread.h>
+		#include <sched.h>
+		#include <unistd.h>
+	#endif
+#endif
+
+/*	no machine we run on has more cores than this, and it keeps the
+	thread handles on the stack	*/
+#define SOIL_MAX_THREADS 64
+
+/*	atomic, loads on any thread read them	*/
+static volatile int soil_thread_count_override = 0;
+static volatile int soil_cpu_count_cache = 0;
+
+typedef struct
+{
+	soil_parallel_job job;
+	void *user_data;
+	int first;
+	int last;
+	/*	ranges the shared pool still has to finish	*/
+	volatile int *remaining;
+}
+soil_parallel_range;
+
+#if !defined( SOIL_NO_THREADS ) && defined( SOIL_THREAD_LOCAL )
+/*	set on pool workers: a job they run never fans out again, so a
+	worker can't end up waiting on a queue only it would drain	*/
+static SOIL_THREAD_LOCAL int soil_is_pool_worker = 0;
+
+static int soil_parallel_for_shared_pool( soil_parallel_range *ranges, int threads );
+#elif !defined( SOIL_NO_THREADS )
+/*	pool tasks running right now: without thread locals a job can't
+	tell it runs on a worker, so it shares the threads with them	*/
+static volatile int soil_pool_tasks_running = 0;
+#endif
+
+static int soil_cpu_count( void )
+{
+#if defined( SOIL_THREADS_WIN32 )
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int)info.dwNumberOfProcessors;
+#elif defined( SOIL_THREADS_PTHREADS ) && defined( _SC_NPROCESSORS_ONLN )
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (int)count : 1;
+#else
+	return 1;
+#endif
+}
+
+int
+	soil_get_thread_count
+	(
+		void
+	)
+{
+	int count = soil_atomic_load( &soil_thread_count_override );
+	if( count < 1 )
+	{
+		count = soil_atomic_load( &soil_cpu_count_cache );
+		if( count < 1 )
+		{
+			/*	every thread gets the same answer, whichever stores it	*/
+			count = soil_cpu_count();
+			soil_atomic_store( &soil_cpu_count_cache, count );
+		}
+	}
+	if( count > SOIL_MAX_THREADS )
+	{
+		count = SOIL_MAX_THREADS;
+	}
+	return count;
+}
+
+void
+	soil_set_thread_count
+	(
+		int thread_count
+	)
+{
+	soil_atomic_store( &soil_thread_count_override, thread_count < 0 ? 0 : thread_count );
+}
+
+#if defined( SOIL_THREADS_WIN32 )
+static DWORD WINAPI soil_thread_entry( LPVOID param )
+{
+	soil_parallel_range *range = (soil_parallel_range*)param;
+	range->job( range->user_data, range->first, range->last );
+	return 0;
+}
+#elif defined( SOIL_THREADS_PTHREADS )
+static void *soil_thread_entry( void *param )
+{
+	soil_parallel_range *range = (soil_parallel_range*)param;
+	range->job( range->user_data, range->first, range->last );
+	return NULL;
+}
+#endif
+
+void
+	soil_parallel_for
+	(
+		int count,
+		int min_items_per_thread,
+		soil_parallel_job job,
+		void *user_data
+	)
+{
+	int threads = 1;
+	if( (count < 1) || (NULL == job) )
+	{
+		return;
+	}
+	if( min_items_per_thread < 1 )
+	{
+		min_items_per_thread = 1;
+	}
+#if !defined( SOIL_NO_THREADS )
+	threads = soil_get_thread_count();
+#if defined( SOIL_THREAD_LOCAL )
+	if( soil_is_pool_worker )
+	{
+		threads = 1;
+	}
+#else
+	threads /= 1 + soil_atomic_load( &soil_pool_tasks_running );
+#endif
+	if( threads > count / min_items_per_thread )
+	{
+		threads = count / min_items_per_thread;
+	}
+#endif
+	if( threads <= 1 )
+	{
+		/*	not worth it, or not possible	*/
+		job( user_data, 0, count );
+		return;
+	}
+#if !defined( SOIL_NO_THREADS )
+	{
+		soil_parallel_range ranges[SOIL_MAX_THREADS];
+		int started[SOIL_MAX_THREADS];
+#if defined( SOIL_THREADS_WIN32 )
+		HANDLE handles[SOIL_MAX_THREADS];
+#else
+		pthread_t handles[SOIL_MAX_THREADS];
+#endif
+		int i;
+		/*	split the items evenly, the first ranges get the remainder	*/
+		for( i = 0; i < threads; ++i )
+		{
+			int base = count / threads;
+			int extra = count % threads;
+			ranges[i].job = job;
+			ranges[i].user_data = user_data;
+			ranges[i].first = i * base + (i < extra ? i : extra);
+			ranges[i].last = ranges[i].first + base + (i < extra ? 1 : 0);
+			ranges[i].remaining = NULL;
+		}
+#if defined( SOIL_THREAD_LOCAL )
+		if( soil_parallel_for_shared_pool( ranges, threads ) )
+		{
+			return;
+		}
+#endif
+		/*	no shared pool: a thread per range, for this call only	*/
+		/*	the calling thread does range 0	*/
+		for( i = 1; i < threads; ++i )
+		{
+#if defined( SOIL_THREADS_WIN32 )
+			handles[i] = CreateThread( NULL, 0, soil_thread_entry, &ranges[i], 0, NULL );
+			started[i] = ( NULL != handles[i] );
+#else
+			started[i] = ( 0 == pthread_create( &handles[i], NULL, soil_thread_entry, &ranges[i] ) );
+#endif
+		}
+		job( user_data, ranges[0].first, ranges[0].last );
+		for( i = 1; i < threads; ++i )
+		{
+			if( started[i] )
+			{
+#if defined( SOIL_THREADS_WIN32 )
+				WaitForSingleObject( handles[i], INFINITE );
+				CloseHandle( handles[i] );
+#else
+				pthread_join( handles[i], NULL );
+#endif
+			} else
+			{
+				/*	couldn't get a thread, do it here	*/
+				job( user_data, ranges[i].first, ranges[i].last );
+			}
+		}
+	}
+#endif
+}
+
+int
+	soil_atomic_increment
+	(
+		volatile int *value
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	return (int)InterlockedIncrement( (volatile LONG*)value );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	return __sync_add_and_fetch( value, 1 );
+#else
+	return ++(*value);
+#endif
+}
+
+int
+	soil_atomic_load
+	(
+		volatile int *value
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	return (int)InterlockedCompareExchange( (volatile LONG*)value, 0, 0 );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+#else
+	return *value;
+#endif
+}
+
+void
+	soil_atomic_store
+	(
+		volatile int *value,
+		int new_value
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	InterlockedExchange( (volatile LONG*)value, new_value );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	__atomic_store_n( value, new_value, __ATOMIC_RELEASE );
+#else
+	*value = new_value;
+#endif
+}
+
+int
+	soil_atomic_decrement
+	(
+		volatile int *value
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	return (int)InterlockedDecrement( (volatile LONG*)value );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	return __sync_sub_and_fetch( value, 1 );
+#else
+	return --(*value);
+#endif
+}
+
+void
+	soil_spin_lock_acquire
+	(
+		soil_spin_lock *lock
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	while( 0 != InterlockedExchange( (volatile LONG*)lock, 1 ) )
+	{
+		SwitchToThread();
+	}
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	while( 0 != __sync_lock_test_and_set( lock, 1 ) )
+	{
+	#if defined( SOIL_THREADS_PTHREADS )
+		sched_yield();
+	#endif
+	}
+#else
+	*lock = 1;
+#endif
+}
+
+void
+	soil_spin_lock_release
+	(
+		soil_spin_lock *lock
+	)
+{
+#if defined( SOIL_THREADS_WIN32 )
+	InterlockedExchange( (volatile LONG*)lock, 0 );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+	__sync_lock_release( lock );
+#else
+	*lock = 0;
+#endif
+}
+
+/*	the thread pool	*/
+typedef struct soil_pool_task
+{
+	soil_thread_task task;
+	void *user_data;
+	struct soil_pool_task *next;
+}
+soil_pool_task;
+
+struct soil_thread_pool
+{
+	soil_pool_task *head;
+	soil_pool_task *tail;
+	/*	queued + running	*/
+	int pending;
+	int stopping;
+	int thread_count;
+#if defined( SOIL_THREADS_WIN32 )
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE work_ready;
+	CONDITION_VARIABLE work_done;
+	HANDLE threads[SOIL_MAX_THREADS];
+#elif defined( SOIL_THREADS_PTHREADS )
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	pthread_t threads[SOIL_MAX_THREADS];
+#endif
+};
+
+#if defined( SOIL_THREADS_WIN32 )
+	#define SOIL_POOL_LOCK( pool )		EnterCriticalSection( &(pool)->lock )
+	#define SOIL_POOL_UNLOCK( pool )	LeaveCriticalSection( &(pool)->lock )
+	#define SOIL_POOL_WAIT( pool, cond )	SleepConditionVariableCS( &(pool)->cond, &(pool)->lock, INFINITE )
+	#define SOIL_POOL_SIGNAL( pool, cond )	WakeConditionVariable( &(pool)->cond )
+	#define SOIL_POOL_BROADCAST( pool, cond )	WakeAllConditionVariable( &(pool)->cond )
+#elif defined( SOIL_THREADS_PTHREADS )
+	#define SOIL_POOL_LOCK( pool )		pthread_mutex_lock( &(pool)->lock )
+	#define SOIL_POOL_UNLOCK( pool )	pthread_mutex_unlock( &(pool)->lock )
+	#define SOIL_POOL_WAIT( pool, cond )	pthread_cond_wait( &(pool)->cond, &(pool)->lock )
+	#define SOIL_POOL_SIGNAL( pool, cond )	pthread_cond_signal( &(pool)->cond )
+	#define SOIL_POOL_BROADCAST( pool, cond )	pthread_cond_broadcast( &(pool)->cond )
+#endif
+
+#if !defined( SOIL_NO_THREADS )
+static void soil_pool_worker( soil_thread_pool *pool )
+{
+#if defined( SOIL_THREAD_LOCAL )
+	soil_is_pool_worker = 1;
+#endif
+	for( ;; )
+	{
+		soil_pool_task *item;
+		SOIL_POOL_LOCK( pool );
+		while( (NULL == pool->head) && !pool->stopping )
+		{
+			SOIL_POOL_WAIT( pool, work_ready );
+		}
+		item = pool->head;
+		if( NULL == item )
+		{
+			/*	stopping, and the queue is drained	*/
+			SOIL_POOL_UNLOCK( pool );
+			return;
+		}
+		pool->head = item->next;
+		if( NULL == pool->head )
+		{
+			pool->tail = NULL;
+		}
+		SOIL_POOL_UNLOCK( pool );
+
+#if !defined( SOIL_THREAD_LOCAL )
+		soil_atomic_increment( &soil_pool_tasks_running );
+		item->task( item->user_data );
+		soil_atomic_decrement( &soil_pool_tasks_running );
+#else
+		item->task( item->user_data );
+#endif
+		free( item );
+
+		SOIL_POOL_LOCK( pool );
+		--pool->pending;
+		SOIL_POOL_BROADCAST( pool, work_done );
+		SOIL_POOL_UNLOCK( pool );
+	}
+}
+
+#if defined( SOIL_THREADS_WIN32 )
+static DWORD WINAPI soil_pool_thread_entry( LPVOID param )
+{
+	soil_pool_worker( (soil_thread_pool*)param );
+	return 0;
+}
+#else
+static void *soil_pool_thread_entry( void *param )
+{
+	soil_pool_worker( (soil_thread_pool*)param );
+	return NULL;
+}
+#endif
+#endif
+
+soil_thread_pool*
+	soil_thread_pool_create
+	(
+		int thread_count
+	)
+{
+	soil_thread_pool *pool = (soil_thread_pool*)calloc( 1, sizeof( soil_thread_pool ) );
+	if( NULL == pool )
+	{
+		return NULL;
+	}
+#if !defined( SOIL_NO_THREADS )
+	if( thread_count < 1 )
+	{
+		thread_count = soil_cpu_count();
+	}
+	if( thread_count > SOIL_MAX_THREADS )
+	{
+		thread_count = SOIL_MAX_THREADS;
+	}
+#if defined( SOIL_THREADS_WIN32 )
+	InitializeCriticalSection( &pool->lock );
+	InitializeConditionVariable( &pool->work_ready );
+	InitializeConditionVariable( &pool->work_done );
+#else
+	pthread_mutex_init( &pool->lock, NULL );
+	pthread_cond_init( &pool->work_ready, NULL );
+	pthread_cond_init( &pool->work_done, NULL );
+#endif
+	for( pool->thread_count = 0; pool->thread_count < thread_count; ++pool->thread_count )
+	{
+#if defined( SOIL_THREADS_WIN32 )
+		pool->threads[pool->thread_count] = CreateThread( NULL, 0, soil_pool_thread_entry, pool, 0, NULL );
+		if( NULL == pool->threads[pool->thread_count] )
+		{
+			break;
+		}
+#else
+		if( 0 != pthread_create( &pool->threads[pool->thread_count], NULL, soil_pool_thread_entry, pool ) )
+		{
+			break;
+		}
+#endif
+	}
+#else
+	(void)thread_count;
+#endif
+	return pool;
+}
+
+int
+	soil_thread_pool_submit
+	(
+		soil_thread_pool *pool,
+		soil_thread_task task,
+		void *user_data
+	)
+{
+	soil_pool_task *item;
+	if( (NULL == pool) || (NULL == task) )
+	{
+		return 0;
+	}
+	if( pool->thread_count < 1 )
+	{
+		/*	no workers (no threads, or none could be started)	*/
+		task( user_data );
+		return 1;
+	}
+#if !defined( SOIL_NO_THREADS )
+	item = (soil_pool_task*)malloc( sizeof( soil_pool_task ) );
+	if( NULL == item )
+	{
+		return 0;
+	}
+	item->task = task;
+	item->user_data = user_data;
+	item->next = NULL;
+	SOIL_POOL_LOCK( pool );
+	if( NULL != pool->tail )
+	{
+		pool->tail->next = item;
+	} else
+	{
+		pool->head = item;
+	}
+	pool->tail = item;
+	++pool->pending;
+	SOIL_POOL_SIGNAL( pool, work_ready );
+	SOIL_POOL_UNLOCK( pool );
+#else
+	(void)item;
+#endif
+	return 1;
+}
+
+int
+	soil_thread_pool_wait
+	(
+		soil_thread_pool *pool,
+		int max_pending
+	)
+{
+	int pending = 0;
+	if( (NULL == pool) || (pool->thread_count < 1) )
+	{
+		return 0;
+	}
+#if !defined( SOIL_NO_THREADS )
+	SOIL_POOL_LOCK( pool );
+	while( pool->pending > max_pending )
+	{
+		SOIL_POOL_WAIT( pool, work_done );
+	}
+	pending = pool->pending;
+	SOIL_POOL_UNLOCK( pool );
+#else
+	(void)max_pending;
+#endif
+	return pending;
+}
+
+void
+	soil_thread_pool_destroy
+	(
+		soil_thread_pool *pool
+	)
+{
+	if( NULL == pool )
+	{
+		return;
+	}
+#if !defined( SOIL_NO_THREADS )
+	{
+		int i;
+		SOIL_POOL_LOCK( pool );
+		pool->stopping = 1;
+		SOIL_POOL_BROADCAST( pool, work_ready );
+		SOIL_POOL_UNLOCK( pool );
+		for( i = 0; i < pool->thread_count; ++i )
+		{
+#if defined( SOIL_THREADS_WIN32 )
+			WaitForSingleObject( pool->threads[i], INFINITE );
+			CloseHandle( pool->threads[i] );
+#else
+			pthread_join( pool->threads[i], NULL );
+#endif
+		}
+#if defined( SOIL_THREADS_WIN32 )
+		DeleteCriticalSection( &pool->lock );
+#else
+		pthread_mutex_destroy( &pool->lock );
+		pthread_cond_destroy( &pool->work_ready );
+		pthread_cond_destroy( &pool->work_done );
+#endif
+	}
+#endif
+	free( pool );
+}
+
+#if !defined( SOIL_NO_THREADS ) && defined( SOIL_THREAD_LOCAL )
+/*	the pool soil_parallel_for shares, started on first use and kept
+	for the life of the process	*/
+static soil_thread_pool *soil_shared_pool = NULL;
+/*	0 not tried yet, 1 running, -1 couldn't start any workers	*/
+static volatile int soil_shared_pool_state = 0;
+static soil_spin_lock soil_shared_pool_lock = 0;
+
+static soil_thread_pool *soil_get_shared_pool( void )
+{
+	int state = soil_atomic_load( &soil_shared_pool_state );
+	if( 0 == state )
+	{
+		soil_spin_lock_acquire( &soil_shared_pool_lock );
+		state = soil_atomic_load( &soil_shared_pool_state );
+		if( 0 == state )
+		{
+			soil_shared_pool = soil_thread_pool_create( soil_get_thread_count() );
+			if( (NULL != soil_shared_pool) && (soil_shared_pool->thread_count < 1) )
+			{
+				soil_thread_pool_destroy( soil_shared_pool );
+				soil_shared_pool = NULL;
+			}
+			state = ( NULL != soil_shared_pool ) ? 1 : -1;
+			soil_atomic_store( &soil_shared_pool_state, state );
+		}
+		soil_spin_lock_release( &soil_shared_pool_lock );
+	}
+	return ( 1 == state ) ? soil_shared_pool : NULL;
+}
+
+static void soil_shared_pool_task( void *user_data )
+{
+	soil_parallel_range *range = (soil_parallel_range*)user_data;
+	range->job( range->user_data, range->first, range->last );
+	/*	the last touch of the caller's stack, it may return right after	*/
+	soil_atomic_decrement( range->remaining );
+}
+
+static int soil_parallel_for_shared_pool( soil_parallel_range *ranges, int threads )
+{
+	soil_thread_pool *pool = soil_get_shared_pool();
+	volatile int remaining = 0;
+	int i;
+	if( NULL == pool )
+	{
+		return 0;
+	}
+	remaining = threads - 1;
+	for( i = 1; i < threads; ++i )
+	{
+		ranges[i].remaining = &remaining;
+		if( !soil_thread_pool_submit( pool, soil_shared_pool_task, &ranges[i] ) )
+		{
+			/*	couldn't queue it, do it here	*/
+			soil_shared_pool_task( &ranges[i] );
+		}
+	}
+	/*	the calling thread does range 0	*/
+	ranges[0].job( ranges[0].user_data, ranges[0].first, ranges[0].last );
+	/*	workers broadcast work_done under the lock after every task, so
+		a decrement can't slip in between the check and the wait	*/
+	SOIL_POOL_LOCK( pool );
+	while( 0 != soil_atomic_load( &remaining ) )
+	{
+		SOIL_POOL_WAIT( pool, work_done );
+	}
+	SOIL_POOL_UNLOCK( pool );
+	return 1;
+}
+#endif
@@ -0,0 +1,199 @@
+/*
+	Thread helper functions
+
+	A tiny "parallel for" used by the block based
+	encoders and decoders, and a small thread pool
+	for background work.  Uses pthreads or Win32
+	threads, define SOIL_NO_THREADS to run everything
+	on the calling thread.
+
+	MIT license
+*/
+
+#ifndef HEADER_THREAD_HELPER
+#define HEADER_THREAD_HELPER
+
+/*	thread local storage, where the compiler has it and
+	SOIL_NO_THREAD_LOCALS isn't defined	*/
+#ifndef SOIL_NO_THREAD_LOCALS
+	#if defined( __cplusplus ) && __cplusplus >= 201103L
+		#define SOIL_THREAD_LOCAL thread_local
+	#elif defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L
+		#define SOIL_THREAD_LOCAL _Thread_local
+	#elif defined( __GNUC__ )
+		#define SOIL_THREAD_LOCAL __thread
+	#elif defined( _MSC_VER )
+		#define SOIL_THREAD_LOCAL __declspec(thread)
+	#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+	A job run by soil_parallel_for.
+	It must process the items in [first, last).
+**/
+typedef void (*soil_parallel_job)( void *user_data, int first, int last );
+
+/**
+	This function returns the number of threads soil_parallel_for
+	will use: the number of online CPUs, unless it was overridden
+	with soil_set_thread_count.
+**/
+int
+	soil_get_thread_count
+	(
+		void
+	);
+
+/**
+	This function overrides the number of threads used by
+	soil_parallel_for.  Pass 0 to go back to the CPU count,
+	pass 1 to disable threading.
+**/
+void
+	soil_set_thread_count
+	(
+		int thread_count
+	);
+
+/**
+	This function splits [0, count) into contiguous ranges of
+	at least min_items_per_thread items and runs job on each range.
+	The calling thread takes the first range itself, and the function
+	returns once every range is done.  If a thread can't be created
+	its range is run on the calling thread, so job always covers
+	all the items.
+	The other ranges go to a process wide soil_thread_pool started on
+	the first call; without thread locals a thread is started per range
+	instead.  Called from a pool worker, the job runs serially (without
+	thread locals the threads are shared by the pool tasks running).
+**/
+void
+	soil_parallel_for
+	(
+		int count,
+		int min_items_per_thread,
+		soil_parallel_job job,
+		void *user_data
+	);
+
+/**
+	This function atomically adds 1 to *value.
+	\return the new value
+**/
+int
+	soil_atomic_increment
+	(
+		volatile int *value
+	);
+
+/**
+	This function atomically reads *value.
+**/
+int
+	soil_atomic_load
+	(
+		volatile int *value
+	);
+
+/**
+	This function atomically writes new_value to *value.
+**/
+void
+	soil_atomic_store
+	(
+		volatile int *value,
+		int new_value
+	);
+
+/**
+	This function atomically subtracts 1 from *value.
+	\return the new value
+**/
+int
+	soil_atomic_decrement
+	(
+		volatile int *value
+	);
+
+/**
+	A lock for a few instructions' worth of work, 0 is unlocked.
+	Waiters yield instead of sleeping, so keep what it guards short.
+**/
+typedef volatile int soil_spin_lock;
+
+void
+	soil_spin_lock_acquire
+	(
+		soil_spin_lock *lock
+	);
+
+void
+	soil_spin_lock_release
+	(
+		soil_spin_lock *lock
+	);
+
+/**
+	A task run by a soil_thread_pool worker.
+**/
+typedef void (*soil_thread_task)( void *user_data );
+
+/**
+	A set of long lived worker threads with a FIFO task queue.
+**/
+typedef struct soil_thread_pool soil_thread_pool;
+
+/**
+	This function starts thread_count workers (0 means CPU count).
+	Without thread support the pool has no workers and
+	soil_thread_pool_submit runs the task right away.
+	\return the pool, NULL if failed
+**/
+soil_thread_pool*
+	soil_thread_pool_create
+	(
+		int thread_count
+	);
+
+/**
+	This function queues a task, it runs on the first free worker.
+	\return 0 if failed (the task was not queued), otherwise returns 1
+**/
+int
+	soil_thread_pool_submit
+	(
+		soil_thread_pool *pool,
+		soil_thread_task task,
+		void *user_data
+	);
+
+/**
+	This function blocks until at most max_pending tasks are
+	queued or running (0 waits for all of them).
+	\return the number of tasks queued or running
+**/
+int
+	soil_thread_pool_wait
+	(
+		soil_thread_pool *pool,
+		int max_pending
+	);
+
+/**
+	This function finishes every queued task, then stops the workers.
+**/
+void
+	soil_thread_pool_destroy
+	(
+		soil_thread_pool *pool
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_THREAD_HELPER	*/
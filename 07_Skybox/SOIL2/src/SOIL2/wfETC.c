@@ -1,5 +1,12 @@
 
 #include "wfETC.h"
+#include "thread_helper.h"
+#include <string.h>
+
+#if !defined( WF_ETC_NO_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+	#define WF_ETC_SSE2
+	#include <emmintrin.h>
+#endif
 
 // specification: http://www.khronos.org/registry/gles/extensions/OES/OES_compressed_ETC1_RGB8_texture.txt
 
@@ -59,6 +66,7 @@ typedef struct _wfETC1_Block
 
 #define WF_ETC1_CHECK_DIFF_BIT( block ) ( block->baseColorsAndFlags & (1<<WF_ETC1_COLOR_OFFSET(33)) )
 #define WF_ETC1_CHECK_FLIP_BIT( block ) ( block->baseColorsAndFlags & (1<<WF_ETC1_COLOR_OFFSET(32)) )
+#define WF_ETC1_TABLE_IDX( block, offset ) ( ( block->baseColorsAndFlags >> WF_ETC1_COLOR_OFFSET(offset) ) & 0x7 )
 
 WF_INLINE
 int32_t wfETC1_ReadColor4( const wfETC1_Block* block, const uint32_t offset )
@@ -101,14 +109,9 @@ int32_t wfETC1_ReadPixel( const wfETC1_Block* block, const uint32_t offset )
 	;
 }
 
-void wfETC1_DecodeBlock( const void* WF_RESTRICT src, void* WF_RESTRICT pDst, const uint32_t dstStride )
+static WF_INLINE
+void wfETC1_ReadBaseColors( const wfETC1_Block* block, int32_t baseColors[2][3] )
 {
-	const wfETC1_Block* WF_RESTRICT block = ( wfETC1_Block* )src;
-	int32_t* WF_RESTRICT dst = (int32_t*)pDst;
-
-	int32_t baseColors[2][3]; // [sub-block][r,g,b]
-	int32_t colors[2][4]; // [sub-block][colorIdx]
-
 	// individual mode
 	if( WF_ETC1_CHECK_DIFF_BIT( block ) == 0 )
 	{
@@ -126,13 +129,24 @@ void wfETC1_DecodeBlock( const void* WF_RESTRICT src, void* WF_RESTRICT pDst, co
 		wfETC1_ReadColor53( block, 48, &baseColors[0][1], &baseColors[1][1] );
 		wfETC1_ReadColor53( block, 40, &baseColors[0][2], &baseColors[1][2] );
 	}
+}
+
+void wfETC1_DecodeBlock( const void* WF_RESTRICT src, void* WF_RESTRICT pDst, const uint32_t dstStride )
+{
+	const wfETC1_Block* WF_RESTRICT block = ( wfETC1_Block* )src;
+	int32_t* WF_RESTRICT dst = (int32_t*)pDst;
+
+	int32_t baseColors[2][3]; // [sub-block][r,g,b]
+	int32_t colors[2][4]; // [sub-block][colorIdx]
+
+	wfETC1_ReadBaseColors( block, baseColors );
 
 	// build color tables
 	{
 		const int32_t* intensityTable[2] = // [sub-block]
 		{
-			wfETC_IntensityTables[ ( block->baseColorsAndFlags >> WF_ETC1_COLOR_OFFSET(37) ) & 0x7 ],
-			wfETC_IntensityTables[ ( block->baseColorsAndFlags >> WF_ETC1_COLOR_OFFSET(34) ) & 0x7 ]
+			wfETC_IntensityTables[ WF_ETC1_TABLE_IDX( block, 37 ) ],
+			wfETC_IntensityTables[ WF_ETC1_TABLE_IDX( block, 34 ) ]
 		};
 		WF_ETC1_BUILD_COLOR( colors, 0, 0, intensityTable, baseColors );
 		WF_ETC1_BUILD_COLOR( colors, 0, 1, intensityTable, baseColors );
@@ -208,21 +222,146 @@ void wfETC1_DecodeBlock( const void* WF_RESTRICT src, void* WF_RESTRICT pDst, co
 	}
 }
 
-void wfETC1_DecodeImage( const void* WF_RESTRICT pSrc, void* WF_RESTRICT pDst, const uint32_t width, const uint32_t height )
+#ifdef WF_ETC_SSE2
+
+#define WF_ETC1_PIXEL_MASK( offset ) ( (int)( 1u << WF_ETC1_PIXEL_OFFSET( offset ) ) )
+
+// per pixel select: mask ? a : b
+#define WF_ETC1_SELECT( mask, a, b ) _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) )
+
+// the 4 colors of a sub-block, in the byte order WF_ETC_RGBA gives on little endian
+static WF_INLINE
+__m128i wfETC1_BuildPaletteSSE2( const int32_t baseColor[3], const int32_t* intensityTable )
+{
+	const __m128i base = _mm_setr_epi16(
+		(short)baseColor[2], (short)baseColor[1], (short)baseColor[0], 255,
+		(short)baseColor[2], (short)baseColor[1], (short)baseColor[0], 255 );
+	const __m128i mod01 = _mm_setr_epi16(
+		(short)intensityTable[0], (short)intensityTable[0], (short)intensityTable[0], 0,
+		(short)intensityTable[1], (short)intensityTable[1], (short)intensityTable[1], 0 );
+	const __m128i mod23 = _mm_setr_epi16(
+		(short)intensityTable[2], (short)intensityTable[2], (short)intensityTable[2], 0,
+		(short)intensityTable[3], (short)intensityTable[3], (short)intensityTable[3], 0 );
+	// packus does the [0,255] clamp
+	return _mm_packus_epi16( _mm_add_epi16( base, mod01 ), _mm_add_epi16( base, mod23 ) );
+}
+
+// writes one row of 4 pixels, palette[k] holds color k for each of the 4 pixels
+static WF_INLINE
+void wfETC1_WriteRowSSE2( const __m128i pixels, const __m128i palette[4], const int y, uint8_t* WF_RESTRICT dst )
+{
+	const __m128i maskLo = _mm_setr_epi32(
+		WF_ETC1_PIXEL_MASK( y ), WF_ETC1_PIXEL_MASK( 4+y ), WF_ETC1_PIXEL_MASK( 8+y ), WF_ETC1_PIXEL_MASK( 12+y ) );
+	const __m128i maskHi = _mm_setr_epi32(
+		WF_ETC1_PIXEL_MASK( 16+y ), WF_ETC1_PIXEL_MASK( 20+y ), WF_ETC1_PIXEL_MASK( 24+y ), WF_ETC1_PIXEL_MASK( 28+y ) );
+	const __m128i lo = _mm_cmpeq_epi32( _mm_and_si128( pixels, maskLo ), maskLo );
+	const __m128i hi = _mm_cmpeq_epi32( _mm_and_si128( pixels, maskHi ), maskHi );
+	const __m128i c01 = WF_ETC1_SELECT( lo, palette[1], palette[0] );
+	const __m128i c23 = WF_ETC1_SELECT( lo, palette[3], palette[2] );
+	_mm_storeu_si128( (__m128i*)dst, WF_ETC1_SELECT( hi, c23, c01 ) );
+}
+
+// same output as wfETC1_DecodeBlock, dstStride in pixels
+static void wfETC1_DecodeBlockSSE2( const wfETC1_Block* WF_RESTRICT block, uint8_t* WF_RESTRICT dst, const uint32_t dstStride )
 {
-	const uint8_t* WF_RESTRICT src = (uint8_t*)pSrc;
-	uint8_t* WF_RESTRICT dst = (uint8_t*)pDst;
-	const uint32_t widthBlocks  = width/4;
-	const uint32_t heightBlocks = height/4;
+	int32_t baseColors[2][3]; // [sub-block][r,g,b]
+	__m128i pal[2], bcast[2][4], row[4];
+	const __m128i pixels = _mm_set1_epi32( block->pixels );
+	const size_t rowBytes = (size_t)dstStride * 4;
+	int k;
+
+	wfETC1_ReadBaseColors( block, baseColors );
+	pal[0] = wfETC1_BuildPaletteSSE2( baseColors[0], wfETC_IntensityTables[ WF_ETC1_TABLE_IDX( block, 37 ) ] );
+	pal[1] = wfETC1_BuildPaletteSSE2( baseColors[1], wfETC_IntensityTables[ WF_ETC1_TABLE_IDX( block, 34 ) ] );
+
+	bcast[0][0] = _mm_shuffle_epi32( pal[0], 0x00 );
+	bcast[0][1] = _mm_shuffle_epi32( pal[0], 0x55 );
+	bcast[0][2] = _mm_shuffle_epi32( pal[0], 0xaa );
+	bcast[0][3] = _mm_shuffle_epi32( pal[0], 0xff );
+	bcast[1][0] = _mm_shuffle_epi32( pal[1], 0x00 );
+	bcast[1][1] = _mm_shuffle_epi32( pal[1], 0x55 );
+	bcast[1][2] = _mm_shuffle_epi32( pal[1], 0xaa );
+	bcast[1][3] = _mm_shuffle_epi32( pal[1], 0xff );
+
+	// vertical split
+	if( WF_ETC1_CHECK_FLIP_BIT( block ) == 0 )
+	{
+		// columns 0-1 from sub-block 0, columns 2-3 from sub-block 1
+		for( k = 0; k < 4; ++k )
+		{
+			row[k] = _mm_unpacklo_epi64( bcast[0][k], bcast[1][k] );
+		}
+		wfETC1_WriteRowSSE2( pixels, row, 0, dst );
+		wfETC1_WriteRowSSE2( pixels, row, 1, dst + rowBytes );
+		wfETC1_WriteRowSSE2( pixels, row, 2, dst + rowBytes*2 );
+		wfETC1_WriteRowSSE2( pixels, row, 3, dst + rowBytes*3 );
+	}
+	// horizontal split
+	else
+	{
+		wfETC1_WriteRowSSE2( pixels, bcast[0], 0, dst );
+		wfETC1_WriteRowSSE2( pixels, bcast[0], 1, dst + rowBytes );
+		wfETC1_WriteRowSSE2( pixels, bcast[1], 2, dst + rowBytes*2 );
+		wfETC1_WriteRowSSE2( pixels, bcast[1], 3, dst + rowBytes*3 );
+	}
+}
+
+#define WF_ETC1_DECODE_BLOCK( src, dst, dstStride ) wfETC1_DecodeBlockSSE2( (const wfETC1_Block*)(src), (uint8_t*)(dst), dstStride )
+#else
+#define WF_ETC1_DECODE_BLOCK( src, dst, dstStride ) wfETC1_DecodeBlock( src, dst, dstStride )
+#endif
+
+typedef struct _wfETC1_DecodeJob
+{
+	const uint8_t* src;
+	uint8_t* dst;
+	uint32_t width;
+	uint32_t height;
+} wfETC1_DecodeJob;
+
+// decodes the block rows [first, last)
+static void wfETC1_DecodeRows( void* userData, int first, int last )
+{
+	const wfETC1_DecodeJob* job = (const wfETC1_DecodeJob*)userData;
+	const uint32_t widthBlocks = ( job->width + 3 ) / 4;
+	const uint32_t fullWidthBlocks = job->width / 4;
 	uint32_t x, y;
-	for( y = 0; y != heightBlocks; ++y )
+	for( y = (uint32_t)first; y != (uint32_t)last; ++y )
 	{
-		for( x = 0; x != widthBlocks; ++x )
+		const uint8_t* WF_RESTRICT src = job->src + (size_t)y * widthBlocks * 8;
+		uint8_t* WF_RESTRICT dst = job->dst + (size_t)y * 4 * job->width * 4;
+		const uint32_t rows = ( job->height - y*4 ) < 4 ? ( job->height - y*4 ) : 4;
+
+		for( x = 0; x != widthBlocks; ++x, src += 8, dst += 16 )
 		{
-			wfETC1_DecodeBlock( src, dst, width );
-			src += 8;
-			dst += 16;
+			if( rows == 4 && x < fullWidthBlocks )
+			{
+				WF_ETC1_DECODE_BLOCK( src, dst, job->width );
+			}
+			else
+			{
+				// edge block, decode aside and copy what is inside the image
+				int32_t tmp[16];
+				const uint32_t cols = ( x < fullWidthBlocks ) ? 4 : job->width - x*4;
+				uint32_t r;
+				WF_ETC1_DECODE_BLOCK( src, tmp, 4 );
+				for( r = 0; r != rows; ++r )
+				{
+					memcpy( dst + (size_t)r * job->width * 4, &tmp[r*4], cols * 4 );
+				}
+			}
 		}
-		dst += width*4*3;
 	}
 }
+
+void wfETC1_DecodeImage( const void* WF_RESTRICT pSrc, void* WF_RESTRICT pDst, const uint32_t width, const uint32_t height )
+{
+	wfETC1_DecodeJob job;
+	job.src = (const uint8_t*)pSrc;
+	job.dst = (uint8_t*)pDst;
+	job.width = width;
+	job.height = height;
+
+	// 16 block rows is ~64 KB of output for a 256 wide image, less than that isn't worth a thread
+	soil_parallel_for( (int)( ( height + 3 ) / 4 ), 16, wfETC1_DecodeRows, &job );
+}
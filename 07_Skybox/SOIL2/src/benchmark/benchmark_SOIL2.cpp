@@ -0,0 +1,774 @@
+// Headless SOIL2 benchmark suite: no window, no GL context, no SDL.
+// Runs decode, convert, mipmap, DXT encode and save over every file in bin
+// (or the files given on the command line), reports median / p95 as JSON
+// and compares against a stored baseline.
+//
+//	soil2-benchmark [--warmup N] [--reps N] [--threads N] [--json out.json]
+//					[--baseline base.json] [--tolerance percent] [files...]
+//
+// The exit code is 1 when a result is slower than its baseline by more than
+// the tolerance, so a CI job can run it as is.  Write a baseline with --json
+// on the reference build, then pass that file as --baseline.
+//
+// Before anything is timed, the output of the fast decode paths is checked
+// against a scalar build of the same decoders (reference_decoder.h); a
+// mismatch fails the run as well.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "../common/common.hpp"
+#include "../SOIL2/SOIL2.h"
+#include "../SOIL2/image_helper.h"
+extern "C" {
+#include "../SOIL2/image_DXT.h"
+}
+#include "../SOIL2/thread_helper.h"
+#include "reference_decoder.h"
+
+#if defined( _WIN32 )
+	#include <windows.h>
+#else
+	#include <dirent.h>
+	#include <sys/stat.h>
+#endif
+
+struct BenchOptions
+{
+	BenchOptions() : warmup(2), repetitions(10), threads(0), tolerance(10.0) { }
+
+	int warmup;
+	int repetitions;
+	int threads;
+	double tolerance;
+	std::string jsonFile;
+	std::string baselineFile;
+	std::vector<std::string> files;
+};
+
+struct BenchResult
+{
+	std::string name;
+	std::string op;
+	std::string file;
+	int width, height, channels;
+	double bytes;
+	double medianMs, p95Ms, minMs;
+};
+
+static double NowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string BaseName(const std::string &path)
+{
+	return path.substr(path.find_last_of("/\\") + 1);
+}
+
+// every regular file in dir but the programs built into it (soil2-*),
+// sorted so the report order is stable
+static bool IsBenchmarkInput(const std::string &name)
+{
+	return name[0] != '.' && name.compare(0, 5, "soil2") != 0 && name.find(".dll") == std::string::npos;
+}
+
+static std::vector<std::string> ListFiles(const std::string &dir)
+{
+	std::vector<std::string> files;
+
+#if defined( _WIN32 )
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((dir + "*").c_str(), &fd);
+
+	if (INVALID_HANDLE_VALUE != h)
+	{
+		do
+		{
+			if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && IsBenchmarkInput(fd.cFileName))
+				files.push_back(dir + fd.cFileName);
+		} while (FindNextFileA(h, &fd));
+
+		FindClose(h);
+	}
+#else
+	DIR *d = opendir(dir.c_str());
+
+	if (NULL != d)
+	{
+		struct dirent *e;
+		while (NULL != (e = readdir(d)))
+		{
+			std::string path = dir + e->d_name;
+			struct stat st;
+
+			if (IsBenchmarkInput(e->d_name) && 0 == stat(path.c_str(), &st) && S_ISREG(st.st_mode))
+				files.push_back(path);
+		}
+
+		closedir(d);
+	}
+#endif
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+static bool ReadFileData(const std::string &file, std::vector<unsigned char> &data)
+{
+	FILE *fp = fopen(file.c_str(), "rb");
+
+	if (NULL == fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	data.resize((size_t)ftell(fp));
+	fseek(fp, 0, SEEK_SET);
+
+	bool ok = !data.empty() && fread(&data[0], 1, data.size(), fp) == data.size();
+	fclose(fp);
+	return ok;
+}
+
+// nearest rank percentile of the sorted samples
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+	size_t rank = (size_t)ceil(p * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// runs op warmup + repetitions times, only the repetitions are kept
+template <typename Op>
+static bool Measure(const BenchOptions &options, Op op, BenchResult &result)
+{
+	std::vector<double> samples;
+
+	for (int i = 0; i < options.warmup + options.repetitions; ++i)
+	{
+		double start = NowMs();
+		if (!op())
+			return false;
+		double end = NowMs();
+
+		if (i >= options.warmup)
+			samples.push_back(end - start);
+	}
+
+	std::sort(samples.begin(), samples.end());
+	result.minMs = samples.front();
+	result.medianMs = samples.size() & 1 ? samples[samples.size() / 2] :
+		0.5 * (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]);
+	result.p95Ms = Percentile(samples, 0.95);
+	return true;
+}
+
+static void AddResult(std::vector<BenchResult> &results, const std::string &op, const std::string &file,
+					  int width, int height, int channels, const BenchResult &timing)
+{
+	BenchResult r = timing;
+	r.name = op + "/" + file;
+	r.op = op;
+	r.file = file;
+	r.width = width;
+	r.height = height;
+	r.channels = channels;
+	r.bytes = (double)width * height * channels;
+	results.push_back(r);
+
+	printf("%-28s %-24s %5dx%-5d %8.3f ms median %8.3f ms p95 %9.2f MB/s\n", op.c_str(), file.c_str(),
+		   width, height, r.medianMs, r.p95Ms, r.bytes / (1024.0 * 1024.0) / (r.medianMs * 0.001));
+}
+
+static void BenchFile(const BenchOptions &options, const std::string &path, std::vector<BenchResult> &results)
+{
+	const std::string file = BaseName(path);
+	std::vector<unsigned char> data;
+	int width = 0, height = 0, channels = 0;
+	BenchResult timing;
+
+	if (!ReadFileData(path, data))
+	{
+		fprintf(stderr, "skipping %s: could not read it\n", file.c_str());
+		return;
+	}
+
+	unsigned char *img = SOIL_load_image_from_memory(&data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_AUTO);
+
+	if (NULL == img)
+	{
+		fprintf(stderr, "skipping %s: %s\n", file.c_str(), SOIL_last_result());
+		return;
+	}
+
+	// decode, from memory so the file system stays out of the timings
+	if (Measure(options, [&]() {
+			int w, h, c;
+			unsigned char *p = SOIL_load_image_from_memory(&data[0], (int)data.size(), &w, &h, &c, SOIL_LOAD_AUTO);
+			SOIL_free_image_data(p);
+			return NULL != p;
+		}, timing))
+		AddResult(results, "decode", file, width, height, channels, timing);
+
+	// convert: the fused flip / premultiply / YCoCg pass of the texture loaders
+	std::vector<unsigned char> converted((size_t)width * height * channels);
+	if (Measure(options, [&]() {
+			return 0 != postprocess_image(img, &converted[0], width, height, channels,
+				IMAGE_POSTPROCESS_INVERT_Y | IMAGE_POSTPROCESS_MULTIPLY_ALPHA | IMAGE_POSTPROCESS_YCOCG);
+		}, timing))
+		AddResult(results, "convert", file, width, height, channels, timing);
+
+	// mipmap: the whole chain, each level from the full image like the texture loaders
+	std::vector<unsigned char> resampled((size_t)((width + 1) / 2) * ((height + 1) / 2) * channels);
+	if (Measure(options, [&]() {
+			for (int level = 1; (1 << level) <= width || (1 << level) <= height; ++level)
+			{
+				if (!mipmap_image(img, width, height, channels, &resampled[0], 1 << level, 1 << level))
+					return false;
+			}
+			return true;
+		}, timing))
+		AddResult(results, "mipmap", file, width, height, channels, timing);
+
+	// DXT encode: DXT1 without alpha, DXT5 with it
+	const bool alpha = !(channels & 1);
+	if (Measure(options, [&]() {
+			int size = 0;
+			unsigned char *dxt = alpha ? convert_image_to_DXT5(img, width, height, channels, &size) :
+										 convert_image_to_DXT1(img, width, height, channels, &size);
+			SOIL_free_image_data(dxt);
+			return NULL != dxt;
+		}, timing))
+		AddResult(results, alpha ? "dxt5_encode" : "dxt1_encode", file, width, height, channels, timing);
+
+	// save, in every format SOIL writes
+	const int NUM_SAVE_TYPES = 5;
+	const int saveTypes[NUM_SAVE_TYPES] = { SOIL_SAVE_TYPE_TGA, SOIL_SAVE_TYPE_BMP, SOIL_SAVE_TYPE_PNG, SOIL_SAVE_TYPE_JPG, SOIL_SAVE_TYPE_DDS };
+	const char *saveNames[NUM_SAVE_TYPES] = { "tga", "bmp", "png", "jpg", "dds" };
+	for (int s = 0; s < NUM_SAVE_TYPES; ++s)
+	{
+		std::string outFile = std::string("soil2_benchmark_save.") + saveNames[s];
+
+		if (Measure(options, [&]() {
+				return 0 != SOIL_save_image(outFile.c_str(), saveTypes[s], width, height, channels, img);
+			}, timing))
+			AddResult(results, std::string("save_") + saveNames[s], file, width, height, channels, timing);
+		else
+			fprintf(stderr, "save_%s %s failed: %s\n", saveNames[s], file.c_str(), SOIL_last_result());
+
+		remove(outFile.c_str());
+	}
+
+	SOIL_free_image_data(img);
+}
+
+// output checks: prints each one and returns whether it passed
+static bool ReportCheck(const std::string &check, bool passed, const std::string &detail)
+{
+	if (passed)
+		printf("check %-40s ok\n", check.c_str());
+	else
+		fprintf(stderr, "CHECK FAILED %s: %s\n", check.c_str(), detail.c_str());
+
+	return passed;
+}
+
+static bool CheckSameImage(const std::string &check, const unsigned char *image, int width, int height,
+						   const unsigned char *reference, int refWidth, int refHeight, int channels)
+{
+	char detail[256];
+
+	if (NULL == image || NULL == reference)
+	{
+		snprintf(detail, sizeof(detail), "%s", NULL == image ? SOIL_last_result() : "the reference could not decode it");
+		return ReportCheck(check, false, detail);
+	}
+
+	if (width != refWidth || height != refHeight)
+	{
+		snprintf(detail, sizeof(detail), "%dx%d, the reference is %dx%d", width, height, refWidth, refHeight);
+		return ReportCheck(check, false, detail);
+	}
+
+	const size_t size = (size_t)width * height * channels;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (image[i] != reference[i])
+		{
+			const size_t pixel = i / channels;
+			snprintf(detail, sizeof(detail), "pixel %d,%d channel %d is %d, the reference has %d",
+					 (int)(pixel % width), (int)(pixel / width), (int)(i % channels), image[i], reference[i]);
+			return ReportCheck(check, false, detail);
+		}
+	}
+
+	return ReportCheck(check, true, "");
+}
+
+// DDS: the block decode on several threads, and with AVX2 where the CPU has it,
+// against the scalar decode on one thread
+static int CheckDds(const BenchOptions &options)
+{
+	const int NUM_IMAGES = 2;
+	const char *images[NUM_IMAGES] = { "img_test.dds", "test_RGTC.dds" };
+	int failures = 0;
+
+	for (int f = 0; f < NUM_IMAGES; ++f)
+	{
+		const std::string check = std::string("dds_decode/") + images[f];
+		std::vector<unsigned char> data;
+
+		if (!ReadFileData(ResourcePath(images[f]), data))
+		{
+			failures += !ReportCheck(check, false, "could not read it");
+			continue;
+		}
+
+		int refWidth = 0, refHeight = 0, width = 0, height = 0, channels = 0;
+
+		unsigned char *reference = reference_load_image_from_memory(&data[0], (int)data.size(), &refWidth, &refHeight, &channels, 4);
+
+		// several ranges even on a single core machine
+		soil_set_thread_count(4);
+		unsigned char *img = SOIL_load_image_from_memory(&data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_RGBA);
+		soil_set_thread_count(options.threads);
+
+		failures += !CheckSameImage(check, img, width, height, reference, refWidth, refHeight, 4);
+
+		SOIL_free_image_data(img);
+		reference_free_image_data(reference);
+	}
+
+	return failures;
+}
+
+// PNG: the wide-refill inflater and the SSE2 unfiltering against the original
+// scalar decoder, over the PngSuite (every color type and bit depth) and the
+// PNGs in bin
+static int CheckPng()
+{
+	const int NUM_IMAGES = 32;
+	const char *images[NUM_IMAGES] = {
+		"pngsuite/basn0g01.png", "pngsuite/basn0g02.png", "pngsuite/basn0g04.png", "pngsuite/basn0g08.png",
+		"pngsuite/basn0g16.png", "pngsuite/basn2c08.png", "pngsuite/basn2c16.png", "pngsuite/basn3p01.png",
+		"pngsuite/basn3p02.png", "pngsuite/basn3p04.png", "pngsuite/basn3p08.png", "pngsuite/basn4a08.png",
+		"pngsuite/basn4a16.png", "pngsuite/basn6a08.png", "pngsuite/basn6a16.png", "pngsuite/ftbbn0g01.png",
+		"pngsuite/ftbbn0g02.png", "pngsuite/ftbbn0g04.png", "pngsuite/ftbbn2c16.png", "pngsuite/ftbbn3p08.png",
+		"pngsuite/ftbgn2c16.png", "pngsuite/ftbgn3p08.png", "pngsuite/ftbrn2c08.png", "pngsuite/ftbwn0g16.png",
+		"pngsuite/ftbwn3p08.png", "pngsuite/ftbyn3p08.png", "pngsuite/ftp0n0g08.png", "pngsuite/ftp0n2c08.png",
+		"pngsuite/ftp0n3p08.png", "pngsuite/ftp1n3p08.png", "img_test.png", "test_rect.png"
+	};
+	int failures = 0;
+
+	for (int f = 0; f < NUM_IMAGES; ++f)
+	{
+		const std::string check = std::string("png_decode/") + images[f];
+		std::vector<unsigned char> data;
+
+		if (!ReadFileData(ResourcePath(images[f]), data))
+		{
+			failures += !ReportCheck(check, false, "could not read it");
+			continue;
+		}
+
+		int refWidth = 0, refHeight = 0, refChannels = 0, width = 0, height = 0, channels = 0;
+		unsigned char *reference = reference_load_image_from_memory(&data[0], (int)data.size(), &refWidth, &refHeight, &refChannels, 0);
+		unsigned char *img = SOIL_load_image_from_memory(&data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_AUTO);
+
+		if (NULL != img && NULL != reference && channels != refChannels)
+			failures += !ReportCheck(check, false, "decoded to " + std::to_string(channels) + " channels, the reference to " + std::to_string(refChannels));
+		else
+			failures += !CheckSameImage(check, img, width, height, reference, refWidth, refHeight, channels);
+
+		SOIL_free_image_data(img);
+		reference_free_image_data(reference);
+	}
+
+	return failures;
+}
+
+// JPEG: the SIMD IDCT, color conversion and upsampling (AVX2 where the CPU has
+// it) against the scalar ones, at full size and at every SOIL_context::jpeg_scale
+static int CheckJpeg()
+{
+	const int NUM_IMAGES = 4;
+	const char *images[NUM_IMAGES] = { "lenna1.jpg", "lenna2.jpg", "lenna3.jpg", "img_mars.jpg" };
+	int failures = 0;
+
+	for (int f = 0; f < NUM_IMAGES; ++f)
+	{
+		std::vector<unsigned char> data;
+
+		if (!ReadFileData(ResourcePath(images[f]), data))
+		{
+			failures += !ReportCheck(std::string("jpeg_decode/") + images[f], false, "could not read it");
+			continue;
+		}
+
+		for (int scale = 0; scale <= 3; ++scale)
+		{
+			const std::string check = std::string("jpeg_decode") + (0 == scale ? "" : "_1_" + std::to_string(1 << scale)) + "/" + images[f];
+			SOIL_context ctx;
+			SOIL_context_init(&ctx);
+			ctx.jpeg_scale = scale;
+
+			int refWidth = 0, refHeight = 0, width = 0, height = 0, channels = 0;
+
+			reference_set_jpeg_scale(scale);
+			unsigned char *reference = reference_load_image_from_memory(&data[0], (int)data.size(), &refWidth, &refHeight, &channels, 4);
+			unsigned char *img = SOIL_load_image_from_memory_ctx(&ctx, &data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_RGBA);
+
+			failures += !CheckSameImage(check, img, width, height, reference, refWidth, refHeight, 4);
+
+			SOIL_free_image_data(img);
+			reference_free_image_data(reference);
+		}
+	}
+
+	reference_set_jpeg_scale(0);
+	return failures;
+}
+
+// the GL_RGB9_E5 texel of one pixel, by the rules of EXT_texture_shared_exponent in doubles
+static unsigned int ReferenceRGB9E5(const float *rgb)
+{
+	const int N = 9, B = 15;
+	const double SHAREDEXP_MAX = 511.0 / 512.0 * 65536.0;
+	double c[3], maxrgb = 0.0;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		// NaN fails every comparison and ends up 0
+		c[i] = rgb[i] > 0.0f ? std::min((double)rgb[i], SHAREDEXP_MAX) : 0.0;
+		maxrgb = std::max(maxrgb, c[i]);
+	}
+
+	int expShared = 0;
+
+	if (maxrgb > 0.0)
+	{
+		int exponent;
+		frexp(maxrgb, &exponent);
+		// floor(log2(maxrgb)) is exponent - 1
+		expShared = std::max(-B - 1, exponent - 1) + 1 + B;
+
+		if (floor(maxrgb / ldexp(1.0, expShared - B - N) + 0.5) == (double)(1 << N))
+			++expShared;
+	}
+
+	unsigned int texel = (unsigned int)expShared << 27;
+
+	for (int i = 0; i < 3; ++i)
+		texel |= (unsigned int)floor(c[i] / ldexp(1.0, expShared - B - N) + 0.5) << (9 * i);
+
+	return texel;
+}
+
+// an IEEE half, rounded to nearest even, with the clamping of RGBF_to_RGB16F
+static unsigned short ReferenceHalf(float value)
+{
+	double v = value > 0.0f ? std::min((double)value, 65504.0) : 0.0;
+
+	if (v < ldexp(1.0, -14))
+		return (unsigned short)nearbyint(v / ldexp(1.0, -24));
+
+	int exponent;
+	frexp(v, &exponent);
+	--exponent;
+
+	double mantissa = nearbyint(v / ldexp(1.0, exponent - 10));
+
+	if (mantissa == 2048.0)
+	{
+		mantissa = 1024.0;
+		++exponent;
+	}
+
+	return (unsigned short)(((exponent + 15) << 10) | ((int)mantissa - 1024));
+}
+
+// HDR: RGBF_to_RGB9E5 and RGBF_to_RGB16F (SIMD, on several threads) against the
+// reference encodings, over edge values and a spread of float bit patterns
+static int CheckHdrPacking(const BenchOptions &options)
+{
+	const int width = 64, height = 256;
+	const float edges[] = { 0.0f, -0.0f, -1.0f, 1.0f, 0.5f, 65408.0f, 65504.0f, 65520.0f, 1e9f, 1e-9f, 6.1e-5f, 5.96e-8f,
+							2.98e-8f, 1.0f / 3.0f, 1.00048828125f, 1.000732421875f, std::numeric_limits<float>::infinity(),
+							-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+							std::numeric_limits<float>::denorm_min() };
+	const size_t numEdges = sizeof(edges) / sizeof(edges[0]);
+	std::vector<float> rgb((size_t)width * height * 3);
+	unsigned int seed = 0x9E3779B9u;
+
+	for (size_t i = 0; i < rgb.size(); ++i)
+	{
+		if (i < numEdges * numEdges * 3)
+		{
+			// every pair of edge values shares a pixel, for the shared exponent
+			const size_t pair = i / 3;
+			rgb[i] = edges[i % 3 == 0 ? pair / numEdges : pair % numEdges];
+			continue;
+		}
+
+		// mostly the range textures use, and now and then any bit pattern at all
+		seed = seed * 1664525u + 1013904223u;
+
+		if (seed & 0x80000000u)
+			rgb[i] = ldexpf((float)(seed & 0xFFFFFF) / 16777216.0f, (int)((seed >> 24) & 0x3F) - 40);
+		else
+			memcpy(&rgb[i], &seed, sizeof(float));
+	}
+
+	std::vector<unsigned int> rgb9e5((size_t)width * height);
+	std::vector<unsigned short> rgb16f((size_t)width * height * 3);
+	int failures = 0;
+	char detail[256];
+
+	soil_set_thread_count(4);
+	bool packed9e5 = 0 != RGBF_to_RGB9E5(&rgb[0], &rgb9e5[0], width, height);
+	bool packed16f = 0 != RGBF_to_RGB16F(&rgb[0], &rgb16f[0], width, height);
+	soil_set_thread_count(options.threads);
+
+	size_t mismatch = rgb9e5.size();
+	for (size_t i = 0; packed9e5 && i < rgb9e5.size() && mismatch == rgb9e5.size(); ++i)
+	{
+		if (rgb9e5[i] != ReferenceRGB9E5(&rgb[i * 3]))
+			mismatch = i;
+	}
+
+	if (mismatch < rgb9e5.size())
+		snprintf(detail, sizeof(detail), "(%g, %g, %g) packs to 0x%08x, the reference is 0x%08x", rgb[mismatch * 3],
+				 rgb[mismatch * 3 + 1], rgb[mismatch * 3 + 2], rgb9e5[mismatch], ReferenceRGB9E5(&rgb[mismatch * 3]));
+
+	failures += !ReportCheck("hdr_pack/rgb9_e5", packed9e5 && mismatch == rgb9e5.size(), packed9e5 ? detail : "it failed");
+
+	mismatch = rgb16f.size();
+	for (size_t i = 0; packed16f && i < rgb16f.size() && mismatch == rgb16f.size(); ++i)
+	{
+		if (rgb16f[i] != ReferenceHalf(rgb[i]))
+			mismatch = i;
+	}
+
+	if (mismatch < rgb16f.size())
+		snprintf(detail, sizeof(detail), "%g packs to 0x%04x, the reference is 0x%04x", rgb[mismatch], rgb16f[mismatch],
+				 ReferenceHalf(rgb[mismatch]));
+
+	failures += !ReportCheck("hdr_pack/rgb16f", packed16f && mismatch == rgb16f.size(), packed16f ? detail : "it failed");
+
+	return failures;
+}
+
+static int CheckOutputs(const BenchOptions &options)
+{
+	int failures = CheckDds(options);
+	failures += CheckPng();
+	failures += CheckJpeg();
+	failures += CheckHdrPacking(options);
+
+	printf("output checks: %d failure(s)\n", failures);
+	return failures;
+}
+
+static std::string JsonEscape(const std::string &s)
+{
+	std::string out;
+
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		if (s[i] == '"' || s[i] == '\\')
+			out += '\\';
+		out += s[i];
+	}
+
+	return out;
+}
+
+// one result per line, so the baseline reader doesn't need a JSON parser
+static bool WriteJson(const BenchOptions &options, const std::vector<BenchResult> &results)
+{
+	FILE *fp = fopen(options.jsonFile.c_str(), "w");
+
+	if (NULL == fp)
+		return false;
+
+	fprintf(fp, "{\n\t\"benchmark\": \"soil2\",\n\t\"warmup\": %d,\n\t\"repetitions\": %d,\n\t\"threads\": %d,\n\t\"results\": [\n",
+			options.warmup, options.repetitions, soil_get_thread_count());
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult &r = results[i];
+		fprintf(fp, "\t\t{ \"name\": \"%s\", \"op\": \"%s\", \"file\": \"%s\", \"width\": %d, \"height\": %d, \"channels\": %d, "
+				"\"median_ms\": %.4f, \"p95_ms\": %.4f, \"min_ms\": %.4f, \"median_mb_per_s\": %.2f }%s\n",
+				JsonEscape(r.name).c_str(), r.op.c_str(), JsonEscape(r.file).c_str(), r.width, r.height, r.channels,
+				r.medianMs, r.p95Ms, r.minMs, r.bytes / (1024.0 * 1024.0) / (r.medianMs * 0.001),
+				i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(fp, "\t]\n}\n");
+	fclose(fp);
+
+	return true;
+}
+
+// name -> median_ms, from a file written by WriteJson
+static bool ReadBaseline(const std::string &file, std::map<std::string, double> &baseline)
+{
+	FILE *fp = fopen(file.c_str(), "r");
+	char line[4096];
+
+	if (NULL == fp)
+		return false;
+
+	while (NULL != fgets(line, sizeof(line), fp))
+	{
+		const char *name = strstr(line, "\"name\": \"");
+		const char *median = strstr(line, "\"median_ms\": ");
+
+		if (NULL == name || NULL == median)
+			continue;
+
+		name += strlen("\"name\": \"");
+		const char *end = strstr(name, "\"");
+
+		if (NULL != end)
+			baseline[std::string(name, end)] = atof(median + strlen("\"median_ms\": "));
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// a result regresses when its median is over the baseline by more than the
+// tolerance, and by more than a few microseconds so timer noise on tiny
+// images doesn't fail the run; over a zero baseline there is no percentage,
+// only the few microseconds count. A baseline entry this run has no result
+// for (the case failed, or its file wasn't given) fails as well
+static int CompareWithBaseline(const BenchOptions &options, const std::vector<BenchResult> &results)
+{
+	const double MIN_REGRESSION_MS = 0.05;
+	std::map<std::string, double> baseline;
+	std::map<std::string, double> medians;
+	int regressions = 0;
+
+	if (!ReadBaseline(options.baselineFile, baseline))
+	{
+		fprintf(stderr, "error!, could not read the baseline %s\n", options.baselineFile.c_str());
+		return -1;
+	}
+
+	for (size_t i = 0; i < results.size(); ++i)
+		medians[results[i].name] = results[i].medianMs;
+
+	for (std::map<std::string, double>::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+	{
+		std::map<std::string, double>::const_iterator found = medians.find(it->first);
+
+		if (found == medians.end())
+		{
+			fprintf(stderr, "MISSING %s: in the baseline, not measured by this run\n", it->first.c_str());
+			++regressions;
+			continue;
+		}
+
+		const double medianMs = found->second;
+
+		if (medianMs - it->second <= MIN_REGRESSION_MS)
+			continue;
+
+		if (it->second <= 0.0)
+		{
+			fprintf(stderr, "REGRESSION %s: %.3f ms vs %.3f ms baseline\n", it->first.c_str(), medianMs, it->second);
+			++regressions;
+			continue;
+		}
+
+		double change = (medianMs - it->second) / it->second * 100.0;
+
+		if (change > options.tolerance)
+		{
+			fprintf(stderr, "REGRESSION %s: %.3f ms vs %.3f ms baseline (%+.1f%%)\n",
+					it->first.c_str(), medianMs, it->second, change);
+			++regressions;
+		}
+	}
+
+	printf("baseline %s: %d regression(s) over %.1f%% or missing\n", options.baselineFile.c_str(), regressions, options.tolerance);
+	return regressions;
+}
+
+static bool ParseArgs(int argc, char **argv, BenchOptions &options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--warmup" && hasValue)
+			options.warmup = atoi(argv[++i]);
+		else if (arg == "--reps" && hasValue)
+			options.repetitions = atoi(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			options.threads = atoi(argv[++i]);
+		else if (arg == "--json" && hasValue)
+			options.jsonFile = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			options.baselineFile = argv[++i];
+		else if (arg == "--tolerance" && hasValue)
+			options.tolerance = atof(argv[++i]);
+		else if (arg.compare(0, 2, "--") == 0)
+			return false;
+		else
+			options.files.push_back(arg);
+	}
+
+	return options.warmup >= 0 && options.repetitions > 0 && options.threads >= 0;
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options;
+
+	if (!ParseArgs(argc, argv, options))
+	{
+		fprintf(stderr, "usage: %s [--warmup N] [--reps N] [--threads N] [--json out.json] "
+				"[--baseline base.json] [--tolerance percent] [files...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (options.files.empty())
+		options.files = ListFiles(ResourcePath(""));
+
+	soil_set_thread_count(options.threads);
+	printf("soil2_benchmark: %d file(s), %d warmup, %d repetitions, %d thread(s)\n",
+		   (int)options.files.size(), options.warmup, options.repetitions, soil_get_thread_count());
+
+	const int checkFailures = CheckOutputs(options);
+	std::vector<BenchResult> results;
+
+	for (size_t i = 0; i < options.files.size(); ++i)
+		BenchFile(options, options.files[i], results);
+
+	if (results.empty())
+	{
+		fprintf(stderr, "error!, nothing was benchmarked\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!options.jsonFile.empty() && !WriteJson(options, results))
+	{
+		fprintf(stderr, "error!, could not write %s\n", options.jsonFile.c_str());
+		return EXIT_FAILURE;
+	}
+
+	if (!options.baselineFile.empty() && CompareWithBaseline(options, results) != 0)
+		return EXIT_FAILURE;
+
+	return checkFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,34 @@
+#include "reference_decoder.h"
+
+// every stbi function is static here, so this build doesn't clash with the one in
+// SOIL2, and most of them go unused
+#if defined( __GNUC__ ) || defined( __clang__ )
+	#pragma GCC diagnostic ignored "-Wunused-function"
+	#pragma GCC diagnostic ignored "-Wsign-compare"
+#endif
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_SIMD
+#define STBI_NO_WIDE_REFILL
+// the other augmentations have no static build, and nothing checks them
+#define STBI_NO_PVR
+#define STBI_NO_PKM
+#define STBI_NO_EXT
+#include "../SOIL2/stb_image.h"
+
+unsigned char *reference_load_image_from_memory(const unsigned char *buffer, int length, int *width, int *height,
+												int *channels, int force_channels)
+{
+	return stbi_load_from_memory(buffer, length, width, height, channels, force_channels);
+}
+
+void reference_free_image_data(unsigned char *img)
+{
+	stbi_image_free(img);
+}
+
+void reference_set_jpeg_scale(int scale)
+{
+	stbi_set_jpeg_scale_on_load(scale);
+}
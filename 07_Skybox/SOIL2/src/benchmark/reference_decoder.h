@@ -0,0 +1,17 @@
+#ifndef SOIL2_BENCHMARK_REFERENCE_DECODER_H
+#define SOIL2_BENCHMARK_REFERENCE_DECODER_H
+
+// The stb_image decoders without their SIMD kernels or the wide-refill inflater:
+// a second, scalar build of SOIL2's stb_image.h (reference_decoder.cpp), which
+// the benchmark checks the output of the fast paths against. Its DDS blocks
+// are decoded on the calling thread.
+
+unsigned char *reference_load_image_from_memory(const unsigned char *buffer, int length, int *width, int *height,
+												int *channels, int force_channels);
+
+void reference_free_image_data(unsigned char *img);
+
+// JPEGs decode at 1/(1 << scale) of their size from here on, like SOIL_context::jpeg_scale
+void reference_set_jpeg_scale(int scale);
+
+#endif
@@ -4,8 +4,13 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <atomic>
 #include "../common/common.hpp"
 #include "../SOIL2/SOIL2.h"
+#include "../SOIL2/thread_helper.h"
 
 #define NO_SDL_GLEXT
 #if ( ( defined( _MSCVER ) || defined( _MSC_VER ) ) || defined( __APPLE_CC__ ) || defined ( __APPLE__ ) ) && !defined( SOIL2_NO_FRAMEWORKS )
@@ -182,6 +187,515 @@ void CalcaAndPrintTestResult(const TestParams &params, const TestOutputs &result
 			(float)(durationInSec), (float)memInMB, (float)memSpeed);
 }
 
+// Times runs of run, which returns what release is given once the time is taken
+// (an image, a texture, whether a file was saved) and something false if it failed.
+// The result is the mean in ms, negative if a run failed
+template <typename Run, typename Release>
+double TimeRuns(int runs, Run run, Release release)
+{
+	double durationInMsec = 0.0;
+
+	for (int i = 0; i < runs; ++i)
+	{
+		Uint64 t_start = SDL_GetPerformanceCounter();
+		auto result = run();
+		Uint64 t_end = SDL_GetPerformanceCounter();
+
+		if (!result)
+			return -1.0;
+
+		durationInMsec += get_total_ms(t_start, t_end);
+		release(result);
+	}
+
+	return runs > 0 ? durationInMsec / runs : 0.0;
+}
+
+void FreeImage(unsigned char *img)
+{
+	SOIL_free_image_data(img);
+}
+
+void KeepResult(int)
+{
+}
+
+double SpeedInMBs(double bytes, double durationInMsec)
+{
+	return durationInMsec > 0.0 ? bytes / (1024.0*1024) / (durationInMsec*0.001) : 0.0;
+}
+
+// CPU only: the ETC1 software decoder used when the driver can't take ETC1 directly
+void DecodeTestPKM(const std::string &file, int numberOfLoads, int threadCount)
+{
+	int width = 0, height = 0, channels = 0;
+
+	soil_set_thread_count(threadCount);
+	const int threadsUsed = soil_get_thread_count();
+
+	double durationInMsec = TimeRuns(numberOfLoads, [&]() {
+		return SOIL_load_image(file.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+	}, FreeImage);
+
+	soil_set_thread_count(0);
+
+	if (durationInMsec < 0.0)
+	{
+		std::cout << "error!, could not decode " << file << std::endl;
+		return;
+	}
+
+	double memInMB = (double)width * height * 4 * numberOfLoads/(1024.0*1024);
+	printf("ETC1 decode (%d threads): %2.2fsec, memory: %3.2f MB, speed %3.3f MB/s\n", threadsUsed,
+			(float)(durationInMsec*numberOfLoads*0.001), (float)memInMB, (float)SpeedInMBs((double)width * height * 4, durationInMsec));
+}
+
+struct DecodedImage
+{
+	DecodedImage() : width(0), height(0), channels(0), result(SOIL_RESULT_OK) { }
+
+	int width, height, channels, result;
+	std::vector<unsigned char> pixels;
+};
+
+DecodedImage DecodeWithContext(const std::string &file, int flip)
+{
+	DecodedImage image;
+	SOIL_context ctx;
+	SOIL_context_init(&ctx);
+	ctx.flip_vertically = flip;
+
+	unsigned char *img = SOIL_load_image_ctx(&ctx, file.c_str(), &image.width, &image.height, &image.channels, SOIL_LOAD_RGBA);
+	image.result = ctx.result;
+
+	if (NULL != img)
+	{
+		image.pixels.assign(img, img + (size_t)image.width * image.height * 4);
+		SOIL_free_image_data(img);
+	}
+
+	return image;
+}
+
+// CPU only: decodes every test image on many threads at once, each call with its own
+// options, and checks the output against a single threaded decode. decoderThreads is
+// what the decoders may spawn on top of that, 1 for none and 0 for the CPU count
+bool ConcurrentDecodeTest(int numberOfThreads, int rounds, int decoderThreads)
+{
+	const int NUM_IMAGES = 17;
+	const char *images[NUM_IMAGES] = {
+		"field_128_cube.dds", "img_mars.jpg", "img_test.bmp", "img_test.dds", "img_test.png",
+		"img_test.tga", "img_test_indexed.tga", "lenna1.jpg", "lenna2.jpg", "lenna3.jpg",
+		"test.pkm", "test_RGTC.dds", "test_image_pvrtc2bpp.pvr", "test_image_pvrtc4bpp.pvr",
+		"test_image_rgb888.pvr", "test_image_rgba8888.pvr", "test_rect.png" };
+
+	// the reference decode is single threaded either way
+	soil_set_thread_count(1);
+
+	std::vector<std::string> files;
+	std::vector<DecodedImage> expected[2];
+	for (int i = 0; i < NUM_IMAGES; ++i)
+	{
+		files.push_back(ResourcePath(images[i]));
+		expected[0].push_back(DecodeWithContext(files[i], 0));
+		expected[1].push_back(DecodeWithContext(files[i], 1));
+
+		if (expected[0][i].pixels.empty())
+			printf("concurrent decode: %s can't be decoded on the CPU, checking the error only\n", images[i]);
+	}
+
+	std::atomic<int> mismatches(0);
+	std::atomic<long> decodedBytes(0);
+	std::vector<std::thread> threads;
+
+	soil_set_thread_count(decoderThreads);
+	const int threadsUsed = soil_get_thread_count();
+
+	Uint64 t_start = SDL_GetPerformanceCounter();
+
+	for (int t = 0; t < numberOfThreads; ++t)
+	{
+		threads.push_back(std::thread([&, t]()
+		{
+			for (int round = 0; round < rounds; ++round)
+			{
+				for (int i = 0; i < NUM_IMAGES; ++i)
+				{
+					// every thread walks the list from a different place, flipping every other image
+					const int index = (i + t) % NUM_IMAGES;
+					const int flip = (index + t + round) & 1;
+					DecodedImage image = DecodeWithContext(files[index], flip);
+					const DecodedImage &reference = expected[flip][index];
+
+					if (image.result != reference.result || image.width != reference.width ||
+						image.height != reference.height || image.pixels != reference.pixels)
+					{
+						printf("concurrent decode: mismatch on %s (thread %d, flip %d)\n", images[index], t, flip);
+						++mismatches;
+					}
+
+					decodedBytes += (long)image.pixels.size();
+				}
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	Uint64 t_end = SDL_GetPerformanceCounter();
+
+	soil_set_thread_count(0);
+
+	double durationInSec = get_total_ms(t_start, t_end)*0.001;
+	double memInMB = decodedBytes/(1024.0*1024);
+	printf("Concurrent decode (%d threads, %d decoder threads each): %2.2fsec, memory: %3.2f MB, speed %3.3f MB/s, %d mismatches\n",
+			numberOfThreads, threadsUsed, (float)durationInSec, (float)memInMB, (float)(memInMB/durationInSec), (int)mismatches);
+
+	return 0 == mismatches;
+}
+
+// loads the batch with the malloc backed allocator, then with the arena, and
+// reports how often the arena had to go to the heap
+void ArenaLoadTest(const TestParams &params)
+{
+	TestOutputs resultHeap = LoadTest(params);
+
+	SOIL_set_allocator(SOIL_get_arena_allocator());
+	TestOutputs resultArena = LoadTest(params);
+	SOIL_set_allocator(NULL);
+
+	size_t arenaSize = 0;
+	unsigned int heapAllocations = 0;
+	SOIL_get_arena_stats(&arenaSize, &heapAllocations);
+	SOIL_arena_release();
+
+	printf("%s: malloc %2.2fsec, arena %2.2fsec, arena: %3.2f MB from %u heap allocations for %d loads\n",
+			params.testName.c_str(), (float)(resultHeap.durationInMsec*0.001), (float)(resultArena.durationInMsec*0.001),
+			(float)(arenaSize/(1024.0*1024)), heapAllocations, params.numberOfLoads);
+}
+
+// an RGB source image stretched to a capture sized frame
+std::vector<unsigned char> MakeCaptureFrame(const unsigned char *src, int srcWidth, int srcHeight, int width, int height)
+{
+	std::vector<unsigned char> frame((size_t)width * height * 3);
+
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+			memcpy(&frame[((size_t)y * width + x) * 3], &src[((size_t)(y * srcHeight / height) * srcWidth + x * srcWidth / width) * 3], 3);
+
+	return frame;
+}
+
+long GetFileSize(const char *file)
+{
+	FILE *f = fopen(file, "rb");
+	long fileSize = 0;
+
+	if (NULL != f)
+	{
+		fseek(f, 0, SEEK_END);
+		fileSize = ftell(f);
+		fclose(f);
+	}
+
+	return fileSize;
+}
+
+// PNG saving of capture sized frames (a source image stretched to 1080p and 4K)
+// at a few compression levels, on one thread and on every core
+void PngWriteTest(const std::string &file)
+{
+	int srcWidth = 0, srcHeight = 0, srcChannels = 0;
+	unsigned char *src = SOIL_load_image(file.c_str(), &srcWidth, &srcHeight, &srcChannels, SOIL_LOAD_RGB);
+
+	if (NULL == src)
+	{
+		std::cout << "error!, could not decode " << file << std::endl;
+		return;
+	}
+
+	const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	const int levels[3] = { 0, 2, 8 };
+	const char *outFile = "soil2_png_write_test.png";
+
+	for (int s = 0; s < 2; ++s)
+	{
+		const int width = sizes[s][0], height = sizes[s][1];
+		std::vector<unsigned char> frame = MakeCaptureFrame(src, srcWidth, srcHeight, width, height);
+
+		for (int l = 0; l < 3; ++l)
+		{
+			for (int threads = 1; threads >= 0; --threads)
+			{
+				soil_set_thread_count(threads);
+
+				double durationInMsec = TimeRuns(1, [&]() {
+					return SOIL_save_PNG_image(outFile, width, height, 3, &frame[0], levels[l]);
+				}, KeepResult);
+
+				if (durationInMsec < 0.0)
+				{
+					printf("PNG write %dx%d level %d (%d threads): failed!\n", width, height, levels[l], soil_get_thread_count());
+					continue;
+				}
+
+				printf("PNG write %dx%d level %d (%d threads): %3.1f ms, %3.2f MB\n", width, height, levels[l],
+						soil_get_thread_count(), (float)durationInMsec, (float)(GetFileSize(outFile)/(1024.0*1024)));
+			}
+		}
+	}
+
+	remove(outFile);
+	soil_set_thread_count(0);
+	SOIL_free_image_data(src);
+}
+
+// JPEG saving of 1080p and 4K frames, on one thread and on every core
+void JpegWriteTest(const std::string &file, int numberOfSaves)
+{
+	int srcWidth = 0, srcHeight = 0, srcChannels = 0;
+	unsigned char *src = SOIL_load_image(file.c_str(), &srcWidth, &srcHeight, &srcChannels, SOIL_LOAD_RGB);
+
+	if (NULL == src)
+	{
+		std::cout << "error!, could not decode " << file << std::endl;
+		return;
+	}
+
+	const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	const char *outFile = "soil2_jpeg_write_test.jpg";
+
+	for (int s = 0; s < 2; ++s)
+	{
+		const int width = sizes[s][0], height = sizes[s][1];
+		std::vector<unsigned char> frame = MakeCaptureFrame(src, srcWidth, srcHeight, width, height);
+
+		for (int threads = 1; threads >= 0; --threads)
+		{
+			soil_set_thread_count(threads);
+
+			double durationInMsec = TimeRuns(numberOfSaves, [&]() {
+				return SOIL_save_image_quality(outFile, SOIL_SAVE_TYPE_JPG, width, height, 3, &frame[0], 90);
+			}, KeepResult);
+
+			if (durationInMsec < 0.0)
+			{
+				printf("JPEG write %dx%d quality 90 (%d threads): failed!\n", width, height, soil_get_thread_count());
+				continue;
+			}
+
+			printf("JPEG write %dx%d quality 90 (%d threads): %3.1f ms, speed %3.3f MB/s, %3.2f MB\n", width, height,
+					soil_get_thread_count(), (float)durationInMsec, (float)SpeedInMBs((double)frame.size(), durationInMsec),
+					(float)(GetFileSize(outFile)/(1024.0*1024)));
+		}
+	}
+
+	remove(outFile);
+	soil_set_thread_count(0);
+	SOIL_free_image_data(src);
+}
+
+bool ReadFileData(const std::string &file, std::vector<unsigned char> &data)
+{
+	data.resize((size_t)GetFileSize(file.c_str()));
+	FILE *fp = fopen(file.c_str(), "rb");
+
+	if (NULL == fp || data.empty() || fread(&data[0], 1, data.size(), fp) != data.size())
+	{
+		std::cout << "error!, could not read " << file << std::endl;
+		if (NULL != fp) fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// CPU only: JPEG decoding from memory, so the file system stays out of the timings,
+// at full size and at the reduced sizes of SOIL_context::jpeg_scale
+void JpegDecodeTest(int numberOfLoads)
+{
+	const int NUM_IMAGES = 4;
+	const char *images[NUM_IMAGES] = { "lenna1.jpg", "lenna2.jpg", "lenna3.jpg", "img_mars.jpg" };
+
+	for (int f = 0; f < NUM_IMAGES; ++f)
+	{
+		std::string file = ResourcePath(images[f]);
+		std::vector<unsigned char> data;
+
+		if (!ReadFileData(file, data))
+			continue;
+
+		double fullSizeMsec = 0.0;
+
+		for (int scale = 0; scale <= 3; ++scale)
+		{
+			SOIL_context ctx;
+			SOIL_context_init(&ctx);
+			ctx.jpeg_scale = scale;
+
+			int width = 0, height = 0, channels = 0;
+
+			double durationInMsec = TimeRuns(numberOfLoads, [&]() {
+				return SOIL_load_image_from_memory_ctx(&ctx, &data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_RGBA);
+			}, FreeImage);
+
+			if (durationInMsec < 0.0)
+			{
+				std::cout << "error!, could not decode " << file << ": " << ctx.result_string << std::endl;
+				break;
+			}
+
+			if (0 == scale)
+			{
+				fullSizeMsec = durationInMsec;
+				printf("JPEG decode %s %dx%d: %3.2f ms, speed %3.3f MB/s\n", images[f], width, height,
+						(float)durationInMsec, (float)SpeedInMBs((double)width * height * 4, durationInMsec));
+			} else
+			{
+				printf("JPEG decode %s 1/%d %dx%d: %3.2f ms, %3.1fx faster than full size\n", images[f], 1 << scale, width, height,
+						(float)durationInMsec, (float)(durationInMsec > 0.0 ? fullSizeMsec/durationInMsec : 0.0));
+			}
+		}
+	}
+}
+
+// CPU only: PNG decoding (inflate and row unfiltering) from memory. PNG files are
+// decoded as they are, anything else is saved as a PNG first
+void PngDecodeTest(const std::vector<std::string> &files, int numberOfLoads)
+{
+	const char *tmpFile = "soil2_png_decode_test.png";
+
+	for (size_t f = 0; f < files.size(); ++f)
+	{
+		std::string file = files[f];
+		std::vector<unsigned char> data;
+
+		if (file.size() < 4 || 0 != strcmp(file.c_str() + file.size() - 4, ".png"))
+		{
+			int width = 0, height = 0, channels = 0;
+			unsigned char *src = SOIL_load_image(file.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+
+			if (NULL == src || !SOIL_save_image(tmpFile, SOIL_SAVE_TYPE_PNG, width, height, channels, src))
+			{
+				std::cout << "error!, could not convert " << file << " to PNG" << std::endl;
+				SOIL_free_image_data(src);
+				continue;
+			}
+
+			SOIL_free_image_data(src);
+			file = tmpFile;
+		}
+
+		if (!ReadFileData(file, data))
+			continue;
+
+		int width = 0, height = 0, channels = 0;
+
+		double durationInMsec = TimeRuns(numberOfLoads, [&]() {
+			return SOIL_load_image_from_memory(&data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_AUTO);
+		}, FreeImage);
+
+		if (durationInMsec < 0.0)
+		{
+			std::cout << "error!, could not decode " << files[f] << ": " << SOIL_last_result() << std::endl;
+			continue;
+		}
+
+		printf("PNG decode %s %dx%d: %3.2f ms, speed %3.3f MB/s\n", files[f].c_str(), width, height,
+				(float)durationInMsec, (float)SpeedInMBs((double)width * height * channels, durationInMsec));
+	}
+
+	remove(tmpFile);
+}
+
+// CPU only: the software BC1/BC3/BC5 decode used when a DDS can't be uploaded
+// compressed, on one thread and on every core
+void DdsDecodeTest(int numberOfLoads)
+{
+	const int NUM_IMAGES = 2;
+	const char *images[NUM_IMAGES] = { "img_test.dds", "test_RGTC.dds" };
+
+	for (int f = 0; f < NUM_IMAGES; ++f)
+	{
+		std::vector<unsigned char> data;
+
+		if (!ReadFileData(ResourcePath(images[f]), data))
+			continue;
+
+		for (int threads = 1; threads >= 0; --threads)
+		{
+			int width = 0, height = 0, channels = 0;
+
+			soil_set_thread_count(threads);
+
+			double durationInMsec = TimeRuns(numberOfLoads, [&]() {
+				return SOIL_load_image_from_memory(&data[0], (int)data.size(), &width, &height, &channels, SOIL_LOAD_RGBA);
+			}, FreeImage);
+
+			if (durationInMsec < 0.0)
+			{
+				std::cout << "error!, could not decode " << images[f] << ": " << SOIL_last_result() << std::endl;
+				break;
+			}
+
+			printf("DDS decode %s %dx%d (%d threads): %3.3f ms, speed %3.3f MB/s\n", images[f], width, height,
+					soil_get_thread_count(), (float)durationInMsec, (float)SpeedInMBs((double)width * height * 4, durationInMsec));
+		}
+	}
+
+	soil_set_thread_count(0);
+}
+
+void HdrTextureTest(int numberOfLoads)
+{
+	const char *tmpFile = "soil2_hdr_test.hdr";
+	const int width = 1024, height = 512;
+	const int NUM_FORMATS = 3;
+	const int formats[NUM_FORMATS] = { SOIL_HDR_RGBdivA2, SOIL_HDR_RGB9_E5, SOIL_HDR_RGB16F };
+	const char *names[NUM_FORMATS] = { "RGBdivA2", "RGB9_E5", "RGB16F" };
+	std::vector<float> data((size_t)width * height * 3);
+
+	// a smooth gradient over a wide range, like a sky probe
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			float *px = &data[((size_t)y * width + x) * 3];
+			float intensity = (float)pow(2.0, 12.0 * x / width - 6.0);
+			px[0] = intensity;
+			px[1] = intensity * (float)y / height;
+			px[2] = intensity * 0.5f;
+		}
+	}
+
+	if (!SOIL_save_HDR_image(tmpFile, SOIL_SAVE_TYPE_HDR, width, height, 3, &data[0]))
+	{
+		std::cout << "error!, could not save " << tmpFile << ": " << SOIL_last_result() << std::endl;
+		return;
+	}
+
+	for (int f = 0; f < NUM_FORMATS; ++f)
+	{
+		double durationInMsec = TimeRuns(numberOfLoads, [&]() {
+			GLuint tex = SOIL_load_OGL_HDR_texture(tmpFile, formats[f], 0, 0, 0);
+			glFinish();
+			return tex;
+		}, [](GLuint tex) { glDeleteTextures(1, &tex); });
+
+		if (durationInMsec < 0.0)
+		{
+			std::cout << "error!, could not load " << tmpFile << " as " << names[f] << ": " << SOIL_last_result() << std::endl;
+			continue;
+		}
+
+		printf("HDR texture %dx%d as %s: %3.3f ms\n", width, height, names[f], (float)durationInMsec);
+	}
+
+	remove(tmpFile);
+}
+
 void DoTest(std::vector<std::string> args)
 {
 	const int NUM_FILES = 3;
@@ -236,4 +750,51 @@ void DoTest(std::vector<std::string> args)
 
 		CalcaAndPrintTestResult(paramsMip, resultMip);
 	}
+
+	// ETC1 software decode, single threaded and on every core
+	{
+		std::string pkmFile = ResourcePath("test.pkm");
+
+		DecodeTestPKM(pkmFile, NUM_LOADS, 1);
+		DecodeTestPKM(pkmFile, NUM_LOADS, 0);
+	}
+
+	// allocator hooks
+	{
+		TestParams paramsArena;
+		paramsArena.files = files;
+		paramsArena.numberOfLoads = NUM_LOADS;
+		paramsArena.soilFlags = SOIL_FLAG_MIPMAPS;
+		paramsArena.testName = "FLAG_MIPMAPS arena";
+
+		ArenaLoadTest(paramsArena);
+	}
+
+	// JPEG decoder kernels
+	JpegDecodeTest(NUM_LOADS);
+
+	// inflate and PNG unfiltering
+	{
+		std::vector<std::string> pngFiles = files;
+		pngFiles.push_back(ResourcePath("test_rect.png"));
+
+		PngDecodeTest(pngFiles, NUM_LOADS);
+	}
+
+	// software DXT/RGTC decoding
+	DdsDecodeTest(NUM_LOADS);
+
+	// real HDR packed at load time vs the fake HDR encodings
+	HdrTextureTest(10);
+
+	// parallel PNG and JPEG writers
+	PngWriteTest(files[0]);
+	JpegWriteTest(files[0], 5);
+
+	// reentrant loading, fails the run if any thread saw a different image; once with
+	// the decoders on the calling thread, once with their own threads as well
+	if (!ConcurrentDecodeTest(16, 4, 1) || !ConcurrentDecodeTest(16, 4, 0))
+	{
+		exit(EXIT_FAILURE);
+	}
 }
@@ -8,6 +8,9 @@
 
 #include <GL/glew.h>
 
+#include "CpuProfiler.h"
+#include "GLStats.h"
+
 class Shader
 {
 public:
@@ -15,6 +18,8 @@ public:
     // Constructor generates the shader on the fly
     Shader( const GLchar *vertexPath, const GLchar *fragmentPath )
     {
+        CPU_PROFILE_SCOPE( "Shader compile" );
+        
         // 1. Retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -4,8 +4,16 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+#include <iostream>
 #include <vector>
 
+#include <SOIL2/SOIL2.h>
+#include <SOIL2/stb_image.h>
+
+#include "CpuProfiler.h"
+#include "GLStats.h"
+#include "GpuMemory.h"
+
 class TextureLoading
 {
 public:
@@ -15,14 +23,43 @@ public:
         GLuint textureID;
         glGenTextures( 1, &textureID );
         
-        int imageWidth, imageHeight;
+        int imageWidth, imageHeight, imageChannels;
+        
+        // Only the header is read here, to size the staging buffer
+        if ( !SOIL_image_info( path, &imageWidth, &imageHeight, &imageChannels ) )
+        {
+            return textureID;
+        }
+        
+        // Rows padded to the default GL_UNPACK_ALIGNMENT of 4
+        GLint rowStride = ( imageWidth * 3 + 3 ) & ~3;
+        GLint stagingSize = rowStride * imageHeight;
+        
+        // Decode straight into a pixel unpack buffer, no intermediate copy on our side
+        GLuint pbo;
+        glGenBuffers( 1, &pbo );
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+        glBufferData( GL_PIXEL_UNPACK_BUFFER, stagingSize, NULL, GL_STREAM_DRAW );
+        unsigned char *staging = ( unsigned char * )glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, stagingSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
         
-        unsigned char *image = SOIL_load_image( path, &imageWidth, &imageHeight, 0, SOIL_LOAD_RGB );
+        CpuProfileScope decodeScope( "Decode" );
+        int loaded = ( NULL != staging ) && SOIL_load_image_into( path, &imageWidth, &imageHeight, &imageChannels, SOIL_LOAD_RGB, staging, rowStride, stagingSize );
+        decodeScope.End( );
+        // GL_FALSE means the store got corrupted while mapped (e.g. a mode switch), what was decoded is lost
+        if ( NULL != staging && GL_FALSE == glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER ) )
+        {
+            loaded = 0;
+        }
         
         // Assign texture to ID
         glBindTexture( GL_TEXTURE_2D, textureID );
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image );
-        glGenerateMipmap( GL_TEXTURE_2D );
+        if ( loaded )
+        {
+            glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, ( GLvoid * )0 );
+            glGenerateMipmap( GL_TEXTURE_2D );
+        }
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+        glDeleteBuffers( 1, &pbo );
         
         // Parameters
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
@@ -31,7 +68,10 @@ public:
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
         glBindTexture( GL_TEXTURE_2D,  0);
         
-        SOIL_free_image_data( image );
+        if ( loaded )
+        {
+            GpuMemory::RegisterTexture( GL_TEXTURE_2D, textureID, path );
+        }
         
         return textureID;
     }
@@ -48,7 +88,9 @@ public:
         
         for ( GLuint i = 0; i < faces.size( ); i++ )
         {
+            CpuProfileScope decodeScope( "Decode" );
             image = SOIL_load_image( faces[i], &imageWidth, &imageHeight, 0, SOIL_LOAD_RGB );
+            decodeScope.End( );
             glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image );
             SOIL_free_image_data( image );
         }
@@ -59,6 +101,58 @@ public:
         glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
         glBindTexture( GL_TEXTURE_CUBE_MAP, 0);
         
+        // Owned by the first face, the others are next to it
+        GpuMemory::RegisterTexture( GL_TEXTURE_CUBE_MAP, textureID, faces[0] );
+        
+        return textureID;
+    }
+    
+    // Uploads a BC6H (or DXT) DDS cubemap as is. When the file isn't there it is made from the faces first
+    // (order as in LoadCubemap), returns 0 if it can't be made or is unsupported
+    static GLuint LoadCompressedCubemap( const GLchar *path, const vector<const GLchar *> &faces )
+    {
+        GLuint textureID = UploadCompressedCubemap( path );
+        
+        if ( 0 == textureID && 6 == faces.size( ) )
+        {
+            CpuProfileScope encodeScope( "Encode" );
+            // The faces are LDR, keep their values as they are instead of linearizing them so the sky looks the same
+            stbi_ldr_to_hdr_gamma( 1.0f );
+            int saved = SOIL_save_HDR_cubemap_as_DDS( path, faces[0], faces[1], faces[2], faces[3], faces[4], faces[5] );
+            stbi_ldr_to_hdr_gamma( 2.2f );
+            encodeScope.End( );
+            
+            if ( saved )
+            {
+                textureID = UploadCompressedCubemap( path );
+            }
+            else
+            {
+                std::cout << "Could not make " << path << ": " << SOIL_last_result( ) << std::endl;
+            }
+        }
+        
+        return textureID;
+    }
+    
+private:
+    static GLuint UploadCompressedCubemap( const GLchar *path )
+    {
+        CpuProfileScope decodeScope( "Decode" );
+        GLuint textureID = SOIL_direct_load_DDS( path, 0, 0, 1 );
+        decodeScope.End( );
+        
+        if ( 0 != textureID )
+        {
+            glBindTexture( GL_TEXTURE_CUBE_MAP, textureID );
+            glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+            glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+            glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+            glBindTexture( GL_TEXTURE_CUBE_MAP, 0);
+            
+            GpuMemory::RegisterTexture( GL_TEXTURE_CUBE_MAP, textureID, path );
+        }
+        
         return textureID;
     }
 };
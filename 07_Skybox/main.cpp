@@ -1,5 +1,14 @@
 // Std. Includes
+#include <algorithm>
+#include <cctype>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Counts heap allocations, the global operator new/delete are compiled here in builds with TRACK_ALLOCATIONS
+#define ALLOCATION_TRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
 
 // GLEW
 #define GLEW_STATIC
@@ -11,7 +20,16 @@
 // GL includes
 #include "Shader.h"
 #include "Camera.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "CpuProfiler.h"
+#include "GLCapture.h"
+#include "GLStats.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "Headless.h"
 #include "Model.h"
+#include "Overlay.h"
 
 // GLM Mathemtics
 #include <glm/glm.hpp>
@@ -31,6 +49,7 @@ int SCREEN_WIDTH, SCREEN_HEIGHT;
 void KeyCallback( GLFWwindow *window, int key, int scancode, int action, int mode );
 void MouseCallback( GLFWwindow *window, double xPos, double yPos );
 void DoMovement( );
+double GetTime( );
 
 // Camera
 Camera camera( glm::vec3( 0.0f, 0.0f, 3.0f ) );
@@ -41,48 +60,257 @@ bool firstMouse = true;
 GLfloat deltaTime = 0.0f;
 GLfloat lastFrame = 0.0f;
 
-int main( )
+// Camera path, recorded with --record <file> and played back with --replay <file>
+CameraPath cameraPath;
+bool replaying = false;
+GLfloat replayStep = 1.0f / 60.0f;
+GLuint replayFrames = 0;
+
+// Rendering without a window, with --headless
+bool headless = false;
+Headless headlessContext;
+GLuint frameLimit = 0;
+
+// Frame time measurements, with --benchmark
+Benchmark benchmark;
+
+// GPU time of the passes, shown with --overlay or toggled with O
+GpuProfiler gpuProfiler;
+Overlay overlay;
+bool showOverlay = false;
+
+// Frame recording, toggled with R
+bool recording = false;
+SOIL_capture *frameCapture = NULL;
+GLuint capturedFrames = 0;
+
+int main( int argc, char *argv[] )
 {
-    // Init GLFW
-    glfwInit( );
-    // Set all the required options for GLFW
-    glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
-    glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
-    glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
-    glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE );
-    glfwWindowHint( GLFW_RESIZABLE, GL_FALSE );
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    const char *jsonPath = NULL;
+    const char *baselinePath = NULL;
+    const char *tracePath = NULL;
+    const char *capturePath = NULL;
+    GLuint captureFrame = 0;
+    // With --gpu-memory, how many of the largest allocations the report at the end lists
+    bool gpuMemoryReport = false;
+    GLuint gpuMemoryTop = 0;
+    bool benchmarking = false;
+    bool allocationCheck = false;
+    GLuint warmupFrames = 60, measuredFrames = 600;
+    double tolerance = 10.0;
     
-    // Create a GLFW window object that we can use for GLFW's functions
-    GLFWwindow *window = glfwCreateWindow( WIDTH, HEIGHT, "C++ sect: OpenGL (lecture 7)", nullptr, nullptr );
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( 0 == strcmp( argv[i], "--record" ) && i + 1 < argc )
+        {
+            recordPath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--replay" ) && i + 1 < argc )
+        {
+            replayPath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--replay-step" ) && i + 1 < argc )
+        {
+            replayStep = ( GLfloat )atof( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--headless" ) )
+        {
+            headless = true;
+        }
+        else if ( 0 == strcmp( argv[i], "--frames" ) && i + 1 < argc )
+        {
+            frameLimit = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--dump-frame" ) && i + 1 < argc )
+        {
+            headlessContext.DumpFrame( ( GLuint )atoi( argv[++i] ) );
+        }
+        else if ( 0 == strcmp( argv[i], "--overlay" ) )
+        {
+            showOverlay = true;
+        }
+        else if ( 0 == strcmp( argv[i], "--trace" ) && i + 1 < argc )
+        {
+            tracePath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--capture" ) && i + 1 < argc )
+        {
+            capturePath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--capture-frame" ) && i + 1 < argc )
+        {
+            captureFrame = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--gpu-memory" ) && i + 1 < argc )
+        {
+            gpuMemoryReport = true;
+            gpuMemoryTop = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--alloc-check" ) )
+        {
+            allocationCheck = true;
+        }
+        else if ( 0 == strcmp( argv[i], "--benchmark" ) )
+        {
+            benchmarking = true;
+        }
+        else if ( 0 == strcmp( argv[i], "--warmup" ) && i + 1 < argc )
+        {
+            warmupFrames = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--measure" ) && i + 1 < argc )
+        {
+            measuredFrames = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--json" ) && i + 1 < argc )
+        {
+            jsonPath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--baseline" ) && i + 1 < argc )
+        {
+            baselinePath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--tolerance" ) && i + 1 < argc )
+        {
+            tolerance = atof( argv[++i] );
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--record <path>] [--replay <path>] [--replay-step <seconds>]"
+                      << " [--headless] [--frames <count>] [--dump-frame <frame>]... [--overlay] [--trace <path>]"
+                      << " [--capture <path>] [--capture-frame <frame>] [--gpu-memory <count>] [--alloc-check]"
+                      << " [--benchmark] [--warmup <frames>] [--measure <frames>] [--json <path>] [--baseline <path>] [--tolerance <percent>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
     
-    if ( nullptr == window )
+    if ( allocationCheck && !AllocationTracker::IsAvailable( ) )
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate( );
-        
+        std::cout << "--alloc-check needs a build with TRACK_ALLOCATIONS" << std::endl;
         return EXIT_FAILURE;
     }
     
-    glfwMakeContextCurrent( window );
+    if ( NULL != capturePath )
+    {
+        if ( !GLCapture::IsAvailable( ) )
+        {
+            std::cout << "--capture needs a build without NDEBUG" << std::endl;
+            return EXIT_FAILURE;
+        }
+        
+        GLCapture::CaptureFrame( capturePath, captureFrame );
+    }
+    
+    // CPU scopes from the start, so loading is in the trace too
+    if ( NULL != tracePath )
+    {
+        CpuProfiler::Enable( );
+        CpuProfiler::SetThreadName( "Main" );
+    }
+    
+    // The benchmark decides how long the run is
+    if ( benchmarking )
+    {
+        frameLimit = warmupFrames + measuredFrames;
+    }
     
-    glfwGetFramebufferSize( window, &SCREEN_WIDTH, &SCREEN_HEIGHT );
+    // Nothing would end a headless run otherwise
+    if ( headless && !replayPath && 0 == frameLimit )
+    {
+        frameLimit = 100;
+    }
+    
+    if ( NULL != replayPath )
+    {
+        if ( !cameraPath.Load( replayPath ) || replayStep <= 0.0f )
+        {
+            std::cout << "Failed to load camera path " << replayPath << std::endl;
+            return EXIT_FAILURE;
+        }
+        
+        replaying = true;
+    }
+    else if ( NULL != recordPath && !cameraPath.BeginRecording( recordPath ) )
+    {
+        std::cout << "Failed to create camera path " << recordPath << std::endl;
+        return EXIT_FAILURE;
+    }
     
-    // Set the required callback functions
-    glfwSetKeyCallback( window, KeyCallback );
-    glfwSetCursorPosCallback( window, MouseCallback );
+    GLFWwindow *window = nullptr;
     
-    // GLFW Options
-    glfwSetInputMode( window, GLFW_CURSOR, GLFW_CURSOR_DISABLED );
+    if ( headless )
+    {
+        if ( !headlessContext.CreateContext( ) )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        // Init GLFW
+        glfwInit( );
+        // Set all the required options for GLFW
+        glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
+        glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+        glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+        glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE );
+        glfwWindowHint( GLFW_RESIZABLE, GL_FALSE );
+        
+        // Create a GLFW window object that we can use for GLFW's functions
+        window = glfwCreateWindow( WIDTH, HEIGHT, "C++ sect: OpenGL (lecture 7)", nullptr, nullptr );
+        
+        if ( nullptr == window )
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate( );
+            
+            return EXIT_FAILURE;
+        }
+        
+        glfwMakeContextCurrent( window );
+        
+        glfwGetFramebufferSize( window, &SCREEN_WIDTH, &SCREEN_HEIGHT );
+        
+        // Set the required callback functions
+        glfwSetKeyCallback( window, KeyCallback );
+        glfwSetCursorPosCallback( window, MouseCallback );
+        
+        // GLFW Options
+        glfwSetInputMode( window, GLFW_CURSOR, GLFW_CURSOR_DISABLED );
+    }
     
     // Set this to true so GLEW knows to use a modern approach to retrieving function pointers and extensions
     glewExperimental = GL_TRUE;
     // Initialize GLEW to setup the OpenGL Function pointers
-    if ( GLEW_OK != glewInit( ) )
+    GLenum glewStatus = glewInit( );
+    
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // A GLEW built for GLX has loaded the functions by the time it finds there is no GLX display, which is fine without a window
+    if ( headless && GLEW_ERROR_NO_GLX_DISPLAY == glewStatus )
+    {
+        glewStatus = GLEW_OK;
+    }
+#endif
+    
+    if ( GLEW_OK != glewStatus )
     {
         std::cout << "Failed to initialize GLEW" << std::endl;
         return EXIT_FAILURE;
     }
     
+    if ( headless )
+    {
+        if ( !headlessContext.CreateFramebuffer( WIDTH, HEIGHT ) )
+        {
+            return EXIT_FAILURE;
+        }
+        
+        SCREEN_WIDTH = WIDTH;
+        SCREEN_HEIGHT = HEIGHT;
+    }
+    
     // Define the viewport dimensions
     glViewport( 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT );
     
@@ -92,6 +320,7 @@ int main( )
     // Setup and compile our shaders
     Shader shader( "res/shaders/cube.vs", "res/shaders/cube.frag" );
     Shader skyboxShader( "res/shaders/skybox.vs", "res/shaders/skybox.frag" );
+    Shader overlayShader( "res/shaders/overlay.vs", "res/shaders/overlay.frag" );
 
     
     GLfloat cubeVertices[] =
@@ -192,6 +421,7 @@ int main( )
     glBindVertexArray( cubeVAO );
     glBindBuffer( GL_ARRAY_BUFFER, cubeVBO );
     glBufferData( GL_ARRAY_BUFFER, sizeof( cubeVertices ), &cubeVertices, GL_STATIC_DRAW );
+    GpuMemory::RegisterBuffer( GL_ARRAY_BUFFER, cubeVBO, "cube" );
     glEnableVertexAttribArray(0);
     glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof( GLfloat ), ( GLvoid * ) 0 );
     glEnableVertexAttribArray( 1 );
@@ -205,10 +435,14 @@ int main( )
     glBindVertexArray( skyboxVAO );
     glBindBuffer( GL_ARRAY_BUFFER, skyboxVBO );
     glBufferData( GL_ARRAY_BUFFER, sizeof( skyboxVertices ), &skyboxVertices, GL_STATIC_DRAW );
+    GpuMemory::RegisterBuffer( GL_ARRAY_BUFFER, skyboxVBO, "skybox" );
     glEnableVertexAttribArray( 0 );
     glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( GLfloat ), ( GLvoid * ) 0 );
     glBindVertexArray(0);
     
+    // Decode from the per-thread arena, after the first texture the loads stop hitting the heap
+    SOIL_set_allocator( SOIL_get_arena_allocator( ) );
+    
     // Load textures
     GLuint cubeTexture = TextureLoading::LoadTexture( "res/images/container2.png" );
     
@@ -220,63 +454,165 @@ int main( )
     faces.push_back( "res/images/skybox/bottom.tga" );
     faces.push_back( "res/images/skybox/back.tga" );
     faces.push_back( "res/images/skybox/front.tga" );
-    GLuint cubemapTexture = TextureLoading::LoadCubemap( faces );
+    // Prefer the compressed HDR cubemap, the first run makes it from the faces with SOIL_save_HDR_cubemap_as_DDS
+    GLuint cubemapTexture = TextureLoading::LoadCompressedCubemap( "res/images/skybox/skybox.dds", faces );
+    if ( 0 == cubemapTexture )
+    {
+        cubemapTexture = TextureLoading::LoadCubemap( faces );
+    }
+    
+    // Loading is over, give the arena back
+    SOIL_set_allocator( NULL );
+    if ( !SOIL_arena_release( ) )
+    {
+        std::cout << "An image still points into the SOIL arena, it was not released" << std::endl;
+    }
 
     
-    glm::mat4 projection = glm::perspective( camera.GetZoom( ), ( float )SCREEN_WIDTH/( float )SCREEN_HEIGHT, 0.1f, 1000.0f );
+    camera.SetProjection( ( float )SCREEN_WIDTH/( float )SCREEN_HEIGHT, 0.1f, 1000.0f );
+    
+    // Get the uniform locations, they don't change once the programs are linked
+    GLint modelLoc = glGetUniformLocation( shader.Program, "model" );
+    GLint viewLoc = glGetUniformLocation( shader.Program, "view" );
+    GLint projLoc = glGetUniformLocation( shader.Program, "projection" );
+    GLint skyboxViewLoc = glGetUniformLocation( skyboxShader.Program, "view" );
+    GLint skyboxProjLoc = glGetUniformLocation( skyboxShader.Program, "projection" );
+    
+    shader.Use( );
+    glUniform1i( glGetUniformLocation( shader.Program, "texture1" ), 0 );
+    
+    // The camera version the uniforms were last uploaded for, uniforms stay with their program so
+    // nothing has to be sent again while the camera stands still
+    unsigned long uploadedCameraVersion = 0;
+    
+    if ( benchmarking )
+    {
+        benchmark.Start( warmupFrames, measuredFrames );
+        gpuProfiler.SetFirstMeasuredFrame( warmupFrames );
+    }
+    
+    gpuProfiler.Init( );
+    overlay.Init( overlayShader.Program );
+    
+    GLfloat replayStart = GetTime( );
+    GLuint frames = 0;
+    
+    // With --alloc-check, the frames after the warmup that allocated and the first of them
+    GLuint allocatingFrames = 0, firstAllocatingFrame = 0;
+    AllocationCount allocatedAfterWarmup = { 0, 0 }, firstFrameAllocated = { 0, 0 };
     
     // Game loop
-    while( !glfwWindowShouldClose( window ) )
+    while( headless || !glfwWindowShouldClose( window ) )
     {
+        if ( 0 != frameLimit && frames == frameLimit )
+        {
+            break;
+        }
+        
+        frames++;
+        
+        AllocationCount frameStartAllocations = AllocationTracker::GetThreadCount( );
+        CPU_PROFILE_SCOPE( "Frame" );
+        GLStats::BeginFrame( );
+        GLCapture::BeginFrame( );
+        benchmark.BeginFrame( );
+        gpuProfiler.BeginFrame( );
+        
         // Set frame time
-        GLfloat currentFrame = glfwGetTime( );
+        GLfloat currentFrame = GetTime( );
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         
         // Check and call events
-        glfwPollEvents( );
-        DoMovement( );
+        if ( !headless )
+        {
+            glfwPollEvents( );
+        }
+        
+        if ( replaying )
+        {
+            // Fixed timestep, so every run renders the same frames whatever the machine
+            deltaTime = replayStep;
+            
+            GLuint replayFrame = replayFrames;
+            
+            // A benchmark runs its number of frames, going round the path as often as that takes
+            if ( benchmark.IsEnabled( ) )
+            {
+                replayFrame %= ( GLuint )( cameraPath.GetDuration( ) / replayStep ) + 1;
+            }
+            
+            if ( !cameraPath.Apply( replayFrame * replayStep, camera ) )
+            {
+                break;
+            }
+            
+            replayFrames++;
+        }
+        else
+        {
+            DoMovement( );
+            cameraPath.Record( currentFrame, camera );
+        }
         
         // Clear the colorbuffer
         glClearColor( 0.05f, 0.05f, 0.05f, 1.0f );
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
         
+        // All the input of the frame is in, the camera updates once here
+        const glm::mat4 &view = camera.GetViewMatrix( );
+        const glm::mat4 &projection = camera.GetProjectionMatrix( );
+        bool cameraChanged = ( camera.GetVersion( ) != uploadedCameraVersion );
+        uploadedCameraVersion = camera.GetVersion( );
         
         glm::mat4 model(1);
-        glm::mat4 view = camera.GetViewMatrix();
+        
+        // The cube is left out when its bounding sphere is out of view
+        CpuProfileScope cullingScope( "Culling" );
+        bool cubeVisible = camera.IsSphereVisible( glm::vec3( model[3] ), 0.87f );
+        cullingScope.End( );
+        
+        CpuProfileScope submitScope( "Submit" );
         
         // Draw our first triangle
+        gpuProfiler.BeginScope( "Cube" );
         shader.Use( );
         
         // Bind Textures using texture units
         glActiveTexture( GL_TEXTURE0 );
         glBindTexture( GL_TEXTURE_2D, cubeTexture );
-        glUniform1i( glGetUniformLocation( shader.Program, "texture1" ), 0 );
-
-        // Get the uniform locations
-        GLint modelLoc = glGetUniformLocation( shader.Program, "model" );
-        GLint viewLoc = glGetUniformLocation( shader.Program, "view" );
-        GLint projLoc = glGetUniformLocation( shader.Program, "projection" );
         
         // Pass the matrices to the shader
-        glUniformMatrix4fv( viewLoc, 1, GL_FALSE, glm::value_ptr( view ) );
-        glUniformMatrix4fv( projLoc, 1, GL_FALSE, glm::value_ptr( projection ) );
+        if ( cameraChanged )
+        {
+            glUniformMatrix4fv( viewLoc, 1, GL_FALSE, glm::value_ptr( view ) );
+            glUniformMatrix4fv( projLoc, 1, GL_FALSE, glm::value_ptr( projection ) );
+        }
         
         glBindVertexArray( cubeVAO );
        
         // Calculate the model matrix for each object and pass it to shader before drawing
-        glUniformMatrix4fv( modelLoc, 1, GL_FALSE, glm::value_ptr( model ) );
-        glDrawArrays( GL_TRIANGLES, 0, 36 );
+        if ( cubeVisible )
+        {
+            glUniformMatrix4fv( modelLoc, 1, GL_FALSE, glm::value_ptr( model ) );
+            glDrawArrays( GL_TRIANGLES, 0, 36 );
+        }
         glBindVertexArray( 0 );
+        gpuProfiler.EndScope( );
         
         
         // Draw skybox as last
+        gpuProfiler.BeginScope( "Skybox" );
         glDepthFunc( GL_LEQUAL );  // Change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.Use( );
-        view = glm::mat4( glm::mat3( camera.GetViewMatrix( ) ) );	// Remove any translation component of the view matrix
         
-        glUniformMatrix4fv( glGetUniformLocation( skyboxShader.Program, "view" ), 1, GL_FALSE, glm::value_ptr( view ) );
-        glUniformMatrix4fv( glGetUniformLocation( skyboxShader.Program, "projection" ), 1, GL_FALSE, glm::value_ptr( projection ) );
+        if ( cameraChanged )
+        {
+            glm::mat4 skyboxView = glm::mat4( glm::mat3( view ) );	// Remove any translation component of the view matrix
+            
+            glUniformMatrix4fv( skyboxViewLoc, 1, GL_FALSE, glm::value_ptr( skyboxView ) );
+            glUniformMatrix4fv( skyboxProjLoc, 1, GL_FALSE, glm::value_ptr( projection ) );
+        }
         
         // skybox cube
         glBindVertexArray( skyboxVAO );
@@ -284,15 +620,204 @@ int main( )
         glDrawArrays( GL_TRIANGLES, 0, 36 );
         glBindVertexArray( 0 );
         glDepthFunc( GL_LESS ); // Set depth function back to default
-
+        gpuProfiler.EndScope( );
         
+        // The averages lag a few frames behind, the queries are read once the GPU is done with them
+        if ( showOverlay )
+        {
+            gpuProfiler.BeginScope( "Overlay" );
+            overlay.Clear( );
+            overlay.Print( "GPU MS, %u FRAME AVERAGE", ( GLuint )GpuProfiler::AVERAGE_FRAMES );
+            
+            for ( GLuint i = 0; i < gpuProfiler.GetScopeCount( ); i++ )
+            {
+                overlay.Print( "%*s%-*s%8.3f", 2 * gpuProfiler.GetScopeDepth( i ), "", 14 - 2 * gpuProfiler.GetScopeDepth( i ), gpuProfiler.GetScopeName( i ), gpuProfiler.GetRollingAverage( i ) );
+            }
+            
+            if ( GLStats::IsAvailable( ) )
+            {
+                const GLFrameStats &stats = GLStats::GetLastFrame( );
+                
+                overlay.Print( "GL CALLS, LAST FRAME" );
+                overlay.Print( "  DRAWS %llu, TRIANGLES %llu", stats.drawCalls, stats.triangles );
+                overlay.Print( "  BINDS PROGRAM %llu VAO %llu TEXTURE %llu", stats.programBinds, stats.vertexArrayBinds, stats.textureBinds );
+                overlay.Print( "  UNIFORMS %llu, %llu BYTES", stats.uniformUploads, stats.uniformBytes );
+                overlay.Print( "  UPLOADS BUFFER %llu TEXTURE %llu BYTES", stats.bufferUploadBytes, stats.textureUploadBytes );
+            }
+            
+            const double MB = 1024.0 * 1024.0;
+            overlay.Print( "GPU MEMORY %.2f MB", GpuMemory::GetTotal( ) / MB );
+            overlay.Print( "  TEXTURES %.2f CUBEMAPS %.2f", GpuMemory::GetTotal( GpuMemory::TEXTURES ) / MB, GpuMemory::GetTotal( GpuMemory::CUBEMAPS ) / MB );
+            overlay.Print( "  BUFFERS %.2f TARGETS %.2f",
+                           ( GpuMemory::GetTotal( GpuMemory::VERTEX_BUFFERS ) + GpuMemory::GetTotal( GpuMemory::INDEX_BUFFERS ) + GpuMemory::GetTotal( GpuMemory::OTHER_BUFFERS ) ) / MB,
+                           GpuMemory::GetTotal( GpuMemory::RENDER_TARGETS ) / MB );
+            
+            overlay.Draw( SCREEN_WIDTH, SCREEN_HEIGHT );
+            gpuProfiler.EndScope( );
+        }
+        
+        submitScope.End( );
+        GLCapture::EndFrame( );
+
+        // Record the frame, the read back and the encoding happen in the background
+        if ( recording )
+        {
+            if ( NULL == frameCapture )
+            {
+                frameCapture = SOIL_capture_create( SOIL_SAVE_TYPE_JPG, 90, 0, 0 );
+            }
+            
+            char filename[32];
+            sprintf( filename, "frame_%05u.jpg", capturedFrames++ );
+            SOIL_capture_frame( frameCapture, filename, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT );
+        }
                
+        gpuProfiler.EndFrame( );
+        benchmark.EndFrame( );
+        
         // Swap the buffers
-        glfwSwapBuffers( window );
+        if ( headless )
+        {
+            headlessContext.EndFrame( );
+        }
+        else
+        {
+            glfwSwapBuffers( window );
+        }
+        
+        // Once warm, a frame has everything it needs and should not touch the heap
+        if ( allocationCheck && frames > warmupFrames )
+        {
+            AllocationCount allocated = AllocationTracker::Difference( frameStartAllocations, AllocationTracker::GetThreadCount( ) );
+            
+            if ( 0 != allocated.allocations )
+            {
+                if ( 0 == allocatingFrames )
+                {
+                    firstAllocatingFrame = frames - 1;
+                    firstFrameAllocated = allocated;
+                }
+                
+                allocatingFrames++;
+                allocatedAfterWarmup.allocations += allocated.allocations;
+                allocatedAfterWarmup.bytes += allocated.bytes;
+            }
+        }
+    }
+    
+    // Waits for the frames still being written
+    SOIL_capture_destroy( frameCapture );
+    
+    // Before anything is deleted, so the report has all the lesson made
+    if ( gpuMemoryReport )
+    {
+        GpuMemory::PrintReport( gpuMemoryTop );
+    }
+    
+    cameraPath.EndRecording( );
+    
+    int exitCode = EXIT_SUCCESS;
+    
+    if ( benchmark.IsEnabled( ) )
+    {
+        benchmark.Finish( );
+        gpuProfiler.Flush( );
+        
+        // The passes are only there to explain a change of the frame time, they are not compared with the baseline
+        for ( GLuint i = 1; i < gpuProfiler.GetScopeCount( ); i++ )
+        {
+            std::string name = gpuProfiler.GetScopeName( i );
+            std::transform( name.begin( ), name.end( ), name.begin( ), ::tolower );
+            benchmark.AddMetric( "gpu_pass_" + name + "_ms", gpuProfiler.GetMeasuredAverage( i ), false );
+        }
+        
+        // Only the total is compared, growing past the tolerance is a regression like a slower frame
+        for ( GLuint i = 0; i < GpuMemory::CATEGORY_COUNT; i++ )
+        {
+            benchmark.AddMetric( std::string( "gpu_memory_" ) + GpuMemory::GetCategoryName( ( GpuMemory::Category )i ) + "_bytes", ( double )GpuMemory::GetTotal( ( GpuMemory::Category )i ), false );
+        }
+        
+        benchmark.AddMetric( "gpu_memory_bytes", ( double )GpuMemory::GetTotal( ), true );
+        
+        if ( !benchmark.WriteJson( jsonPath, "07_Skybox" ) )
+        {
+            std::cout << "Failed to write " << jsonPath << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+        
+        // A regression, or a baseline that can't be read, fails the run
+        if ( NULL != baselinePath && 0 != benchmark.CompareWithBaseline( baselinePath, tolerance ) )
+        {
+            exitCode = EXIT_FAILURE;
+        }
+    }
+    
+    // After the benchmark, which counts its memory too
+    overlay.Destroy( );
+    gpuProfiler.Destroy( );
+    
+    if ( allocationCheck )
+    {
+        // Nothing checked is no pass, --frames has to go past --warmup
+        if ( frames <= warmupFrames )
+        {
+            std::cout << "No frames checked for allocations, the run ended within the " << warmupFrames << " warmup frames" << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+        else if ( 0 != allocatingFrames )
+        {
+            // --trace gives the allocations of every scope
+            printf( "ALLOCATIONS in %u of %u frames after the warmup: %llu, %llu bytes; the first in frame %u: %llu, %llu bytes\n",
+                    allocatingFrames, frames - warmupFrames, allocatedAfterWarmup.allocations, allocatedAfterWarmup.bytes,
+                    firstAllocatingFrame, firstFrameAllocated.allocations, firstFrameAllocated.bytes );
+            exitCode = EXIT_FAILURE;
+        }
+        else
+        {
+            printf( "No allocations in the %u frames after the warmup\n", frames - warmupFrames );
+        }
+    }
+    
+    if ( NULL != capturePath && GLCapture::IsPending( ) )
+    {
+        std::cout << "Nothing captured, the run ended before frame " << captureFrame << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    else if ( NULL != capturePath && GLCapture::HasFailed( ) )
+    {
+        std::cout << "Failed to write " << capturePath << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    
+    if ( NULL != tracePath && !CpuProfiler::WriteTrace( tracePath ) )
+    {
+        std::cout << "Failed to write " << tracePath << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    
+    if ( replaying )
+    {
+        GLfloat replayTime = GetTime( ) - replayStart;
+        
+        printf( "Replayed %u frames in %.3f s, %.3f ms per frame\n", replayFrames, replayTime, replayFrames ? 1000.0f * replayTime / replayFrames : 0.0f );
+    }
+    
+    if ( headless )
+    {
+        headlessContext.Destroy( );
+    }
+    else
+    {
+        glfwTerminate( );
     }
     
-    glfwTerminate( );
-    return 0;
+    return exitCode;
+}
+
+// Seconds since the start, GLFW's timer is only there with a window
+double GetTime( )
+{
+    return headless ? headlessContext.GetTime( ) : glfwGetTime( );
 }
 
 
@@ -329,6 +854,16 @@ void KeyCallback( GLFWwindow *window, int key, int scancode, int action, int mod
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
     
+    if ( GLFW_KEY_R == key && GLFW_PRESS == action )
+    {
+        recording = !recording;
+    }
+    
+    if ( GLFW_KEY_O == key && GLFW_PRESS == action )
+    {
+        showOverlay = !showOverlay;
+    }
+    
     if ( key >= 0 && key < 1024 )
     {
         if ( action == GLFW_PRESS )
@@ -344,6 +879,12 @@ void KeyCallback( GLFWwindow *window, int key, int scancode, int action, int mod
 
 void MouseCallback( GLFWwindow *window, double xPos, double yPos )
 {
+    // The recorded path drives the camera
+    if ( replaying )
+    {
+        return;
+    }
+    
     if ( firstMouse )
     {
         lastX = xPos;
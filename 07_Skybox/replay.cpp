@@ -0,0 +1,144 @@
+// Std. Includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// GL includes
+#include "Benchmark.h"
+#include "GLReplay.h"
+#include "GLStats.h"
+#include "Headless.h"
+
+// Runs a frame captured with --capture again and again, headless, and times it like --benchmark times the lesson:
+// the same JSON and the same baseline comparison, without the lesson, its assets or a window. GALLIUM_DRIVER picks
+// the software driver to compare, e.g. llvmpipe and softpipe, or two builds of Mesa.
+int main( int argc, char *argv[] )
+{
+    const char *tracePath = NULL;
+    const char *jsonPath = NULL;
+    const char *baselinePath = NULL;
+    GLuint warmupFrames = 10, measuredFrames = 100;
+    double tolerance = 10.0;
+    Headless headless;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( 0 == strcmp( argv[i], "--warmup" ) && i + 1 < argc )
+        {
+            warmupFrames = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--measure" ) && i + 1 < argc )
+        {
+            measuredFrames = ( GLuint )atoi( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--json" ) && i + 1 < argc )
+        {
+            jsonPath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--baseline" ) && i + 1 < argc )
+        {
+            baselinePath = argv[++i];
+        }
+        else if ( 0 == strcmp( argv[i], "--tolerance" ) && i + 1 < argc )
+        {
+            tolerance = atof( argv[++i] );
+        }
+        else if ( 0 == strcmp( argv[i], "--dump-frame" ) && i + 1 < argc )
+        {
+            headless.DumpFrame( ( GLuint )atoi( argv[++i] ) );
+        }
+        else if ( NULL == tracePath && '-' != argv[i][0] )
+        {
+            tracePath = argv[i];
+        }
+        else
+        {
+            tracePath = NULL;
+            break;
+        }
+    }
+
+    if ( NULL == tracePath )
+    {
+        std::cout << "Usage: " << argv[0] << " <trace> [--warmup <frames>] [--measure <frames>] [--json <path>] [--baseline <path>] [--tolerance <percent>]"
+                  << " [--dump-frame <frame>]..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if ( !headless.CreateContext( ) )
+    {
+        return EXIT_FAILURE;
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit( );
+
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // A GLEW built for GLX has loaded the functions by the time it finds there is no GLX display, which is fine without a window
+    if ( GLEW_ERROR_NO_GLX_DISPLAY == glewStatus )
+    {
+        glewStatus = GLEW_OK;
+    }
+#endif
+
+    if ( GLEW_OK != glewStatus )
+    {
+        std::cout << "Failed to initialize GLEW" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int exitCode = EXIT_SUCCESS;
+
+    // Scoped, so the objects of the trace go before the context
+    {
+        GLReplay replay;
+        std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now( );
+
+        if ( !replay.Load( tracePath ) || !headless.CreateFramebuffer( replay.GetWidth( ), replay.GetHeight( ) ) )
+        {
+            return EXIT_FAILURE;
+        }
+
+        glFinish( );
+        printf( "Loaded %s: %u calls, %u objects, %zu bytes in %.3f ms\n", tracePath, replay.GetCallCount( ), replay.GetObjectCount( ), replay.GetTraceSize( ),
+                std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - loadStart ).count( ) );
+
+        Benchmark benchmark;
+        benchmark.Start( warmupFrames, measuredFrames );
+
+        for ( GLuint frame = 0; frame < benchmark.GetTotalFrames( ); frame++ )
+        {
+            GLStats::BeginFrame( );
+            benchmark.BeginFrame( );
+            replay.Execute( );
+            benchmark.EndFrame( );
+            headless.EndFrame( );
+        }
+
+        benchmark.Finish( );
+
+        if ( !benchmark.WriteJson( jsonPath, tracePath ) )
+        {
+            std::cout << "Failed to write " << jsonPath << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+
+        // A regression, or a baseline that can't be read, fails the run
+        if ( NULL != baselinePath && 0 != benchmark.CompareWithBaseline( baselinePath, tolerance ) )
+        {
+            exitCode = EXIT_FAILURE;
+        }
+
+        replay.Destroy( );
+    }
+
+    headless.Destroy( );
+
+    return exitCode;
+}
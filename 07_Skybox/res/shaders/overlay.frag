@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 TexCoords;
+in vec4 Color;
+out vec4 color;
+
+uniform sampler2D font;
+
+void main()
+{
+    color = vec4(Color.rgb, Color.a * texture(font, TexCoords).r);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 texCoords;
+layout (location = 2) in vec4 color;
+out vec2 TexCoords;
+out vec4 Color;
+
+// Positions are in pixels from the top left
+uniform vec2 screenSize;
+
+
+void main()
+{
+    gl_Position = vec4(position.x / screenSize.x * 2.0 - 1.0, 1.0 - position.y / screenSize.y * 2.0, 0.0, 1.0);
+    TexCoords = texCoords;
+    Color = color;
+}